@@ -0,0 +1,88 @@
+/* Compare writing text with writing an Arrow IPC file.  The data file
+   is converted to /dev/null once with --format=text and once with
+   --format=arrow.  Arrow output copies doubles instead of formatting
+   them and should be much faster.
+
+   Usage: bench/bench_arrow [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_arrow.iout";
+static const char *data_file = "bench/tmp/bench_arrow.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, int format)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.format = format;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    unsigned long nrecord;
+    double t;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_arrow: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_arrow: %lu records\n", nrecord);
+    t = convert(&layout, FORMAT_TEXT);
+    printf("%-16s %8.3f s %12.0f records/s\n", "--format=text", t,
+        nrecord / t);
+    t = convert(&layout, FORMAT_ARROW);
+    printf("%-16s %8.3f s %12.0f records/s\n", "--format=arrow", t,
+        nrecord / t);
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,192 @@
+/* Measure converting many small result sets, as from an analysis that
+   was split into chunks, once as one r3shuffle process per result set,
+   all started at once, and once as a single run with --manifest.  Both
+   modes write one output file per result set, FILE.txt, and use the
+   same number of threads per conversion.  Every mode runs REPEAT times
+   and we keep the fastest run.
+
+   Usage: bench/bench_batch [NSET [NSNP [NTRAIT [NTHREAD]]]] */
+
+#include "parse_layout_file.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static const char *program = "./r3shuffle";
+static const char *manifest = "bench/tmp/bench_batch.manifest";
+
+enum { REPEAT = 3, MAX_NAME = 64 };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static pid_t start(const char *argv[])
+{
+    pid_t pid;
+
+    if ((pid = fork()) == -1) {
+        perror("bench_batch: fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        execv(program, (char **) argv);
+        perror(program);
+        _exit(127);
+    }
+    return pid;
+}
+
+static void finish(pid_t pid)
+{
+    int status;
+
+    if (waitpid(pid, &status, 0) != pid
+        ||  !WIFEXITED(status)  ||  WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench_batch: %s failed\n", program);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Start one process per result set at once and wait for all of
+   them. */
+static double run_processes(char (*prefix)[MAX_NAME],
+    char (*output)[MAX_NAME], int nset, const char *threads)
+{
+    const char *argv[6];
+    pid_t *pids;
+    double t;
+    int i;
+
+    if ((pids = (pid_t *) malloc(nset * sizeof(pid_t))) == NULL) {
+        fprintf(stderr, "bench_batch: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    t = now();
+    for (i = 0; i < nset; i++) {
+        argv[0] = program;
+        argv[1] = threads;
+        argv[2] = "-o";
+        argv[3] = output[i];
+        argv[4] = prefix[i];
+        argv[5] = NULL;
+        pids[i] = start(argv);
+    }
+    for (i = 0; i < nset; i++)
+        finish(pids[i]);
+    t = now() - t;
+    free(pids);
+    return t;
+}
+
+static double run_batch(const char *threads)
+{
+    const char *argv[4];
+    char option[MAX_NAME + 16];
+    double t;
+
+    sprintf(option, "--manifest=%s", manifest);
+    argv[0] = program;
+    argv[1] = threads;
+    argv[2] = option;
+    argv[3] = NULL;
+    t = now();
+    finish(start(argv));
+    return now() - t;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    char (*prefix)[MAX_NAME], (*output)[MAX_NAME], file[MAX_NAME + 8];
+    char threads[32];
+    double t, best[2], mb;
+    int nset, nthread, i, k, mode;
+    FILE *fp;
+
+    nset = argc > 1 ? atoi(argv[1]) : 50;
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nsnp             = argc > 2 ? atoi(argv[2]) : 4000;
+    layout.ntrait           = argc > 3 ? atoi(argv[3]) : 20;
+    nthread                 = argc > 4 ? atoi(argv[4]) : 2;
+    layout.nvar             = 3;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+    sprintf(threads, "--threads=%d", nthread);
+
+    prefix = malloc(nset * sizeof(*prefix));
+    output = malloc(nset * sizeof(*output));
+    if (prefix == NULL  ||  output == NULL
+        ||  !make_synthetic_layout(&layout)
+        ||  (fp = fopen(manifest, "w")) == NULL) {
+        fprintf(stderr, "bench_batch: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+    /* All result sets are links to the files of the first, so that
+       they share the page cache like chunks of similar size would. */
+    for (i = 0; i < nset; i++) {
+        sprintf(prefix[i], "bench/tmp/bench_batch_%d", i);
+        sprintf(output[i], "%s.txt", prefix[i]);
+        fprintf(fp, "%s\n", prefix[i]);
+    }
+    fclose(fp);
+    if (!write_synthetic_files("bench/tmp/bench_batch_0.iout",
+            "bench/tmp/bench_batch_0.out", &layout)) {
+        fprintf(stderr, "bench_batch: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 1; i < nset; i++) {
+        sprintf(file, "%s.iout", prefix[i]);
+        remove(file);
+        k = symlink("bench_batch_0.iout", file);
+        sprintf(file, "%s.out", prefix[i]);
+        remove(file);
+        if (k != 0  ||  symlink("bench_batch_0.out", file) != 0) {
+            perror("bench_batch: symlink");
+            return EXIT_FAILURE;
+        }
+    }
+
+    mb = (double) nset * layout.nsnp * layout.ntrait
+        * (2 * layout.nvar + layout.ncov) * layout.bytes_per_double / 1e6;
+    printf("# bench_batch: %d result sets of %d snps x %d traits, "
+        "%.0f MB in total, %d threads\n", nset, layout.nsnp,
+        layout.ntrait, mb, nthread);
+    printf("mode\tseconds\tMB/s\n");
+    for (mode = 0; mode < 2; mode++) {
+        for (k = 0; k < REPEAT; k++) {
+            t = mode == 0 ? run_processes(prefix, output, nset, threads)
+                : run_batch(threads);
+            if (k == 0  ||  t < best[mode])
+                best[mode] = t;
+        }
+        printf("%s\t%.3f\t%.0f\n", mode == 0 ? "processes" : "manifest",
+            best[mode], mb / best[mode]);
+        fflush(stdout);
+    }
+    printf("# speedup of --manifest: %.2fx\n", best[0] / best[1]);
+
+    for (i = 0; i < nset; i++) {
+        sprintf(file, "%s.iout", prefix[i]);
+        remove(file);
+        sprintf(file, "%s.out", prefix[i]);
+        remove(file);
+        remove(output[i]);
+    }
+    remove(manifest);
+    free_synthetic_layout(&layout);
+    free(prefix);
+    free(output);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,122 @@
+/* Measure --compress=bgzf.  The data file is converted without
+   compression and with BGZF compression on 1, 2, and 4 threads, and
+   single lines are then looked up through the index.  A lookup
+   decompresses about one block, whatever the size of the output.
+
+   Usage: bench/bench_bgzf [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "result_index.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+enum { NLOOKUP = 1000 };
+
+static const char *layout_file = "bench/tmp/bench_bgzf.iout";
+static const char *data_file = "bench/tmp/bench_bgzf.out";
+static const char *output_file = "bench/tmp/bench_bgzf.txt";
+static const char *index_file = "bench/tmp/bench_bgzf.txt.r3i";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, int compress, int nthread)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = (char *) output_file;
+    params.compress = compress;
+    params.nthread = nthread;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+static double file_size(const char *file)
+{
+    struct stat st;
+
+    return stat(file, &st) == 0 ? st.st_size : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    unsigned long nrecord;
+    char line[4096];
+    double t, size;
+    int i, nthread;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_bgzf: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_bgzf: %lu records\n", nrecord);
+    t = convert(&layout, COMPRESS_NONE, 1);
+    size = file_size(output_file);
+    printf("%-24s %8.3f s %12.0f records/s %12.0f bytes\n",
+        "--compress=none", t, nrecord / t, size);
+    for (nthread = 1; nthread <= 4; nthread *= 2) {
+        t = convert(&layout, COMPRESS_BGZF, nthread);
+        printf("--compress=bgzf -t %-5d %8.3f s %12.0f records/s "
+            "%12.0f bytes\n", nthread, t, nrecord / t,
+            file_size(output_file));
+    }
+
+    srand(1);
+    t = now();
+    for (i = 0; i < NLOOKUP; i++)
+        if (!fetch_result(output_file, index_file, &layout,
+                rand() % layout.nsnp, rand() % layout.ntrait, line,
+                sizeof line)) {
+            pr_err_msg();
+            return EXIT_FAILURE;
+        }
+    t = now() - t;
+    printf("%-24s %8.3f ms per line\n", "fetch_result", 1000 * t / NLOOKUP);
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+    remove(output_file);
+    remove(index_file);
+
+    return EXIT_SUCCESS;
+}
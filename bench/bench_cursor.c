@@ -0,0 +1,96 @@
+/* Measure how fast we find the snp and trait of every record in file
+   order, once with offset2index for every record, as we used to, and
+   once with a tile cursor.  The tile shapes are those of typical
+   OmicABEL runs, with sizes that leave undersized tiles at the right
+   and bottom margins.  Both walks must agree on every record.
+
+   Usage: bench/bench_cursor [NRECORD] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct Shape {
+    int nsnp, ntrait;
+    int snps_per_tile, traits_per_tile;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Walk the first nrecord records, with a cursor if use_cursor is set.
+   Return the time it took and a checksum of the indexes in *sum. */
+static double walk(struct Layout *layout, unsigned long nrecord,
+    int use_cursor, unsigned long *sum)
+{
+    struct TileCursor c;
+    unsigned long offset, s;
+    int snp, trait;
+    double t;
+
+    s = 0;
+    t = now();
+    if (use_cursor) {
+        init_tile_cursor(&c, layout, 0);
+        for (offset = 0; offset < nrecord; offset++) {
+            s += (unsigned long) c.snp * 31 + c.trait;
+            next_tile_cursor(&c);
+        }
+    }
+    else {
+        for (offset = 0; offset < nrecord; offset++) {
+            offset2index(offset, &snp, &trait, layout);
+            s += (unsigned long) snp * 31 + trait;
+        }
+    }
+    *sum = s;
+    return now() - t;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct Shape shapes[] = {
+        {  1000003,   97, 1000,   16 },
+        {   200003,  500, 4096,   64 },
+        {    20011, 5003,  256,  256 },
+        { 10000019,   10, 10000,   1 },
+    };
+    struct Layout layout;
+    unsigned long nrecord, n, sum[2];
+    double t[2];
+    int i;
+
+    nrecord = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000000UL;
+    printf("bench_cursor: up to %lu records\n", nrecord);
+    printf("%-26s %14s %14s %8s\n", "nsnp x ntrait / tile",
+        "offset2index/s", "cursor/s", "speedup");
+    for (i = 0; i < (int) (sizeof shapes / sizeof shapes[0]); i++) {
+        layout.nsnp = shapes[i].nsnp;
+        layout.ntrait = shapes[i].ntrait;
+        layout.snps_per_tile = shapes[i].snps_per_tile;
+        layout.traits_per_tile = shapes[i].traits_per_tile;
+        n = (unsigned long) layout.nsnp * layout.ntrait;
+        if (n > nrecord)
+            n = nrecord;
+
+        t[0] = walk(&layout, n, 0, &sum[0]);
+        t[1] = walk(&layout, n, 1, &sum[1]);
+        if (sum[0] != sum[1]) {
+            fprintf(stderr, "bench_cursor: cursor disagrees with "
+                "offset2index\n");
+            return EXIT_FAILURE;
+        }
+        printf("%8d x %-5d / %5d x %-3d %14.0f %14.0f %7.1fx\n",
+            layout.nsnp, layout.ntrait, layout.snps_per_tile,
+            layout.traits_per_tile, n / t[0], n / t[1], t[0] / t[1]);
+    }
+
+    return EXIT_SUCCESS;
+}
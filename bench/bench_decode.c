@@ -0,0 +1,79 @@
+/* Measure how fast every decode kernel converts float32 values and
+   values of the other byte order to native doubles, in GB of input
+   per second, and compare with a plain copy of native doubles.  The
+   buffers are about the size of a batch of wide records, so that they
+   stay in cache as they do during a conversion.  All kernels must
+   agree with the scalar kernel.
+
+   Usage: bench/bench_decode [NVALUE [NREPEAT]] */
+
+#include "decode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *level_names[] = { "scalar", "ssse3", "avx2" };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int sizes[] = {4, 8};
+    double *dst, *ref, t;
+    char *src;
+    size_t nvalue, i;
+    int nrepeat, r, k, swap, level;
+    DecodeFunc decode;
+
+    nvalue = argc > 1 ? strtoul(argv[1], NULL, 10) : 1UL << 15;
+    nrepeat = argc > 2 ? atoi(argv[2]) : 20000;
+    if ((src = (char *) malloc(nvalue * sizeof(double))) == NULL
+        ||  (dst = (double *) malloc(nvalue * sizeof(double))) == NULL
+        ||  (ref = (double *) malloc(nvalue * sizeof(double))) == NULL) {
+        fprintf(stderr, "bench_decode: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    srand(1);
+    for (i = 0; i < nvalue * sizeof(double); i++)
+        src[i] = (char) (rand() >> 8);
+
+    printf("bench_decode: %lu values, %d repeats, best kernel %s\n",
+        (unsigned long) nvalue, nrepeat, level_names[best_decode_level()]);
+    printf("%-8s %-6s %-7s %10s\n", "input", "swap", "kernel", "GB/s");
+    for (k = 0; k < 2; k++)
+        for (swap = 0; swap <= 1; swap++) {
+            find_decoder(sizes[k], swap, DECODE_SCALAR)(ref, src, nvalue);
+            for (level = DECODE_SCALAR; level <= best_decode_level();
+                 level++) {
+                decode = find_decoder(sizes[k], swap, level);
+                memset(dst, 0, nvalue * sizeof(double));
+                t = now();
+                for (r = 0; r < nrepeat; r++)
+                    decode(dst, src, nvalue);
+                t = now() - t;
+
+                /* Random bits make NaNs, so compare bits. */
+                if (memcmp(dst, ref, nvalue * sizeof(double))) {
+                    fprintf(stderr, "bench_decode: %s kernel disagrees "
+                        "with scalar kernel\n", level_names[level]);
+                    return EXIT_FAILURE;
+                }
+                printf("%-8s %-6s %-7s %10.2f\n",
+                    sizes[k] == 4 ? "float32" : "float64",
+                    swap ? "yes" : "no", level_names[level],
+                    (double) nvalue * sizes[k] * nrepeat / t / 1e9);
+            }
+        }
+
+    free(src);
+    free(dst);
+    free(ref);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/* Measure r3shuffle end to end on a synthetic data set.  We write a
+   layout file and a data file of the given dimensions and run
+   ./r3shuffle on them for a fixed matrix of scenarios: a full scan,
+   with mmap(2) and with buffered reads, a subset of the columns,
+   several --digits, --order=trait, and --threads.  Every scenario
+   runs REPEAT times; we keep the fastest run and the largest peak
+   resident set size.  The results are printed as tab-separated
+   columns with a header line, ready for other tools to pick up.
+
+   Usage: bench/bench_e2e [NSNP [NTRAIT [NVAR [SNPS_PER_TILE
+          [TRAITS_PER_TILE]]]]] */
+
+#include "parse_layout_file.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static const char *program = "./r3shuffle";
+static const char *base = "bench/tmp/bench_e2e";
+static const char *layout_file = "bench/tmp/bench_e2e.iout";
+static const char *data_file = "bench/tmp/bench_e2e.out";
+static const char *output_file = "bench/tmp/bench_e2e.txt";
+
+enum { REPEAT = 3, MAX_ARGS = 8 };
+
+struct Scenario {
+    const char *name;
+    const char *args[MAX_ARGS];
+};
+
+static const struct Scenario scenarios[] = {
+    { "full",           { NULL } },
+    { "full-no-mmap",   { "--no-mmap", NULL } },
+    { "columns",        { "-c", "beta0", "-c", "se0", NULL } },
+    { "digits-3",       { "--digits=3", NULL } },
+    { "digits-15",      { "--digits=15", NULL } },
+    { "digits-shortest", { "--digits=shortest", NULL } },
+    { "order-trait",    { "--order=trait", NULL } },
+    { "threads-4",      { "--threads=4", NULL } },
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Run r3shuffle once for scenario s.  Return the wall time and set
+   *rss to the peak resident set size of the run in kilobytes. */
+static double run(const struct Scenario *s, long *rss)
+{
+    const char *argv[MAX_ARGS + 5];
+    struct rusage usage;
+    double t;
+    pid_t pid;
+    int i, n, status;
+
+    n = 0;
+    argv[n++] = program;
+    for (i = 0; s->args[i] != NULL; i++)
+        argv[n++] = s->args[i];
+    argv[n++] = "-o";
+    argv[n++] = output_file;
+    argv[n++] = base;
+    argv[n] = NULL;
+
+    t = now();
+    if ((pid = fork()) == -1) {
+        perror("bench_e2e: fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        execv(program, (char **) argv);
+        perror(program);
+        _exit(127);
+    }
+    if (wait4(pid, &status, 0, &usage) != pid
+        ||  !WIFEXITED(status)  ||  WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench_e2e: %s failed in scenario %s\n", program,
+            s->name);
+        exit(EXIT_FAILURE);
+    }
+    t = now() - t;
+    *rss = usage.ru_maxrss;
+
+    return t;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    struct stat st;
+    unsigned long nrecord;
+    double mb, t, best;
+    long rss, max_rss;
+    int i, k;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.nvar             = argc > 3 ? atoi(argv[3]) : 3;
+    layout.snps_per_tile    = argc > 4 ? atoi(argv[4]) : 1000;
+    layout.traits_per_tile  = argc > 5 ? atoi(argv[5]) : 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_e2e: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    mb = (double) nrecord * (2 * layout.nvar + layout.ncov)
+        * layout.bytes_per_double / 1e6;
+    printf("# bench_e2e: %d snps x %d traits, %d variables, tiles of "
+        "%d x %d, %.0f MB\n", layout.nsnp, layout.ntrait, layout.nvar,
+        layout.snps_per_tile, layout.traits_per_tile, mb);
+    printf("scenario\tseconds\tMB/s\trecords/s\tpeak_rss_kB\toutput_MB\n");
+    for (i = 0; i < (int) (sizeof scenarios / sizeof scenarios[0]); i++) {
+        best = 0.0;
+        max_rss = 0;
+        for (k = 0; k < REPEAT; k++) {
+            t = run(&scenarios[i], &rss);
+            if (k == 0  ||  t < best)
+                best = t;
+            if (rss > max_rss)
+                max_rss = rss;
+        }
+        if (stat(output_file, &st) != 0)
+            st.st_size = 0;
+        printf("%s\t%.3f\t%.0f\t%.0f\t%ld\t%.1f\n", scenarios[i].name,
+            best, mb / best, nrecord / best, max_rss, st.st_size / 1e6);
+        fflush(stdout);
+    }
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+    remove(output_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/* Measure the cost of --where.  The data file is converted to
+   /dev/null without a filter, with a filter that keeps all records,
+   and with a filter that keeps about one record in a thousand.  Since
+   rejected records are never formatted, the last conversion should be
+   much faster than the first.
+
+   Usage: bench/bench_filter [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "Filter.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_filter.iout";
+static const char *data_file = "bench/tmp/bench_filter.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, const char *where)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    if (where != NULL
+        &&  (params.filter = Filter_Compile(where, layout)) == NULL)
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    Filter_Destroy(params.filter);
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *filters[] = {
+        NULL,
+        "p(beta1) <= 1",
+        "abs(beta1) < 0.01 && p(beta1) < 1"
+    };
+    struct Layout layout;
+    unsigned long nrecord;
+    double t;
+    size_t i;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_filter: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_filter: %lu records\n", nrecord);
+    for (i = 0; i < sizeof filters / sizeof filters[0]; i++) {
+        t = convert(&layout, filters[i]);
+        printf("%-32s %8.3f s %12.0f records/s\n",
+            filters[i] != NULL ? filters[i] : "(no filter)", t,
+            nrecord / t);
+    }
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/* Measure how many doubles per second format_double and
+   snprintf("%.*g") turn into text for a few typical numbers of
+   significant digits.
+
+   Usage: bench/bench_format [N] */
+
+#include "format_double.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int digits[] = {3, 8, 17, FORMAT_DOUBLE_SHORTEST, 30};
+    char buf[FORMAT_DOUBLE_MAXLEN + 1], name[16];
+    double *x, t1, t2;
+    uint64_t state = 88172645463325252ULL;
+    size_t nchar1, nchar2;
+    int n, i, j, k, p;
+
+    n = argc > 1 ? atoi(argv[1]) : 1000000;
+    if ((x = (double *) malloc(n * sizeof(double))) == NULL)
+        return EXIT_FAILURE;
+
+    /* Regression estimates: a few significant digits, magnitudes
+       between 1e-8 and 1e2. */
+    for (i = 0; i < n; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        x[i] = (double) (state % 100000000) / 1e6;
+        for (k = (state >> 40) % 8; k > 0; k--)
+            x[i] /= 10.0;
+        if (state >> 63)
+            x[i] = -x[i];
+    }
+
+    printf("bench_format: %d doubles\n", n);
+    for (j = 0; j < (int) (sizeof digits / sizeof digits[0]); j++) {
+        p = digits[j];
+
+        nchar1 = 0;
+        t1 = now();
+        for (i = 0; i < n; i++)
+            nchar1 += snprintf(buf, sizeof buf, "%.*g",
+                p == FORMAT_DOUBLE_SHORTEST ? 17 : p, x[i]);
+        t1 = now() - t1;
+
+        nchar2 = 0;
+        t2 = now();
+        for (i = 0; i < n; i++)
+            nchar2 += format_double(buf, x[i], p) - buf;
+        t2 = now() - t2;
+
+        if (p == FORMAT_DOUBLE_SHORTEST)
+            strcpy(name, "shortest");
+        else
+            sprintf(name, "%d", p);
+        printf("digits=%-8s snprintf %11.0f/s  format_double %11.0f/s"
+            "  speedup %4.1fx  (%lu vs %lu chars)\n", name, n / t1,
+            n / t2, t1 / t2, (unsigned long) nchar1,
+            (unsigned long) nchar2);
+    }
+
+    free(x);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/* Measure label emission.  We write a layout file with max_char = 64,
+   parse it back, and copy the snp and trait labels of every record in
+   file order into a buffer, once by calling strlen(3) on the labels in
+   the layout file for every record, as we used to, and once through
+   LabelPool.  We also print how many bytes the snp pool allocates,
+   compared to a pool with a max_char-wide slot and the same
+   bookkeeping for every label of a tile, and time a full conversion
+   with a single column, where labels make up a large part of every
+   line.
+
+   Usage: bench/bench_labels [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "LabelPool.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_labels.iout";
+static const char *data_file = "bench/tmp/bench_labels.out";
+
+enum { BUFFER_SIZE = 1 << 16 };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Copy the labels of all records into a buffer, with a pool if use_pool
+   is set.  Return the time it took. */
+static double emit(struct Layout *layout, int use_pool,
+    unsigned long *pooled)
+{
+    LabelPool snps, traits;
+    struct TileCursor c;
+    const char *s;
+    char buf[BUFFER_SIZE], *t;
+    unsigned long offset, nrecord, sum;
+    size_t n;
+    double time;
+
+    snps = LabelPool_Create(layout, snp_label, layout->nsnp,
+        layout->snps_per_tile);
+    traits = LabelPool_Create(layout, trait_label, layout->ntrait,
+        layout->traits_per_tile);
+    if (snps == NULL  ||  traits == NULL) {
+        pr_err_msg();
+        exit(EXIT_FAILURE);
+    }
+
+    nrecord = (unsigned long) layout->nsnp * layout->ntrait;
+    sum = *pooled = 0;
+    t = buf;
+    time = now();
+    init_tile_cursor(&c, layout, 0);
+    for (offset = 0; offset < nrecord; offset++, next_tile_cursor(&c)) {
+        if (use_pool) {
+            s = LabelPool_Get(snps, c.snp, &n);
+            memcpy(t, s, n);
+            t += n;
+            *t++ = ' ';
+            s = LabelPool_Get(traits, c.trait, &n);
+            memcpy(t, s, n);
+            t += n;
+        }
+        else {
+            s = snp_label(layout, c.snp);
+            n = strlen(s);
+            memcpy(t, s, n);
+            t += n;
+            *t++ = ' ';
+            s = trait_label(layout, c.trait);
+            n = strlen(s);
+            memcpy(t, s, n);
+            t += n;
+        }
+        *t++ = '\n';
+        if (t - buf > BUFFER_SIZE - 2 * layout->max_char - 2) {
+            sum += buf[0] + (t - buf);
+            t = buf;
+        }
+    }
+    time = now() - time;
+    *pooled = LabelPool_Size(snps);
+    if (sum == 1)
+        printf("%lu\n", sum);   /* keep the copies */
+
+    LabelPool_Destroy(snps);
+    LabelPool_Destroy(traits);
+
+    return time;
+}
+
+static double convert(struct Layout *layout)
+{
+    struct Params params;
+    char *column = "beta1";
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.columns = &column;
+    params.ncolumn = 1;
+    if ((params.ucp2acp = (int *) malloc(2 * sizeof(int))) == NULL
+        ||  !set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout synthetic, layout;
+    unsigned long nrecord, pooled;
+    double t;
+    int i;
+
+    synthetic.magic_number     = 6;
+    synthetic.bytes_per_double = sizeof(double);
+    synthetic.nvar             = 3;
+    synthetic.nsnp             = argc > 1 ? atoi(argv[1]) : 100000;
+    synthetic.ntrait           = argc > 2 ? atoi(argv[2]) : 50;
+    synthetic.snps_per_tile    = 1000;
+    synthetic.traits_per_tile  = 16;
+    synthetic.max_char         = 64;
+
+    if (!make_synthetic_layout(&synthetic)
+        ||  !write_synthetic_files(layout_file, data_file, &synthetic)) {
+        fprintf(stderr, "bench_labels: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+    free_synthetic_layout(&synthetic);
+    if (!parse_layout_file(layout_file, &layout)) {
+        pr_err_msg();
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_labels: %lu records, max_char %d\n", nrecord,
+        layout.max_char);
+    printf("%-10s %14s %14s\n", "labels", "lines/s", "pool bytes");
+    for (i = 0; i < 2; i++) {
+        t = emit(&layout, i, &pooled);
+        printf("%-10s %14.0f %14lu\n", i ? "pool" : "strlen",
+            nrecord / t, i ? pooled : 0UL);
+    }
+    printf("%-10s %14s %14lu\n", "slots", "",
+        (unsigned long) layout.snps_per_tile
+        * (layout.max_char + 3 * sizeof(unsigned)));
+    t = convert(&layout);
+    printf("%-10s %14.0f\n", "-c beta1", nrecord / t);
+
+    free_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
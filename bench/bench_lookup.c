@@ -0,0 +1,129 @@
+/* Measure point lookups through a Lookup across queue depths.  For
+   every depth we read NLOOKUP single records at random offsets, once
+   with io_uring and once with the pool of pread(2) threads, and print
+   the mean latency per batch of depth reads and the reads per second.
+   Without O_DIRECT the file usually sits in the page cache, so this
+   measures the cost of a read more than that of the disk.
+
+   Usage: bench/bench_lookup [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "Lookup.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *layout_file = "bench/tmp/bench_lookup.iout";
+static const char *data_file = "bench/tmp/bench_lookup.out";
+
+enum { NLOOKUP = 1 << 16 };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Read NLOOKUP random records, depth at a time, and return the time it
+   took.  Set *uring if the Lookup used io_uring. */
+static double lookup(int fd, unsigned long nrecord, size_t nbytes,
+    int depth, int engine, int *uring)
+{
+    struct LookupRead *reads;
+    char *buf;
+    Lookup lk;
+    unsigned long i, k;
+    double t;
+
+    reads = (struct LookupRead *) malloc(depth * sizeof(*reads));
+    buf = (char *) malloc(depth * nbytes);
+    if (reads == NULL  ||  buf == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (depth * (sizeof(*reads) + nbytes)));
+        goto ERROR;
+    }
+    if ((lk = Lookup_Create(fd, data_file, nbytes, depth, engine)) == NULL)
+        goto ERROR;
+    *uring = Lookup_UsesIoUring(lk);
+
+    srand(1);
+    t = now();
+    for (k = 0; k < NLOOKUP; k += depth) {
+        for (i = 0; i < (unsigned long) depth; i++) {
+            reads[i].offset = (unsigned long) rand() % nrecord;
+            reads[i].n = 1;
+            reads[i].buf = buf + i * nbytes;
+        }
+        if (!Lookup_Run(lk, reads, depth))
+            goto ERROR;
+    }
+    t = now() - t;
+
+    Lookup_Destroy(lk);
+    free(reads);
+    free(buf);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int depths[] = {1, 4, 16, 64, 256};
+    static const char *engines[] = {"auto", "pread"};
+    struct Layout layout;
+    unsigned long nrecord;
+    size_t nbytes;
+    double t;
+    int i, e, fd, uring;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_lookup: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+    if ((fd = open(data_file, O_RDONLY)) == -1) {
+        fprintf(stderr, "bench_lookup: failed to open %s\n", data_file);
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    nbytes = (2 * layout.nvar + layout.ncov) * layout.bytes_per_double;
+    printf("bench_lookup: %d random reads of %lu records\n", NLOOKUP,
+        nrecord);
+    printf("%-8s %-10s %14s %14s\n", "depth", "engine", "batch us",
+        "reads/s");
+    for (i = 0; i < (int) (sizeof depths / sizeof depths[0]); i++)
+        for (e = LOOKUP_AUTO; e <= LOOKUP_PREAD; e++) {
+            t = lookup(fd, nrecord, nbytes, depths[i], e, &uring);
+            printf("%-8d %-10s %14.1f %14.0f\n", depths[i],
+                e == LOOKUP_AUTO && uring ? "io_uring" : engines[e],
+                t / (NLOOKUP / depths[i]) * 1e6, NLOOKUP / t);
+        }
+
+    close(fd);
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
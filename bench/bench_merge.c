@@ -0,0 +1,211 @@
+/* Measure merging result sets that were split by snps, once with the
+   same tiles as the merged result set and once with other tiles, and
+   compare with copying their data files into one with read(2) and
+   write(2), and with converting them to text.  Mode retile rewrites the
+   merged result set of merge-retile with a single trait per tile, so
+   that all snps of a trait follow each other.  All files are in the
+   page cache, so the numbers show what merging costs in CPU and memory
+   traffic.
+   Every mode runs REPEAT times and we keep the fastest run.
+
+   Usage: bench/bench_merge [NPART [NSNP [NTRAIT [NTHREAD]]]] */
+
+#include "merge_result_sets.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+enum { REPEAT = 3, MAX_NAME = 64, READ_BYTES = 1 << 20 };
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "bench_merge: %s: %s\n", what, err_msg);
+    exit(EXIT_FAILURE);
+}
+
+/* Copy all data files once from front to back into a single file,
+   which is the least any binary merge has to do. */
+static double copy_pass(char **prefix, int npart)
+{
+    char file[MAX_NAME + 8], *buf;
+    double t;
+    ssize_t n;
+    int i, fd, out;
+
+    if ((buf = (char *) malloc(READ_BYTES)) == NULL)
+        fail("out of memory");
+    t = now();
+    if ((out = open("bench/tmp/bench_merge.out", O_WRONLY | O_CREAT
+                | O_TRUNC, 0644)) == -1)
+        fail("bench/tmp/bench_merge.out");
+    for (i = 0; i < npart; i++) {
+        sprintf(file, "%s.out", prefix[i]);
+        if ((fd = open(file, O_RDONLY)) == -1)
+            fail(file);
+        while ((n = read(fd, buf, READ_BYTES)) > 0)
+            if (write(out, buf, n) != n)
+                fail("bench/tmp/bench_merge.out");
+        close(fd);
+    }
+    close(out);
+    t = now() - t;
+    free(buf);
+    return t;
+}
+
+static double merge(char **prefix, int npart, int nthread)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.command = COMMAND_MERGE;
+    params.inputs = prefix;
+    params.ninput = npart;
+    params.output_file = "bench/tmp/bench_merge";
+    params.nthread = nthread;
+    t = now();
+    if (!merge_result_sets(&params))
+        fail("merge");
+    return now() - t;
+}
+
+static double retile(int nsnp, int nthread)
+{
+    static char *merged[] = {"bench/tmp/bench_merge"};
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.command = COMMAND_RETILE;
+    params.inputs = merged;
+    params.ninput = 1;
+    params.output_file = "bench/tmp/bench_merge_retiled";
+    params.snps_per_tile = nsnp;
+    params.traits_per_tile = 1;
+    params.nthread = nthread;
+    t = now();
+    if (!merge_result_sets(&params))
+        fail("retile");
+    return now() - t;
+}
+
+/* Convert every part to text, as one would without merge. */
+static double convert(char **prefix, int npart, int nthread)
+{
+    struct Params params;
+    struct Layout layout;
+    char layout_file[MAX_NAME + 8], data_file[MAX_NAME + 8];
+    double t;
+    int i;
+
+    t = now();
+    for (i = 0; i < npart; i++) {
+        initialize_parameters(&params);
+        sprintf(layout_file, "%s.iout", prefix[i]);
+        sprintf(data_file, "%s.out", prefix[i]);
+        params.layout_file = layout_file;
+        params.data_file = data_file;
+        params.output_file = "bench/tmp/bench_merge.txt";
+        params.nthread = nthread;
+        if (!parse_layout_file(layout_file, &layout)
+            ||  !set_column_print_order(&params, &layout)
+            ||  !parse_data_file(&params, &layout))
+            fail("convert");
+        free_layout(&layout);
+        free(params.ucp2acp);
+    }
+    return now() - t;
+}
+
+int main(int argc, char *argv[])
+{
+    static const char *modes[] = {"copy", "merge", "merge-retile",
+        "retile", "text"};
+    struct Layout layout;
+    char **prefix, file[MAX_NAME + 8], data_file[MAX_NAME + 8];
+    double t, best, mb;
+    int npart, nsnp, nthread, i, k, mode;
+
+    npart = argc > 1 ? atoi(argv[1]) : 8;
+    nsnp = argc > 2 ? atoi(argv[2]) : 200000;
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.ntrait           = argc > 3 ? atoi(argv[3]) : 16;
+    nthread                 = argc > 4 ? atoi(argv[4]) : 1;
+    layout.nvar             = 3;
+    layout.max_char         = 16;
+
+    if ((prefix = (char **) malloc(npart * sizeof(char *))) == NULL)
+        fail("out of memory");
+    for (i = 0; i < npart; i++) {
+        if ((prefix[i] = (char *) malloc(MAX_NAME)) == NULL)
+            fail("out of memory");
+        sprintf(prefix[i], "bench/tmp/bench_merge_%d", i);
+    }
+
+    mb = (double) nsnp * layout.ntrait * (2 * layout.nvar
+        + layout.nvar * (layout.nvar - 1) / 2) * sizeof(double) / 1e6;
+    printf("# bench_merge: %d parts of %d snps x %d traits, %.0f MB in "
+        "total, %d threads\n", npart, nsnp / npart, layout.ntrait, mb,
+        nthread);
+    printf("mode\tseconds\tMB/s\n");
+    for (mode = 0; mode < 5; mode++) {
+        /* The first part decides the tiles of the merged result set.
+           Give it other tiles than the rest to make merge retile. */
+        if (mode <= 2)
+            for (i = 0; i < npart; i++) {
+                layout.nsnp = nsnp / npart;
+                layout.snps_per_tile = mode == 2  &&  i == 0 ? 700 : 1000;
+                layout.traits_per_tile = mode == 2  &&  i == 0 ? 5 : 16;
+                sprintf(file, "%s.iout", prefix[i]);
+                sprintf(data_file, "%s.out", prefix[i]);
+                if (!make_synthetic_layout(&layout))
+                    fail("out of memory");
+                if (!write_synthetic_files(file, data_file, &layout))
+                    fail("failed to write input files");
+                free_synthetic_layout(&layout);
+            }
+        for (k = 0; k < REPEAT; k++) {
+            t = mode == 0 ? copy_pass(prefix, npart)
+                : mode == 3 ? retile(nsnp, nthread)
+                : mode == 4 ? convert(prefix, npart, nthread)
+                : merge(prefix, npart, nthread);
+            if (k == 0  ||  t < best)
+                best = t;
+        }
+        printf("%s\t%.3f\t%.0f\n", modes[mode], best, mb / best);
+        fflush(stdout);
+    }
+
+    for (i = 0; i < npart; i++) {
+        sprintf(file, "%s.iout", prefix[i]);
+        remove(file);
+        sprintf(file, "%s.out", prefix[i]);
+        remove(file);
+        free(prefix[i]);
+    }
+    remove("bench/tmp/bench_merge.iout");
+    remove("bench/tmp/bench_merge.out");
+    remove("bench/tmp/bench_merge_retiled.iout");
+    remove("bench/tmp/bench_merge_retiled.out");
+    remove("bench/tmp/bench_merge.txt");
+    free(prefix);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/* Measure the cost of reading unused columns.  With 48 variables a
+   record holds 1224 doubles, most of them covariances, and spans more
+   than two pages.  The data file is converted to /dev/null once with
+   all columns and once with only the betas, both through a memory
+   mapping and with buffered reads.  With only the betas, most pages
+   of the data file are never read.  The bytes read are reported on
+   stderr; the timings also include formatting all columns.
+
+   Usage: bench/bench_projection [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_projection.iout";
+static const char *data_file = "bench/tmp/bench_projection.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, int ncolumn, char **columns,
+    int use_mmap)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.use_mmap = use_mmap;
+    params.io_report = 1;
+    params.ncolumn = ncolumn;
+    params.columns = columns;
+    if (ncolumn > 0  &&  (params.ucp2acp =
+            (int *) malloc((ncolumn + 1) * sizeof(int))) == NULL) {
+        set_err_msg("failed to allocate column map");
+        goto ERROR;
+    }
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    static char *betas[] = {"beta0", "beta1", "beta2"};
+    struct Layout layout;
+    unsigned long nrecord;
+    double t;
+    int use_mmap;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 48;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 2000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 10;
+    layout.snps_per_tile    = 500;
+    layout.traits_per_tile  = 5;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_projection: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_projection: %lu records\n", nrecord);
+    for (use_mmap = 1; use_mmap >= 0; use_mmap--) {
+        t = convert(&layout, 0, NULL, use_mmap);
+        printf("%-6s all columns  %8.3f s %12.0f records/s\n",
+            use_mmap ? "mmap" : "pread", t, nrecord / t);
+        t = convert(&layout, 3, betas, use_mmap);
+        printf("%-6s three betas  %8.3f s %12.0f records/s\n",
+            use_mmap ? "mmap" : "pread", t, nrecord / t);
+    }
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/* Compare the two ways parse_data_file can read the data file: one
+   fread(3) per record into a scratch buffer versus walking a read-only
+   memory mapping.  We first time a bare scan over all records and then
+   a full conversion to /dev/null through parse_data_file.
+
+   Usage: bench/bench_read [NSNP [NTRAIT [NVAR]]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "MappedFile.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_read.iout";
+static const char *data_file = "bench/tmp/bench_read.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Scan all records one fread(3) at a time. */
+static double scan_buffered(unsigned long nrecord, size_t nbytes)
+{
+    FILE *fp;
+    char *buf;
+    unsigned long k;
+    double sum = 0.0;
+
+    if ((fp = fopen(data_file, "rb")) == NULL
+        ||  (buf = (char *) malloc(nbytes)) == NULL)
+        exit(EXIT_FAILURE);
+    for (k = 0; k < nrecord; k++) {
+        if (fread(buf, nbytes, 1, fp) != 1)
+            exit(EXIT_FAILURE);
+        sum += ((double *) buf)[0];
+    }
+    free(buf);
+    fclose(fp);
+
+    return sum;
+}
+
+/* Scan all records through a memory mapping. */
+static double scan_mapped(unsigned long nrecord, size_t nbytes)
+{
+    MappedFile mf;
+    const char *p;
+    unsigned long k;
+    double sum = 0.0;
+
+    if ((mf = MappedFile_Open(data_file)) == NULL)
+        exit(EXIT_FAILURE);
+    p = MappedFile_Data(mf);
+    for (k = 0; k < nrecord; k++, p += nbytes)
+        sum += ((const double *) p)[0];
+    MappedFile_Close(mf);
+
+    return sum;
+}
+
+static double convert(struct Layout *layout, int use_mmap)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.use_mmap = use_mmap;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+static void report(const char *name, double seconds, double mbytes,
+    unsigned long nrecord)
+{
+    printf("%-18s %8.3f s %10.1f MB/s %12.0f records/s\n", name,
+        seconds, mbytes / seconds, nrecord / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    unsigned long nrecord;
+    size_t nbytes;
+    double t, mb, sum1, sum2;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = argc > 3 ? atoi(argv[3]) : 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 10;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_read: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    nbytes = (2 * layout.nvar + layout.ncov) * sizeof(double);
+    mb = nrecord * nbytes / 1e6;
+    printf("bench_read: %lu records of %lu bytes (%.1f MB)\n", nrecord,
+        (unsigned long) nbytes, mb);
+
+    t = now();
+    sum1 = scan_buffered(nrecord, nbytes);
+    report("scan fread", now() - t, mb, nrecord);
+
+    t = now();
+    sum2 = scan_mapped(nrecord, nbytes);
+    report("scan mmap", now() - t, mb, nrecord);
+
+    if (sum1 != sum2) {
+        fprintf(stderr, "bench_read: checksums differ\n");
+        return EXIT_FAILURE;
+    }
+
+    report("convert fread", convert(&layout, 0), mb, nrecord);
+    report("convert mmap", convert(&layout, 1), mb, nrecord);
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/* Measure how long it takes to extract a selection of snps and traits
+   with --snps-file and --traits-file, compared with converting the
+   whole data file.  Every k-th snp and every l-th trait is selected,
+   such that about NSEL_SNP snps and NSEL_TRAIT traits are selected.
+   Both the mapped data file and pread(2) are measured.  Note that the
+   data file will usually be in the page cache.
+
+   Usage: bench/bench_select [NSNP [NTRAIT [NSEL_SNP [NSEL_TRAIT]]]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_select.iout";
+static const char *data_file = "bench/tmp/bench_select.out";
+static const char *snps_file = "bench/tmp/bench_select.snps";
+static const char *traits_file = "bench/tmp/bench_select.traits";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, int select, int use_mmap)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.use_mmap = use_mmap;
+    if (select) {
+        params.snps_file = (char *) snps_file;
+        params.traits_file = (char *) traits_file;
+    }
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+/* Write every step-th of the n labels to file.  Return the number of
+   labels written. */
+static int write_labels(const char *file, char **labels, int n, int step)
+{
+    FILE *fp;
+    int i, k;
+
+    if ((fp = fopen(file, "w")) == NULL)
+        return -1;
+    for (i = k = 0; i < n; i += step, k++)
+        fprintf(fp, "%s\n", labels[i]);
+    if (fclose(fp))
+        return -1;
+    return k;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    unsigned long nrecord, nselected;
+    int nsel_snp, nsel_trait, use_mmap;
+    double t;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 2;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 100000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 200;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+    nsel_snp                = argc > 3 ? atoi(argv[3]) : 1000;
+    nsel_trait              = argc > 4 ? atoi(argv[4]) : 20;
+
+    if (nsel_snp < 1  ||  nsel_snp > layout.nsnp)
+        nsel_snp = layout.nsnp;
+    if (nsel_trait < 1  ||  nsel_trait > layout.ntrait)
+        nsel_trait = layout.ntrait;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)
+        ||  (nsel_snp = write_labels(snps_file, layout.snp_labels,
+                layout.nsnp, layout.nsnp / nsel_snp)) < 0
+        ||  (nsel_trait = write_labels(traits_file, layout.trait_labels,
+                layout.ntrait, layout.ntrait / nsel_trait)) < 0) {
+        fprintf(stderr, "bench_select: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    nselected = (unsigned long) nsel_snp * nsel_trait;
+    printf("bench_select: %lu records, %d snps x %d traits selected\n",
+        nrecord, nsel_snp, nsel_trait);
+    for (use_mmap = 1; use_mmap >= 0; use_mmap--) {
+        t = convert(&layout, 0, use_mmap);
+        printf("%-5s full scan %8.3f s %12.0f records/s\n",
+            use_mmap ? "mmap" : "pread", t, nrecord / t);
+        t = convert(&layout, 1, use_mmap);
+        printf("%-5s selection %8.3f s %12.0f records/s\n",
+            use_mmap ? "mmap" : "pread", t, nselected / t);
+    }
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+    remove(snps_file);
+    remove(traits_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,244 @@
+/* Load generator for "r3shuffle serve".  Start the server on a
+   synthetic result set and let NCLIENT clients send batches of BATCH
+   lookups of random snps and traits, three columns each, as fast as
+   they can for NBATCH batches per client.  Report the batches and
+   records per second, the round-trip latency that the clients see,
+   and the latency and cache statistics of the server.  For
+   comparison, run r3shuffle once per batch with --snps-file and
+   --traits-file, as one would without serve.
+
+   Usage: bench/bench_serve [NSNP [NTRAIT [NCLIENT [BATCH [NBATCH]]]]] */
+
+#include "serve_queries.h"
+#include "parse_layout_file.h"
+#include "Histogram.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+static const char *program = "./r3shuffle";
+static char prefix[] = "bench/tmp/bench_serve";
+static char socket_path[] = "bench/tmp/bench_serve.sock";
+
+enum { NCLI = 20 };
+
+struct Client {
+    int nsnp, ntrait;
+    int batch, nbatch;
+    unsigned seed;
+    unsigned long long *latency;    /* nanoseconds per batch */
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "bench_serve: %s: %s\n", what, err_msg);
+    exit(EXIT_FAILURE);
+}
+
+static pid_t start(const char *argv[])
+{
+    pid_t pid;
+
+    if ((pid = fork()) == -1)
+        fail("fork");
+    if (pid == 0) {
+        execv(program, (char **) argv);
+        perror(program);
+        _exit(127);
+    }
+    return pid;
+}
+
+static void finish(pid_t pid)
+{
+    int status;
+
+    if (waitpid(pid, &status, 0) != pid
+        ||  !WIFEXITED(status)  ||  WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "bench_serve: %s failed\n", program);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void *run_client(void *arg)
+{
+    static const uint32_t columns[] = {1, 4, 6};
+    struct Client *c = (struct Client *) arg;
+    int32_t *queries;
+    double *values;
+    unsigned long long t;
+    int fd, i, k;
+
+    queries = (int32_t *) malloc(2 * c->batch * sizeof(int32_t));
+    values = (double *) malloc(3 * c->batch * sizeof(double));
+    if (queries == NULL  ||  values == NULL)
+        fail("out of memory");
+    if ((fd = serve_connect(socket_path)) == -1)
+        fail("connect");
+    for (i = 0; i < c->nbatch; i++) {
+        for (k = 0; k < c->batch; k++) {
+            queries[2 * k] = rand_r(&c->seed) % c->nsnp;
+            queries[2 * k + 1] = rand_r(&c->seed) % c->ntrait;
+        }
+        t = now_ns();
+        if (!serve_query(fd, 3, columns, c->batch, queries, values))
+            fail("query");
+        c->latency[i] = now_ns() - t;
+    }
+    close(fd);
+    free(queries);
+    free(values);
+    return NULL;
+}
+
+/* Run r3shuffle on a batch of snps of a single trait, NCLI times, and
+   return the seconds per run. */
+static double run_cli(struct Layout *layout, int batch)
+{
+    const char *argv[6];
+    unsigned seed = 1;
+    unsigned long long t;
+    FILE *fp;
+    int i, k;
+
+    if ((fp = fopen("bench/tmp/bench_serve.snps", "w")) == NULL)
+        fail("bench/tmp/bench_serve.snps");
+    for (k = 0; k < batch; k++)
+        fprintf(fp, "%s\n", layout->snp_labels[rand_r(&seed)
+                % layout->nsnp]);
+    fclose(fp);
+    if ((fp = fopen("bench/tmp/bench_serve.traits", "w")) == NULL)
+        fail("bench/tmp/bench_serve.traits");
+    fprintf(fp, "%s\n", layout->trait_labels[0]);
+    fclose(fp);
+
+    argv[0] = program;
+    argv[1] = "--snps-file=bench/tmp/bench_serve.snps";
+    argv[2] = "--traits-file=bench/tmp/bench_serve.traits";
+    argv[3] = "--output=/dev/null";
+    argv[4] = prefix;
+    argv[5] = NULL;
+    t = now_ns();
+    for (i = 0; i < NCLI; i++)
+        finish(start(argv));
+    return (now_ns() - t) / 1e9 / NCLI;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    struct Client *clients;
+    pthread_t *threads;
+    Histogram h;
+    double stats[SERVE_NSTAT], seconds, cli;
+    const char *server_argv[5];
+    char socket_option[64];
+    unsigned long long t;
+    int nclient, batch, nbatch, i, k, fd;
+    pid_t server;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 200000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 16;
+    nclient                 = argc > 3 ? atoi(argv[3]) : 4;
+    batch                   = argc > 4 ? atoi(argv[4]) : 64;
+    nbatch                  = argc > 5 ? atoi(argv[5]) : 5000;
+    layout.nvar             = 3;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files("bench/tmp/bench_serve.iout",
+            "bench/tmp/bench_serve.out", &layout))
+        fail("failed to write input files");
+
+    sprintf(socket_option, "--socket=%s", socket_path);
+    server_argv[0] = program;
+    server_argv[1] = "serve";
+    server_argv[2] = socket_option;
+    server_argv[3] = prefix;
+    server_argv[4] = NULL;
+    server = start(server_argv);
+    for (i = 0; i < 5000  &&  (fd = serve_connect(socket_path)) == -1;
+         i++)
+        usleep(1000);
+    if (fd == -1)
+        fail("connect");
+
+    clients = (struct Client *) calloc(nclient, sizeof(struct Client));
+    threads = (pthread_t *) malloc(nclient * sizeof(pthread_t));
+    if (clients == NULL  ||  threads == NULL
+        ||  (h = Histogram_Create()) == NULL)
+        fail("out of memory");
+    t = now_ns();
+    for (i = 0; i < nclient; i++) {
+        clients[i].nsnp = layout.nsnp;
+        clients[i].ntrait = layout.ntrait;
+        clients[i].batch = batch;
+        clients[i].nbatch = nbatch;
+        clients[i].seed = i + 1;
+        clients[i].latency = (unsigned long long *) malloc(nbatch
+            * sizeof(unsigned long long));
+        if (clients[i].latency == NULL
+            ||  pthread_create(&threads[i], NULL, run_client, &clients[i]))
+            fail("failed to start client");
+    }
+    for (i = 0; i < nclient; i++)
+        pthread_join(threads[i], NULL);
+    seconds = (now_ns() - t) / 1e9;
+    for (i = 0; i < nclient; i++)
+        for (k = 0; k < nbatch; k++)
+            Histogram_Record(h, clients[i].latency[k]);
+
+    if (!serve_stats(fd, stats)  ||  !serve_shutdown(fd))
+        fail("stats");
+    close(fd);
+    finish(server);
+
+    printf("# bench_serve: %d snps x %d traits, %d clients, batches of "
+        "%d records\n", layout.nsnp, layout.ntrait, nclient, batch);
+    printf("batches/s\t%.0f\n", nclient * nbatch / seconds);
+    printf("records/s\t%.0f\n", (double) nclient * nbatch * batch
+        / seconds);
+    printf("client p50 us\t%.1f\n", Histogram_Percentile(h, 50) / 1e3);
+    printf("client p99 us\t%.1f\n", Histogram_Percentile(h, 99) / 1e3);
+    printf("server p50 us\t%.1f\n", stats[SERVE_STAT_P50]);
+    printf("server p99 us\t%.1f\n", stats[SERVE_STAT_P99]);
+    printf("server p99.9 us\t%.1f\n", stats[SERVE_STAT_P999]);
+    printf("cache hit rate\t%.3f\n", stats[SERVE_STAT_HITS]
+        / (stats[SERVE_STAT_HITS] + stats[SERVE_STAT_MISSES]));
+    fflush(stdout);
+    cli = run_cli(&layout, batch);
+    printf("cli us/batch\t%.0f\n", cli * 1e6);
+    printf("# serve vs. one r3shuffle per batch: %.0fx\n",
+        cli / (Histogram_Percentile(h, 50) / 1e9));
+
+    for (i = 0; i < nclient; i++)
+        free(clients[i].latency);
+    free(clients);
+    free(threads);
+    Histogram_Destroy(h);
+    free_synthetic_layout(&layout);
+    remove("bench/tmp/bench_serve.iout");
+    remove("bench/tmp/bench_serve.out");
+    remove("bench/tmp/bench_serve.snps");
+    remove("bench/tmp/bench_serve.traits");
+
+    return EXIT_SUCCESS;
+}
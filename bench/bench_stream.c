@@ -0,0 +1,147 @@
+/* Measure Stream throughput across chunk sizes.  For every chunk size
+   we read all records FILTER_BATCH at a time, once with no work per
+   batch and once with work that takes about as long as formatting the
+   batch.  With work, the reader thread overlaps the next read with the
+   work on the current chunk.  We also time a full conversion with
+   --no-mmap, which reads through a Stream.
+
+   Usage: bench/bench_stream [NSNP [NTRAIT]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "Stream.h"
+#include "Filter.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static const char *layout_file = "bench/tmp/bench_stream.iout";
+static const char *data_file = "bench/tmp/bench_stream.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Read all records through a stream with chunks of about chunk_bytes
+   and spend about work nanoseconds per record. */
+static double scan(unsigned long nrecord, size_t nbytes,
+    size_t chunk_bytes, int work)
+{
+    Stream st;
+    const char *p;
+    unsigned long k, n, chunk;
+    double sum, t;
+    int i, j;
+
+    chunk = chunk_bytes / nbytes / FILTER_BATCH * FILTER_BATCH;
+    if (chunk < FILTER_BATCH)
+        chunk = FILTER_BATCH;
+    if ((st = Stream_Create(data_file)) == NULL)
+        goto ERROR;
+    Stream_SetRecordSize(st, nbytes);
+    Stream_SetChunkSize(st, chunk);
+
+    t = now();
+    sum = 0.0;
+    for (k = 0; k < nrecord; k += n) {
+        n = nrecord - k < FILTER_BATCH ? nrecord - k : FILTER_BATCH;
+        if (!Stream_Read(st, n, &p))
+            goto ERROR;
+        for (i = 0; i < (int) n; i++)
+            for (j = 0; j < work; j++)
+                sum += ((const double *) (p + i * nbytes))[j % 3];
+    }
+    t = now() - t;
+    if (!Stream_Close(st))
+        goto ERROR;
+    if (sum == -1.0)
+        printf("%g\n", sum);    /* keep the work */
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+static double convert(struct Layout *layout)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.use_mmap = 0;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    static const size_t chunk_bytes[] = {
+        4 << 10, 64 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20
+    };
+    struct Layout layout;
+    unsigned long nrecord;
+    size_t nbytes;
+    double t, mb;
+    int i;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_stream: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    nbytes = (2 * layout.nvar + layout.ncov) * layout.bytes_per_double;
+    mb = nrecord * nbytes / 1e6;
+    printf("bench_stream: %lu records, %.0f MB\n", nrecord, mb);
+    printf("%-12s %14s %14s\n", "chunk", "read MB/s", "with work s");
+    for (i = 0; i < (int) (sizeof chunk_bytes / sizeof chunk_bytes[0]);
+         i++) {
+        t = scan(nrecord, nbytes, chunk_bytes[i], 0);
+        printf("%10luK %14.0f", (unsigned long) chunk_bytes[i] >> 10,
+            mb / t);
+        t = scan(nrecord, nbytes, chunk_bytes[i], 200);
+        printf(" %14.3f\n", t);
+    }
+    t = convert(&layout);
+    printf("%-12s %14.3f s %12.0f records/s\n", "--no-mmap", t,
+        nrecord / t);
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/* Measure --summary against the read alone, which we time with a
+   filter that keeps no record, and against converting the two
+   columns that one would otherwise summarize elsewhere to text.  The
+   summary reads the data file once and writes a line per trait, so
+   it should take little more than the read.
+
+   Usage: bench/bench_summary [NSNP [NTRAIT [NTHREAD]]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "Filter.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static const char *layout_file = "bench/tmp/bench_summary.iout";
+static const char *data_file = "bench/tmp/bench_summary.out";
+static const char *text_file = "bench/tmp/bench_summary.txt";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Convert the data file to output with the given filter, either as a
+   summary of beta1 / se1 or as the columns beta1 and se1. */
+static double convert(struct Layout *layout, const char *output,
+    const char *where, int summary, int nthread)
+{
+    static char *columns[] = {"beta1", "se1"};
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = (char *) output;
+    params.nthread = nthread;
+    if (summary)
+        params.summary = "beta1";
+    else {
+        params.columns = columns;
+        params.ncolumn = 2;
+    }
+    if ((params.ucp2acp = (int *) malloc(3 * sizeof(int))) == NULL
+        ||  !set_column_print_order(&params, layout))
+        goto ERROR;
+    if (where != NULL
+        &&  (params.filter = Filter_Compile(where, layout)) == NULL)
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    Filter_Destroy(params.filter);
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+static double file_size(const char *file)
+{
+    struct stat st;
+
+    return stat(file, &st) == 0 ? (double) st.st_size : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    double t, summary, text;
+    int nthread;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 100000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    nthread                 = argc > 3 ? atoi(argv[3]) : 1;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_summary: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("# bench_summary: %d snps x %d traits, %d threads\n",
+        layout.nsnp, layout.ntrait, nthread);
+    t = convert(&layout, "/dev/null", "beta1 != beta1", 0, nthread);
+    printf("read only\t%8.3f s\n", t);
+
+    summary = convert(&layout, text_file, NULL, 1, nthread);
+    printf("--summary\t%8.3f s\t%12.0f bytes\n", summary,
+        file_size(text_file));
+
+    text = convert(&layout, text_file, NULL, 0, nthread);
+    printf("beta1 se1\t%8.3f s\t%12.0f bytes\n", text,
+        file_size(text_file));
+
+    printf("# --summary vs. read only: %.2fx, vs. text: %.1fx faster\n",
+        summary / t, text / summary);
+
+    free_synthetic_layout(&layout);
+    remove(text_file);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/* Measure how conversion scales with the number of threads.  The
+   data file is converted to /dev/null with 1, 2, 4, ..., 64 threads
+   and we report records per second and the speedup over a single
+   thread.  Only thread counts up to the number of online processors
+   can be expected to scale.
+
+   Usage: bench/bench_threads [NSNP [NTRAIT [NVAR]]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *layout_file = "bench/tmp/bench_threads.iout";
+static const char *data_file = "bench/tmp/bench_threads.out";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double convert(struct Layout *layout, int nthread)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = "/dev/null";
+    params.nthread = nthread;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    unsigned long nrecord;
+    double t, t1;
+    int nthread;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = argc > 3 ? atoi(argv[3]) : 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 20000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_threads: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    nrecord = (unsigned long) layout.nsnp * layout.ntrait;
+    printf("bench_threads: %lu records, %ld online processors\n",
+        nrecord, sysconf(_SC_NPROCESSORS_ONLN));
+    t1 = 0.0;
+    for (nthread = 1; nthread <= 64; nthread *= 2) {
+        t = convert(&layout, nthread);
+        if (nthread == 1)
+            t1 = t;
+        printf("threads=%-3d %8.3f s %12.0f records/s  speedup %5.2fx\n",
+            nthread, t, nrecord / t, t1 / t);
+    }
+
+    free_synthetic_layout(&layout);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
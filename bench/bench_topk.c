@@ -0,0 +1,134 @@
+/* Measure --top-k against what it replaces: converting the whole data
+   file to text and sorting the text by trait and beta1 with sort(1).
+   Ranking reads the data file once and writes only K lines per trait,
+   so it should take little more than the read itself, which we time
+   with a filter that keeps no record.  Both run before we write the
+   whole text, whose writeback would slow them down.
+
+   Usage: bench/bench_topk [NSNP [NTRAIT [K [NTHREAD]]]] */
+
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "Filter.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static const char *layout_file = "bench/tmp/bench_topk.iout";
+static const char *data_file = "bench/tmp/bench_topk.out";
+static const char *text_file = "bench/tmp/bench_topk.txt";
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Convert the data file to output with the given filter and, if k is
+   positive, only the k records per trait of the smallest p(beta1). */
+static double convert(struct Layout *layout, const char *output,
+    const char *where, int k, int nthread)
+{
+    struct Params params;
+    double t;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = (char *) output;
+    params.nthread = nthread;
+    params.top_k = k;
+    if (!set_column_print_order(&params, layout))
+        goto ERROR;
+    if (where != NULL
+        &&  (params.filter = Filter_Compile(where, layout)) == NULL)
+        goto ERROR;
+    if (k > 0
+        &&  (params.rank = Filter_Compile("p(beta1)", layout)) == NULL)
+        goto ERROR;
+    t = now();
+    if (!parse_data_file(&params, layout))
+        goto ERROR;
+    t = now() - t;
+    Filter_Destroy(params.filter);
+    Filter_Destroy(params.rank);
+    free(params.ucp2acp);
+
+    return t;
+
+ERROR:
+    pr_err_msg();
+    exit(EXIT_FAILURE);
+}
+
+static double file_size(const char *file)
+{
+    struct stat st;
+
+    return stat(file, &st) == 0 ? (double) st.st_size : 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    char command[256];
+    double t, topk, text, sorted;
+    int k, nthread;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 3;
+    layout.nsnp             = argc > 1 ? atoi(argv[1]) : 100000;
+    layout.ntrait           = argc > 2 ? atoi(argv[2]) : 100;
+    k                       = argc > 3 ? atoi(argv[3]) : 100;
+    nthread                 = argc > 4 ? atoi(argv[4]) : 1;
+    layout.snps_per_tile    = 1000;
+    layout.traits_per_tile  = 16;
+    layout.max_char         = 16;
+
+    if (!make_synthetic_layout(&layout)
+        ||  !write_synthetic_files(layout_file, data_file, &layout)) {
+        fprintf(stderr, "bench_topk: failed to create input files\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("# bench_topk: %d snps x %d traits, top %d, %d threads\n",
+        layout.nsnp, layout.ntrait, k, nthread);
+    t = convert(&layout, "/dev/null", "beta1 != beta1", 0, nthread);
+    printf("read only\t%8.3f s\n", t);
+
+    topk = convert(&layout, text_file, NULL, k, nthread);
+    printf("--top-k\t\t%8.3f s\t%12.0f bytes\n", topk,
+        file_size(text_file));
+
+    text = convert(&layout, text_file, NULL, 0, nthread);
+    printf("convert all\t%8.3f s\t%12.0f bytes\n", text,
+        file_size(text_file));
+    sprintf(command, "LC_ALL=C sort -k2,2 -k4,4g %s > %s.sorted",
+        text_file, text_file);
+    sorted = now();
+    if (system(command) != 0) {
+        fprintf(stderr, "bench_topk: %s failed\n", command);
+        return EXIT_FAILURE;
+    }
+    sorted = now() - sorted;
+    printf("sort(1)\t\t%8.3f s\n", sorted);
+
+    printf("# --top-k vs. convert and sort: %.1fx\n",
+        (text + sorted) / topk);
+
+    free_synthetic_layout(&layout);
+    sprintf(command, "%s.sorted", text_file);
+    remove(command);
+    remove(text_file);
+    remove(layout_file);
+    remove(data_file);
+
+    return EXIT_SUCCESS;
+}
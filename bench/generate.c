@@ -0,0 +1,77 @@
+/* Write a synthetic pair of OmicABEL output files BASE.iout and
+   BASE.out of the given dimensions, for benchmarking and for trying
+   out r3shuffle without running OmicABEL.  The layout file is written
+   with write_layout_file, the data file holds nsnp * ntrait records of
+   2 * nvar + nvar * (nvar - 1) / 2 doubles in the tiled file order.
+
+   Usage: bench/generate BASE NSNP NTRAIT [NVAR [SNPS_PER_TILE
+          [TRAITS_PER_TILE [MAX_CHAR]]]] */
+
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include "synthetic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int arg(int argc, char *argv[], int i, int default_value)
+{
+    return argc > i ? atoi(argv[i]) : default_value;
+}
+
+int main(int argc, char *argv[])
+{
+    struct Layout layout;
+    char *layout_file, *data_file;
+    size_t n;
+
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s BASE NSNP NTRAIT [NVAR [SNPS_PER_TILE "
+            "[TRAITS_PER_TILE [MAX_CHAR]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nsnp             = arg(argc, argv, 2, 0);
+    layout.ntrait           = arg(argc, argv, 3, 0);
+    layout.nvar             = arg(argc, argv, 4, 3);
+    layout.snps_per_tile    = arg(argc, argv, 5, 1000);
+    layout.traits_per_tile  = arg(argc, argv, 6, 16);
+    layout.max_char         = arg(argc, argv, 7, 16);
+    if (layout.nsnp <= 0  ||  layout.ntrait <= 0  ||  layout.nvar <= 0
+        ||  layout.snps_per_tile <= 0  ||  layout.traits_per_tile <= 0
+        ||  layout.max_char < 16) {
+        fprintf(stderr, "%s: dimensions must be positive and MAX_CHAR "
+            "at least 16\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    n = strlen(argv[1]) + sizeof ".iout";
+    layout_file = (char *) malloc(n);
+    data_file = (char *) malloc(n);
+    if (layout_file == NULL  ||  data_file == NULL
+        ||  !make_synthetic_layout(&layout)) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    sprintf(layout_file, "%s.iout", argv[1]);
+    sprintf(data_file, "%s.out", argv[1]);
+
+    if (!write_synthetic_files(layout_file, data_file, &layout)) {
+        if (*err_msg)
+            pr_err_msg();
+        fprintf(stderr, "%s: failed to write %s and %s\n", argv[0],
+            layout_file, data_file);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d snps x %d traits, %d variables, tiles of %d x %d\n",
+        argv[1], layout.nsnp, layout.ntrait, layout.nvar,
+        layout.snps_per_tile, layout.traits_per_tile);
+
+    free_synthetic_layout(&layout);
+    free(layout_file);
+    free(data_file);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include "synthetic.h"
+#include "parse_layout_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Fill in the labels of a layout whose dimensions have already been
+   set.  All labels live in a single buffer that is freed together
+   with the label pointers by free_synthetic_layout. */
+int make_synthetic_layout(struct Layout *layout)
+{
+    char **t, *s;
+    int i, nlabel;
+
+    layout->ncov = ((layout->nvar - 1) * layout->nvar) / 2;
+    layout->swapped = 0;
+    nlabel = 2 * layout->nvar + layout->ncov + layout->nsnp
+        + layout->ntrait;
+    if ((t = (char **) malloc((nlabel + 1) * sizeof(char *))) == NULL)
+        return 0;
+    if ((s = (char *) malloc((size_t) nlabel * layout->max_char)) == NULL) {
+        free(t);
+        return 0;
+    }
+    for (i = 0; i < nlabel; i++)
+        t[i + 1] = s + (size_t) i * layout->max_char;
+    t[0] = s;
+    layout->beta_labels  = t + 1;
+    layout->se_labels    = layout->beta_labels + layout->nvar;
+    layout->cov_labels   = layout->se_labels   + layout->nvar;
+    layout->snp_labels   = layout->cov_labels  + layout->ncov;
+    layout->trait_labels = layout->snp_labels  + layout->nsnp;
+
+    for (i = 0; i < layout->nvar; i++) {
+        snprintf(layout->beta_labels[i], layout->max_char, "beta%d", i);
+        snprintf(layout->se_labels[i], layout->max_char, "se%d", i);
+    }
+    for (i = 0; i < layout->ncov; i++)
+        snprintf(layout->cov_labels[i], layout->max_char, "cov%d", i);
+    for (i = 0; i < layout->nsnp; i++)
+        snprintf(layout->snp_labels[i], layout->max_char, "rs%d",
+            1000000 + i);
+    for (i = 0; i < layout->ntrait; i++)
+        snprintf(layout->trait_labels[i], layout->max_char, "trait%d", i);
+
+    return 1;
+}
+
+void free_synthetic_layout(struct Layout *layout)
+{
+    free(layout->beta_labels[-1]);
+    free(layout->beta_labels - 1);
+}
+
+/* Write the layout file and a matching data file.  The records are
+   written in file order.  Values look like regression estimates: a
+   handful of significant digits and magnitudes between 1e-4 and 1e1. */
+int write_synthetic_files(const char *layout_file, const char *data_file,
+    struct Layout *layout)
+{
+    FILE *fp;
+    double *rec;
+    unsigned long n, k, state;
+    int i, ncolumn;
+
+    if (!write_layout_file(layout_file, layout))
+        return 0;
+
+    ncolumn = 2 * layout->nvar + layout->ncov;
+    if ((rec = (double *) malloc(ncolumn * sizeof(double))) == NULL)
+        return 0;
+    if ((fp = fopen(data_file, "wb")) == NULL) {
+        free(rec);
+        return 0;
+    }
+
+    state = 88172645463325252UL;
+    n = (unsigned long) layout->nsnp * layout->ntrait;
+    for (k = 0; k < n; k++) {
+        for (i = 0; i < ncolumn; i++) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            rec[i] = (double) (state % 1000000) / (i < layout->nvar
+                ? 1e5 : 1e9);
+        }
+        if (fwrite(rec, sizeof(double), ncolumn, fp)
+            != (size_t) ncolumn) {
+            fclose(fp);
+            free(rec);
+            return 0;
+        }
+    }
+    free(rec);
+
+    return fclose(fp) == 0;
+}
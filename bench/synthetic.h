@@ -0,0 +1,11 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "parse_layout_file.h"
+
+int make_synthetic_layout(struct Layout *layout);
+void free_synthetic_layout(struct Layout *layout);
+int write_synthetic_files(const char *layout_file, const char *data_file,
+    struct Layout *layout);
+
+#endif  /* SYNTHETIC_H */
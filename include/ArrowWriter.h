@@ -0,0 +1,21 @@
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <stdio.h>
+
+struct Params;
+struct Layout;
+
+struct ArrowWriterStruct;
+typedef struct ArrowWriterStruct *ArrowWriter;
+
+ArrowWriter ArrowWriter_Create(FILE *fp, const char *file,
+    struct Params *params, struct Layout *layout);
+int ArrowWriter_WriteBatch(ArrowWriter, int n, const int *snp,
+    const int *trait, const double *columns, int stride);
+int ArrowWriter_Finish(ArrowWriter);
+unsigned long long ArrowWriter_BytesWritten(ArrowWriter);
+unsigned long long ArrowWriter_Writes(ArrowWriter);
+void ArrowWriter_Destroy(ArrowWriter);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef BGZF_H
+#define BGZF_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Maximum number of uncompressed bytes per block, as with bgzip. */
+enum { BGZF_BLOCK_SIZE = 0xff00 };
+
+/* Maximum size of a compressed block including header and footer. */
+enum { BGZF_MAX_BLOCK = 0x10000 };
+
+/* Called with the virtual offset and the text of the first line that
+   starts and ends within a block, including its newline. */
+typedef int (*BgzfLineHook)(void *arg, unsigned long long voffset,
+    const char *line, size_t len);
+
+struct BgzfWriterStruct;
+typedef struct BgzfWriterStruct *BgzfWriter;
+
+BgzfWriter BgzfWriter_Open(FILE *fp, const char *file, int nthread,
+    BgzfLineHook hook, void *arg);
+int BgzfWriter_Write(BgzfWriter, const char *data, size_t n);
+int BgzfWriter_Close(BgzfWriter);
+FILE *BgzfWriter_OpenStream(BgzfWriter);
+
+int Bgzf_ReadBlock(FILE *fp, unsigned long long coffset, char *buf,
+    size_t *len, unsigned long long *next);
+
+#endif
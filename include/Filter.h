@@ -0,0 +1,21 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+struct Layout;
+
+/* Maximum number of records that Filter_Apply evaluates at once. */
+enum { FILTER_BATCH = 256 };
+
+struct FilterStruct;
+typedef struct FilterStruct *Filter;
+
+Filter Filter_Compile(const char *expr, struct Layout *layout);
+int Filter_Apply(Filter, int n, const double **records,
+    unsigned char *keep);
+void Filter_Evaluate(Filter, int n, const double **records,
+    double *values);
+int Filter_PValueToZ(Filter);
+void Filter_MarkColumns(Filter, unsigned char *used);
+void Filter_Destroy(Filter);
+
+#endif
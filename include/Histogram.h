@@ -0,0 +1,15 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+struct HistogramStruct;
+typedef struct HistogramStruct *Histogram;
+
+Histogram Histogram_Create(void);
+void Histogram_Record(Histogram, unsigned long long value);
+unsigned long long Histogram_Count(Histogram);
+unsigned long long Histogram_Max(Histogram);
+double Histogram_Mean(Histogram);
+unsigned long long Histogram_Percentile(Histogram, double percent);
+void Histogram_Destroy(Histogram);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef LABELPOOL_H
+#define LABELPOOL_H
+
+#include "parse_layout_file.h"
+#include "label_index.h"
+#include <stddef.h>
+
+struct LabelPoolStruct;
+typedef struct LabelPoolStruct *LabelPool;
+
+LabelPool LabelPool_Create(const struct Layout *layout, LabelFunc label,
+    int nlabel, int per_tile);
+const char *LabelPool_Get(LabelPool, int i, size_t *len);
+size_t LabelPool_Size(LabelPool);
+void LabelPool_Destroy(LabelPool);
+
+#endif
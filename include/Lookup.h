@@ -0,0 +1,32 @@
+#ifndef LOOKUP_H
+#define LOOKUP_H
+
+#include <stddef.h>
+
+/* A range of n records starting at offset, to be read into buf. */
+struct LookupRead {
+    unsigned long offset;
+    unsigned long n;
+    char *buf;
+};
+
+/* Engines for Lookup_Create. */
+enum { LOOKUP_AUTO, LOOKUP_PREAD };
+
+/* io_uring_enter(2) without a signal mask.  Tests replace it to
+   simulate a kernel that is short of resources. */
+extern int (*Lookup_Enter)(int fd, unsigned to_submit,
+    unsigned min_complete, unsigned flags);
+
+struct LookupStruct;
+typedef struct LookupStruct *Lookup;
+
+Lookup Lookup_Create(int fd, const char *file, size_t nbytes, int depth,
+    int engine);
+int Lookup_Run(Lookup, struct LookupRead *reads, unsigned long n);
+int Lookup_UsesIoUring(Lookup);
+unsigned long long Lookup_BytesRead(Lookup);
+unsigned long long Lookup_Reads(Lookup);
+void Lookup_Destroy(Lookup);
+
+#endif
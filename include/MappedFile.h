@@ -0,0 +1,15 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+struct MappedFileStruct;
+typedef struct MappedFileStruct *MappedFile;
+
+MappedFile MappedFile_Open(const char *filename);
+const char *MappedFile_Data(MappedFile);
+size_t MappedFile_Size(MappedFile);
+void MappedFile_SetRandomAccess(MappedFile);
+void MappedFile_Close(MappedFile);
+
+#endif
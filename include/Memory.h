@@ -4,5 +4,6 @@
 #include <stddef.h>
 
 extern void *(*Memory_Malloc)(size_t);
+extern void (*Memory_Free)(void *);
 
 #endif
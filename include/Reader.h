@@ -0,0 +1,44 @@
+#ifndef READER_H
+#define READER_H
+
+#include <stddef.h>
+
+/* libr3shuffle.so is built with -fvisibility=hidden, so the functions
+   declared here are all that it exports. */
+#if defined(__GNUC__)
+#define READER_API __attribute__((visibility("default")))
+#else
+#define READER_API
+#endif
+
+/* A tile of a result set: the records of snps snp0 to snp1 - 1 and
+   traits trait0 to trait1 - 1, as they are stored in the data file.
+   The records of trait trait0 come first, ordered by snp, then those
+   of trait trait0 + 1, and so on.  Values are in the precision and
+   byte order of the data file. */
+struct ReaderTile {
+    int snp0, snp1;
+    int trait0, trait1;
+    const char *data;
+};
+
+struct ReaderStruct;
+typedef struct ReaderStruct *Reader;
+
+READER_API Reader Reader_Open(const char *prefix);
+READER_API int Reader_NumSnps(Reader);
+READER_API int Reader_NumTraits(Reader);
+READER_API const char *Reader_SnpLabel(Reader, int snp);
+READER_API const char *Reader_TraitLabel(Reader, int trait);
+READER_API int Reader_ValuesPerRecord(Reader);
+READER_API int Reader_GetRecord(Reader, int snp, int trait,
+    double *values);
+READER_API unsigned long Reader_NumTiles(Reader);
+READER_API int Reader_GetTile(Reader, unsigned long tile,
+    struct ReaderTile *t);
+READER_API void Reader_DecodeTile(Reader, const struct ReaderTile *t,
+    double *values);
+READER_API const char *Reader_ErrMsg(Reader, char *msg, size_t size);
+READER_API void Reader_Close(Reader);
+
+#endif
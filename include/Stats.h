@@ -0,0 +1,36 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct Layout;
+
+/* Phases of a conversion whose time Stats keeps track of. */
+enum { STATS_LAYOUT, STATS_READ, STATS_FORMAT, STATS_WRITE, STATS_NPHASE };
+
+/* Seconds between progress reports. */
+enum { STATS_PROGRESS_INTERVAL = 10 };
+
+struct StatsStruct;
+typedef struct StatsStruct *Stats;
+
+Stats Stats_Create(FILE *progress);
+void Stats_SetInterval(Stats, double seconds);
+void Stats_SetTotal(Stats, struct Layout *layout, unsigned long nrecord,
+    size_t nbytes);
+void Stats_SetBatch(Stats, int nset);
+double Stats_Start(Stats);
+void Stats_Stop(Stats, int phase, double start);
+void Stats_AddRecords(Stats, unsigned long n);
+void Stats_AddSet(Stats);
+void Stats_AddReads(Stats, unsigned long long bytes,
+    unsigned long long nread);
+void Stats_AddWrites(Stats, unsigned long long bytes,
+    unsigned long long nwrite);
+double Stats_Seconds(Stats, int phase);
+unsigned long Stats_Records(Stats);
+int Stats_Print(Stats, FILE *fp, int nthread);
+void Stats_Destroy(Stats);
+
+#endif
@@ -1,11 +1,19 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <stddef.h>
+
 struct StreamStruct;
 typedef struct StreamStruct *Stream;
 
 Stream Stream_Create(const char *filename);
 int Stream_GetChunkSize(Stream);
 void Stream_SetChunkSize(Stream, int);
+size_t Stream_GetRecordSize(Stream);
+void Stream_SetRecordSize(Stream, size_t);
+int Stream_Read(Stream, unsigned long n, const char **records);
+unsigned long long Stream_BytesRead(Stream);
+unsigned long long Stream_Reads(Stream);
+int Stream_Close(Stream);
 
 #endif
@@ -0,0 +1,18 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stddef.h>
+
+struct TileCacheStruct;
+typedef struct TileCacheStruct *TileCache;
+
+TileCache TileCache_Create(size_t capacity);
+double *TileCache_Get(TileCache, unsigned long tile);
+double *TileCache_Put(TileCache, unsigned long tile, size_t n);
+unsigned long TileCache_Tiles(TileCache);
+size_t TileCache_Bytes(TileCache);
+unsigned long long TileCache_Hits(TileCache);
+unsigned long long TileCache_Misses(TileCache);
+void TileCache_Destroy(TileCache);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+struct TopKStruct;
+typedef struct TopKStruct *TopK;
+
+TopK TopK_Create(int ntrait, int k, int nvalue, const int *columns);
+void TopK_Add(TopK, int trait, int snp, double score,
+    const double *record);
+void TopK_Merge(TopK dst, TopK src);
+void TopK_Sort(TopK);
+int TopK_Count(TopK, int trait);
+const double *TopK_Get(TopK, int trait, int i, int *snp);
+void TopK_Destroy(TopK);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef CONVERT_BATCH_H
+#define CONVERT_BATCH_H
+
+#include "parse_command_line_args.h"
+
+/* The result sets listed in a manifest file. */
+struct Manifest {
+    char **prefix;              /* FILE of every result set */
+    int n;                      /* number of result sets */
+};
+
+int read_manifest(const char *file, struct Manifest *m);
+
+void free_manifest(struct Manifest *m);
+
+int convert_batch(struct Params *params);
+
+#endif  /* CONVERT_BATCH_H */
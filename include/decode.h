@@ -0,0 +1,18 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stddef.h>
+
+/* Kernels for find_decoder, from slowest to fastest. */
+enum { DECODE_SCALAR, DECODE_SSSE3, DECODE_AVX2, DECODE_BEST };
+
+/* Convert n values at src to native doubles at dst. */
+typedef void (*DecodeFunc)(double *dst, const char *src, size_t n);
+
+DecodeFunc find_decoder(int bytes_per_double, int swap, int level);
+
+int best_decode_level(void);
+
+int is_big_endian(void);
+
+#endif  /* DECODE_H */
@@ -0,0 +1,15 @@
+#ifndef FORMAT_DOUBLE_H
+#define FORMAT_DOUBLE_H
+
+/* Passing FORMAT_DOUBLE_SHORTEST as the number of significant digits
+   to format_double selects the shortest output that reads back as
+   the same double. */
+enum { FORMAT_DOUBLE_SHORTEST = -1 };
+
+/* Maximum number of characters written by a single call to
+   format_double for any number of significant digits <100. */
+enum { FORMAT_DOUBLE_MAXLEN = 128 };
+
+char *format_double(char *s, double x, int ndigit);
+
+#endif  /* FORMAT_DOUBLE_H */
@@ -0,0 +1,29 @@
+#ifndef LABEL_INDEX_H
+#define LABEL_INDEX_H
+
+struct Layout;
+
+/* Return label i of a layout, such as snp_label or trait_label. */
+typedef const char *(*LabelFunc)(const struct Layout *layout, int i);
+
+/* Hash index for looking up the position of a label among the labels
+   of a layout, such as its snp labels. */
+struct LabelIndex {
+    const struct Layout *layout;
+    LabelFunc label;            /* label of a position */
+    int *slots;                 /* label positions, -1 if empty */
+    unsigned long mask;         /* number of slots minus 1 */
+};
+
+int build_label_index(struct LabelIndex *index,
+    const struct Layout *layout, LabelFunc label, int nlabel);
+
+int lookup_label(const struct LabelIndex *index, const char *label);
+
+void free_label_index(struct LabelIndex *index);
+
+int read_label_file(const char *file, const char *what,
+    const struct Layout *layout, LabelFunc label, int nlabel,
+    int **selected, int *nselected);
+
+#endif  /* LABEL_INDEX_H */
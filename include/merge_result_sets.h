@@ -0,0 +1,33 @@
+#ifndef MERGE_RESULT_SETS_H
+#define MERGE_RESULT_SETS_H
+
+#include "parse_command_line_args.h"
+#include "parse_layout_file.h"
+#include "MappedFile.h"
+#include "decode.h"
+#include <stdio.h>
+
+/* A result set that makes up part of a merged one.  Its records are
+   those of snps snp0 to snp0 + layout.nsnp - 1 and traits trait0 to
+   trait0 + layout.ntrait - 1 of the merged result set. */
+struct Piece {
+    struct Layout layout;       /* layout of the result set */
+    char *file;                 /* name of its data file */
+    int fd;                     /* data file for pread(2) */
+    MappedFile map;             /* mapping of data file or NULL */
+    DecodeFunc decode;          /* NULL to copy records as they are */
+    size_t record_size;         /* bytes per record in the data file */
+    int snp0, trait0;           /* position in merged result set */
+};
+
+int open_piece(struct Params *params, const char *prefix,
+    struct Piece *p);
+
+void close_piece(struct Piece *p);
+
+int write_pieces(struct Params *params, struct Layout *out,
+    struct Piece *pieces, int npiece, FILE *fp, const char *file);
+
+int merge_result_sets(struct Params *params);
+
+#endif  /* MERGE_RESULT_SETS_H */
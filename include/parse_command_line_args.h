@@ -1,7 +1,39 @@
 #ifndef PARSE_COMMAND_LINE_ARGS_H
 #define PARSE_COMMAND_LINE_ARGS_H
 
+#include "Filter.h"
+#include "Stats.h"
+
+enum { MAX_THREADS = 1024 };
+
+/* Reads in flight for --snps-file and --traits-file. */
+enum { DEFAULT_QUEUE_DEPTH = 32, MAX_QUEUE_DEPTH = 4096 };
+
+/* Order of records in the output file. */
+enum { ORDER_FILE, ORDER_TRAIT, ORDER_SNP };
+
+/* Format of the output file. */
+enum { FORMAT_TEXT, FORMAT_ARROW };
+
+/* Compression of the output file. */
+enum { COMPRESS_NONE, COMPRESS_BGZF };
+
+/* Byte order of the data file. */
+enum { ENDIAN_AUTO, ENDIAN_LITTLE, ENDIAN_BIG };
+
+/* What to do: convert a result set, merge several into one, rewrite
+   one with other tiles, or answer queries about one. */
+enum { COMMAND_CONVERT, COMMAND_MERGE, COMMAND_RETILE, COMMAND_SERVE };
+
+/* Default for --max-memory in bytes. */
+#define DEFAULT_MAX_MEMORY (256UL << 20)
+
 struct Params {
+    int command;                /* COMMAND_CONVERT, COMMAND_MERGE, ... */
+    char **inputs;              /* FILEs to merge, retile or serve */
+    int ninput;                 /* number of FILEs */
+    int snps_per_tile;          /* snps per tile when writing or 0 */
+    int traits_per_tile;        /* traits per tile when writing or 0 */
     int ncolumn;                /* number of selected columns */
     char **columns;             /* labels of selected columns */
     int *ucp2acp; /* user column position -> actual column position */
@@ -11,6 +43,27 @@ struct Params {
     char *output_file;          /* path to output file */
     char *layout_file;          /* path to layout file */
     char *data_file;            /* path to data file */
+    int use_mmap;               /* Try to mmap(2) the data file? */
+    int nthread;                /* number of worker threads */
+    int order;                  /* ORDER_FILE, ORDER_TRAIT, ORDER_SNP */
+    unsigned long max_memory;   /* bytes for reordering records */
+    char *snps_file;            /* labels of snps to convert */
+    char *traits_file;          /* labels of traits to convert */
+    char *where;                /* filter expression */
+    Filter filter;              /* compiled filter expression */
+    int top_k;                  /* records per trait to keep or 0 */
+    char *rank_by;              /* expression to rank records by */
+    Filter rank;                /* compiled rank expression */
+    char *summary;              /* covariate to summarize or NULL */
+    int io_report;              /* Report bytes read from data file? */
+    int format;                 /* FORMAT_TEXT, FORMAT_ARROW */
+    int compress;               /* COMPRESS_NONE, COMPRESS_BGZF */
+    int endian;                 /* ENDIAN_AUTO, ENDIAN_LITTLE, ... */
+    char *manifest;             /* list of FILEs to convert in batch */
+    char *socket_path;          /* Unix socket to serve queries on */
+    int queue_depth;            /* maximum number of reads in flight */
+    int stats_report;           /* Report runtime statistics? */
+    Stats stats;                /* runtime statistics or NULL */
 };
 
 void initialize_parameters(struct Params *params);
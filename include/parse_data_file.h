@@ -3,6 +3,7 @@
 
 #include "parse_layout_file.h"
 #include "parse_command_line_args.h"
+#include <stdio.h>
 
 void offset2index(unsigned long offset, int *snp, int *trait,
     struct Layout *layout);
@@ -10,6 +11,26 @@ void offset2index(unsigned long offset, int *snp, int *trait,
 void index2offset(int snp, int trait, unsigned long *offset,
     struct Layout *layout);
 
+/* Position of a record in the data file that moves on to the next
+   record without divisions.  snp and trait are the indexes of the
+   record at offset, which lies in the tile of snps snp0 to snp1 - 1
+   and traits trait0 to trait1 - 1. */
+struct TileCursor {
+    struct Layout *layout;
+    unsigned long offset;
+    int snp, trait;
+    int snp0, snp1;
+    int trait0, trait1;
+};
+
+void init_tile_cursor(struct TileCursor *c, struct Layout *layout,
+    unsigned long offset);
+
+void next_tile_cursor(struct TileCursor *c);
+
+int convert_data_file(struct Params *params, struct Layout *layout,
+    FILE *fp, const char *file, int header);
+
 int parse_data_file(struct Params *params, struct Layout *layout);
 
 #endif  /* PARSE_DATA_FILE_H */
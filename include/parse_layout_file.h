@@ -2,6 +2,7 @@
 #define PARSE_LAYOUT_FILE_H
 
 #include "parse_command_line_args.h"
+#include "MappedFile.h"
 
 struct Layout {
     int magic_number;      /* magic number */
@@ -16,12 +17,21 @@ struct Layout {
     char **beta_labels;    /* labels for beta columns */
     char **se_labels;      /* labels for standard error columns */
     char **cov_labels;     /* labels for covariance columns */
-    char **snp_labels;     /* snp labels */
-    char **trait_labels;   /* trait labels */
+    char **snp_labels;     /* snp labels or NULL (see snp_label) */
+    char **trait_labels;   /* trait labels or NULL (see trait_label) */
+    const char *label_data; /* labels as stored in the layout file */
+    MappedFile map;        /* mapping of the layout file or NULL */
+    int swapped;           /* Written with the other byte order? */
 };
 
+const char *snp_label(const struct Layout *layout, int snp);
+
+const char *trait_label(const struct Layout *layout, int trait);
+
 int parse_layout_file(const char *file, struct Layout *layout);
 
+void free_layout(struct Layout *layout);
+
 int validate_layout(struct Layout *layout);
 
 int write_layout_file(const char *file, struct Layout *layout);
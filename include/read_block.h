@@ -0,0 +1,63 @@
+#ifndef READ_BLOCK_H
+#define READ_BLOCK_H
+
+#include "parse_layout_file.h"
+#include "decode.h"
+#include <stddef.h>
+
+/* The byte ranges (spans) within a record that hold the columns that
+   we actually use.  If skip is set, pages of the data file that hold
+   none of these bytes are neither read nor faulted in. */
+struct Projection {
+    int nspan;                  /* number of spans */
+    size_t *start;              /* first byte of every span */
+    size_t *len;                /* length of every span in bytes */
+    size_t page_size;           /* granularity of skipping */
+    int skip;                   /* Skip unneeded pages? */
+};
+
+/* Records are read either from a memory-mapped data file or, if the
+   data file isn't mapped, with pread(2) into a staging buffer.  If
+   the data file holds float32 values or values of the other byte
+   order, decode_records converts records to native doubles in a
+   buffer of their own, where they take record_size instead of nbytes
+   bytes each. */
+struct RecordSource {
+    const char *file;           /* name of data file */
+    const char *data;           /* mapped data file or NULL */
+    int fd;                     /* data file if not mapped */
+    size_t nbytes;              /* number of bytes per record */
+    const struct Projection *proj;  /* needed spans or NULL */
+    char *staging;              /* buffer for pread(2) */
+    size_t staging_size;        /* capacity of staging buffer */
+    unsigned long long bytes_read;  /* bytes read or faulted in */
+    unsigned long long nread;   /* number of reads */
+    DecodeFunc decode;          /* decoder of records or NULL */
+    size_t record_size;         /* number of bytes per decoded record */
+    char *decoded;              /* buffer for decoded records */
+    size_t decoded_size;        /* capacity of decoded buffer */
+};
+
+int make_projection(struct Projection *proj, const unsigned char *used,
+    int ncolumn, size_t bytes_per_double, size_t page_size);
+
+void free_projection(struct Projection *proj);
+
+void init_record_source(struct RecordSource *src, const char *file,
+    const char *data, int fd, size_t nbytes);
+
+void free_record_source(struct RecordSource *src);
+
+void set_record_decoder(struct RecordSource *src, DecodeFunc decode,
+    int nvalue);
+
+int decode_records(struct RecordSource *src, unsigned long n,
+    const char **p);
+
+int read_records(struct RecordSource *src, unsigned long offset,
+    unsigned long n, const char **p);
+
+int read_block(struct RecordSource *src, struct Layout *layout,
+    int trait0, int trait1, int snp0, int snp1, char *buf);
+
+#endif  /* READ_BLOCK_H */
@@ -0,0 +1,12 @@
+#ifndef READER_LAYOUT_H
+#define READER_LAYOUT_H
+
+#include "Reader.h"
+#include "parse_layout_file.h"
+
+/* The layout of a reader's result set, for r3shuffle itself.  It is
+   not part of the API of libr3shuffle.so, so struct Layout may change
+   without breaking the programs that link it. */
+const struct Layout *reader_layout(Reader r);
+
+#endif  /* READER_LAYOUT_H */
@@ -0,0 +1,34 @@
+#ifndef RESULT_INDEX_H
+#define RESULT_INDEX_H
+
+#include "parse_layout_file.h"
+#include "label_index.h"
+#include <stddef.h>
+
+/* Index of a BGZF-compressed text output file that maps snp-trait
+   pairs to virtual offsets.  There is one entry per BGZF block. */
+struct ResultIndex {
+    struct Layout *layout;
+    int order;                  /* order of lines in the output */
+    struct LabelIndex snps;
+    struct LabelIndex traits;
+    unsigned long long *entry;  /* pairs of key and virtual offset */
+    unsigned long n;            /* number of entries */
+    unsigned long size;         /* capacity of entry in entries */
+    char *label;                /* scratch buffer for one label */
+};
+
+int init_result_index(struct ResultIndex *index, struct Layout *layout,
+    int order);
+
+int add_result_line(void *index, unsigned long long voffset,
+    const char *line, size_t len);
+
+int write_result_index(const struct ResultIndex *index, const char *file);
+
+void free_result_index(struct ResultIndex *index);
+
+int fetch_result(const char *output_file, const char *index_file,
+    struct Layout *layout, int snp, int trait, char *line, size_t size);
+
+#endif  /* RESULT_INDEX_H */
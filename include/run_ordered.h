@@ -0,0 +1,24 @@
+#ifndef RUN_ORDERED_H
+#define RUN_ORDERED_H
+
+#include <stddef.h>
+
+/* A chunk of bytes produced by a worker thread. */
+struct Chunk {
+    char *data;                 /* start of buffer */
+    size_t len;                 /* number of bytes used */
+    size_t size;                /* capacity of buffer */
+};
+
+/* Called in a worker thread to process unit number unit into chunk.
+   Workers are numbered from 0 to nthread - 1. */
+typedef int (*Work)(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk);
+
+/* Called in the calling thread with the chunks in unit order. */
+typedef int (*Emit)(void *arg, unsigned long unit, struct Chunk *chunk);
+
+int run_ordered(int nthread, unsigned long nunit, Work work, Emit emit,
+    void *arg);
+
+#endif  /* RUN_ORDERED_H */
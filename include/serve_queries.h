@@ -0,0 +1,66 @@
+#ifndef SERVE_QUERIES_H
+#define SERVE_QUERIES_H
+
+#include "parse_command_line_args.h"
+#include <stdint.h>
+
+/* The protocol of "r3shuffle serve".  A client sends a request, a
+   struct ServeRequest followed by
+
+       SERVE_QUERY: ncolumn uint32_t column indexes, then nquery pairs
+           of int32_t snp and trait indexes;
+       SERVE_STATS and SERVE_SHUTDOWN: nothing,
+
+   and gets back a struct ServeReply followed by n doubles, or by an
+   error message of n bytes if status is SERVE_ERROR.  The doubles of a
+   query are the selected columns of every record in the order
+   requested.  Column j is value j of a record: betas first, then
+   standard errors, then covariances, as listed by --print-columns.
+   Numbers are in the byte order of the host, as client and server
+   share it. */
+enum { SERVE_QUERY = 1, SERVE_STATS, SERVE_SHUTDOWN };
+enum { SERVE_OK, SERVE_ERROR };
+
+/* Most records in a single query. */
+enum { SERVE_MAX_QUERIES = 1 << 16 };
+
+struct ServeRequest {
+    uint32_t op;                /* SERVE_QUERY, SERVE_STATS, ... */
+    uint32_t nquery;            /* number of records */
+    uint32_t ncolumn;           /* number of columns per record */
+};
+
+struct ServeReply {
+    uint32_t status;            /* SERVE_OK or SERVE_ERROR */
+    uint32_t n;                 /* number of doubles or bytes */
+};
+
+/* The doubles of a reply to SERVE_STATS.  Latencies are in
+   microseconds from receiving a query to sending its reply. */
+enum {
+    SERVE_STAT_QUERIES,         /* number of queries answered */
+    SERVE_STAT_RECORDS,         /* number of records returned */
+    SERVE_STAT_MEAN,
+    SERVE_STAT_P50,
+    SERVE_STAT_P90,
+    SERVE_STAT_P99,
+    SERVE_STAT_P999,
+    SERVE_STAT_MAX,
+    SERVE_STAT_HITS,            /* tiles found in the cache */
+    SERVE_STAT_MISSES,          /* tiles decoded into the cache */
+    SERVE_STAT_TILES,           /* tiles in the cache */
+    SERVE_NSTAT
+};
+
+int serve_queries(struct Params *params);
+
+int serve_connect(const char *path);
+
+int serve_query(int fd, uint32_t ncolumn, const uint32_t *columns,
+    uint32_t nquery, const int32_t *queries, double *values);
+
+int serve_stats(int fd, double *stats);
+
+int serve_shutdown(int fd);
+
+#endif  /* SERVE_QUERIES_H */
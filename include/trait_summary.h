@@ -0,0 +1,59 @@
+#ifndef TRAIT_SUMMARY_H
+#define TRAIT_SUMMARY_H
+
+/* Number of p-value thresholds at which hits are counted, bins of
+   -log10(p) of width 1 (the last one open), and points of the QQ
+   plot. */
+enum { SUMMARY_NHIT = 5, SUMMARY_NHIST = 21, SUMMARY_NQQ = 10 };
+
+/* The sketch of chi-square values has 2^SKETCH_SUB_BITS buckets per
+   power of two from 2^SKETCH_MIN_EXP to 2^SKETCH_MAX_EXP, that is, up
+   to |z| = 256, plus one bucket below and one open bucket above. */
+enum {
+    SKETCH_SUB_BITS = 5,
+    SKETCH_MIN_EXP = -8,
+    SKETCH_MAX_EXP = 16,
+    SKETCH_NBUCKET = ((SKETCH_MAX_EXP - SKETCH_MIN_EXP) << SKETCH_SUB_BITS)
+        + 2
+};
+
+extern const double summary_thresholds[SUMMARY_NHIT];
+
+/* Summary of the association statistics z = beta / se of one trait.
+   A TraitSummary is a plain block of counts, so summaries can be
+   copied, zeroed, and handed between threads as bytes. */
+struct TraitSummary {
+    unsigned long long n;       /* number of finite statistics */
+    double max_chi2;            /* largest z^2 */
+    unsigned long long hits[SUMMARY_NHIT];   /* p < threshold */
+    unsigned long long hist[SUMMARY_NHIST];  /* k <= -log10(p) < k + 1 */
+    unsigned sketch[SKETCH_NBUCKET];         /* counts of z^2 */
+};
+
+/* Where the thresholds and the edges of the histogram bins fall among
+   the buckets of the sketch.  No bucket holds more than one of either,
+   so the bucket of z^2 and a comparison classify a statistic. */
+struct SummaryEdges {
+    unsigned char nhit[SKETCH_NBUCKET]; /* thresholds below the bucket */
+    unsigned char bin[SKETCH_NBUCKET];  /* bin of the smallest value */
+    double hit[SKETCH_NBUCKET];     /* z^2 of a threshold inside or inf */
+    double edge[SKETCH_NBUCKET];    /* z^2 of a bin edge inside or inf */
+};
+
+void init_summary_edges(struct SummaryEdges *e);
+
+void add_to_trait_summary(struct TraitSummary *s,
+    const struct SummaryEdges *e, double z);
+
+void merge_trait_summary(struct TraitSummary *dst,
+    const struct TraitSummary *src);
+
+double trait_summary_quantile(const struct TraitSummary *s, double q);
+
+double trait_summary_lambda(const struct TraitSummary *s);
+
+double trait_summary_qq(const struct TraitSummary *s, int k);
+
+double minus_log10_p(double z);
+
+#endif  /* TRAIT_SUMMARY_H */
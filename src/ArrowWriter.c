@@ -0,0 +1,653 @@
+#include "ArrowWriter.h"
+#include "parse_command_line_args.h"
+#include "parse_layout_file.h"
+#include "label_index.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* An Arrow IPC file (also known as Feather V2) looks like this:
+
+       "ARROW1" padded to 8 bytes
+       schema message
+       dictionary batch messages
+       record batch messages
+       end-of-stream marker
+       footer
+       footer length (int32)
+       "ARROW1"
+
+   A message consists of a continuation marker (0xFFFFFFFF), the
+   length of its metadata, the metadata, and a body.  The metadata is a
+   flatbuffer that describes where in the body the buffers of every
+   column are.  The footer is another flatbuffer that repeats the
+   schema and lists the file offsets of all dictionary and record
+   batches, which lets readers map the file and use the buffers in
+   place.  Every message and every buffer starts at a multiple of 8
+   bytes.
+
+   Our schema is
+
+       snp     dictionary<int32, utf8>   (dictionary 0: snp labels)
+       trait   dictionary<int32, utf8>   (dictionary 1: trait labels)
+       COLUMN  float64                   (one field per column)
+
+   Buffers hold native-endian values and the schema records the
+   endianness of the machine.  The flatbuffers themselves are always
+   little-endian.  We write them with the small builder below rather
+   than depending on the flatbuffers library. */
+
+/* Flatbuffers
+
+   A flatbuffer starts with the offset of its root table.  A table
+   starts with a signed offset back to its vtable, which lists the
+   size of the table and the positions of its fields within the table
+   ("slots"), and is followed by the fields.  Tables, vectors, and
+   strings are referred to by unsigned offsets relative to the
+   referring field.  Since these offsets must point forward, we write
+   a table before the objects it refers to and patch the offsets once
+   we know where the objects are. */
+struct Builder {
+    unsigned char *buf;
+    size_t len;                 /* number of bytes written */
+    size_t size;                /* capacity of buf */
+    int failed;                 /* Did an allocation fail? */
+};
+
+static void reserve(struct Builder *b, size_t n)
+{
+    unsigned char *t;
+    size_t size;
+
+    if (b->failed  ||  b->len + n <= b->size)
+        return;
+    for (size = b->size ? b->size : 1024; size < b->len + n; size *= 2)
+        ;
+    if ((t = (unsigned char *) realloc(b->buf, size)) == NULL) {
+        b->failed = 1;
+        return;
+    }
+    b->buf = t;
+    b->size = size;
+}
+
+/* Append the n least significant bytes of x in little-endian order
+   and return their position. */
+static size_t put(struct Builder *b, unsigned long long x, int n)
+{
+    size_t pos;
+
+    pos = b->len;
+    reserve(b, n);
+    if (!b->failed)
+        for (; n > 0; n--, x >>= 8)
+            b->buf[b->len++] = x & 0xff;
+    return pos;
+}
+
+static void align(struct Builder *b, size_t n)
+{
+    while (b->len % n)
+        put(b, 0, 1);
+}
+
+/* Let the offset at position where refer to position target. */
+static void patch(struct Builder *b, size_t where, size_t target)
+{
+    unsigned long x;
+    int i;
+
+    x = target - where;
+    if (!b->failed)
+        for (i = 0; i < 4; i++, x >>= 8)
+            b->buf[where + i] = x & 0xff;
+}
+
+enum { MAX_SLOTS = 6 };
+
+struct Table {
+    int nslot;
+    int size[MAX_SLOTS];                /* 0 for absent fields */
+    unsigned long long value[MAX_SLOTS];
+    size_t *where[MAX_SLOTS];           /* position of offset fields */
+};
+
+static void start_table(struct Table *t, int nslot)
+{
+    int i;
+
+    t->nslot = nslot;
+    for (i = 0; i < nslot; i++) {
+        t->size[i] = 0;
+        t->where[i] = NULL;
+    }
+}
+
+static void add_scalar(struct Table *t, int slot, int size,
+    unsigned long long value)
+{
+    t->size[slot] = size;
+    t->value[slot] = value;
+}
+
+/* Add an offset to be patched later.  Its position is stored in
+   *where by end_table. */
+static void add_offset(struct Table *t, int slot, size_t *where)
+{
+    t->size[slot] = 4;
+    t->value[slot] = 0;
+    t->where[slot] = where;
+}
+
+/* Write the vtable and the fields of t and return the position of
+   the table.  Fields are laid out by decreasing size, and the table
+   starts 4 bytes before a multiple of 8, so all fields are aligned. */
+static size_t end_table(struct Builder *b, struct Table *t)
+{
+    size_t vtable, table, pos, n, offset[MAX_SLOTS];
+    int i, size;
+
+    n = 4;
+    for (size = 8; size >= 1; size /= 2)
+        for (i = 0; i < t->nslot; i++)
+            if (t->size[i] == size) {
+                offset[i] = n;
+                n += size;
+            }
+
+    align(b, 2);
+    vtable = put(b, 4 + 2 * t->nslot, 2);
+    put(b, n, 2);
+    for (i = 0; i < t->nslot; i++)
+        put(b, t->size[i] ? offset[i] : 0, 2);
+
+    align(b, 4);
+    if (b->len % 8 != 4)
+        put(b, 0, 4);
+    table = put(b, b->len - vtable, 4);
+    for (size = 8; size >= 1; size /= 2)
+        for (i = 0; i < t->nslot; i++)
+            if (t->size[i] == size) {
+                pos = put(b, t->value[i], size);
+                if (t->where[i] != NULL)
+                    *t->where[i] = pos;
+            }
+
+    return table;
+}
+
+/* Write the length of a vector of n elements such that the elements,
+   which the caller appends, are aligned to n_align (4 or 8) bytes.
+   Return the position of the vector. */
+static size_t start_vector(struct Builder *b, unsigned long n,
+    size_t n_align)
+{
+    align(b, 4);
+    if ((b->len + 4) % n_align)
+        put(b, 0, 4);
+    return put(b, n, 4);
+}
+
+static size_t put_string(struct Builder *b, const char *s)
+{
+    size_t pos, n;
+
+    n = strlen(s);
+    pos = start_vector(b, n, 4);
+    reserve(b, n + 1);
+    if (!b->failed) {
+        memcpy(b->buf + b->len, s, n + 1);
+        b->len += n + 1;
+    }
+    return pos;
+}
+
+/* Arrow metadata */
+
+enum { METADATA_V5 = 4 };
+enum { HEADER_SCHEMA = 1, HEADER_DICTIONARY_BATCH = 2,
+       HEADER_RECORD_BATCH = 3 };
+enum { TYPE_INT = 2, TYPE_FLOATING_POINT = 3, TYPE_UTF8 = 5 };
+enum { PRECISION_DOUBLE = 2 };
+
+#define PAD8(n) (((n) + 7) & ~(unsigned long long) 7)
+
+/* The position of a dictionary or record batch in the file. */
+struct Block {
+    unsigned long long offset;  /* start of message */
+    unsigned long meta;         /* length of marker, length, metadata */
+    unsigned long long body;    /* length of body */
+};
+
+struct Blocks {
+    struct Block *block;
+    int n;
+    int size;
+};
+
+struct ArrowWriterStruct {
+    FILE *fp;
+    const char *file;           /* name of output file */
+    unsigned long long pos;     /* number of bytes written */
+    unsigned long long nwrite;  /* number of writes */
+    int nfield;                 /* snp, trait, and the columns */
+    const char **names;         /* field names */
+    const void **data;          /* buffers of the current message */
+    unsigned long long *len;    /* lengths of those buffers */
+    struct Builder b;           /* metadata of the current message */
+    struct Blocks dictionaries;
+    struct Blocks batches;
+};
+
+static int write_bytes(ArrowWriter w, const void *p, size_t n)
+{
+    if (n > 0  &&  fwrite(p, n, 1, w->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", w->file);
+        return 0;
+    }
+    w->pos += n;
+    w->nwrite += n > 0;
+    return 1;
+}
+
+static int write_padding(ArrowWriter w)
+{
+    static const char zeros[8];
+
+    return write_bytes(w, zeros, PAD8(w->pos) - w->pos);
+}
+
+static unsigned long long body_length(int nbuffer,
+    const unsigned long long *len)
+{
+    unsigned long long n;
+    int i;
+
+    for (n = i = 0; i < nbuffer; i++)
+        n += PAD8(len[i]);
+    return n;
+}
+
+/* Write a Field table for a dictionary-encoded string column with the
+   given dictionary id or, if id is -1, for a float64 column. */
+static size_t put_field(struct Builder *b, const char *name, int id)
+{
+    struct Table t;
+    size_t field, name_at, type_at, dictionary_at, children_at, index_at;
+
+    start_table(&t, 6);
+    add_offset(&t, 0, &name_at);
+    add_scalar(&t, 1, 1, 0);                    /* not nullable */
+    add_scalar(&t, 2, 1, id >= 0 ? TYPE_UTF8 : TYPE_FLOATING_POINT);
+    add_offset(&t, 3, &type_at);
+    if (id >= 0)
+        add_offset(&t, 4, &dictionary_at);
+    add_offset(&t, 5, &children_at);
+    field = end_table(b, &t);
+
+    patch(b, name_at, put_string(b, name));
+
+    start_table(&t, id >= 0 ? 0 : 1);
+    if (id < 0)
+        add_scalar(&t, 0, 2, PRECISION_DOUBLE);
+    patch(b, type_at, end_table(b, &t));
+
+    if (id >= 0) {
+        start_table(&t, 4);
+        add_scalar(&t, 0, 8, id);
+        add_offset(&t, 1, &index_at);
+        patch(b, dictionary_at, end_table(b, &t));
+
+        start_table(&t, 2);
+        add_scalar(&t, 0, 4, 32);               /* bitWidth */
+        add_scalar(&t, 1, 1, 1);                /* is_signed */
+        patch(b, index_at, end_table(b, &t));
+    }
+
+    patch(b, children_at, start_vector(b, 0, 4));
+
+    return field;
+}
+
+static size_t put_schema(struct Builder *b, ArrowWriter w)
+{
+    static const union { int i; char c; } one = {1};
+    struct Table t;
+    size_t schema, fields_at, v;
+    int i;
+
+    start_table(&t, 2);
+    add_scalar(&t, 0, 2, one.c == 1 ? 0 : 1);   /* endianness */
+    add_offset(&t, 1, &fields_at);
+    schema = end_table(b, &t);
+
+    v = start_vector(b, w->nfield, 4);
+    patch(b, fields_at, v);
+    for (i = 0; i < w->nfield; i++)
+        put(b, 0, 4);
+    for (i = 0; i < w->nfield; i++)
+        patch(b, v + 4 + 4 * i, put_field(b, w->names[i],
+                i < 2 ? i : -1));
+
+    return schema;
+}
+
+/* Write a RecordBatch table of n rows with nfield fields, none of
+   which contains nulls.  The body holds the nbuffer buffers of the
+   fields back to back, each padded to a multiple of 8 bytes. */
+static size_t put_record_batch(struct Builder *b, unsigned long n,
+    int nfield, int nbuffer, const unsigned long long *len)
+{
+    struct Table t;
+    size_t batch, nodes_at, buffers_at;
+    unsigned long long offset;
+    int i;
+
+    start_table(&t, 3);
+    add_scalar(&t, 0, 8, n);
+    add_offset(&t, 1, &nodes_at);
+    add_offset(&t, 2, &buffers_at);
+    batch = end_table(b, &t);
+
+    patch(b, nodes_at, start_vector(b, nfield, 8));
+    for (i = 0; i < nfield; i++) {
+        put(b, n, 8);                           /* length */
+        put(b, 0, 8);                           /* null_count */
+    }
+
+    patch(b, buffers_at, start_vector(b, nbuffer, 8));
+    for (offset = i = 0; i < nbuffer; offset += PAD8(len[i]), i++) {
+        put(b, offset, 8);
+        put(b, len[i], 8);
+    }
+
+    return batch;
+}
+
+/* Start the metadata of a message with the given header and return
+   the position of the offset to the header. */
+static size_t start_message(struct Builder *b, int header_type,
+    unsigned long long body)
+{
+    struct Table t;
+    size_t header_at;
+
+    b->len = 0;
+    put(b, 0, 4);                               /* root offset */
+
+    start_table(&t, 4);
+    add_scalar(&t, 0, 2, METADATA_V5);
+    add_scalar(&t, 1, 1, header_type);
+    add_offset(&t, 2, &header_at);
+    add_scalar(&t, 3, 8, body);
+    patch(b, 0, end_table(b, &t));
+
+    return header_at;
+}
+
+static int add_block(struct Blocks *blocks, unsigned long long offset,
+    unsigned long meta, unsigned long long body)
+{
+    struct Block *t;
+    size_t n;
+
+    if (blocks->n == blocks->size) {
+        n = (blocks->size ? 2 * blocks->size : 64) * sizeof(struct Block);
+        if ((t = (struct Block *) realloc(blocks->block, n)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+            return 0;
+        }
+        blocks->block = t;
+        blocks->size = n / sizeof(struct Block);
+    }
+    blocks->block[blocks->n].offset = offset;
+    blocks->block[blocks->n].meta = meta;
+    blocks->block[blocks->n].body = body;
+    blocks->n++;
+
+    return 1;
+}
+
+/* Write the message whose metadata is in w->b, followed by a body
+   made of the nbuffer buffers in w->data, and add it to blocks unless
+   blocks is NULL. */
+static int write_message(ArrowWriter w, struct Blocks *blocks,
+    int nbuffer)
+{
+    unsigned char prefix[8];
+    unsigned long long offset;
+    int i;
+
+    align(&w->b, 8);
+    if (w->b.failed) {
+        set_err_msg("failed to allocate memory for Arrow metadata");
+        return 0;
+    }
+
+    memset(prefix, 0xff, 4);
+    for (i = 0; i < 4; i++)
+        prefix[4 + i] = (w->b.len >> 8 * i) & 0xff;
+
+    offset = w->pos;
+    if (!write_bytes(w, prefix, sizeof prefix)
+        ||  !write_bytes(w, w->b.buf, w->b.len))
+        return 0;
+    for (i = 0; i < nbuffer; i++)
+        if (!write_bytes(w, w->data[i], w->len[i])  ||  !write_padding(w))
+            return 0;
+
+    return blocks == NULL  ||  add_block(blocks, offset,
+        sizeof prefix + w->b.len, w->pos - offset - sizeof prefix
+        - w->b.len);
+}
+
+/* Write the n labels of one dictionary as a utf8 column. */
+static int write_dictionary(ArrowWriter w, int id,
+    const struct Layout *layout, LabelFunc label, int n)
+{
+    struct Table t;
+    size_t dictionary_at, batch_at;
+    unsigned long long nchar;
+    int *offsets, i, status;
+    char *chars, *s;
+
+    for (nchar = i = 0; i < n; i++)
+        nchar += strlen(label(layout, i));
+    if (nchar > INT_MAX) {
+        set_err_msg("labels too long for Arrow dictionary: %llu bytes",
+            nchar);
+        return 0;
+    }
+
+    offsets = (int *) malloc((n + 1) * sizeof(int));
+    chars = (char *) malloc(nchar + 1);
+    if (offsets == NULL  ||  chars == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) ((n + 1) * sizeof(int) + nchar + 1));
+        status = 0;
+        goto FREE_BUFFERS;
+    }
+    for (s = chars, i = 0; i < n; i++) {
+        offsets[i] = s - chars;
+        s = stpcpy(s, label(layout, i));
+    }
+    offsets[n] = s - chars;
+
+    w->data[0] = NULL;
+    w->len[0] = 0;
+    w->data[1] = offsets;
+    w->len[1] = (n + 1) * sizeof(int);
+    w->data[2] = chars;
+    w->len[2] = nchar;
+
+    dictionary_at = start_message(&w->b, HEADER_DICTIONARY_BATCH,
+        body_length(3, w->len));
+    start_table(&t, 2);
+    add_scalar(&t, 0, 8, id);
+    add_offset(&t, 1, &batch_at);
+    patch(&w->b, dictionary_at, end_table(&w->b, &t));
+    patch(&w->b, batch_at, put_record_batch(&w->b, n, 1, 3, w->len));
+
+    status = write_message(w, &w->dictionaries, 3);
+
+FREE_BUFFERS:
+    free(offsets);
+    free(chars);
+    return status;
+}
+
+/* Open an Arrow IPC file on fp and write its schema and dictionaries.
+   The columns are those selected in params. */
+ArrowWriter ArrowWriter_Create(FILE *fp, const char *file,
+    struct Params *params, struct Layout *layout)
+{
+    static const char magic[8] = "ARROW1";
+    ArrowWriter w;
+    size_t header_at;
+    int i, j, nvar;
+
+    if ((w = (ArrowWriter) calloc(1, sizeof *w)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof *w);
+        return NULL;
+    }
+    w->fp = fp;
+    w->file = file;
+    w->nfield = 2 + params->ncolumn;
+    w->names = (const char **) malloc(w->nfield * sizeof(char *));
+    w->data = (const void **) malloc(2 * w->nfield * sizeof(void *));
+    w->len = (unsigned long long *) malloc(2 * w->nfield
+        * sizeof(unsigned long long));
+    if (w->names == NULL  ||  w->data == NULL  ||  w->len == NULL) {
+        set_err_msg("failed to allocate memory for %d Arrow fields",
+            w->nfield);
+        goto DESTROY;
+    }
+
+    nvar = layout->nvar;
+    w->names[0] = "snp";
+    w->names[1] = "trait";
+    for (i = 0; i < params->ncolumn; i++) {
+        j = params->ucp2acp[i];
+        w->names[2 + i] = j < nvar ? layout->beta_labels[j]
+            : j < 2 * nvar ? layout->se_labels[j - nvar]
+            : layout->cov_labels[j - 2 * nvar];
+    }
+
+    header_at = start_message(&w->b, HEADER_SCHEMA, 0);
+    patch(&w->b, header_at, put_schema(&w->b, w));
+
+    if (!write_bytes(w, magic, sizeof magic)
+        ||  !write_message(w, NULL, 0)
+        ||  !write_dictionary(w, 0, layout, snp_label, layout->nsnp)
+        ||  !write_dictionary(w, 1, layout, trait_label, layout->ntrait))
+        goto DESTROY;
+
+    return w;
+
+DESTROY:
+    ArrowWriter_Destroy(w);
+    return NULL;
+}
+
+/* Write a record batch of n rows.  Column j of the selected columns
+   starts at columns + j * stride. */
+int ArrowWriter_WriteBatch(ArrowWriter w, int n, const int *snp,
+    const int *trait, const double *columns, int stride)
+{
+    size_t batch_at;
+    int i;
+
+    for (i = 0; i < w->nfield; i++) {
+        w->data[2 * i] = NULL;
+        w->len[2 * i] = 0;
+        w->data[2 * i + 1] = i == 0 ? (const void *) snp
+            : i == 1 ? (const void *) trait
+            : (const void *) (columns + (size_t) (i - 2) * stride);
+        w->len[2 * i + 1] = (unsigned long long) n
+            * (i < 2 ? sizeof(int) : sizeof(double));
+    }
+
+    batch_at = start_message(&w->b, HEADER_RECORD_BATCH,
+        body_length(2 * w->nfield, w->len));
+    patch(&w->b, batch_at, put_record_batch(&w->b, n, w->nfield,
+            2 * w->nfield, w->len));
+
+    return write_message(w, &w->batches, 2 * w->nfield);
+}
+
+static void put_blocks(struct Builder *b, size_t where,
+    const struct Blocks *blocks)
+{
+    int i;
+
+    patch(b, where, start_vector(b, blocks->n, 8));
+    for (i = 0; i < blocks->n; i++) {
+        put(b, blocks->block[i].offset, 8);
+        put(b, blocks->block[i].meta, 4);
+        put(b, 0, 4);                           /* padding */
+        put(b, blocks->block[i].body, 8);
+    }
+}
+
+/* Write the end-of-stream marker and the footer. */
+int ArrowWriter_Finish(ArrowWriter w)
+{
+    static const unsigned char eos[8] = {0xff, 0xff, 0xff, 0xff};
+    struct Table t;
+    struct Builder *b;
+    size_t schema_at, dictionaries_at, batches_at;
+    unsigned char len[4];
+    int i;
+
+    b = &w->b;
+    b->len = 0;
+    put(b, 0, 4);                               /* root offset */
+    start_table(&t, 4);
+    add_scalar(&t, 0, 2, METADATA_V5);
+    add_offset(&t, 1, &schema_at);
+    add_offset(&t, 2, &dictionaries_at);
+    add_offset(&t, 3, &batches_at);
+    patch(b, 0, end_table(b, &t));
+    patch(b, schema_at, put_schema(b, w));
+    put_blocks(b, dictionaries_at, &w->dictionaries);
+    put_blocks(b, batches_at, &w->batches);
+    align(b, 8);
+    if (b->failed) {
+        set_err_msg("failed to allocate memory for Arrow metadata");
+        return 0;
+    }
+
+    for (i = 0; i < 4; i++)
+        len[i] = (b->len >> 8 * i) & 0xff;
+
+    return write_bytes(w, eos, sizeof eos)
+        &&  write_bytes(w, b->buf, b->len)
+        &&  write_bytes(w, len, sizeof len)
+        &&  write_bytes(w, "ARROW1", 6);
+}
+
+/* Number of bytes written and number of writes to the file so far. */
+unsigned long long ArrowWriter_BytesWritten(ArrowWriter w)
+{
+    return w->pos;
+}
+
+unsigned long long ArrowWriter_Writes(ArrowWriter w)
+{
+    return w->nwrite;
+}
+
+void ArrowWriter_Destroy(ArrowWriter w)
+{
+    if (w == NULL)
+        return;
+    free(w->names);
+    free(w->data);
+    free(w->len);
+    free(w->b.buf);
+    free(w->dictionaries.block);
+    free(w->batches.block);
+    free(w);
+}
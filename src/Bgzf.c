@@ -0,0 +1,312 @@
+#include "Bgzf.h"
+#include "run_ordered.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+/* BGZF, the blocked gzip format of bgzip and samtools, is a series of
+   gzip members, each holding at most BGZF_BLOCK_SIZE bytes of input.
+   Every member carries its own compressed size in a "BC" extra field,
+   so a reader can jump from block to block, and the file ends with an
+   empty member.  Since the members are ordinary gzip members, zcat
+   reads the file like any other gzip file.
+
+   A position in the uncompressed data is given by a virtual offset:
+   the file offset of the block that holds the position shifted left
+   by 16 bits plus the position within the block's uncompressed data.
+
+   Blocks are independent, which lets us compress them in parallel.
+   We collect BLOCKS_PER_THREAD blocks per thread and compress them
+   with run_ordered, which also writes them in order. */
+
+enum { BLOCKS_PER_THREAD = 16 };
+
+/* Size of the gzip header including the BC extra field and of the
+   gzip footer (CRC32 and input size). */
+enum { HEADER_SIZE = 18, FOOTER_SIZE = 8 };
+
+static const unsigned char eof_block[28] = {
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0,
+    3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+struct BgzfWriterStruct {
+    FILE *fp;
+    const char *file;           /* name of output file */
+    int nthread;
+    z_stream *zs;               /* one deflate stream per thread */
+    int *zs_ready;              /* Is zs[i] initialized? */
+    char *buf;                  /* uncompressed data of pending blocks */
+    size_t len;                 /* number of pending bytes */
+    size_t size;                /* capacity of buf */
+    unsigned long long coffset; /* number of compressed bytes written */
+    int at_line_start;          /* Does the next block start a line? */
+    BgzfLineHook hook;
+    void *arg;
+};
+
+BgzfWriter BgzfWriter_Open(FILE *fp, const char *file, int nthread,
+    BgzfLineHook hook, void *arg)
+{
+    BgzfWriter w;
+
+    if ((w = (BgzfWriter) calloc(1, sizeof *w)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof *w);
+        return NULL;
+    }
+    w->fp = fp;
+    w->file = file;
+    w->nthread = nthread;
+    w->size = (size_t) BLOCKS_PER_THREAD * nthread * BGZF_BLOCK_SIZE;
+    w->at_line_start = 1;
+    w->hook = hook;
+    w->arg = arg;
+    w->buf = (char *) malloc(w->size);
+    w->zs = (z_stream *) calloc(nthread, sizeof(z_stream));
+    w->zs_ready = (int *) calloc(nthread, sizeof(int));
+    if (w->buf == NULL  ||  w->zs == NULL  ||  w->zs_ready == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) w->size);
+        free(w->buf);
+        free(w->zs);
+        free(w->zs_ready);
+        free(w);
+        return NULL;
+    }
+
+    return w;
+}
+
+static void put16(unsigned char *p, unsigned long x)
+{
+    p[0] = x & 0xff;
+    p[1] = (x >> 8) & 0xff;
+}
+
+static void put32(unsigned char *p, unsigned long x)
+{
+    put16(p, x);
+    put16(p + 2, x >> 16);
+}
+
+/* Compress pending block number unit into a gzip member. */
+static int compress_block(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    BgzfWriter w = (BgzfWriter) arg;
+    z_stream *zs;
+    unsigned char *p;
+    const char *data;
+    size_t n, size;
+
+    if (chunk->size < BGZF_MAX_BLOCK) {
+        if ((chunk->data = (char *) realloc(chunk->data, BGZF_MAX_BLOCK))
+            == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) BGZF_MAX_BLOCK);
+            return 0;
+        }
+        chunk->size = BGZF_MAX_BLOCK;
+    }
+
+    zs = &w->zs[worker];
+    if (!w->zs_ready[worker]) {
+        if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                Z_DEFAULT_STRATEGY) != Z_OK) {
+            set_err_msg("failed to initialize zlib");
+            return 0;
+        }
+        w->zs_ready[worker] = 1;
+    }
+    else
+        deflateReset(zs);
+
+    data = w->buf + unit * BGZF_BLOCK_SIZE;
+    n = w->len - unit * BGZF_BLOCK_SIZE;
+    if (n > BGZF_BLOCK_SIZE)
+        n = BGZF_BLOCK_SIZE;
+
+    /* A block of BGZF_BLOCK_SIZE bytes always fits: deflate never
+       expands its input by more than a few bytes per 16K. */
+    p = (unsigned char *) chunk->data;
+    zs->next_in = (unsigned char *) data;
+    zs->avail_in = n;
+    zs->next_out = p + HEADER_SIZE;
+    zs->avail_out = BGZF_MAX_BLOCK - HEADER_SIZE - FOOTER_SIZE;
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+        set_err_msg("failed to compress block for output file: %s",
+            w->file);
+        return 0;
+    }
+    size = HEADER_SIZE + zs->total_out + FOOTER_SIZE;
+
+    memcpy(p, eof_block, HEADER_SIZE);
+    put16(p + 16, size - 1);
+    put32(p + size - 8, crc32(0, (const unsigned char *) data, n));
+    put32(p + size - 4, n);
+    chunk->len = size;
+
+    return 1;
+}
+
+/* Write a compressed block and report its first complete line. */
+static int write_block(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    BgzfWriter w = (BgzfWriter) arg;
+    const char *data, *a, *b;
+    size_t n;
+
+    data = w->buf + unit * BGZF_BLOCK_SIZE;
+    n = w->len - unit * BGZF_BLOCK_SIZE;
+    if (n > BGZF_BLOCK_SIZE)
+        n = BGZF_BLOCK_SIZE;
+
+    if (w->hook != NULL) {
+        if (w->at_line_start)
+            a = data;
+        else if ((a = (const char *) memchr(data, '\n', n)) != NULL)
+            a++;
+        if (a != NULL  &&  a < data + n
+            &&  (b = (const char *) memchr(a, '\n', data + n - a)) != NULL
+            &&  !w->hook(w->arg, w->coffset << 16 | (a - data), a,
+                b + 1 - a))
+            return 0;
+    }
+    w->at_line_start = data[n - 1] == '\n';
+
+    if (fwrite(chunk->data, chunk->len, 1, w->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", w->file);
+        return 0;
+    }
+    w->coffset += chunk->len;
+
+    return 1;
+}
+
+/* Compress and write the pending blocks. */
+static int flush_blocks(BgzfWriter w)
+{
+    unsigned long nblock;
+    int status;
+
+    nblock = (w->len + BGZF_BLOCK_SIZE - 1) / BGZF_BLOCK_SIZE;
+    status = nblock == 0  ||  run_ordered(w->nthread, nblock,
+        compress_block, write_block, w);
+    w->len = 0;
+    return status;
+}
+
+int BgzfWriter_Write(BgzfWriter w, const char *data, size_t n)
+{
+    size_t k;
+
+    while (n > 0) {
+        if (w->len == w->size  &&  !flush_blocks(w))
+            return 0;
+        k = w->size - w->len < n ? w->size - w->len : n;
+        memcpy(w->buf + w->len, data, k);
+        w->len += k;
+        data += k;
+        n -= k;
+    }
+    return 1;
+}
+
+/* Write the pending blocks and the end-of-file block, and free w. */
+int BgzfWriter_Close(BgzfWriter w)
+{
+    int status, i;
+
+    status = flush_blocks(w);
+    if (status  &&  fwrite(eof_block, sizeof eof_block, 1, w->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", w->file);
+        status = 0;
+    }
+
+    for (i = 0; i < w->nthread; i++)
+        if (w->zs_ready[i])
+            deflateEnd(&w->zs[i]);
+    free(w->zs);
+    free(w->zs_ready);
+    free(w->buf);
+    free(w);
+
+    return status;
+}
+
+/* Writing to a stream returned by BgzfWriter_OpenStream writes to the
+   BGZF writer, and closing the stream closes the writer.  This lets
+   code that writes to a FILE write BGZF instead. */
+static ssize_t write_stream(void *cookie, const char *data, size_t n)
+{
+    return BgzfWriter_Write((BgzfWriter) cookie, data, n) ? (ssize_t) n
+        : -1;
+}
+
+static int close_stream(void *cookie)
+{
+    return BgzfWriter_Close((BgzfWriter) cookie) ? 0 : EOF;
+}
+
+FILE *BgzfWriter_OpenStream(BgzfWriter w)
+{
+    cookie_io_functions_t io = {NULL, write_stream, NULL, close_stream};
+    FILE *fp;
+
+    if ((fp = fopencookie(w, "w", io)) == NULL) {
+        set_err_msg("failed to open BGZF stream for output file: %s",
+            w->file);
+        BgzfWriter_Close(w);
+    }
+    return fp;
+}
+
+/* Read and decompress the block at file offset coffset into buf,
+   which must hold BGZF_MAX_BLOCK bytes.  Return the number of bytes
+   in the block through *len and the offset of the next block through
+   *next. */
+int Bgzf_ReadBlock(FILE *fp, unsigned long long coffset, char *buf,
+    size_t *len, unsigned long long *next)
+{
+    unsigned char block[BGZF_MAX_BLOCK];
+    z_stream zs;
+    size_t size;
+    int status;
+
+    if (fseeko(fp, (off_t) coffset, SEEK_SET) != 0
+        ||  fread(block, HEADER_SIZE, 1, fp) != 1
+        ||  block[0] != 31  ||  block[1] != 139  ||  block[3] != 4
+        ||  block[12] != 'B'  ||  block[13] != 'C') {
+        set_err_msg("no BGZF block at offset %llu", coffset);
+        return 0;
+    }
+    size = (block[16] | block[17] << 8) + 1;
+    if (size < HEADER_SIZE + FOOTER_SIZE
+        ||  fread(block + HEADER_SIZE, size - HEADER_SIZE, 1, fp) != 1) {
+        set_err_msg("truncated BGZF block at offset %llu", coffset);
+        return 0;
+    }
+
+    memset(&zs, 0, sizeof zs);
+    if (inflateInit2(&zs, -15) != Z_OK) {
+        set_err_msg("failed to initialize zlib");
+        return 0;
+    }
+    zs.next_in = block + HEADER_SIZE;
+    zs.avail_in = size - HEADER_SIZE - FOOTER_SIZE;
+    zs.next_out = (unsigned char *) buf;
+    zs.avail_out = BGZF_MAX_BLOCK;
+    status = inflate(&zs, Z_FINISH) == Z_STREAM_END;
+    *len = zs.total_out;
+    inflateEnd(&zs);
+    if (!status) {
+        set_err_msg("corrupt BGZF block at offset %llu", coffset);
+        return 0;
+    }
+
+    *next = coffset + size;
+    return 1;
+}
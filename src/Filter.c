@@ -0,0 +1,567 @@
+#include "Filter.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+/* A --where expression is compiled into a program for a small stack
+   machine.  Rather than running the program once per record, we run
+   every instruction over a whole batch of FILTER_BATCH records: LOAD
+   gathers a column of the batch into a vector on the stack, and all
+   other instructions combine the vectors on top of the stack element
+   by element.  The loops over a vector have a fixed trip count and
+   don't alias, which lets the compiler turn them into SIMD code.
+   Lanes beyond the records of a short batch hold zeros and are
+   ignored.  The stack lives on the C stack of Filter_Apply, so a
+   compiled filter can be applied by several threads at once.
+
+   Grammar (lowest precedence first):
+
+       or      = and { "||" and }
+       and     = cmp { "&&" cmp }
+       cmp     = sum [ ("<" | "<=" | ">" | ">=" | "==" | "!=") sum ]
+       sum     = product { ("+" | "-") product }
+       product = unary { ("*" | "/") unary }
+       unary   = ("-" | "!") unary | primary
+       primary = number | column | function "(" arg ")" | "(" or ")"
+
+   Columns are referred to by their labels in the layout file.  The
+   functions are abs, sqrt, log10, and p, where p(x) is the two-sided
+   p-value beta/se of covariate x under a normal approximation.  The
+   covariate can be given by its beta label, its se label, or by its
+   beta label without a "beta_" prefix. */
+
+enum Op {
+    OP_LOAD, OP_CONST, OP_P, OP_ABS, OP_SQRT, OP_LOG10, OP_NEG, OP_NOT,
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ,
+    OP_NE, OP_AND, OP_OR
+};
+
+struct Instr {
+    enum Op op;
+    int col;                    /* column for OP_LOAD, beta for OP_P */
+    int col2;                   /* se column for OP_P */
+    double value;               /* constant for OP_CONST */
+};
+
+struct FilterStruct {
+    struct Instr *code;         /* program */
+    int ncode;                  /* number of instructions */
+    int size;                   /* capacity of code */
+    int depth;                  /* current stack depth while compiling */
+};
+
+/* Maximum stack depth of a program. */
+enum { MAX_DEPTH = 32 };
+
+/* Maximum nesting of parentheses, function calls, and unary operators,
+   which bounds the recursion of the parser. */
+enum { MAX_NESTING = 256 };
+
+/* Compiler state. */
+struct Parser {
+    Filter f;
+    struct Layout *layout;
+    const char *expr;           /* whole expression */
+    const char *s;              /* current position */
+    int nesting;                /* current nesting while parsing */
+};
+
+static int parse_or(struct Parser *p);
+
+static int emit(struct Parser *p, enum Op op, int col, int col2,
+    double value)
+{
+    Filter f = p->f;
+    struct Instr *t;
+
+    if (f->ncode == f->size) {
+        f->size = f->size ? 2 * f->size : 16;
+        if ((t = (struct Instr *) realloc(f->code,
+                    f->size * sizeof(struct Instr))) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (f->size * sizeof(struct Instr)));
+            return 0;
+        }
+        f->code = t;
+    }
+    f->code[f->ncode].op = op;
+    f->code[f->ncode].col = col;
+    f->code[f->ncode].col2 = col2;
+    f->code[f->ncode].value = value;
+    f->ncode++;
+
+    /* Loads push a vector, unary operators replace the top of the
+       stack, and binary operators replace the top two vectors. */
+    if (op == OP_LOAD  ||  op == OP_CONST  ||  op == OP_P) {
+        if (++f->depth > MAX_DEPTH) {
+            set_err_msg("expression too complex in --where: %.100s",
+                p->expr);
+            return 0;
+        }
+    }
+    else if (op >= OP_ADD)
+        f->depth--;
+
+    return 1;
+}
+
+static void skip_space(struct Parser *p)
+{
+    while (isspace((unsigned char) *p->s))
+        p->s++;
+}
+
+/* If the next token is tok, consume it and return 1. */
+static int accept(struct Parser *p, const char *tok)
+{
+    size_t n = strlen(tok);
+
+    skip_space(p);
+    if (strncmp(p->s, tok, n))
+        return 0;
+    /* Don't mistake "<=" for "<" and so on. */
+    if (n == 1  &&  strchr("<>=!", *tok)  &&  p->s[1] == '=')
+        return 0;
+    p->s += n;
+    return 1;
+}
+
+static int syntax_error(struct Parser *p)
+{
+    set_err_msg("syntax error in --where at character %d: %.100s",
+        (int) (p->s - p->expr) + 1, p->expr);
+    return 0;
+}
+
+static int is_name_char(int c)
+{
+    return isalnum(c)  ||  c == '_'  ||  c == '.'  ||  c == ':';
+}
+
+/* Return the column position of label or -1. */
+static int find_column(struct Layout *layout, const char *label)
+{
+    int j;
+
+    for (j = 0; j < layout->nvar; j++)
+        if (!strcmp(label, layout->beta_labels[j]))
+            return j;
+    for (j = 0; j < layout->nvar; j++)
+        if (!strcmp(label, layout->se_labels[j]))
+            return layout->nvar + j;
+    for (j = 0; j < layout->ncov; j++)
+        if (!strcmp(label, layout->cov_labels[j]))
+            return 2 * layout->nvar + j;
+    return -1;
+}
+
+/* Return the covariate named by x in p(x) or -1. */
+static int find_covariate(struct Layout *layout, const char *x)
+{
+    int j;
+
+    for (j = 0; j < layout->nvar; j++)
+        if (!strcmp(x, layout->beta_labels[j])
+            ||  !strcmp(x, layout->se_labels[j])
+            ||  (!strncmp(layout->beta_labels[j], "beta_", 5)
+                &&  !strcmp(x, layout->beta_labels[j] + 5)))
+            return j;
+    return -1;
+}
+
+/* Enter a nested subexpression.  The caller leaves it by decrementing
+   p->nesting. */
+static int enter(struct Parser *p)
+{
+    if (++p->nesting > MAX_NESTING) {
+        set_err_msg("expression too deeply nested in --where");
+        return 0;
+    }
+    return 1;
+}
+
+static int parse_primary(struct Parser *p)
+{
+    static const struct {
+        const char *name;
+        enum Op op;
+    } functions[] = {
+        {"abs", OP_ABS}, {"sqrt", OP_SQRT}, {"log10", OP_LOG10},
+        {"p", OP_P}
+    };
+    char name[256];
+    const char *start;
+    char *end;
+    double value;
+    size_t n, i;
+    int col;
+
+    skip_space(p);
+
+    if (accept(p, "(")) {
+        if (!enter(p)  ||  !parse_or(p))
+            return 0;
+        p->nesting--;
+        return accept(p, ")") ? 1 : syntax_error(p);
+    }
+
+    if (isdigit((unsigned char) *p->s)  ||  *p->s == '.') {
+        value = strtod(p->s, &end);
+        if (end == p->s)
+            return syntax_error(p);
+        p->s = end;
+        return emit(p, OP_CONST, 0, 0, value);
+    }
+
+    start = p->s;
+    while (is_name_char((unsigned char) *p->s))
+        p->s++;
+    if ((n = p->s - start) == 0)
+        return syntax_error(p);
+    if (n >= sizeof name) {
+        set_err_msg("name too long in --where: %.20s...", start);
+        return 0;
+    }
+    memcpy(name, start, n);
+    name[n] = '\0';
+
+    if (!accept(p, "(")) {
+        if ((col = find_column(p->layout, name)) == -1) {
+            set_err_msg("unknown column in --where: %.100s", name);
+            return 0;
+        }
+        return emit(p, OP_LOAD, col, 0, 0.0);
+    }
+
+    for (i = 0; i < sizeof functions / sizeof functions[0]; i++)
+        if (!strcmp(name, functions[i].name))
+            break;
+    if (i == sizeof functions / sizeof functions[0]) {
+        set_err_msg("unknown function in --where: %.100s", name);
+        return 0;
+    }
+
+    if (functions[i].op == OP_P) {
+        skip_space(p);
+        start = p->s;
+        while (is_name_char((unsigned char) *p->s))
+            p->s++;
+        n = p->s - start;
+        if (n == 0  ||  n >= sizeof name)
+            return syntax_error(p);
+        memcpy(name, start, n);
+        name[n] = '\0';
+        if ((col = find_covariate(p->layout, name)) == -1) {
+            set_err_msg("unknown covariate in --where: p(%.100s)", name);
+            return 0;
+        }
+        if (!emit(p, OP_P, col, p->layout->nvar + col, 0.0))
+            return 0;
+    }
+    else {
+        if (!enter(p)  ||  !parse_or(p))
+            return 0;
+        p->nesting--;
+        if (!emit(p, functions[i].op, 0, 0, 0.0))
+            return 0;
+    }
+
+    return accept(p, ")") ? 1 : syntax_error(p);
+}
+
+static int parse_unary(struct Parser *p)
+{
+    enum Op op;
+
+    if (accept(p, "-"))
+        op = OP_NEG;
+    else if (accept(p, "!"))
+        op = OP_NOT;
+    else
+        return parse_primary(p);
+    if (!enter(p)  ||  !parse_unary(p))
+        return 0;
+    p->nesting--;
+    return emit(p, op, 0, 0, 0.0);
+}
+
+static int parse_product(struct Parser *p)
+{
+    enum Op op;
+
+    if (!parse_unary(p))
+        return 0;
+    for (;;) {
+        if (accept(p, "*"))
+            op = OP_MUL;
+        else if (accept(p, "/"))
+            op = OP_DIV;
+        else
+            return 1;
+        if (!parse_unary(p)  ||  !emit(p, op, 0, 0, 0.0))
+            return 0;
+    }
+}
+
+static int parse_sum(struct Parser *p)
+{
+    enum Op op;
+
+    if (!parse_product(p))
+        return 0;
+    for (;;) {
+        if (accept(p, "+"))
+            op = OP_ADD;
+        else if (accept(p, "-"))
+            op = OP_SUB;
+        else
+            return 1;
+        if (!parse_product(p)  ||  !emit(p, op, 0, 0, 0.0))
+            return 0;
+    }
+}
+
+static int parse_cmp(struct Parser *p)
+{
+    enum Op op;
+
+    if (!parse_sum(p))
+        return 0;
+    if (accept(p, "<="))
+        op = OP_LE;
+    else if (accept(p, "<"))
+        op = OP_LT;
+    else if (accept(p, ">="))
+        op = OP_GE;
+    else if (accept(p, ">"))
+        op = OP_GT;
+    else if (accept(p, "=="))
+        op = OP_EQ;
+    else if (accept(p, "!="))
+        op = OP_NE;
+    else
+        return 1;
+    return parse_sum(p)  &&  emit(p, op, 0, 0, 0.0);
+}
+
+static int parse_and(struct Parser *p)
+{
+    if (!parse_cmp(p))
+        return 0;
+    while (accept(p, "&&"))
+        if (!parse_cmp(p)  ||  !emit(p, OP_AND, 0, 0, 0.0))
+            return 0;
+    return 1;
+}
+
+static int parse_or(struct Parser *p)
+{
+    if (!parse_and(p))
+        return 0;
+    while (accept(p, "||"))
+        if (!parse_and(p)  ||  !emit(p, OP_OR, 0, 0, 0.0))
+            return 0;
+    return 1;
+}
+
+Filter Filter_Compile(const char *expr, struct Layout *layout)
+{
+    struct Parser p;
+    Filter f;
+
+    if ((f = (Filter) calloc(1, sizeof(*f))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof(*f));
+        return NULL;
+    }
+
+    p.f = f;
+    p.layout = layout;
+    p.expr = p.s = expr;
+    p.nesting = 0;
+    if (!parse_or(&p))
+        goto DESTROY_FILTER;
+    skip_space(&p);
+    if (*p.s != '\0') {
+        syntax_error(&p);
+        goto DESTROY_FILTER;
+    }
+
+    return f;
+
+DESTROY_FILTER:
+    Filter_Destroy(f);
+    return NULL;
+}
+
+void Filter_Destroy(Filter f)
+{
+    if (f == NULL)
+        return;
+    free(f->code);
+    free(f);
+}
+
+/* Set used[j] to 1 for every column j that the filter reads. */
+void Filter_MarkColumns(Filter f, unsigned char *used)
+{
+    int i;
+
+    for (i = 0; i < f->ncode; i++)
+        if (f->code[i].op == OP_LOAD)
+            used[f->code[i].col] = 1;
+        else if (f->code[i].op == OP_P)
+            used[f->code[i].col] = used[f->code[i].col2] = 1;
+}
+
+/* Element-wise operations on vectors of FILTER_BATCH doubles.  The
+   result replaces the first operand. */
+#define UNARY(name, expr)                                       \
+    static void name(double *restrict a)                       \
+    {                                                           \
+        int k;                                                  \
+        for (k = 0; k < FILTER_BATCH; k++)                      \
+            a[k] = (expr);                                      \
+    }
+
+#define BINARY(name, expr)                                      \
+    static void name(double *restrict a, const double *restrict b) \
+    {                                                           \
+        int k;                                                  \
+        for (k = 0; k < FILTER_BATCH; k++)                      \
+            a[k] = (expr);                                      \
+    }
+
+UNARY(vec_abs, fabs(a[k]))
+UNARY(vec_sqrt, sqrt(a[k]))
+UNARY(vec_log10, log10(a[k]))
+UNARY(vec_neg, -a[k])
+UNARY(vec_not, a[k] == 0.0)
+BINARY(vec_add, a[k] + b[k])
+BINARY(vec_sub, a[k] - b[k])
+BINARY(vec_mul, a[k] * b[k])
+BINARY(vec_div, a[k] / b[k])
+BINARY(vec_lt, a[k] < b[k])
+BINARY(vec_le, a[k] <= b[k])
+BINARY(vec_gt, a[k] > b[k])
+BINARY(vec_ge, a[k] >= b[k])
+BINARY(vec_eq, a[k] == b[k])
+BINARY(vec_ne, a[k] != b[k])
+BINARY(vec_and, (a[k] != 0.0) & (b[k] != 0.0))
+BINARY(vec_or, (a[k] != 0.0) | (b[k] != 0.0))
+
+/* Run the program on the n <= FILTER_BATCH given records and return
+   the vector of its values, which lies on the given stack. */
+static const double *run(Filter f, int n, const double **records,
+    double *stack)
+{
+    const struct Instr *in;
+    double *top, z;
+    int i, k;
+
+    top = stack - FILTER_BATCH;
+    for (i = 0, in = f->code; i < f->ncode; i++, in++) {
+        /* Binary operators combine the top two vectors into one. */
+        if (in->op >= OP_ADD)
+            top -= FILTER_BATCH;
+        switch (in->op) {
+        case OP_LOAD:
+            top += FILTER_BATCH;
+            for (k = 0; k < n; k++)
+                top[k] = records[k][in->col];
+            for (; k < FILTER_BATCH; k++)
+                top[k] = 0.0;
+            break;
+        case OP_CONST:
+            top += FILTER_BATCH;
+            for (k = 0; k < FILTER_BATCH; k++)
+                top[k] = in->value;
+            break;
+        case OP_P:
+            top += FILTER_BATCH;
+            for (k = 0; k < n; k++) {
+                z = records[k][in->col] / records[k][in->col2];
+                top[k] = erfc(fabs(z) * M_SQRT1_2);
+            }
+            for (; k < FILTER_BATCH; k++)
+                top[k] = 0.0;
+            break;
+        case OP_ABS:   vec_abs(top);   break;
+        case OP_SQRT:  vec_sqrt(top);  break;
+        case OP_LOG10: vec_log10(top); break;
+        case OP_NEG:   vec_neg(top);   break;
+        case OP_NOT:   vec_not(top);   break;
+        case OP_ADD:   vec_add(top, top + FILTER_BATCH); break;
+        case OP_SUB:   vec_sub(top, top + FILTER_BATCH); break;
+        case OP_MUL:   vec_mul(top, top + FILTER_BATCH); break;
+        case OP_DIV:   vec_div(top, top + FILTER_BATCH); break;
+        case OP_LT:    vec_lt(top, top + FILTER_BATCH); break;
+        case OP_LE:    vec_le(top, top + FILTER_BATCH); break;
+        case OP_GT:    vec_gt(top, top + FILTER_BATCH); break;
+        case OP_GE:    vec_ge(top, top + FILTER_BATCH); break;
+        case OP_EQ:    vec_eq(top, top + FILTER_BATCH); break;
+        case OP_NE:    vec_ne(top, top + FILTER_BATCH); break;
+        case OP_AND:   vec_and(top, top + FILTER_BATCH); break;
+        case OP_OR:    vec_or(top, top + FILTER_BATCH); break;
+        }
+    }
+
+    return top;
+}
+
+/* Evaluate the filter on the n <= FILTER_BATCH given records.  Set
+   keep[k] to 1 if records[k] passes the filter and to 0 otherwise.
+   Return the number of records that pass. */
+int Filter_Apply(Filter f, int n, const double **records,
+    unsigned char *keep)
+{
+    double stack[MAX_DEPTH * FILTER_BATCH];
+    const double *top;
+    int k, nkeep;
+
+    top = run(f, n, records, stack);
+    for (k = nkeep = 0; k < n; k++)
+        nkeep += keep[k] = top[k] != 0.0;
+    return nkeep;
+}
+
+/* Evaluate the expression on the n <= FILTER_BATCH given records and
+   store its value for records[k] in values[k].  This is how --rank-by
+   ranks records. */
+void Filter_Evaluate(Filter f, int n, const double **records,
+    double *values)
+{
+    double stack[MAX_DEPTH * FILTER_BATCH];
+
+    memcpy(values, run(f, n, records, stack), n * sizeof(double));
+}
+
+/* If the expression is nothing but p(COV), recompile it as beta / se
+   of COV and return 1.  The smaller the p-value, the larger the
+   absolute value of beta / se, but only the latter stays apart from 0
+   beyond |beta / se| = 37, where erfc underflows.  Return 0 and keep
+   any other expression.  Return -1 on failure. */
+int Filter_PValueToZ(Filter f)
+{
+    struct Parser p;
+    int beta, se;
+
+    if (f->ncode != 1  ||  f->code[0].op != OP_P)
+        return 0;
+    beta = f->code[0].col;
+    se = f->code[0].col2;
+
+    p.f = f;
+    p.layout = NULL;
+    p.expr = p.s = "";
+    p.nesting = 0;
+    f->ncode = f->depth = 0;
+    if (!emit(&p, OP_LOAD, beta, 0, 0.0)
+        ||  !emit(&p, OP_LOAD, se, 0, 0.0)
+        ||  !emit(&p, OP_DIV, 0, 0, 0.0))
+        return -1;
+    return 1;
+}
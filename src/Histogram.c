@@ -0,0 +1,113 @@
+#include "Histogram.h"
+#include "err_msg.h"
+#include <stdlib.h>
+
+/* A Histogram counts values such as latencies in nanoseconds in the
+   manner of an HDR histogram: values below 2^SUB_BITS are counted
+   exactly, and every range [2^k, 2^(k+1)) above is split into
+   2^(SUB_BITS - 1) buckets of equal width.  Every value thus falls
+   into a bucket less than 1% of its value wide, from nanoseconds to
+   centuries, in a few thousand counters, and recording a value costs
+   a handful of instructions. */
+
+enum { SUB_BITS = 8, HALF = 1 << (SUB_BITS - 1) };
+
+/* Buckets for all 64-bit values. */
+enum { NBUCKET = (64 - SUB_BITS + 2) * HALF };
+
+struct HistogramStruct {
+    unsigned long long count[NBUCKET];
+    unsigned long long total;   /* number of values */
+    unsigned long long max;     /* largest value */
+    double sum;                 /* sum of values */
+};
+
+Histogram Histogram_Create(void)
+{
+    Histogram h;
+
+    if ((h = (Histogram) calloc(1, sizeof(*h))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof(*h));
+        return NULL;
+    }
+    return h;
+}
+
+/* Above 2^SUB_BITS, a value is shifted right until it has SUB_BITS
+   bits.  Its top bit is then always set, so the bucket is given by the
+   shift and the remaining SUB_BITS - 1 bits. */
+static int bucket(unsigned long long value)
+{
+    int shift;
+
+    if (value < 2 * HALF)
+        return value;
+    shift = 64 - __builtin_clzll(value) - SUB_BITS;
+    return shift * HALF + (value >> shift);
+}
+
+/* Largest value in bucket i. */
+static unsigned long long highest_value(int i)
+{
+    int shift;
+
+    if (i < 2 * HALF)
+        return i;
+    shift = i / HALF - 1;
+    return ((unsigned long long) (i - shift * HALF) << shift)
+        + ((1ULL << shift) - 1);
+}
+
+void Histogram_Record(Histogram h, unsigned long long value)
+{
+    h->count[bucket(value)]++;
+    h->total++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+
+unsigned long long Histogram_Count(Histogram h)
+{
+    return h->total;
+}
+
+unsigned long long Histogram_Max(Histogram h)
+{
+    return h->max;
+}
+
+double Histogram_Mean(Histogram h)
+{
+    return h->total > 0 ? h->sum / h->total : 0;
+}
+
+/* Return the smallest value that at least percent percent of all
+   values are no larger than, up to the width of its bucket, or 0 if
+   there are no values. */
+unsigned long long Histogram_Percentile(Histogram h, double percent)
+{
+    unsigned long long rank, n, v;
+    double x;
+    int i;
+
+    if (h->total == 0)
+        return 0;
+    x = percent / 100 * h->total;
+    if ((rank = (unsigned long long) x) < x)
+        rank++;
+    if (rank < 1)
+        rank = 1;
+    n = 0;
+    for (i = 0; i < NBUCKET; i++)
+        if ((n += h->count[i]) >= rank)
+            break;
+    v = highest_value(i < NBUCKET ? i : NBUCKET - 1);
+    return v < h->max ? v : h->max;
+}
+
+void Histogram_Destroy(Histogram h)
+{
+    free(h);
+}
@@ -0,0 +1,152 @@
+#include "LabelPool.h"
+#include "Memory.h"
+#include "err_msg.h"
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+
+/* A LabelPool holds the labels of one tile of snps or traits back to
+   back, together with their lengths.  A label is copied into the pool
+   the first time it is asked for, so we call strnlen(3) once per label
+   and tile instead of once per output line, and every line gets its
+   labels with a plain memcpy(3).  When a label of another tile is
+   asked for, the pool forgets the labels of the previous tile.  The
+   pool therefore never holds more than per_tile labels, no matter
+   how many labels the layout has.
+
+   The pool starts without room for labels and holds only as many
+   bytes as the labels of a tile actually take, not max_char bytes per
+   label.  Returned labels must stay where they are until the tile
+   changes, so the pool can't grow in the middle of a tile.  A label
+   that doesn't fit is left in the layout, which only costs us the
+   copy, and when the tile changes, the pool grows to what the
+   previous tile needed.  Tiles are about equally large, so after the
+   first tile, labels hardly ever stay behind.
+
+   Instead of clearing the pool for every new tile, we count tiles in
+   gen and remember in which one a label was copied. */
+
+/* Position of a label that was left in the layout. */
+#define IN_LAYOUT UINT_MAX
+
+struct LabelPoolStruct {
+    const struct Layout *layout;
+    LabelFunc label;            /* label of a position */
+    int per_tile;               /* number of labels per tile */
+    int nslot;                  /* number of labels in the pool */
+    int max_char;               /* number of bytes per label */
+    int first;                  /* first label of the pooled tile */
+    int last;                   /* first label after the pooled tile */
+    unsigned gen;               /* number of tiles pooled so far */
+    unsigned *seen;             /* tile in which a label was pooled */
+    unsigned *start;            /* position of a label in chars */
+    unsigned *len;              /* length of a label */
+    char *chars;                /* pooled labels */
+    size_t size;                /* number of bytes allocated for chars */
+    size_t used;                /* number of bytes used in chars */
+    size_t need;                /* bytes the labels of the tile take */
+};
+
+/* Create a pool for the nlabel labels of layout given by label, which
+   come in tiles of per_tile labels. */
+LabelPool LabelPool_Create(const struct Layout *layout, LabelFunc label,
+    int nlabel, int per_tile)
+{
+    LabelPool pool;
+    int n;
+
+    if ((pool = (LabelPool) Memory_Malloc(sizeof(*pool))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof(*pool));
+        return NULL;
+    }
+    memset(pool, 0, sizeof(*pool));
+    pool->layout = layout;
+    pool->label = label;
+    pool->per_tile = per_tile;
+    pool->max_char = layout->max_char;
+    pool->first = pool->last = 0;
+
+    n = pool->nslot = per_tile < nlabel ? per_tile : nlabel;
+    pool->seen = (unsigned *) Memory_Malloc(n * sizeof(unsigned));
+    pool->start = (unsigned *) Memory_Malloc(n * sizeof(unsigned));
+    pool->len = (unsigned *) Memory_Malloc(n * sizeof(unsigned));
+    if (pool->seen == NULL  ||  pool->start == NULL  ||  pool->len == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) n * 3 * sizeof(unsigned));
+        LabelPool_Destroy(pool);
+        return NULL;
+    }
+    memset(pool->seen, 0, n * sizeof(unsigned));
+
+    return pool;
+}
+
+/* Start pooling the tile of label i.  Make room for as many bytes as
+   the labels of the previous tile took, if we can. */
+static void switch_tile(LabelPool pool, int i)
+{
+    char *t;
+
+    if (pool->need > pool->size
+        &&  (t = (char *) Memory_Malloc(pool->need)) != NULL) {
+        Memory_Free(pool->chars);
+        pool->chars = t;
+        pool->size = pool->need;
+    }
+    pool->first = i - i % pool->per_tile;
+    pool->last = pool->first + pool->per_tile;
+    pool->used = pool->need = 0;
+    if (++pool->gen == 0) {
+        memset(pool->seen, 0, pool->nslot * sizeof(unsigned));
+        pool->gen = 1;
+    }
+}
+
+/* Return label i and store its length in *len.  The label is not NUL
+   terminated and stays valid until a label of another tile is asked
+   for. */
+const char *LabelPool_Get(LabelPool pool, int i, size_t *len)
+{
+    const char *s;
+    int k;
+
+    if (i < pool->first  ||  i >= pool->last)
+        switch_tile(pool, i);
+    k = i - pool->first;
+    if (pool->seen[k] != pool->gen) {
+        s = pool->label(pool->layout, i);
+        pool->len[k] = strnlen(s, pool->max_char);
+        pool->need += pool->len[k];
+        if (pool->chars != NULL
+            &&  pool->used + pool->len[k] <= pool->size) {
+            pool->start[k] = pool->used;
+            memcpy(pool->chars + pool->used, s, pool->len[k]);
+            pool->used += pool->len[k];
+        }
+        else
+            pool->start[k] = IN_LAYOUT;
+        pool->seen[k] = pool->gen;
+    }
+
+    *len = pool->len[k];
+    if (pool->start[k] == IN_LAYOUT)
+        return pool->label(pool->layout, i);
+    return pool->chars + pool->start[k];
+}
+
+/* Number of bytes allocated by the pool. */
+size_t LabelPool_Size(LabelPool pool)
+{
+    return sizeof(*pool) + pool->size
+        + (size_t) pool->nslot * 3 * sizeof(unsigned);
+}
+
+void LabelPool_Destroy(LabelPool pool)
+{
+    Memory_Free(pool->seen);
+    Memory_Free(pool->start);
+    Memory_Free(pool->len);
+    Memory_Free(pool->chars);
+    Memory_Free(pool);
+}
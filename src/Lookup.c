@@ -0,0 +1,438 @@
+#include "Lookup.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#endif
+
+/* Reading scattered records one pread(2) after the other leaves fast
+   disks idle: every read waits for the previous one, so only one
+   request is ever outstanding.  A Lookup keeps up to depth reads in
+   flight instead.  It submits them through an io_uring if the kernel
+   lets us create one and otherwise hands them to depth threads that
+   call pread(2).
+
+   Reads are submitted in the order given, which should be file order.
+   Every read lands in its own buffer, so callers get their records
+   back in whatever order they asked for them. */
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags)
+{
+#ifdef __NR_io_uring_setup
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+        flags, NULL, 0);
+#else
+    (void) fd;
+    (void) to_submit;
+    (void) min_complete;
+    (void) flags;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int (*Lookup_Enter)(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags) = ring_enter;
+
+#ifdef __NR_io_uring_setup
+struct Ring {
+    int fd;
+    unsigned entries;           /* number of submission queue entries */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+};
+#endif
+
+struct LookupStruct {
+    int fd;                     /* data file */
+    const char *file;           /* name of data file */
+    size_t nbytes;              /* number of bytes per record */
+    int depth;                  /* maximum number of reads in flight */
+    int use_ring;               /* Submit reads through ring? */
+#ifdef __NR_io_uring_setup
+    struct Ring ring;
+    struct iovec *iov;          /* one iovec per read of a run */
+    unsigned long iov_size;     /* capacity of iov */
+#endif
+    unsigned long long bytes_read;
+    unsigned long long nread;
+};
+
+#ifdef __NR_io_uring_setup
+static int ring_setup(struct Ring *r, unsigned entries)
+{
+    struct io_uring_params p;
+    char *sq, *cq;
+
+    memset(&p, 0, sizeof p);
+    if ((r->fd = syscall(__NR_io_uring_setup, entries, &p)) < 0)
+        return 0;
+
+    r->entries = p.sq_entries;
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes
+        + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    /* With IORING_FEAT_SINGLE_MMAP, both rings share one mapping. */
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_size > r->sq_ring_size)
+            r->sq_ring_size = r->cq_ring_size;
+        r->cq_ring_size = r->sq_ring_size;
+    }
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED)
+        goto CLOSE_RING;
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->cq_ring = r->sq_ring;
+    else if ((r->cq_ring = mmap(NULL, r->cq_ring_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+                IORING_OFF_CQ_RING)) == MAP_FAILED)
+        goto UNMAP_SQ_RING;
+    r->sqes = (struct io_uring_sqe *) mmap(NULL, r->sqes_size,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd,
+        IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        goto UNMAP_CQ_RING;
+
+    sq = (char *) r->sq_ring;
+    cq = (char *) r->cq_ring;
+    r->sq_head = (unsigned *) (sq + p.sq_off.head);
+    r->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *) (sq + p.sq_off.array);
+    r->cq_head = (unsigned *) (cq + p.cq_off.head);
+    r->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    return 1;
+
+UNMAP_CQ_RING:
+    if (r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+UNMAP_SQ_RING:
+    munmap(r->sq_ring, r->sq_ring_size);
+CLOSE_RING:
+    close(r->fd);
+    return 0;
+}
+
+static void ring_destroy(struct Ring *r)
+{
+    munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+}
+#endif
+
+Lookup Lookup_Create(int fd, const char *file, size_t nbytes, int depth,
+    int engine)
+{
+    Lookup lk;
+
+    if ((lk = (Lookup) calloc(1, sizeof *lk)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof *lk);
+        return NULL;
+    }
+    lk->fd = fd;
+    lk->file = file;
+    lk->nbytes = nbytes;
+    lk->depth = depth > 0 ? depth : 1;
+#ifdef __NR_io_uring_setup
+    lk->use_ring = engine == LOOKUP_AUTO
+        &&  ring_setup(&lk->ring, lk->depth);
+    if (lk->use_ring  &&  lk->ring.entries < (unsigned) lk->depth)
+        lk->depth = lk->ring.entries;
+#else
+    (void) engine;
+#endif
+
+    return lk;
+}
+
+int Lookup_UsesIoUring(Lookup lk)
+{
+    return lk->use_ring;
+}
+
+unsigned long long Lookup_BytesRead(Lookup lk)
+{
+    return lk->bytes_read;
+}
+
+unsigned long long Lookup_Reads(Lookup lk)
+{
+    return lk->nread;
+}
+
+void Lookup_Destroy(Lookup lk)
+{
+#ifdef __NR_io_uring_setup
+    if (lk->use_ring)
+        ring_destroy(&lk->ring);
+    free(lk->iov);
+#endif
+    free(lk);
+}
+
+/* Read len bytes at byte offset pos into buf, retrying short reads.
+   Return 0 at end of file or on error. */
+static int read_fully(int fd, char *buf, size_t len, off_t pos)
+{
+    ssize_t k;
+
+    while (len > 0) {
+        if ((k = pread(fd, buf, len, pos)) <= 0) {
+            if (k < 0  &&  errno == EINTR)
+                continue;
+            return 0;
+        }
+        buf += k;
+        len -= k;
+        pos += k;
+    }
+    return 1;
+}
+
+static void read_failed(Lookup lk, const struct LookupRead *r)
+{
+    set_err_msg("failed to read records %lu to %lu from data file: %s",
+        r->offset, r->offset + r->n - 1, lk->file);
+}
+
+#ifdef __NR_io_uring_setup
+/* Did io_uring_enter(2) fail for now only?  EAGAIN and EBUSY mean
+   that the kernel is short of resources for new requests or of room
+   for completions until some reads complete. */
+static int transient(int err)
+{
+    return err == EINTR  ||  err == EAGAIN  ||  err == EBUSY;
+}
+
+/* Keep up to depth reads in flight in the ring.  Every completion
+   makes room for the next submission.  Short reads are rare (they
+   happen for reads that cross the end of the file or are interrupted)
+   and we finish them with pread(2).  If the kernel is short of
+   resources, we wait for a read in flight, reap it, and submit the
+   entries that it didn't consume again.  Reads in flight write into
+   the caller's buffers, so after io_uring_enter(2) failed for good, we
+   still wait for all reads in flight before we return, unless the
+   ring can't even be waited on. */
+static int run_ring(Lookup lk, struct LookupRead *reads, unsigned long n)
+{
+    struct Ring *r = &lk->ring;
+    struct io_uring_sqe *sqe;
+    struct io_uring_cqe *cqe;
+    struct iovec *iov;
+    unsigned long next, ndone, i;
+    unsigned tail, head, nsubmit, ninflight;
+    size_t len;
+    long failed;
+    int ret, broken;
+
+    if (lk->iov_size < n) {
+        if ((iov = (struct iovec *) realloc(lk->iov,
+                    n * sizeof(struct iovec))) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (n * sizeof(struct iovec)));
+            return 0;
+        }
+        lk->iov = iov;
+        lk->iov_size = n;
+    }
+
+    next = ndone = 0;
+    ninflight = 0;
+    failed = -1;
+    broken = 0;
+    while (ndone < n) {
+        tail = *r->sq_tail;
+        for (; failed == -1  &&  !broken  &&  next < n
+                 &&  ninflight < (unsigned) lk->depth; next++) {
+            lk->iov[next].iov_base = reads[next].buf;
+            lk->iov[next].iov_len = reads[next].n * lk->nbytes;
+            sqe = &r->sqes[tail & *r->sq_mask];
+            memset(sqe, 0, sizeof *sqe);
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd = lk->fd;
+            sqe->addr = (unsigned long) &lk->iov[next];
+            sqe->len = 1;
+            sqe->off = reads[next].offset * lk->nbytes;
+            sqe->user_data = next;
+            r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+            tail++;
+            ninflight++;
+        }
+        __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+        /* Entries that the kernel hasn't consumed yet, e.g., because
+           the last call was interrupted or the kernel was short of
+           resources, are submitted again. */
+        nsubmit = tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+
+        /* After a failure, we only wait for the reads in flight. */
+        if (ninflight == 0)
+            break;
+        ret = Lookup_Enter(r->fd, nsubmit, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0  &&  (errno == EAGAIN  ||  errno == EBUSY)) {
+            /* Wait for a read in flight, if there is one. */
+            head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+            if (ninflight > tail - head)
+                ret = Lookup_Enter(r->fd, 0, 1, IORING_ENTER_GETEVENTS);
+            else {
+                sched_yield();
+                ret = 0;
+            }
+        }
+        if (ret < 0  &&  !transient(errno)  &&  !broken) {
+            set_err_msg("failed to submit reads of data file: %s",
+                lk->file);
+            broken = 1;
+
+            /* Take back the entries that the kernel hasn't consumed.
+               Only the others are in flight. */
+            head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+            ninflight -= tail - head;
+            __atomic_store_n(r->sq_tail, head, __ATOMIC_RELEASE);
+        }
+        else if (ret < 0  &&  !transient(errno))
+            return 0;           /* the ring can't even be waited on */
+
+        head = *r->cq_head;
+        while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = &r->cqes[head & *r->cq_mask];
+            i = cqe->user_data;
+            len = reads[i].n * lk->nbytes;
+            if (cqe->res < 0
+                ||  ((size_t) cqe->res < len  &&  !read_fully(lk->fd,
+                        reads[i].buf + cqe->res, len - cqe->res,
+                        (off_t) (reads[i].offset * lk->nbytes
+                            + cqe->res))))
+                failed = failed == -1  ||  (long) i < failed ? (long) i
+                    : failed;
+            lk->bytes_read += len;
+            lk->nread++;
+            head++;
+            ninflight--;
+            ndone++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (broken)
+        return 0;
+    if (failed != -1) {
+        read_failed(lk, &reads[failed]);
+        return 0;
+    }
+    return 1;
+}
+#endif
+
+/* Without io_uring, depth threads take the next read in turn. */
+struct Pool {
+    Lookup lk;
+    struct LookupRead *reads;
+    unsigned long n;
+    unsigned long next;         /* next read to take */
+    long failed;                /* first failed read or -1 */
+    pthread_mutex_t lock;
+};
+
+static void *read_loop(void *arg)
+{
+    struct Pool *p = (struct Pool *) arg;
+    struct LookupRead *r;
+    unsigned long i;
+    int ok;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        i = p->next++;
+        pthread_mutex_unlock(&p->lock);
+        if (i >= p->n)
+            break;
+        r = &p->reads[i];
+        ok = read_fully(p->lk->fd, r->buf, r->n * p->lk->nbytes,
+            (off_t) (r->offset * p->lk->nbytes));
+        pthread_mutex_lock(&p->lock);
+        if (!ok  &&  (p->failed == -1  ||  (long) i < p->failed))
+            p->failed = i;
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+static int run_threads(Lookup lk, struct LookupRead *reads,
+    unsigned long n)
+{
+    struct Pool p;
+    pthread_t *threads;
+    unsigned long i, k, nthread;
+
+    nthread = n < (unsigned long) lk->depth ? n : (unsigned long) lk->depth;
+    if ((threads = (pthread_t *) malloc(nthread * sizeof(pthread_t)))
+        == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (nthread * sizeof(pthread_t)));
+        return 0;
+    }
+    p.lk = lk;
+    p.reads = reads;
+    p.n = n;
+    p.next = 0;
+    p.failed = -1;
+    pthread_mutex_init(&p.lock, NULL);
+
+    /* The calling thread is one of the nthread readers, so at most
+       depth reads are in flight.  With a single read or a depth of 1,
+       there is nothing to overlap and it does all the reads. */
+    for (k = 0; k + 1 < nthread; k++)
+        if (pthread_create(&threads[k], NULL, read_loop, &p) != 0)
+            break;
+    read_loop(&p);
+    for (i = 0; i < k; i++)
+        pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&p.lock);
+    free(threads);
+
+    for (i = 0; i < n; i++)
+        lk->bytes_read += reads[i].n * lk->nbytes;
+    lk->nread += n;
+    if (p.failed != -1) {
+        read_failed(lk, &reads[p.failed]);
+        return 0;
+    }
+    return 1;
+}
+
+/* Read the n ranges in reads. */
+int Lookup_Run(Lookup lk, struct LookupRead *reads, unsigned long n)
+{
+    if (n == 0)
+        return 1;
+#ifdef __NR_io_uring_setup
+    if (lk->use_ring)
+        return run_ring(lk, reads, n);
+#endif
+    return run_threads(lk, reads, n);
+}
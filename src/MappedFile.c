@@ -0,0 +1,87 @@
+#include "MappedFile.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+struct MappedFileStruct {
+    const char *data;           /* start of mapping */
+    size_t size;                /* size of mapping in bytes */
+};
+
+/* Map a regular file read-only into memory.  Return NULL if the file
+   cannot be mapped, e.g., because it is a pipe, is empty, or lives on
+   a filesystem that doesn't support mmap(2).  Callers are expected to
+   fall back to ordinary buffered reads in that case. */
+MappedFile MappedFile_Open(const char *filename)
+{
+    MappedFile mf;
+    struct stat buf;
+    void *p;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) == -1)
+        return NULL;
+
+    if (fstat(fd, &buf) == -1  ||  !S_ISREG(buf.st_mode)
+        ||  buf.st_size <= 0)
+        goto CLOSE_FILE;
+
+    p = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+        goto CLOSE_FILE;
+
+    /* The mapping stays valid after the file descriptor is closed. */
+    close(fd);
+
+    /* We walk the data file from front to back exactly once.  Telling
+       the kernel so makes it read ahead aggressively and drop pages
+       behind us early.  Huge pages cut the number of page faults and
+       TLB misses for mappings of hundreds of gigabytes.  Both are
+       only hints: if the kernel ignores them, we are no worse off. */
+    madvise(p, buf.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(p, buf.st_size, MADV_HUGEPAGE);
+#endif
+
+    if ((mf = (MappedFile) malloc(sizeof(*mf))) == NULL) {
+        munmap(p, buf.st_size);
+        return NULL;
+    }
+    mf->data = (const char *) p;
+    mf->size = buf.st_size;
+
+    return mf;
+
+CLOSE_FILE:
+    close(fd);
+
+    return NULL;
+}
+
+const char *MappedFile_Data(MappedFile mf)
+{
+    return mf->data;
+}
+
+size_t MappedFile_Size(MappedFile mf)
+{
+    return mf->size;
+}
+
+/* Turn off read-ahead for callers that skip over large parts of the
+   file.  They are expected to announce the ranges that they are going
+   to touch with madvise(MADV_WILLNEED). */
+void MappedFile_SetRandomAccess(MappedFile mf)
+{
+    madvise((void *) mf->data, mf->size, MADV_RANDOM);
+}
+
+void MappedFile_Close(MappedFile mf)
+{
+    munmap((void *) mf->data, mf->size);
+    free(mf);
+}
@@ -2,3 +2,4 @@
 #include <stdlib.h>
 
 void *(*Memory_Malloc)(size_t) = malloc;
+void (*Memory_Free)(void *) = free;
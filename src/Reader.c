@@ -0,0 +1,231 @@
+#include "Reader.h"
+#include "reader_layout.h"
+#include "parse_data_file.h"
+#include "decode.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* A Reader gives programs that link libr3shuffle the records of a
+   result set without going through text.  Reader_GetRecord fetches
+   the record of a snp and a trait as native doubles, and
+   Reader_GetTile hands out the records of a tile where they lie in
+   the mapped data file, without copying them.
+
+   The data file is mapped once and never written to, so any number of
+   threads may call Reader_GetRecord and Reader_GetTile on the same
+   reader at once.  Every reader keeps the message of its last failure
+   for Reader_ErrMsg under a lock of its own, so threads that share a
+   reader may fail and ask for the message at once; they get the
+   message of whichever failure came last.  A thread that wants the
+   message of its own failure looks at err_msg, which every thread has
+   a copy of. */
+
+struct ReaderStruct {
+    struct Layout layout;
+    MappedFile map;             /* mapping of the data file */
+    DecodeFunc decode;          /* converts values to native doubles */
+    int nvalue;                 /* number of values per record */
+    size_t nbytes;              /* number of bytes per record */
+    int ntile_col;              /* number of tiles per tile row */
+    pthread_mutex_t lock;       /* guards err */
+    char err[ERR_MSG_MAXLEN];   /* message of last failure */
+};
+
+/* Keep the calling thread's error message as the reader's. */
+static int fail(Reader r)
+{
+    pthread_mutex_lock(&r->lock);
+    memcpy(r->err, err_msg, ERR_MSG_MAXLEN);
+    pthread_mutex_unlock(&r->lock);
+    return 0;
+}
+
+/* Open the result set with layout file prefix.iout and data file
+   prefix.out.  Return NULL and set err_msg on failure. */
+Reader Reader_Open(const char *prefix)
+{
+    Reader r;
+    char *file;
+    unsigned long nrecord;
+    size_t n;
+
+    n = strlen(prefix) + sizeof ".iout";
+    if ((r = (Reader) calloc(1, sizeof(*r))) == NULL
+        ||  (file = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (sizeof(*r) + n));
+        free(r);
+        return NULL;
+    }
+
+    sprintf(file, "%s.iout", prefix);
+    if (!parse_layout_file(file, &r->layout))
+        goto FREE_READER;
+
+    sprintf(file, "%s.out", prefix);
+    if ((r->map = MappedFile_Open(file)) == NULL) {
+        set_err_msg("failed to map data file: %s", file);
+        goto FREE_LAYOUT;
+    }
+    r->nvalue = 2 * r->layout.nvar + r->layout.ncov;
+    r->nbytes = (size_t) r->nvalue * r->layout.bytes_per_double;
+    nrecord = (unsigned long) r->layout.nsnp * r->layout.ntrait;
+    if (MappedFile_Size(r->map) / r->nbytes < nrecord) {
+        set_err_msg("data file too short: expected %lu bytes, got %lu: "
+            "%s", nrecord * r->nbytes,
+            (unsigned long) MappedFile_Size(r->map), file);
+        goto CLOSE_MAP;
+    }
+
+    r->decode = find_decoder(r->layout.bytes_per_double,
+        r->layout.swapped, DECODE_BEST);
+    r->ntile_col = (r->layout.nsnp + r->layout.snps_per_tile - 1)
+        / r->layout.snps_per_tile;
+    free(file);
+    pthread_mutex_init(&r->lock, NULL);
+
+    return r;
+
+CLOSE_MAP:
+    MappedFile_Close(r->map);
+FREE_LAYOUT:
+    free_layout(&r->layout);
+FREE_READER:
+    free(file);
+    free(r);
+
+    return NULL;
+}
+
+const struct Layout *reader_layout(Reader r)
+{
+    return &r->layout;
+}
+
+int Reader_NumSnps(Reader r)
+{
+    return r->layout.nsnp;
+}
+
+int Reader_NumTraits(Reader r)
+{
+    return r->layout.ntrait;
+}
+
+/* Return the label of snp, or NULL if there is no such snp.  Labels
+   stay valid until the reader is closed. */
+const char *Reader_SnpLabel(Reader r, int snp)
+{
+    if (snp < 0  ||  snp >= r->layout.nsnp) {
+        set_err_msg("snp index out of range: %d", snp);
+        fail(r);
+        return NULL;
+    }
+    return snp_label(&r->layout, snp);
+}
+
+/* Return the label of trait, or NULL if there is no such trait. */
+const char *Reader_TraitLabel(Reader r, int trait)
+{
+    if (trait < 0  ||  trait >= r->layout.ntrait) {
+        set_err_msg("trait index out of range: %d", trait);
+        fail(r);
+        return NULL;
+    }
+    return trait_label(&r->layout, trait);
+}
+
+/* Number of doubles that Reader_GetRecord stores: nvar betas, nvar
+   standard errors and ncov covariances. */
+int Reader_ValuesPerRecord(Reader r)
+{
+    return r->nvalue;
+}
+
+/* Store the record of snp and trait in values as native doubles. */
+int Reader_GetRecord(Reader r, int snp, int trait, double *values)
+{
+    unsigned long offset;
+
+    if (snp < 0  ||  snp >= r->layout.nsnp) {
+        set_err_msg("snp index out of range: %d", snp);
+        return fail(r);
+    }
+    if (trait < 0  ||  trait >= r->layout.ntrait) {
+        set_err_msg("trait index out of range: %d", trait);
+        return fail(r);
+    }
+    index2offset(snp, trait, &offset, &r->layout);
+    r->decode(values, MappedFile_Data(r->map) + offset * r->nbytes,
+        r->nvalue);
+
+    return 1;
+}
+
+/* Tiles are numbered in file order, from 0 to Reader_NumTiles - 1. */
+unsigned long Reader_NumTiles(Reader r)
+{
+    return (unsigned long) r->ntile_col * ((r->layout.ntrait
+            + r->layout.traits_per_tile - 1) / r->layout.traits_per_tile);
+}
+
+int Reader_GetTile(Reader r, unsigned long tile, struct ReaderTile *t)
+{
+    const struct Layout *layout;
+    unsigned long offset;
+
+    if (tile >= Reader_NumTiles(r)) {
+        set_err_msg("tile index out of range: %lu", tile);
+        return fail(r);
+    }
+    layout = &r->layout;
+    t->snp0 = (tile % r->ntile_col) * layout->snps_per_tile;
+    t->snp1 = layout->nsnp - t->snp0 < layout->snps_per_tile
+        ? layout->nsnp : t->snp0 + layout->snps_per_tile;
+    t->trait0 = (tile / r->ntile_col) * layout->traits_per_tile;
+    t->trait1 = layout->ntrait - t->trait0 < layout->traits_per_tile
+        ? layout->ntrait : t->trait0 + layout->traits_per_tile;
+    index2offset(t->snp0, t->trait0, &offset, &r->layout);
+    t->data = MappedFile_Data(r->map) + offset * r->nbytes;
+
+    return 1;
+}
+
+/* Store the records of tile t as native doubles in values, which has
+   room for Reader_ValuesPerRecord values per record. */
+void Reader_DecodeTile(Reader r, const struct ReaderTile *t,
+    double *values)
+{
+    r->decode(values, t->data, (size_t) (t->snp1 - t->snp0)
+        * (t->trait1 - t->trait0) * r->nvalue);
+}
+
+/* Copy the message of the last failure on r, or of the calling thread
+   if r is NULL, e.g., after Reader_Open failed, into msg, which has
+   room for size characters.  Return msg. */
+const char *Reader_ErrMsg(Reader r, char *msg, size_t size)
+{
+    if (size == 0)
+        return msg;
+    if (r == NULL) {
+        snprintf(msg, size, "%s", err_msg);
+        return msg;
+    }
+    pthread_mutex_lock(&r->lock);
+    snprintf(msg, size, "%s", r->err);
+    pthread_mutex_unlock(&r->lock);
+    return msg;
+}
+
+void Reader_Close(Reader r)
+{
+    if (r == NULL)
+        return;
+    MappedFile_Close(r->map);
+    free_layout(&r->layout);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
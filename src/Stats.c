@@ -0,0 +1,321 @@
+#include "Stats.h"
+#include "parse_layout_file.h"
+#include "parse_data_file.h"
+#include "Memory.h"
+#include "err_msg.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* Stats collects the numbers behind --stats: the time spent in each
+   phase of a conversion, the records converted, and the bytes read and
+   written.  While records are converted, it reports progress and an
+   estimate of the remaining time every few seconds.  At the end it
+   prints all numbers as a single line of JSON, together with the peak
+   resident set size and the read(2) and write(2) calls of the process.
+
+   Worker threads add to the same counters, so the time of the read and
+   format phases is the sum over all threads and may exceed the wall
+   time.  With --manifest, progress is counted in result sets instead
+   of tiles, and the numbers add up over all result sets.  All
+   functions but Stats_Create do nothing if they are given NULL instead
+   of a Stats, so callers need not check for --stats. */
+
+struct StatsStruct {
+    FILE *progress;             /* where to report progress */
+    double interval;            /* seconds between progress reports */
+    double created;             /* time of Stats_Create */
+    double started;             /* time of Stats_SetTotal */
+    double reported;            /* time of the last progress report */
+    double seconds[STATS_NPHASE];   /* time spent in every phase */
+    struct Layout *layout;      /* layout of the data file */
+    unsigned long total;        /* number of records to convert */
+    unsigned long done;         /* number of records converted */
+    int nset;                   /* result sets in batch or 0 */
+    int sets_done;              /* result sets converted */
+    size_t nbytes;              /* number of bytes per record */
+    unsigned long long bytes_read;  /* bytes read from data file */
+    unsigned long long nread;   /* number of reads from data file */
+    unsigned long long bytes_written;   /* bytes of output */
+    unsigned long long nwrite;  /* number of writes of output */
+    pthread_mutex_t lock;
+};
+
+static const char *phase_names[STATS_NPHASE] = {
+    "layout", "read", "format", "write"
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+Stats Stats_Create(FILE *progress)
+{
+    Stats st;
+
+    if ((st = (Stats) Memory_Malloc(sizeof(*st))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof(*st));
+        return NULL;
+    }
+    memset(st, 0, sizeof(*st));
+    st->progress = progress;
+    st->interval = STATS_PROGRESS_INTERVAL;
+    st->created = st->started = st->reported = now();
+    pthread_mutex_init(&st->lock, NULL);
+
+    return st;
+}
+
+void Stats_SetInterval(Stats st, double seconds)
+{
+    if (st != NULL)
+        st->interval = seconds;
+}
+
+/* Start the clock for progress reports on the conversion of nrecord
+   records of nbytes bytes each from a data file with the given
+   layout.  In a batch, only keep the record size. */
+void Stats_SetTotal(Stats st, struct Layout *layout, unsigned long nrecord,
+    size_t nbytes)
+{
+    if (st == NULL)
+        return;
+    if (st->nset > 0) {
+        pthread_mutex_lock(&st->lock);
+        st->nbytes = nbytes;
+        pthread_mutex_unlock(&st->lock);
+        return;
+    }
+    st->layout = layout;
+    st->total = nrecord;
+    st->nbytes = nbytes;
+    st->done = 0;
+    st->started = st->reported = now();
+}
+
+/* Start the clock for progress reports on a batch of nset result
+   sets. */
+void Stats_SetBatch(Stats st, int nset)
+{
+    if (st == NULL)
+        return;
+    st->nset = nset;
+    st->sets_done = 0;
+    st->done = 0;
+    st->started = st->reported = now();
+}
+
+/* Return the current time, to be passed on to Stats_Stop. */
+double Stats_Start(Stats st)
+{
+    return st != NULL ? now() : 0.0;
+}
+
+/* Add the time since start to the given phase. */
+void Stats_Stop(Stats st, int phase, double start)
+{
+    double t;
+
+    if (st == NULL)
+        return;
+    t = now() - start;
+    pthread_mutex_lock(&st->lock);
+    st->seconds[phase] += t;
+    pthread_mutex_unlock(&st->lock);
+}
+
+/* Number of tiles before the record at the given offset.  Since tiles
+   are converted in file order, these are the tiles completed. */
+static unsigned long tiles_before(struct Layout *layout,
+    unsigned long offset)
+{
+    unsigned long ncol;
+    int snp, trait;
+
+    ncol = (layout->nsnp + layout->snps_per_tile - 1)
+        / layout->snps_per_tile;
+    if (offset >= (unsigned long) layout->nsnp * layout->ntrait)
+        return (layout->ntrait + layout->traits_per_tile - 1)
+            / layout->traits_per_tile * ncol;
+    offset2index(offset, &snp, &trait, layout);
+    return trait / layout->traits_per_tile * ncol
+        + snp / layout->snps_per_tile;
+}
+
+static void report_progress(Stats st, double t)
+{
+    struct Layout *layout;
+    double elapsed, rate, eta;
+    unsigned long ntile;
+
+    elapsed = t - st->started;
+    rate = elapsed > 0.0 ? st->done / elapsed : 0.0;
+
+    /* A batch is done when all of its result sets are. */
+    if (st->nset > 0) {
+        eta = st->sets_done > 0
+            ? elapsed * (st->nset - st->sets_done) / st->sets_done : 0.0;
+        fprintf(st->progress, "r3shuffle: %.1f%%, %d of %d result sets",
+            100.0 * st->sets_done / st->nset, st->sets_done, st->nset);
+    }
+    else {
+        eta = rate > 0.0 ? (st->total - st->done) / rate : 0.0;
+        fprintf(st->progress, "r3shuffle: %.1f%%",
+            st->total ? 100.0 * st->done / st->total : 100.0);
+
+        /* Selections don't convert whole tiles. */
+        layout = st->layout;
+        if (st->total == (unsigned long) layout->nsnp * layout->ntrait) {
+            ntile = tiles_before(layout, st->total);
+            fprintf(st->progress, ", %lu of %lu tiles",
+                tiles_before(layout, st->done), ntile);
+        }
+    }
+    fprintf(st->progress, ", %.0f records/s, %.1f MB/s, "
+        "ETA %d:%02d:%02d\n", rate, rate * st->nbytes / 1e6,
+        (int) eta / 3600, (int) eta / 60 % 60, (int) eta % 60);
+    fflush(st->progress);
+}
+
+/* Count n more records as converted and report progress if it's
+   time. */
+void Stats_AddRecords(Stats st, unsigned long n)
+{
+    double t;
+
+    if (st == NULL)
+        return;
+    pthread_mutex_lock(&st->lock);
+    st->done += n;
+    if (st->progress != NULL  &&  (st->layout != NULL  ||  st->nset > 0)
+        &&  (t = now()) - st->reported >= st->interval) {
+        st->reported = t;
+        report_progress(st, t);
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+/* Count one more result set of a batch as converted. */
+void Stats_AddSet(Stats st)
+{
+    if (st == NULL)
+        return;
+    pthread_mutex_lock(&st->lock);
+    st->sets_done++;
+    pthread_mutex_unlock(&st->lock);
+}
+
+void Stats_AddReads(Stats st, unsigned long long bytes,
+    unsigned long long nread)
+{
+    if (st == NULL)
+        return;
+    pthread_mutex_lock(&st->lock);
+    st->bytes_read += bytes;
+    st->nread += nread;
+    pthread_mutex_unlock(&st->lock);
+}
+
+void Stats_AddWrites(Stats st, unsigned long long bytes,
+    unsigned long long nwrite)
+{
+    if (st == NULL)
+        return;
+    pthread_mutex_lock(&st->lock);
+    st->bytes_written += bytes;
+    st->nwrite += nwrite;
+    pthread_mutex_unlock(&st->lock);
+}
+
+double Stats_Seconds(Stats st, int phase)
+{
+    return st != NULL ? st->seconds[phase] : 0.0;
+}
+
+unsigned long Stats_Records(Stats st)
+{
+    return st != NULL ? st->done : 0;
+}
+
+/* Read the number of read(2) and write(2) calls of the process from
+   /proc/self/io.  Leave them at -1 if that isn't possible. */
+static void count_syscalls(long long *syscr, long long *syscw)
+{
+    FILE *fp;
+    char line[64];
+
+    *syscr = *syscw = -1;
+    if ((fp = fopen("/proc/self/io", "r")) == NULL)
+        return;
+    while (fgets(line, sizeof line, fp) != NULL)
+        if (sscanf(line, "syscr: %lld", syscr) != 1)
+            sscanf(line, "syscw: %lld", syscw);
+    fclose(fp);
+}
+
+static void print_count(FILE *fp, const char *key, long long n)
+{
+    if (n < 0)
+        fprintf(fp, ",\"%s\":null", key);
+    else
+        fprintf(fp, ",\"%s\":%lld", key, n);
+}
+
+/* Print all numbers as a single line of JSON to fp. */
+int Stats_Print(Stats st, FILE *fp, int nthread)
+{
+    struct rusage usage;
+    long long syscr, syscw;
+    double wall, t;
+    int i;
+
+    if (st == NULL)
+        return 1;
+    wall = now() - st->created;
+    t = now() - st->started;
+    count_syscalls(&syscr, &syscw);
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        memset(&usage, 0, sizeof(usage));
+
+    fprintf(fp, "{\"threads\":%d,\"records\":%lu,\"wall_seconds\":%.3f",
+        nthread, st->done, wall);
+    for (i = 0; i < STATS_NPHASE; i++)
+        fprintf(fp, ",\"%s_seconds\":%.3f", phase_names[i],
+            st->seconds[i]);
+    fprintf(fp, ",\"records_per_second\":%.0f"
+        ",\"bytes_read\":%llu,\"read_mb_per_second\":%.1f"
+        ",\"bytes_written\":%llu,\"write_mb_per_second\":%.1f"
+        ",\"data_reads\":%llu,\"output_writes\":%llu"
+        ",\"peak_rss_kb\":%ld",
+        t > 0.0 ? st->done / t : 0.0,
+        st->bytes_read, t > 0.0 ? st->bytes_read / t / 1e6 : 0.0,
+        st->bytes_written, t > 0.0 ? st->bytes_written / t / 1e6 : 0.0,
+        st->nread, st->nwrite, usage.ru_maxrss);
+    print_count(fp, "read_syscalls", syscr);
+    print_count(fp, "write_syscalls", syscw);
+    fprintf(fp, ",\"major_page_faults\":%ld,\"minor_page_faults\":%ld}\n",
+        usage.ru_majflt, usage.ru_minflt);
+
+    if (ferror(fp)) {
+        set_err_msg("failed to write statistics");
+        return 0;
+    }
+    return 1;
+}
+
+void Stats_Destroy(Stats st)
+{
+    if (st == NULL)
+        return;
+    pthread_mutex_destroy(&st->lock);
+    Memory_Free(st);
+}
@@ -1,11 +1,47 @@
 #include "Stream.h"
 #include "IO.h"
 #include "Memory.h"
+#include "err_msg.h"
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+
+/* A Stream reads a file of fixed-size records from front to back,
+   chunk_size records per fread(3).  The first Stream_Read starts a
+   reader thread that fills two chunk buffers in turn: while the caller
+   works on the records of one buffer, the reader fills the other.
+   This keeps the disk or the pipe busy while we format output, which
+   takes longer than reading.
+
+   Stream_Read hands out pointers into the current chunk.  Requests
+   that straddle two chunks are gathered in a carry buffer.  Either
+   way, the records stay valid until the next call. */
+
+struct Buffer {
+    char *data;
+    unsigned long len;          /* number of records in data */
+    int full;                   /* Filled but not yet consumed? */
+};
 
 struct StreamStruct {
-    int chunk_size;
+    FILE *fp;
+    const char *filename;
+    int chunk_size;             /* number of records per read */
+    size_t record_size;         /* number of bytes per record */
+    struct Buffer buf[2];
+    char *carry;                /* records that straddle two chunks */
+    int cur;                    /* buffer being consumed, -1 if none */
+    unsigned long pos;          /* records consumed from buf[cur] */
+    unsigned long nrecord;      /* records handed out so far */
+    int started;                /* Is the reader thread running? */
+    int stop;                   /* Should the reader thread stop? */
+    unsigned long long bytes_read;
+    unsigned long long nread;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        /* signaled when a buffer changes */
 };
 
 Stream Stream_Create(const char *filename)
@@ -13,13 +49,23 @@ Stream Stream_Create(const char *filename)
     FILE *fp;
     Stream st;
 
-    if ((fp = IO_OpenFile(filename, "rb")) == NULL)
+    if ((fp = IO_OpenFile(filename, "rb")) == NULL) {
+        set_err_msg("failed to open file for reading: %s", filename);
         return NULL;
+    }
 
-    if ((st = (Stream) Memory_Malloc(sizeof(*st))) == NULL)
+    if ((st = (Stream) Memory_Malloc(sizeof(*st))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) sizeof(*st));
         goto CLOSE_FILE;
+    }
 
+    memset(st, 0, sizeof(*st));
+    st->fp = fp;
+    st->filename = filename;
     st->chunk_size = 1;
+    st->record_size = 1;
+    st->cur = -1;
 
     return st;
 
@@ -34,7 +80,217 @@ int Stream_GetChunkSize(Stream st)
     return st->chunk_size;
 }
 
+/* The chunk size and the record size can only be changed before the
+   first Stream_Read. */
 void Stream_SetChunkSize(Stream st, int chunk_size)
 {
     st->chunk_size = chunk_size;
 }
+
+size_t Stream_GetRecordSize(Stream st)
+{
+    return st->record_size;
+}
+
+void Stream_SetRecordSize(Stream st, size_t record_size)
+{
+    st->record_size = record_size;
+}
+
+static void *read_chunks(void *arg)
+{
+    Stream st = (Stream) arg;
+    struct Buffer *b;
+    size_t n;
+    int i;
+
+    for (i = 0; ; i ^= 1) {
+        b = &st->buf[i];
+        pthread_mutex_lock(&st->lock);
+        while (b->full  &&  !st->stop)
+            pthread_cond_wait(&st->cond, &st->lock);
+        if (st->stop) {
+            pthread_mutex_unlock(&st->lock);
+            break;
+        }
+        pthread_mutex_unlock(&st->lock);
+
+        n = fread(b->data, st->record_size, st->chunk_size, st->fp);
+
+        pthread_mutex_lock(&st->lock);
+        b->len = n;
+        b->full = 1;
+        st->bytes_read += n * st->record_size;
+        st->nread++;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+
+        /* A short chunk is the last one. */
+        if (n < (size_t) st->chunk_size)
+            break;
+    }
+
+    return NULL;
+}
+
+static int start_reader(Stream st)
+{
+    size_t size;
+
+    size = st->chunk_size * st->record_size;
+    st->buf[0].data = (char *) Memory_Malloc(size);
+    st->buf[1].data = (char *) Memory_Malloc(size);
+    st->carry = (char *) Memory_Malloc(size);
+    if (st->buf[0].data == NULL  ||  st->buf[1].data == NULL
+        ||  st->carry == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) size);
+        return 0;
+    }
+
+    /* Chunks go straight from the kernel into our buffers. */
+    if (size >= BUFSIZ)
+        setvbuf(st->fp, NULL, _IONBF, 0);
+
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cond, NULL);
+    if (pthread_create(&st->thread, NULL, read_chunks, st) != 0) {
+        set_err_msg("failed to create reader thread for file: %s",
+            st->filename);
+        pthread_cond_destroy(&st->cond);
+        pthread_mutex_destroy(&st->lock);
+        return 0;
+    }
+    st->started = 1;
+
+    return 1;
+}
+
+/* Hand the current buffer back to the reader and wait for the next
+   one.  Return 0 if there are no more records. */
+static int next_chunk(Stream st)
+{
+    int i;
+
+    if (st->cur != -1  &&  st->buf[st->cur].len < (size_t) st->chunk_size)
+        return 0;
+
+    i = st->cur == -1 ? 0 : st->cur ^ 1;
+    pthread_mutex_lock(&st->lock);
+    if (st->cur != -1) {
+        st->buf[st->cur].full = 0;
+        pthread_cond_broadcast(&st->cond);
+    }
+    while (!st->buf[i].full)
+        pthread_cond_wait(&st->cond, &st->lock);
+    pthread_mutex_unlock(&st->lock);
+
+    st->cur = i;
+    st->pos = 0;
+    return st->buf[i].len > 0;
+}
+
+static unsigned long available(Stream st)
+{
+    return st->cur == -1 ? 0 : st->buf[st->cur].len - st->pos;
+}
+
+/* Point *records to the next n records, where n is at most the chunk
+   size. */
+int Stream_Read(Stream st, unsigned long n, const char **records)
+{
+    struct Buffer *b;
+    unsigned long k, m;
+    size_t size;
+
+    assert(n <= (unsigned long) st->chunk_size);
+    if (!st->started  &&  !start_reader(st))
+        return 0;
+
+    size = st->record_size;
+    k = 0;
+    if (available(st) < n) {
+        /* Keep the rest of the current chunk. */
+        if ((k = available(st)) > 0)
+            memcpy(st->carry, st->buf[st->cur].data + st->pos * size,
+                k * size);
+        if (!next_chunk(st))
+            goto SHORT_READ;
+    }
+
+    b = &st->buf[st->cur];
+    if (k == 0  &&  available(st) >= n) {
+        *records = b->data + st->pos * size;
+        st->pos += n;
+        st->nrecord += n;
+        return 1;
+    }
+
+    m = available(st) < n - k ? available(st) : n - k;
+    memcpy(st->carry + k * size, b->data + st->pos * size, m * size);
+    st->pos += m;
+    k += m;
+    if (k < n)
+        goto SHORT_READ;
+    *records = st->carry;
+    st->nrecord += n;
+
+    return 1;
+
+SHORT_READ:
+    set_err_msg("failed to read record %lu from data file: %s",
+        st->nrecord + k, st->filename);
+    return 0;
+}
+
+/* Number of bytes read and number of reads from the file so far. */
+unsigned long long Stream_BytesRead(Stream st)
+{
+    unsigned long long n;
+
+    if (!st->started)
+        return 0;
+    pthread_mutex_lock(&st->lock);
+    n = st->bytes_read;
+    pthread_mutex_unlock(&st->lock);
+    return n;
+}
+
+unsigned long long Stream_Reads(Stream st)
+{
+    unsigned long long n;
+
+    if (!st->started)
+        return 0;
+    pthread_mutex_lock(&st->lock);
+    n = st->nread;
+    pthread_mutex_unlock(&st->lock);
+    return n;
+}
+
+/* Stop the reader thread, close the file, and free st. */
+int Stream_Close(Stream st)
+{
+    int status;
+
+    if (st->started) {
+        pthread_mutex_lock(&st->lock);
+        st->stop = 1;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        pthread_join(st->thread, NULL);
+        pthread_cond_destroy(&st->cond);
+        pthread_mutex_destroy(&st->lock);
+    }
+
+    status = 1;
+    if (IO_CloseFile(st->fp)) {
+        set_err_msg("failed to close file: %s", st->filename);
+        status = 0;
+    }
+    Memory_Free(st->buf[0].data);
+    Memory_Free(st->buf[1].data);
+    Memory_Free(st->carry);
+    Memory_Free(st);
+
+    return status;
+}
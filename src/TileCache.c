@@ -0,0 +1,198 @@
+#include "TileCache.h"
+#include "err_msg.h"
+#include <stdlib.h>
+
+/* A TileCache keeps the decoded records of recently used tiles, up to
+   capacity bytes of them.  When a new tile doesn't fit, the tiles that
+   were used least recently make room for it.  A tile larger than the
+   whole cache is still kept, alone.
+
+   Tiles are found through a hash table with chaining that grows with
+   the number of tiles, and they are kept in a doubly linked list from
+   the most to the least recently used one.  Both get and put take
+   constant time.  A TileCache is not thread-safe; callers that share
+   one hold a lock while they use the values it hands out. */
+
+enum { MIN_BUCKETS = 64 };
+
+struct Entry {
+    unsigned long tile;
+    size_t n;                   /* number of values */
+    struct Entry *prev, *next;  /* neighbours in order of use */
+    struct Entry *chain;        /* next entry in the same bucket */
+    double *values;
+};
+
+struct TileCacheStruct {
+    size_t capacity;            /* bytes of values to keep at most */
+    size_t bytes;               /* bytes of values kept */
+    struct Entry **bucket;
+    unsigned long nbucket;      /* a power of two */
+    unsigned long ntile;
+    struct Entry *first;        /* most recently used tile */
+    struct Entry *last;         /* least recently used tile */
+    unsigned long long hits;
+    unsigned long long misses;
+};
+
+TileCache TileCache_Create(size_t capacity)
+{
+    TileCache c;
+
+    if ((c = (TileCache) calloc(1, sizeof(*c))) == NULL
+        ||  (c->bucket = (struct Entry **) calloc(MIN_BUCKETS,
+                sizeof(struct Entry *))) == NULL) {
+        set_err_msg("failed to allocate memory for tile cache");
+        free(c);
+        return NULL;
+    }
+    c->capacity = capacity;
+    c->nbucket = MIN_BUCKETS;
+    return c;
+}
+
+static struct Entry **find(TileCache c, unsigned long tile)
+{
+    struct Entry **e;
+
+    e = &c->bucket[tile & (c->nbucket - 1)];
+    while (*e != NULL  &&  (*e)->tile != tile)
+        e = &(*e)->chain;
+    return e;
+}
+
+static void unlink_entry(TileCache c, struct Entry *e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        c->first = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        c->last = e->prev;
+}
+
+static void push_front(TileCache c, struct Entry *e)
+{
+    e->prev = NULL;
+    e->next = c->first;
+    if (c->first != NULL)
+        c->first->prev = e;
+    else
+        c->last = e;
+    c->first = e;
+}
+
+/* Return the values of tile or NULL if it isn't cached. */
+double *TileCache_Get(TileCache c, unsigned long tile)
+{
+    struct Entry *e;
+
+    if ((e = *find(c, tile)) == NULL) {
+        c->misses++;
+        return NULL;
+    }
+    c->hits++;
+    if (e != c->first) {
+        unlink_entry(c, e);
+        push_front(c, e);
+    }
+    return e->values;
+}
+
+static void evict_last(TileCache c)
+{
+    struct Entry *e, **p;
+
+    e = c->last;
+    unlink_entry(c, e);
+    p = find(c, e->tile);
+    *p = e->chain;
+    c->bytes -= e->n * sizeof(double);
+    c->ntile--;
+    free(e);
+}
+
+/* Double the number of buckets once there are more tiles than
+   buckets.  If that fails, chains just get longer. */
+static void grow(TileCache c)
+{
+    struct Entry **bucket, *e;
+    unsigned long i;
+
+    if ((bucket = (struct Entry **) calloc(2 * c->nbucket,
+                sizeof(struct Entry *))) == NULL)
+        return;
+    for (e = c->first; e != NULL; e = e->next) {
+        i = e->tile & (2 * c->nbucket - 1);
+        e->chain = bucket[i];
+        bucket[i] = e;
+    }
+    free(c->bucket);
+    c->bucket = bucket;
+    c->nbucket *= 2;
+}
+
+/* Make room for n values of tile, which must not be cached yet, and
+   return them for the caller to fill in. */
+double *TileCache_Put(TileCache c, unsigned long tile, size_t n)
+{
+    struct Entry *e, **p;
+    size_t size;
+
+    size = n * sizeof(double);
+    while (c->ntile > 0  &&  c->bytes + size > c->capacity)
+        evict_last(c);
+    if ((e = (struct Entry *) malloc(sizeof(*e) + size)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (sizeof(*e) + size));
+        return NULL;
+    }
+    e->tile = tile;
+    e->n = n;
+    e->values = (double *) (e + 1);
+    if (c->ntile >= c->nbucket)
+        grow(c);
+    p = &c->bucket[tile & (c->nbucket - 1)];
+    e->chain = *p;
+    *p = e;
+    push_front(c, e);
+    c->bytes += size;
+    c->ntile++;
+    return e->values;
+}
+
+unsigned long TileCache_Tiles(TileCache c)
+{
+    return c->ntile;
+}
+
+size_t TileCache_Bytes(TileCache c)
+{
+    return c->bytes;
+}
+
+unsigned long long TileCache_Hits(TileCache c)
+{
+    return c->hits;
+}
+
+unsigned long long TileCache_Misses(TileCache c)
+{
+    return c->misses;
+}
+
+void TileCache_Destroy(TileCache c)
+{
+    struct Entry *e, *next;
+
+    if (c == NULL)
+        return;
+    for (e = c->first; e != NULL; e = next) {
+        next = e->next;
+        free(e);
+    }
+    free(c->bucket);
+    free(c);
+}
@@ -0,0 +1,211 @@
+#include "TopK.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* A TopK keeps the k records with the highest scores of every trait.
+   The hits of a trait form a binary min-heap, so the weakest hit that
+   we kept sits at the root: a record that doesn't beat it is dropped
+   after a single comparison, which is what happens to almost every
+   record once the heaps are full.  Otherwise the record replaces the
+   root and sinks to its place in O(log k) steps.  Of equal scores,
+   the one of the smaller snp wins, so the hits don't depend on the
+   order in which records are added.
+
+   Of every kept record we copy the nvalue columns that we write.  The
+   heap moves small hits around, each of which owns a slot of nvalue
+   doubles that stays put.  Memory is therefore bounded by ntrait * k
+   hits and slots, however many records are added.  A TopK is not
+   thread-safe; every thread fills its own and TopK_Merge combines
+   them at the end. */
+
+struct Hit {
+    double score;
+    int snp;
+    int slot;                   /* index of the hit's values */
+};
+
+struct TopKStruct {
+    int ntrait;
+    int k;                      /* hits per trait at most */
+    int nvalue;                 /* values per hit */
+    int *columns;               /* column of every value in a record */
+    int *n;                     /* number of hits of every trait */
+    struct Hit *hits;           /* k hits per trait */
+    double *values;             /* k * nvalue values per trait */
+};
+
+TopK TopK_Create(int ntrait, int k, int nvalue, const int *columns)
+{
+    TopK t;
+    size_t nhit;
+
+    nhit = (size_t) ntrait * k;
+    if ((t = (TopK) calloc(1, sizeof(*t))) == NULL
+        ||  (t->columns = (int *) malloc((nvalue + 1) * sizeof(int)))
+            == NULL
+        ||  (t->n = (int *) calloc(ntrait, sizeof(int))) == NULL
+        ||  (t->hits = (struct Hit *) malloc(nhit * sizeof(struct Hit)))
+            == NULL
+        ||  (t->values = (double *) malloc(nhit * nvalue
+                * sizeof(double) + 1)) == NULL) {
+        set_err_msg("failed to allocate memory for the top %d records "
+            "of %d traits", k, ntrait);
+        TopK_Destroy(t);
+        return NULL;
+    }
+    t->ntrait = ntrait;
+    t->k = k;
+    t->nvalue = nvalue;
+    memcpy(t->columns, columns, nvalue * sizeof(int));
+    return t;
+}
+
+/* Is hit a weaker than hit b? */
+static int weaker(const struct Hit *a, const struct Hit *b)
+{
+    return a->score < b->score
+        ||  (a->score == b->score  &&  a->snp > b->snp);
+}
+
+/* Move the hit at position i of the heap h of n hits down to its
+   place. */
+static void sift_down(struct Hit *h, int n, int i)
+{
+    struct Hit x;
+    int c;
+
+    x = h[i];
+    while ((c = 2 * i + 1) < n) {
+        if (c + 1 < n  &&  weaker(&h[c + 1], &h[c]))
+            c++;
+        if (!weaker(&h[c], &x))
+            break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = x;
+}
+
+static void sift_up(struct Hit *h, int i)
+{
+    struct Hit x;
+    int parent;
+
+    x = h[i];
+    while (i > 0  &&  weaker(&x, &h[parent = (i - 1) / 2])) {
+        h[i] = h[parent];
+        i = parent;
+    }
+    h[i] = x;
+}
+
+static void copy_values(TopK t, int trait, int slot, const double *v,
+    const int *columns)
+{
+    double *dst;
+    int j;
+
+    dst = t->values + ((size_t) trait * t->k + slot) * t->nvalue;
+    for (j = 0; j < t->nvalue; j++)
+        dst[j] = v[columns != NULL ? columns[j] : j];
+}
+
+/* Add hit x of the given trait with the values v, which are the
+   columns of a record if columns is not NULL and else the values of a
+   hit. */
+static void add(TopK t, int trait, struct Hit *x, const double *v,
+    const int *columns)
+{
+    struct Hit *h;
+    int *n;
+
+    if (x->score != x->score)   /* NaN never ranks */
+        return;
+    h = t->hits + (size_t) trait * t->k;
+    n = &t->n[trait];
+    if (*n < t->k) {
+        x->slot = *n;
+        h[*n] = *x;
+        copy_values(t, trait, x->slot, v, columns);
+        sift_up(h, (*n)++);
+    }
+    else if (t->k > 0  &&  weaker(&h[0], x)) {
+        x->slot = h[0].slot;
+        h[0] = *x;
+        copy_values(t, trait, x->slot, v, columns);
+        sift_down(h, *n, 0);
+    }
+}
+
+/* Offer the record of snp and trait with the given score. */
+void TopK_Add(TopK t, int trait, int snp, double score,
+    const double *record)
+{
+    struct Hit x;
+
+    x.score = score;
+    x.snp = snp;
+    add(t, trait, &x, record, t->columns);
+}
+
+/* Add the hits of src, which must keep as many hits of as many values
+   of as many traits as dst, to dst. */
+void TopK_Merge(TopK dst, TopK src)
+{
+    struct Hit *h, x;
+    int trait, i;
+
+    for (trait = 0; trait < src->ntrait; trait++) {
+        h = src->hits + (size_t) trait * src->k;
+        for (i = 0; i < src->n[trait]; i++) {
+            x = h[i];
+            add(dst, trait, &x, src->values + ((size_t) trait * src->k
+                    + h[i].slot) * src->nvalue, NULL);
+        }
+    }
+}
+
+/* Sort the hits of every trait from the strongest to the weakest.
+   Only TopK_Count, TopK_Get, and TopK_Destroy may be called after. */
+void TopK_Sort(TopK t)
+{
+    struct Hit *h, x;
+    int trait, n;
+
+    for (trait = 0; trait < t->ntrait; trait++) {
+        h = t->hits + (size_t) trait * t->k;
+        for (n = t->n[trait]; n > 1; n--) {
+            x = h[0];
+            h[0] = h[n - 1];
+            h[n - 1] = x;
+            sift_down(h, n - 1, 0);
+        }
+    }
+}
+
+int TopK_Count(TopK t, int trait)
+{
+    return t->n[trait];
+}
+
+/* Return the values of hit i of trait and store its snp in *snp. */
+const double *TopK_Get(TopK t, int trait, int i, int *snp)
+{
+    const struct Hit *h;
+
+    h = t->hits + (size_t) trait * t->k + i;
+    *snp = h->snp;
+    return t->values + ((size_t) trait * t->k + h->slot) * t->nvalue;
+}
+
+void TopK_Destroy(TopK t)
+{
+    if (t == NULL)
+        return;
+    free(t->columns);
+    free(t->n);
+    free(t->hits);
+    free(t->values);
+    free(t);
+}
@@ -0,0 +1,345 @@
+#include "convert_batch.h"
+#include "parse_layout_file.h"
+#include "parse_data_file.h"
+#include "err_msg.h"
+#include "Filter.h"
+#include "Stats.h"
+#include "run_ordered.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* With --manifest, r3shuffle converts many result sets in one run,
+   such as the chunks of a genome-wide analysis, instead of one process
+   per result set.  The result sets share the --threads workers and
+   the --max-memory budget.
+
+   Every result set is written to FILE.txt (FILE.arrow, FILE.txt.gz)
+   unless --output is given.  Then the result sets are independent, and
+   every worker converts whole result sets on its own, taking the next
+   one in manifest order as soon as it is done, with its share of
+   --max-memory.  There is no coordination within a result set and no
+   idle worker at the end of one, as long as result sets remain.
+
+   With --output, all lines go to the output file in manifest order
+   under a single header.  The result sets must then have the same
+   columns, or --column must select columns that all of them have.
+   They are converted one after another, each on all workers.
+
+   Either way, while a result set is converted, the kernel reads ahead
+   the beginning of the data file of the result set that comes next. */
+
+struct Batch {
+    struct Params *params;
+    struct Manifest *m;
+    FILE *fp;                   /* output file with --output or NULL */
+    char *header;               /* column labels of first result set */
+    int ahead;                  /* distance of result set to prefetch */
+    int nthread;                /* threads per result set */
+    unsigned long max_memory;   /* memory per result set */
+};
+
+/* Bytes of the next data file to read ahead. */
+enum { PREFETCH_BYTES = 16 << 20 };
+
+/* Read the FILE of every result set from a manifest file, one per
+   line.  Blank lines and lines starting with '#' are skipped. */
+int read_manifest(const char *file, struct Manifest *m)
+{
+    FILE *fp;
+    char *line, *s, *e, **t;
+    size_t size;
+    int cap;
+
+    m->prefix = NULL;
+    m->n = cap = 0;
+    if ((fp = fopen(file, "r")) == NULL) {
+        set_err_msg("failed to open file for reading: %s", file);
+        return 0;
+    }
+
+    line = NULL;
+    size = 0;
+    while (getline(&line, &size, fp) != -1) {
+        for (s = line; isspace((unsigned char) *s); s++)
+            ;
+        for (e = s + strlen(s); e > s  &&  isspace((unsigned char) e[-1]);
+             e--)
+            ;
+        if (e == s  ||  *s == '#')
+            continue;
+        *e = '\0';
+        if (m->n == cap) {
+            cap = cap ? 2 * cap : 16;
+            if ((t = (char **) realloc(m->prefix, cap * sizeof(char *)))
+                == NULL) {
+                set_err_msg("failed to allocate %lu bytes",
+                    (unsigned long) (cap * sizeof(char *)));
+                goto FREE_LINE;
+            }
+            m->prefix = t;
+        }
+        if ((m->prefix[m->n] = strdup(s)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (e - s + 1));
+            goto FREE_LINE;
+        }
+        m->n++;
+    }
+    if (ferror(fp)) {
+        set_err_msg("failed to read file: %s", file);
+        goto FREE_LINE;
+    }
+    if (m->n == 0) {
+        set_err_msg("manifest lists no result sets: %s", file);
+        goto FREE_LINE;
+    }
+
+    free(line);
+    fclose(fp);
+    return 1;
+
+FREE_LINE:
+    free(line);
+    fclose(fp);
+    free_manifest(m);
+    return 0;
+}
+
+void free_manifest(struct Manifest *m)
+{
+    int i;
+
+    for (i = 0; i < m->n; i++)
+        free(m->prefix[i]);
+    free(m->prefix);
+    m->prefix = NULL;
+    m->n = 0;
+}
+
+/* Return a newly allocated string of prefix followed by suffix. */
+static char *join(const char *prefix, const char *suffix)
+{
+    size_t n;
+    char *s;
+
+    n = strlen(prefix) + strlen(suffix) + 1;
+    if ((s = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return NULL;
+    }
+    sprintf(s, "%s%s", prefix, suffix);
+    return s;
+}
+
+/* Return the labels of all columns of a layout, each preceded by a
+   blank, as they appear in the header line. */
+static char *column_labels(struct Layout *layout)
+{
+    char **labels[3];
+    int counts[3], i, j;
+    size_t n;
+    char *s, *t;
+
+    labels[0] = layout->beta_labels;
+    labels[1] = layout->se_labels;
+    labels[2] = layout->cov_labels;
+    counts[0] = counts[1] = layout->nvar;
+    counts[2] = layout->ncov;
+
+    n = 1;
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < counts[i]; j++)
+            n += 1 + strlen(labels[i][j]);
+    if ((s = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return NULL;
+    }
+    t = s;
+    *t = '\0';
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < counts[i]; j++)
+            t += sprintf(t, " %s", labels[i][j]);
+    return s;
+}
+
+/* Ask the kernel to read the beginning of the data file of a result
+   set into the page cache. */
+static void prefetch(const char *prefix)
+{
+    char *file;
+    int fd;
+
+    if ((file = join(prefix, ".out")) == NULL) {
+        clear_err_msg();
+        return;
+    }
+    if ((fd = open(file, O_RDONLY)) != -1) {
+        posix_fadvise(fd, 0, PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+    free(file);
+}
+
+/* Convert result set i of the manifest, into b->fp if it isn't
+   NULL. */
+static int convert_result_set(struct Batch *b, int i)
+{
+    struct Params job;
+    struct Layout layout;
+    char *labels, *prefix;
+    size_t n;
+    double t;
+    int k, status;
+
+    status = 0;
+    prefix = b->m->prefix[i];
+    job = *b->params;
+    job.nthread = b->nthread;
+    job.max_memory = b->max_memory;
+    job.output_file = job.layout_file = job.data_file = NULL;
+
+    /* Every result set maps columns on its own. */
+    n = (job.ncolumn + 1) * sizeof(int);
+    if ((job.ucp2acp = (int *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return 0;
+    }
+    for (k = 0; k < job.ncolumn; k++)
+        job.ucp2acp[k] = -1;
+    job.ucp2acp[job.ncolumn] = -9;
+
+    if ((job.layout_file = join(prefix, ".iout")) == NULL
+        ||  (job.data_file = join(prefix, ".out")) == NULL
+        ||  (b->fp == NULL  &&  (job.output_file = join(prefix,
+                    job.format == FORMAT_ARROW ? ".arrow"
+                    : job.compress == COMPRESS_BGZF ? ".txt.gz"
+                    : ".txt")) == NULL))
+        goto FREE_NAMES;
+
+    t = Stats_Start(job.stats);
+    if (!parse_layout_file(job.layout_file, &layout))
+        goto FREE_NAMES;
+    if (!validate_layout(&layout))
+        goto FREE_LAYOUT;
+    Stats_Stop(job.stats, STATS_LAYOUT, t);
+
+    /* Without --column, every result set gets all of its columns. */
+    if (job.columns == NULL)
+        job.ncolumn = 0;
+    if (!set_column_print_order(&job, &layout))
+        goto FREE_LAYOUT;
+
+    if (b->fp != NULL  &&  job.columns == NULL) {
+        if ((labels = column_labels(&layout)) == NULL)
+            goto FREE_LAYOUT;
+        if (b->header == NULL)
+            b->header = labels;
+        else if (strcmp(labels, b->header) != 0) {
+            set_err_msg("columns of %s differ from those of %s", prefix,
+                b->m->prefix[0]);
+            free(labels);
+            goto FREE_LAYOUT;
+        }
+        else
+            free(labels);
+    }
+
+    if (job.where != NULL
+        &&  (job.filter = Filter_Compile(job.where, &layout)) == NULL)
+        goto FREE_LAYOUT;
+    if (job.rank_by != NULL
+        &&  (job.rank = Filter_Compile(job.rank_by, &layout)) == NULL)
+        goto DESTROY_FILTER;
+
+    if (i + b->ahead < b->m->n)
+        prefetch(b->m->prefix[i + b->ahead]);
+    status = b->fp != NULL
+        ? convert_data_file(&job, &layout, b->fp, b->params->output_file,
+            i == 0)
+        : parse_data_file(&job, &layout);
+    if (status)
+        Stats_AddSet(job.stats);
+
+    if (job.rank != NULL)
+        Filter_Destroy(job.rank);
+DESTROY_FILTER:
+    if (job.filter != NULL)
+        Filter_Destroy(job.filter);
+FREE_LAYOUT:
+    free_layout(&layout);
+FREE_NAMES:
+    free(job.output_file);
+    free(job.data_file);
+    free(job.layout_file);
+    free(job.ucp2acp);
+    return status;
+}
+
+static int convert_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    (void) worker;
+    (void) chunk;
+    return convert_result_set((struct Batch *) arg, (int) unit);
+}
+
+static int finish_unit(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    (void) arg;
+    (void) unit;
+    (void) chunk;
+    return 1;
+}
+
+int convert_batch(struct Params *params)
+{
+    struct Manifest m;
+    struct Batch b;
+    int i, status;
+
+    if (!read_manifest(params->manifest, &m))
+        return 0;
+
+    b.params = params;
+    b.m = &m;
+    b.fp = NULL;
+    b.header = NULL;
+    if (params->output_file != NULL
+        &&  (b.fp = fopen(params->output_file, "wb")) == NULL) {
+        set_err_msg("failed to open file for writing: %s",
+            params->output_file);
+        free_manifest(&m);
+        return 0;
+    }
+    Stats_SetBatch(params->stats, m.n);
+
+    if (b.fp == NULL  &&  params->nthread > 1  &&  m.n > 1) {
+        b.ahead = params->nthread;
+        b.nthread = 1;
+        b.max_memory = params->max_memory / params->nthread;
+        if (b.max_memory == 0)
+            b.max_memory = 1;
+        status = run_ordered(params->nthread < m.n ? params->nthread
+            : m.n, m.n, convert_unit, finish_unit, &b);
+    }
+    else {
+        b.ahead = 1;
+        b.nthread = params->nthread;
+        b.max_memory = params->max_memory;
+        status = 1;
+        for (i = 0; status  &&  i < m.n; i++)
+            status = convert_result_set(&b, i);
+    }
+
+    if (b.fp != NULL  &&  fclose(b.fp)  &&  status) {
+        set_err_msg("failed to close file: %s", params->output_file);
+        status = 0;
+    }
+    free(b.header);
+    free_manifest(&m);
+    return status;
+}
@@ -0,0 +1,233 @@
+#include "decode.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__)  &&  (defined(__x86_64__)  ||  defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+/* OmicABEL writes the regression results as doubles in the byte order
+   of the machine it ran on, and the layout file says how many bytes a
+   "double" takes, which may be 4 for single precision.  Before we can
+   filter and format records of such files, their values must be
+   widened to double, byte-swapped, or both.  Every combination has a
+   scalar kernel and, on x86, kernels with SSSE3 and AVX2, which
+   convert 4 or 8 values per instruction and keep up with memory
+   bandwidth.  find_decoder picks the fastest kernel that the CPU
+   supports.  Native doubles need no decoding: their kernel is a plain
+   copy. */
+
+static uint32_t swap32(uint32_t x)
+{
+    return __builtin_bswap32(x);
+}
+
+static uint64_t swap64(uint64_t x)
+{
+    return __builtin_bswap64(x);
+}
+
+static void copy_float64(double *dst, const char *src, size_t n)
+{
+    memcpy(dst, src, n * sizeof(double));
+}
+
+static void widen_float32(double *dst, const char *src, size_t n)
+{
+    float f;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        memcpy(&f, src + 4 * i, 4);
+        dst[i] = f;
+    }
+}
+
+static void swap_float32(double *dst, const char *src, size_t n)
+{
+    uint32_t u;
+    float f;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        memcpy(&u, src + 4 * i, 4);
+        u = swap32(u);
+        memcpy(&f, &u, 4);
+        dst[i] = f;
+    }
+}
+
+static void swap_float64(double *dst, const char *src, size_t n)
+{
+    uint64_t u;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        memcpy(&u, src + 8 * i, 8);
+        u = swap64(u);
+        memcpy(dst + i, &u, 8);
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+
+/* Byte order of each 4-byte and 8-byte lane reversed, for pshufb. */
+#define SWAP32_MASK 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define SWAP64_MASK 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+
+__attribute__((target("ssse3")))
+static void widen_float32_ssse3(double *dst, const char *src, size_t n)
+{
+    __m128 f;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        f = _mm_loadu_ps((const float *) (src + 4 * i));
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+    widen_float32(dst + i, src + 4 * i, n - i);
+}
+
+__attribute__((target("ssse3")))
+static void swap_float32_ssse3(double *dst, const char *src, size_t n)
+{
+    const __m128i mask = _mm_setr_epi8(SWAP32_MASK);
+    __m128 f;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        f = _mm_castsi128_ps(_mm_shuffle_epi8(_mm_loadu_si128(
+                    (const __m128i *) (src + 4 * i)), mask));
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(f));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+    }
+    swap_float32(dst + i, src + 4 * i, n - i);
+}
+
+__attribute__((target("ssse3")))
+static void swap_float64_ssse3(double *dst, const char *src, size_t n)
+{
+    const __m128i mask = _mm_setr_epi8(SWAP64_MASK);
+    size_t i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *) (src + 8 * i)), mask));
+    swap_float64(dst + i, src + 8 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void widen_float32_avx2(double *dst, const char *src, size_t n)
+{
+    __m256 f;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        f = _mm256_loadu_ps((const float *) (src + 4 * i));
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(
+                _mm256_castps256_ps128(f)));
+        _mm256_storeu_pd(dst + i + 4, _mm256_cvtps_pd(
+                _mm256_extractf128_ps(f, 1)));
+    }
+    widen_float32(dst + i, src + 4 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void swap_float32_avx2(double *dst, const char *src, size_t n)
+{
+    const __m256i mask = _mm256_setr_epi8(SWAP32_MASK, SWAP32_MASK);
+    __m256 f;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        f = _mm256_castsi256_ps(_mm256_shuffle_epi8(_mm256_loadu_si256(
+                    (const __m256i *) (src + 4 * i)), mask));
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(
+                _mm256_castps256_ps128(f)));
+        _mm256_storeu_pd(dst + i + 4, _mm256_cvtps_pd(
+                _mm256_extractf128_ps(f, 1)));
+    }
+    swap_float32(dst + i, src + 4 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void swap_float64_avx2(double *dst, const char *src, size_t n)
+{
+    const __m256i mask = _mm256_setr_epi8(SWAP64_MASK, SWAP64_MASK);
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_shuffle_epi8(
+                _mm256_loadu_si256((const __m256i *) (src + 8 * i)),
+                mask));
+    swap_float64(dst + i, src + 8 * i, n - i);
+}
+
+#endif  /* HAVE_X86_KERNELS */
+
+/* Return the fastest kernel level that this CPU supports. */
+int best_decode_level(void)
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return DECODE_AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return DECODE_SSSE3;
+#endif
+    return DECODE_SCALAR;
+}
+
+/* Return the kernel of the given level, or the fastest one that the CPU
+   supports for DECODE_BEST, that converts values of bytes_per_double
+   bytes, byte-swapped if swap is set, to native doubles.  Return NULL
+   if there is no such kernel. */
+DecodeFunc find_decoder(int bytes_per_double, int swap, int level)
+{
+    static const DecodeFunc scalar[2][2] = {
+        { widen_float32, swap_float32 },
+        { copy_float64, swap_float64 }
+    };
+#ifdef HAVE_X86_KERNELS
+    static const DecodeFunc ssse3[2][2] = {
+        { widen_float32_ssse3, swap_float32_ssse3 },
+        { copy_float64, swap_float64_ssse3 }
+    };
+    static const DecodeFunc avx2[2][2] = {
+        { widen_float32_avx2, swap_float32_avx2 },
+        { copy_float64, swap_float64_avx2 }
+    };
+#endif
+    int size;
+
+    if (bytes_per_double == 4)
+        size = 0;
+    else if (bytes_per_double == 8)
+        size = 1;
+    else
+        return NULL;
+    swap = swap != 0;
+
+    if (level == DECODE_BEST)
+        level = best_decode_level();
+    else if (level > best_decode_level())
+        return NULL;
+
+#ifdef HAVE_X86_KERNELS
+    if (level == DECODE_AVX2)
+        return avx2[size][swap];
+    if (level == DECODE_SSSE3)
+        return ssse3[size][swap];
+#endif
+    return scalar[size][swap];
+}
+
+int is_big_endian(void)
+{
+    const uint16_t one = 1;
+
+    return *(const unsigned char *) &one == 0;
+}
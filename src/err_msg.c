@@ -1,3 +1,3 @@
 #include "err_msg.h"
 
-char err_msg[ERR_MSG_MAXLEN];
+__thread char err_msg[ERR_MSG_MAXLEN];
@@ -0,0 +1,447 @@
+#include "format_double.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NELEMS(x) (sizeof (x) / sizeof (x[0]))
+
+/* format_double writes a double in exactly the same way as
+   printf("%.*g", ndigit, x) does with glibc in the "C" locale, but
+   without going through stdio, locales, and format string parsing.
+
+   Every finite double x is of the form m * 2^e2 where m is an integer
+   with at most 53 bits.  Formatting x with ndigit significant digits
+   amounts to finding the integer q = round(x * 10^s) where s is chosen
+   such that q has exactly ndigit digits.  Like glibc we round to
+   nearest and break ties by rounding to an even last digit.
+
+   For up to 17 significant digits and not too extreme exponents, the
+   product x * 10^s and its remainder can be computed exactly with
+   128-bit integer arithmetic (fast path).  Everything else is handled
+   by computing the complete decimal expansion of x with a small
+   bignum (slow path).  Since x is a binary fraction, its decimal
+   expansion is finite and has at most 767 significant digits. */
+
+typedef unsigned __int128 uint128;
+
+enum {
+    MAX_FAST_DIGITS = 17,       /* fast path: at most 17 digits */
+    MAX_EXACT_DIGITS = 800,     /* decimal expansion of any double */
+    NLIMB = 90                  /* 32-bit limbs for m * 5^1074 */
+};
+
+static const uint64_t pow10_tab[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL
+};
+
+static const uint64_t pow5_tab[] = {
+    1ULL, 5ULL, 25ULL, 125ULL, 625ULL, 3125ULL, 15625ULL, 78125ULL,
+    390625ULL, 1953125ULL, 9765625ULL, 48828125ULL, 244140625ULL,
+    1220703125ULL, 6103515625ULL, 30517578125ULL, 152587890625ULL,
+    762939453125ULL, 3814697265625ULL, 19073486328125ULL,
+    95367431640625ULL, 476837158203125ULL, 2384185791015625ULL,
+    11920928955078125ULL, 59604644775390625ULL, 298023223876953125ULL,
+    1490116119384765625ULL, 7450580596923828125ULL
+};
+
+static const char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+static int bit_length(uint64_t x)
+{
+    return 64 - __builtin_clzll(x);
+}
+
+/* Return floor(e * log10(2)).  The approximation is exact for
+   |e| <= 1650, which covers all binary exponents of doubles. */
+static int floor_log10_pow2(int e)
+{
+    return (e * 78913) >> 18;
+}
+
+/* Compute m * 2^e2 * 10^s = q + r / d exactly.  On success also store
+   in *h2 the width of the interval of reals that round to m * 2^e2,
+   scaled by 10^s and measured in units of 1 / d.  Return 0 if 128
+   bits are not enough. */
+static int scale(uint64_t m, int e2, int s, uint64_t *q, uint128 *r,
+    uint128 *d, uint128 *h2)
+{
+    uint128 n, den;
+    int t, u;
+
+    if (s >= 0) {
+        if (s >= (int) NELEMS(pow5_tab) + 4)
+            return 0;
+        if (s < (int) NELEMS(pow5_tab))
+            den = pow5_tab[s];
+        else
+            den = (uint128) pow5_tab[NELEMS(pow5_tab) - 1]
+                * pow5_tab[s - NELEMS(pow5_tab) + 1];
+        n = (uint128) m * den;  /* m < 2^53 and 5^31 < 2^72 */
+        t = e2 + s;
+        if (t >= 0) {
+            if (t > 63  ||  (n << t) >> t != n  ||  (n << t) >> 64)
+                return 0;
+            *q = (uint64_t) (n << t);
+            *r = 0;
+            *d = 1;
+            *h2 = 1;            /* anything positive will do */
+            return 1;
+        }
+        if (-t > 120)
+            return 0;
+        *d = (uint128) 1 << -t;
+        if ((n >> -t) >> 64)
+            return 0;
+        *q = (uint64_t) (n >> -t);
+        *r = n & (*d - 1);
+        *h2 = den;
+        return 1;
+    }
+
+    if (-s >= (int) NELEMS(pow5_tab))
+        return 0;
+    den = pow5_tab[-s];
+    u = e2 + s;
+    if (u >= 0) {
+        if (u > 74)
+            return 0;
+        n = (uint128) m << u;
+        *h2 = (uint128) 1 << u;
+    }
+    else {
+        if (-u > 64)
+            return 0;
+        n = m;
+        den <<= -u;
+        *h2 = 1;
+    }
+    if ((n / den) >> 64)
+        return 0;
+    *q = (uint64_t) (n / den);
+    *r = n % den;
+    *d = den;
+    return 1;
+}
+
+/* Fast path: find the ndigit (1 <= ndigit <= 17) leading decimal
+   digits of m * 2^e2 as an integer *digits and the decimal exponent
+   *exp10 of the leading digit.  If roundtrip is not NULL, also report
+   whether reading back the rounded decimal yields m * 2^e2 again.
+   Return 0 if the fast path doesn't apply. */
+static int fast_digits(uint64_t m, int e2, int ndigit, uint64_t *digits,
+    int *exp10, int *roundtrip)
+{
+    uint64_t q;
+    uint128 r, d, h2, diff;
+    int x, s, up, below;
+
+    /* The estimate is either exact or one too small. */
+    x = floor_log10_pow2(e2 + bit_length(m) - 1);
+    s = ndigit - 1 - x;
+    if (!scale(m, e2, s, &q, &r, &d, &h2))
+        return 0;
+    if (q >= pow10_tab[ndigit]) {
+        ++x;
+        --s;
+        if (!scale(m, e2, s, &q, &r, &d, &h2))
+            return 0;
+    }
+
+    /* Round to nearest, ties to even. */
+    up = 2 * r > d  ||  (2 * r == d  &&  (q & 1));
+    diff = up ? d - r : r;
+    below = !up  &&  r != 0;
+    q += up;
+    if (q == pow10_tab[ndigit]) {
+        q = pow10_tab[ndigit - 1];
+        ++x;
+    }
+
+    /* The rounded decimal reads back as m * 2^e2 if it lies within
+       half an ulp of m * 2^e2.  If m is a power of two, the gap to the
+       next smaller double is only half as wide, unless m * 2^e2 is the
+       smallest normal double.  Decimals exactly halfway between two
+       doubles read back as the one with the even significand. */
+    if (roundtrip != NULL) {
+        if (diff >= h2)
+            *roundtrip = 0;
+        else if (below  &&  m == (1ULL << 52)  &&  e2 > -1074)
+            *roundtrip = 4 * diff < h2
+                || (4 * diff == h2  &&  !(m & 1));
+        else
+            *roundtrip = 2 * diff < h2
+                || (2 * diff == h2  &&  !(m & 1));
+    }
+
+    *digits = q;
+    *exp10 = x;
+    return 1;
+}
+
+/* Slow path: write the complete decimal expansion of m * 2^e2 to d
+   (without leading zeros) and return the number of digits written.
+   Store the decimal exponent of the leading digit in *exp10. */
+static int exact_digits(uint64_t m, int e2, char *d, int *exp10)
+{
+    uint32_t a[NLIMB], chunk[NLIMB + 2];
+    uint64_t carry, rem;
+    int n, i, k, nchunk, nd;
+
+    a[0] = (uint32_t) m;
+    a[1] = (uint32_t) (m >> 32);
+    n = a[1] ? 2 : 1;
+
+    if (e2 >= 0) {
+        /* a <<= e2 */
+        k = e2 / 32;
+        e2 %= 32;
+        for (i = n - 1; i >= 0; i--)
+            a[i + k] = a[i];
+        for (i = 0; i < k; i++)
+            a[i] = 0;
+        n += k;
+        if (e2) {
+            a[n] = 0;
+            for (i = n; i > 0; i--)
+                a[i] = (a[i] << e2) | (a[i - 1] >> (32 - e2));
+            a[0] <<= e2;
+            n += a[n] != 0;
+        }
+        *exp10 = 0;
+    }
+    else {
+        /* a *= 5^-e2 in steps of at most 5^13 < 2^32. */
+        for (k = -e2; k > 0; k -= 13) {
+            carry = 0;
+            for (i = 0; i < n; i++) {
+                carry += (uint64_t) a[i] * pow5_tab[k > 13 ? 13 : k];
+                a[i] = (uint32_t) carry;
+                carry >>= 32;
+            }
+            if (carry)
+                a[n++] = (uint32_t) carry;
+        }
+        *exp10 = e2;
+    }
+
+    /* Peel off chunks of 9 decimal digits, least significant first. */
+    nchunk = 0;
+    while (n > 0) {
+        rem = 0;
+        for (i = n - 1; i >= 0; i--) {
+            rem = (rem << 32) | a[i];
+            a[i] = (uint32_t) (rem / 1000000000);
+            rem %= 1000000000;
+        }
+        chunk[nchunk++] = (uint32_t) rem;
+        while (n > 0  &&  a[n - 1] == 0)
+            --n;
+    }
+
+    nd = 0;
+    for (k = chunk[nchunk - 1]; k; k /= 10)
+        ++nd;
+    for (i = nd - 1, k = chunk[nchunk - 1]; i >= 0; i--, k /= 10)
+        d[i] = '0' + k % 10;
+    for (i = nchunk - 2; i >= 0; i--, nd += 9)
+        for (k = 8, rem = chunk[i]; k >= 0; k--, rem /= 10)
+            d[nd + k] = '0' + rem % 10;
+
+    *exp10 += nd - 1;
+    return nd;
+}
+
+/* Round the nd-digit decimal expansion in d to ndigit digits, padding
+   with zeros if necessary. */
+static void round_digits(char *d, int nd, int ndigit, int *exp10)
+{
+    int i, up;
+
+    if (nd <= ndigit) {
+        memset(d + nd, '0', ndigit - nd);
+        return;
+    }
+
+    up = d[ndigit] > '5';
+    if (d[ndigit] == '5') {
+        for (i = ndigit + 1; i < nd  &&  d[i] == '0'; i++)
+            ;
+        up = i < nd  ||  (d[ndigit - 1] - '0') % 2;
+    }
+    if (!up)
+        return;
+
+    for (i = ndigit - 1; i >= 0  &&  d[i] == '9'; i--)
+        d[i] = '0';
+    if (i >= 0)
+        ++d[i];
+    else {
+        d[0] = '1';
+        ++*exp10;
+    }
+}
+
+/* Write the ndigit-digit integer q to d. */
+static void write_digits(char *d, uint64_t q, int ndigit)
+{
+    int i;
+
+    for (i = ndigit; i >= 2; i -= 2, q /= 100)
+        memcpy(d + i - 2, digit_pairs + 2 * (q % 100), 2);
+    if (i == 1)
+        d[0] = '0' + q;
+}
+
+/* Return the number of digits in d left after stripping trailing
+   zeros. */
+static int significant(const char *d, int ndigit)
+{
+    while (ndigit > 1  &&  d[ndigit - 1] == '0')
+        --ndigit;
+    return ndigit;
+}
+
+/* Lay out ndigit significant digits d with decimal exponent x the way
+   %g does: use %e style if x < -4 or x >= ndigit and %f style
+   otherwise, then strip trailing zeros and a trailing decimal point. */
+static char *layout_digits(char *s, const char *d, int ndigit, int x)
+{
+    int n, e;
+
+    /* Trailing zeros are never printed. */
+    n = significant(d, ndigit);
+
+    if (x < -4  ||  x >= ndigit) {
+        *s++ = d[0];
+        if (n > 1) {
+            *s++ = '.';
+            memcpy(s, d + 1, n - 1);
+            s += n - 1;
+        }
+        *s++ = 'e';
+        *s++ = x < 0 ? '-' : '+';
+        e = x < 0 ? -x : x;
+        if (e >= 100) {
+            *s++ = '0' + e / 100;
+            e %= 100;
+        }
+        memcpy(s, digit_pairs + 2 * e, 2);
+        return s + 2;
+    }
+
+    if (x < 0) {
+        *s++ = '0';
+        *s++ = '.';
+        memset(s, '0', -x - 1);
+        s += -x - 1;
+        memcpy(s, d, n);
+        return s + n;
+    }
+
+    if (n <= x + 1) {
+        memcpy(s, d, n);
+        memset(s + n, '0', x + 1 - n);
+        return s + x + 1;
+    }
+    memcpy(s, d, x + 1);
+    s += x + 1;
+    *s++ = '.';
+    memcpy(s, d + x + 1, n - x - 1);
+    return s + n - x - 1;
+}
+
+/* Format the shortest decimal that reads back as m * 2^e2.  If any
+   decimal with at most 15 significant digits reads back correctly,
+   then so does m * 2^e2 rounded to 15 digits, because the spacing of
+   15-digit decimals is wider than the spacing of normal doubles.  So
+   it suffices to try 15, 16, and 17 digits and strip trailing zeros.
+   The spacing of subnormal doubles is wider, so for those we start
+   with a single digit.  The result is laid out like %g with as many
+   significant digits as remain after stripping trailing zeros. */
+static char *format_shortest(char *s, double v, uint64_t m, int e2,
+    int subnormal)
+{
+    char d[MAX_EXACT_DIGITS], *t;
+    uint64_t q;
+    int ndigit, nd, x, ok;
+
+    for (ndigit = subnormal ? 1 : 15; ; ndigit++) {
+        if (fast_digits(m, e2, ndigit, &q, &x, &ok)) {
+            if (ok  ||  ndigit == MAX_FAST_DIGITS) {
+                write_digits(d, q, ndigit);
+                return layout_digits(s, d, significant(d, ndigit), x);
+            }
+            continue;
+        }
+
+        /* The slow path doesn't tell us whether the decimal reads
+           back correctly, so we ask strtod(3). */
+        nd = exact_digits(m, e2, d, &x);
+        round_digits(d, nd, ndigit, &x);
+        t = layout_digits(s, d, significant(d, ndigit), x);
+        if (ndigit == MAX_FAST_DIGITS)
+            return t;
+        *t = '\0';
+        if (strtod(s, NULL) == v)
+            return t;
+    }
+}
+
+/* Write x with ndigit significant digits to s and return a pointer
+   just past the last character written.  The output is not
+   NUL-terminated.  See FORMAT_DOUBLE_SHORTEST and
+   FORMAT_DOUBLE_MAXLEN in format_double.h. */
+char *format_double(char *s, double x, int ndigit)
+{
+    char d[MAX_EXACT_DIGITS];
+    uint64_t bits, m, q;
+    int e2, exp2, nd, e10;
+
+    memcpy(&bits, &x, sizeof bits);
+    m = bits & ((1ULL << 52) - 1);
+    exp2 = (int) ((bits >> 52) & 0x7ff);
+
+    if (bits >> 63)
+        *s++ = '-';
+
+    if (exp2 == 0x7ff) {
+        memcpy(s, m ? "nan" : "inf", 3);
+        return s + 3;
+    }
+    if (exp2 == 0  &&  m == 0) {
+        *s++ = '0';
+        return s;
+    }
+
+    /* Normal doubles have an implicit leading 1 bit. */
+    if (exp2 == 0)
+        e2 = -1074;
+    else {
+        m |= 1ULL << 52;
+        e2 = exp2 - 1075;
+    }
+
+    if (ndigit == FORMAT_DOUBLE_SHORTEST)
+        return format_shortest(s, x < 0 ? -x : x, m, e2, exp2 == 0);
+
+    /* Like %g, treat a precision of 0 as 1. */
+    if (ndigit == 0)
+        ndigit = 1;
+
+    if (ndigit <= MAX_FAST_DIGITS
+        &&  fast_digits(m, e2, ndigit, &q, &e10, NULL)) {
+        write_digits(d, q, ndigit);
+        return layout_digits(s, d, ndigit, e10);
+    }
+
+    nd = exact_digits(m, e2, d, &e10);
+    round_digits(d, nd, ndigit, &e10);
+    return layout_digits(s, d, ndigit, e10);
+}
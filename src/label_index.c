@@ -0,0 +1,155 @@
+#include "label_index.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Labels are hashed with 64-bit FNV-1a and stored in an open
+   addressing table with linear probing.  The table has at least twice
+   as many slots as labels, so probe sequences stay short. */
+static unsigned long hash_label(const char *s)
+{
+    unsigned long long h = 14695981039346656037ULL;
+
+    for (; *s; s++) {
+        h ^= (unsigned char) *s;
+        h *= 1099511628211ULL;
+    }
+    return (unsigned long) (h ^ (h >> 32));
+}
+
+int build_label_index(struct LabelIndex *index,
+    const struct Layout *layout, LabelFunc label, int nlabel)
+{
+    unsigned long nslot, i, j;
+    const char *s;
+
+    for (nslot = 16; nslot < 2 * (unsigned long) nlabel; nslot *= 2)
+        ;
+    if ((index->slots = (int *) malloc(nslot * sizeof(int))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (nslot * sizeof(int)));
+        return 0;
+    }
+    for (j = 0; j < nslot; j++)
+        index->slots[j] = -1;
+    index->layout = layout;
+    index->label = label;
+    index->mask = nslot - 1;
+
+    /* If a label occurs more than once, the first occurrence wins. */
+    for (i = 0; i < (unsigned long) nlabel; i++)
+        for (s = label(layout, i), j = hash_label(s) & index->mask; ;
+             j = (j + 1) & index->mask) {
+            if (index->slots[j] == -1) {
+                index->slots[j] = i;
+                break;
+            }
+            if (!strcmp(label(layout, index->slots[j]), s))
+                break;
+        }
+
+    return 1;
+}
+
+/* Return the position of label or -1 if it isn't indexed. */
+int lookup_label(const struct LabelIndex *index, const char *label)
+{
+    unsigned long j;
+
+    for (j = hash_label(label) & index->mask; index->slots[j] != -1;
+         j = (j + 1) & index->mask)
+        if (!strcmp(index->label(index->layout, index->slots[j]), label))
+            return index->slots[j];
+    return -1;
+}
+
+void free_label_index(struct LabelIndex *index)
+{
+    free(index->slots);
+    index->slots = NULL;
+}
+
+/* Read a file with one label per line and look up every label among
+   the nlabel labels of layout given by label.  Store the positions of
+   the labels in increasing order and without duplicates in a newly
+   allocated array *selected and their number in *nselected.  Leading
+   and trailing whitespace and empty lines are ignored.  An unknown
+   label is an error; what names the kind of label in the error
+   message. */
+int read_label_file(const char *file, const char *what,
+    const struct Layout *layout, LabelFunc label, int nlabel,
+    int **selected, int *nselected)
+{
+    struct LabelIndex index;
+    FILE *fp;
+    char *line, *s, *e, *seen;
+    size_t size;
+    unsigned long lineno;
+    int i, n, *p;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+        set_err_msg("failed to open file for reading: %s", file);
+        goto RETURN_ZERO;
+    }
+    if (!build_label_index(&index, layout, label, nlabel))
+        goto CLOSE_FILE;
+    if ((seen = (char *) calloc(nlabel, 1)) == NULL) {
+        set_err_msg("failed to allocate %d bytes", nlabel);
+        goto FREE_INDEX;
+    }
+
+    line = NULL;
+    size = 0;
+    for (lineno = 1; getline(&line, &size, fp) != -1; lineno++) {
+        for (s = line; isspace((unsigned char) *s); s++)
+            ;
+        for (e = s + strlen(s); e > s  &&  isspace((unsigned char) e[-1]);
+             e--)
+            ;
+        if (e == s)
+            continue;
+        *e = '\0';
+        if ((i = lookup_label(&index, s)) == -1) {
+            set_err_msg("unknown %s in line %lu of %s: %s", what, lineno,
+                file, s);
+            goto FREE_LINE;
+        }
+        seen[i] = 1;
+    }
+    if (ferror(fp)) {
+        set_err_msg("failed to read file: %s", file);
+        goto FREE_LINE;
+    }
+
+    for (n = i = 0; i < nlabel; i++)
+        n += seen[i];
+    if ((p = (int *) malloc((n + 1) * sizeof(int))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) ((n + 1) * sizeof(int)));
+        goto FREE_LINE;
+    }
+    for (n = i = 0; i < nlabel; i++)
+        if (seen[i])
+            p[n++] = i;
+
+    *selected = p;
+    *nselected = n;
+
+    free(line);
+    free(seen);
+    free_label_index(&index);
+    fclose(fp);
+    return 1;
+
+FREE_LINE:
+    free(line);
+    free(seen);
+FREE_INDEX:
+    free_label_index(&index);
+CLOSE_FILE:
+    fclose(fp);
+RETURN_ZERO:
+    return 0;
+}
@@ -1,7 +1,11 @@
 #include "parse_command_line_args.h"
 #include "parse_layout_file.h"
 #include "parse_data_file.h"
+#include "convert_batch.h"
+#include "merge_result_sets.h"
+#include "serve_queries.h"
 #include "err_msg.h"
+#include "Filter.h"
 #include <stdlib.h>
 
 void usage(void);
@@ -10,6 +14,7 @@ int main(int argc, char **argv)
 {
     struct Params params;
     struct Layout layout;
+    double t;
 
     initialize_parameters(&params);
     if (!parse_command_line_args(argc, argv, &params))
@@ -23,11 +28,35 @@ int main(int argc, char **argv)
     if (!validate_command_line_args(&params))
         goto ERROR;
 
+    if (params.stats_report
+        &&  (params.stats = Stats_Create(stderr)) == NULL)
+        goto ERROR;
+
+    if (params.command == COMMAND_SERVE) {
+        if (!serve_queries(&params))
+            goto ERROR;
+        goto SUCCESS;
+    }
+
+    if (params.command != COMMAND_CONVERT) {
+        if (!merge_result_sets(&params))
+            goto ERROR;
+        goto PRINT_STATS;
+    }
+
+    if (params.manifest != NULL) {
+        if (!convert_batch(&params))
+            goto ERROR;
+        goto PRINT_STATS;
+    }
+
+    t = Stats_Start(params.stats);
     if (!parse_layout_file(params.layout_file, &layout))
         goto ERROR;
 
     if  (!validate_layout(&layout))
         goto ERROR;
+    Stats_Stop(params.stats, STATS_LAYOUT, t);
 
     if (params.print_columns) {
         print_columns(&layout);
@@ -37,9 +66,21 @@ int main(int argc, char **argv)
     if (!set_column_print_order(&params, &layout))
         goto ERROR;
 
+    if (params.where != NULL
+        &&  (params.filter = Filter_Compile(params.where, &layout)) == NULL)
+        goto ERROR;
+
+    if (params.rank_by != NULL
+        &&  (params.rank = Filter_Compile(params.rank_by, &layout)) == NULL)
+        goto ERROR;
+
     if (!parse_data_file(&params, &layout))
         goto ERROR;
 
+PRINT_STATS:
+    if (!Stats_Print(params.stats, stderr, params.nthread))
+        goto ERROR;
+
 SUCCESS:
     exit(EXIT_SUCCESS);
 
@@ -56,26 +97,160 @@ void usage(void)
         "\n"
         "SYNOPSIS\n"
         "       r3shuffle [OPTION]... FILE\n"
+        "       r3shuffle [OPTION]... --manifest=MANIFEST\n"
+        "       r3shuffle merge [OPTION]... --output=OUTFILE FILE...\n"
+        "       r3shuffle retile [OPTION]... --output=OUTFILE FILE\n"
+        "       r3shuffle serve [OPTION]... --socket=PATH FILE\n"
         "\n"
         "DESCRIPTION\n"
         "       Convert OmicABEL's binary output files FILE.iout and\n"
         "       FILE.out into a single plain text file.\n"
         "\n"
+        "       With merge, combine the result sets FILE... of jobs that\n"
+        "       were split by snps or by traits into OUTFILE.iout and\n"
+        "       OUTFILE.out, binary to binary.  The result sets must have\n"
+        "       the same columns and either the same traits or the same\n"
+        "       snps; the merged result set has the tiles of the first\n"
+        "       unless --snps-per-tile or --traits-per-tile is given.\n"
+        "\n"
+        "       With retile, rewrite the result set FILE with the tiles\n"
+        "       given by --snps-per-tile and --traits-per-tile into\n"
+        "       OUTFILE.iout and OUTFILE.out, reading forward only and\n"
+        "       using at most --max-memory bytes; --traits-per-tile=1\n"
+        "       puts all snps of a trait into one contiguous range.\n"
+        "\n"
+        "       With serve, map the result set FILE once and answer\n"
+        "       batches of (snp, trait, columns) queries from clients on\n"
+        "       the Unix domain socket PATH until a client asks to shut\n"
+        "       down; decoded tiles are cached in up to --max-memory\n"
+        "       bytes, and clients can ask for the latency percentiles\n"
+        "       of all queries so far (see serve_queries.h).\n"
+        "\n"
         "       Mandatory arguments to long options are mandatory for short\n"
         "       options too.\n"
         "\n"
         "       -c, --column=LABEL\n"
         "              include column LABEL in output\n"
         "\n"
+        "       --compress=METHOD\n"
+        "              compress the output with METHOD: none (default)\n"
+        "              or bgzf, blocked gzip readable by zcat; with\n"
+        "              --output=FILE, also write the index FILE.r3i for\n"
+        "              looking up single lines\n"
+        "\n"
         "       -d, --digits=K\n"
-        "              use K significant digits in output (default: 8)\n"
+        "              use K significant digits in output (default: 8);\n"
+        "              'shortest' uses as few digits as needed to read\n"
+        "              back the exact same double\n"
+        "\n"
+        "       --endian=ORDER\n"
+        "              byte order of the data file: 'auto' (default)\n"
+        "              takes it from the layout file, 'little' or 'big'\n"
+        "              override it\n"
+        "\n"
+        "       --format=FORMAT\n"
+        "              write FORMAT: text (default) or arrow, an Arrow\n"
+        "              IPC file with one record batch per tile; snp and\n"
+        "              trait are dictionary-encoded, all other columns\n"
+        "              are float64; requires --order=file\n"
         "\n"
         "       -h, --help\n"
         "              display this help message\n"
         "\n"
+        "       --io-report\n"
+        "              report bytes read from the data file on stderr;\n"
+        "              pages that hold only unused columns are skipped\n"
+        "\n"
+        "       --manifest=MANIFEST\n"
+        "              convert every FILE listed in MANIFEST, one per\n"
+        "              line, sharing --threads and --max-memory; each\n"
+        "              is written to FILE.txt (FILE.arrow, FILE.txt.gz),\n"
+        "              or with --output all to OUTFILE under one header\n"
+        "\n"
+        "       --max-memory=SIZE\n"
+        "              use at most SIZE bytes to reorder records with\n"
+        "              --order, merge, or retile, or to cache tiles with\n"
+        "              serve (default: 256M); SIZE may end in K, M, or G\n"
+        "\n"
+        "       --no-mmap\n"
+        "              read data file with buffered reads instead of mmap(2)\n"
+        "\n"
+        "       --order=ORDER\n"
+        "              write records in ORDER: 'file' in data file order\n"
+        "              (default), 'trait' grouped by trait, 'snp' grouped\n"
+        "              by snp\n"
+        "\n"
         "       -o, --output=OUTFILE\n"
         "              name of output file (default: stdout)\n"
         "\n"
         "       --print-columns\n"
-        "              write available output variables to --output\n");
+        "              write available output variables to --output\n"
+        "\n"
+        "       --queue-depth=N\n"
+        "              keep up to N reads of the data file in flight\n"
+        "              with --snps-file and --traits-file (default: 32);\n"
+        "              uses io_uring if available, else N threads\n"
+        "\n"
+        "       --rank-by=EXPR\n"
+        "              with --top-k, rank records by EXPR, which takes\n"
+        "              the same form as with --where: by the smallest\n"
+        "              value if EXPR is p(COV), else by the largest\n"
+        "              absolute value, e.g. --rank-by='p(snp)' or\n"
+        "              --rank-by=beta_snp/se_snp\n"
+        "\n"
+        "       --snps-file=SNPFILE\n"
+        "              only convert the snps listed in SNPFILE, one label\n"
+        "              per line\n"
+        "\n"
+        "       --snps-per-tile=N\n"
+        "              with merge and retile, write tiles of N snps\n"
+        "\n"
+        "       --socket=PATH\n"
+        "              with serve, listen on the Unix domain socket PATH\n"
+        "\n"
+        "       --stats\n"
+        "              report progress and an estimate of the remaining\n"
+        "              time on stderr every 10 seconds, and finally a\n"
+        "              line of JSON with the seconds spent parsing the\n"
+        "              layout, reading, formatting, and writing (read\n"
+        "              and format summed over threads), bytes and\n"
+        "              records per second, peak RSS, and system calls\n"
+        "\n"
+        "       --summary=COV\n"
+        "              instead of records, write a line per trait that\n"
+        "              summarizes z = beta_COV/se_COV of the records that\n"
+        "              pass --where: their number, the genomic inflation\n"
+        "              factor lambda, the largest -log10(p), the number\n"
+        "              of hits at p < 1e-3, 1e-5, 1e-6, 5e-8, and 1e-10,\n"
+        "              a histogram of -log10(p) in bins of width 1, and\n"
+        "              the observed -log10(p) where 1 to 10 are expected;\n"
+        "              lambda and the latter are NA where chi-square\n"
+        "              exceeds 65536; memory doesn't grow with the\n"
+        "              number of snps\n"
+        "\n"
+        "       --threads=N\n"
+        "              convert with N threads (default: 1); the output\n"
+        "              doesn't depend on N\n"
+        "\n"
+        "       --top-k=K\n"
+        "              only write the K records of every trait that rank\n"
+        "              highest by --rank-by, trait by trait and from the\n"
+        "              highest rank down, after a single pass over the\n"
+        "              data file; memory grows with K times the number\n"
+        "              of traits, not with the size of the data file\n"
+        "\n"
+        "       --traits-file=TRAITFILE\n"
+        "              only convert the traits listed in TRAITFILE, one\n"
+        "              label per line\n"
+        "\n"
+        "       --traits-per-tile=N\n"
+        "              with merge and retile, write tiles of N traits\n"
+        "\n"
+        "       --where=EXPR\n"
+        "              only write records for which EXPR is true; EXPR\n"
+        "              can use column labels, numbers, + - * /, < <= > >=\n"
+        "              == !=, && || !, parentheses, abs(x), sqrt(x),\n"
+        "              log10(x), and p(COV), the two-sided p-value of\n"
+        "              beta/se of covariate COV, e.g.\n"
+        "              --where='p(snp) < 5e-8 && abs(beta_snp) > 0.05'\n");
 }
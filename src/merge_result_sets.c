@@ -0,0 +1,646 @@
+#include "merge_result_sets.h"
+#include "parse_data_file.h"
+#include "read_block.h"
+#include "run_ordered.h"
+#include "label_index.h"
+#include "err_msg.h"
+#include "Stats.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* OmicABEL jobs are often split by snp range or by trait block, and
+   every job writes a result set of its own.  "r3shuffle merge"
+   combines such result sets into one, binary to binary: the merged
+   layout file lists the snps or traits of all result sets in the
+   order given on the command line.
+
+   Result sets can be merged if they have the same columns and either
+   the same traits, in which case their snps are concatenated, or the
+   same snps, in which case their traits are concatenated.  They need
+   not have the same tiles, but the merged result set must not list
+   a snp (or trait) twice.
+
+   OmicABEL picks its tiles for the speed of the regression, not for
+   the speed of reading its results.  "r3shuffle retile" rewrites a
+   single result set with other tiles, e.g., with --traits-per-tile=1,
+   so that all snps of a trait lie in a single contiguous range.  It
+   is the same as merging a single result set.  Without
+   --snps-per-tile and --traits-per-tile, the merged result set has
+   the tiles of the first result set.
+
+   Either way, the merged data file is written from front to back,
+   unit by unit, on the --threads workers of run_ordered.  A unit is a
+   rectangle of snps and traits that is contiguous in the merged data
+   file: several whole tile rows, or else several whole tiles of a
+   single tile row, as many as fit into the unit's share of
+   --max-memory.  Every worker reads the records of its unit from
+   every result set that holds some of them with read_block, which
+   reads forward only and in ranges of at least a row of a tile, and
+   then puts them in the merged order.  Nothing but the units in
+   flight is held in memory, however large the result sets are.  If
+   the result sets differ in precision or byte order, all records are
+   decoded to native doubles (see decode.c) on the way. */
+
+/* run_ordered holds up to four units per worker, and every worker
+   reads the records of its unit into a block of its own, so units may
+   take this fraction of --max-memory per worker. */
+enum { UNITS_PER_THREAD = 8 };
+
+/* But units larger than this don't make reading any faster. */
+#define MAX_UNIT_BYTES (64UL << 20)
+
+/* A rectangle of the merged trait-snp matrix that is contiguous in the
+   merged data file, starting at offset. */
+struct Unit {
+    int trait0, trait1;
+    int snp0, snp1;
+    unsigned long offset;
+};
+
+struct Copy {
+    struct Layout *out;         /* layout of merged result set */
+    struct Piece *pieces;
+    int npiece;
+    size_t nbytes;              /* bytes per merged record */
+    struct Unit *units;
+    unsigned long nunit;
+    struct RecordSource *src;   /* every piece for every worker */
+    char **block;               /* records of a unit for every worker */
+    size_t *block_size;         /* capacity of every block */
+    FILE *fp;                   /* merged data file */
+    const char *file;           /* name of merged data file */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+static char *file_name(const char *prefix, const char *extension)
+{
+    char *s;
+    size_t n;
+
+    n = strlen(prefix) + strlen(extension) + 1;
+    if ((s = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return NULL;
+    }
+    sprintf(s, "%s%s", prefix, extension);
+    return s;
+}
+
+/* Open the result set FILE given by prefix as a piece at snp 0 and
+   trait 0.  Its data file must be seekable.  Unless --no-mmap is
+   given, it is also mapped if possible. */
+int open_piece(struct Params *params, const char *prefix,
+    struct Piece *p)
+{
+    struct Layout *layout;
+    unsigned long nrecord;
+    struct stat buf;
+    int swap;
+
+    layout = &p->layout;
+    p->map = NULL;
+    p->fd = -1;
+    p->decode = NULL;
+    p->snp0 = p->trait0 = 0;
+    if ((p->file = file_name(prefix, ".iout")) == NULL)
+        return 0;
+    if (!parse_layout_file(p->file, layout))
+        goto FREE_NAME;
+    if (!validate_layout(layout))
+        goto FREE_LAYOUT;
+
+    free(p->file);
+    if ((p->file = file_name(prefix, ".out")) == NULL)
+        goto FREE_LAYOUT;
+    if ((p->fd = open(p->file, O_RDONLY)) == -1) {
+        set_err_msg("failed to open file for reading: %s", p->file);
+        goto FREE_LAYOUT;
+    }
+    if (fstat(p->fd, &buf) == -1  ||  !S_ISREG(buf.st_mode)) {
+        set_err_msg("data file must be a regular file: %s", p->file);
+        goto CLOSE_FILE;
+    }
+    p->record_size = (2 * layout->nvar + layout->ncov)
+        * (size_t) layout->bytes_per_double;
+    nrecord = (unsigned long) layout->nsnp * layout->ntrait;
+    if ((unsigned long) buf.st_size < nrecord * p->record_size) {
+        set_err_msg("data file too short: expected %lu bytes, got %lu: "
+            "%s", nrecord * p->record_size, (unsigned long) buf.st_size,
+            p->file);
+        goto CLOSE_FILE;
+    }
+    if (params->use_mmap)
+        p->map = MappedFile_Open(p->file);
+
+    /* Values in the other byte order must be decoded, as in
+       parse_data_file. */
+    swap = params->endian == ENDIAN_AUTO ? layout->swapped
+        : (params->endian == ENDIAN_BIG) != is_big_endian();
+    if (swap)
+        p->decode = find_decoder(layout->bytes_per_double, swap,
+            DECODE_BEST);
+    return 1;
+
+CLOSE_FILE:
+    close(p->fd);
+    p->fd = -1;
+FREE_LAYOUT:
+    free_layout(layout);
+FREE_NAME:
+    free(p->file);
+    p->file = NULL;
+    return 0;
+}
+
+void close_piece(struct Piece *p)
+{
+    if (p->map != NULL)
+        MappedFile_Close(p->map);
+    if (p->fd != -1)
+        close(p->fd);
+    p->map = NULL;
+    p->fd = -1;
+    free(p->file);
+    p->file = NULL;
+    free_layout(&p->layout);
+}
+
+/* Cut the merged data file into units of at most max_unit records, or
+   a single tile if a tile holds more.  Return the number of units or
+   0 on failure. */
+static unsigned long make_units(struct Layout *out,
+    unsigned long max_unit, struct Unit **units)
+{
+    unsigned long n, nrow, ntile;
+    struct Unit *u;
+    int pass, trait, snp, ntrait, nsnp;
+
+    u = NULL;
+    nrow = max_unit / out->nsnp;
+    for (pass = 0; pass < 2; pass++) {
+        n = 0;
+        for (trait = 0; trait < out->ntrait; trait += ntrait) {
+            /* As many whole tile rows as fit, or else one tile row. */
+            if (nrow >= (unsigned long) out->ntrait - trait)
+                ntrait = out->ntrait - trait;
+            else if (nrow >= (unsigned long) out->traits_per_tile)
+                ntrait = nrow - nrow % out->traits_per_tile;
+            else
+                ntrait = out->traits_per_tile;
+            if (ntrait > out->ntrait - trait)
+                ntrait = out->ntrait - trait;
+
+            /* As many whole tiles of it as fit. */
+            ntile = max_unit / ((unsigned long) ntrait
+                * out->snps_per_tile);
+            if (ntile == 0)
+                ntile = 1;
+            nsnp = ntile * out->snps_per_tile >= (unsigned long) out->nsnp
+                ? out->nsnp : (int) ntile * out->snps_per_tile;
+
+            for (snp = 0; snp < out->nsnp; snp += nsnp, n++)
+                if (u != NULL) {
+                    u[n].trait0 = trait;
+                    u[n].trait1 = trait + ntrait;
+                    u[n].snp0 = snp;
+                    u[n].snp1 = out->nsnp - snp < nsnp ? out->nsnp
+                        : snp + nsnp;
+                    index2offset(snp, trait, &u[n].offset, out);
+                }
+        }
+        if (u == NULL
+            &&  (u = (struct Unit *) malloc(n * sizeof(struct Unit)))
+            == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (n * sizeof(struct Unit)));
+            return 0;
+        }
+    }
+
+    *units = u;
+    return n;
+}
+
+/* Copy the records of a piece that are part of a unit from the block
+   read by read_block, trait by trait, into the chunk of the unit.
+   Runs of records that are consecutive in both end with a tile of the
+   merged result set. */
+static void copy_block(struct Copy *c, struct Piece *p, struct Unit *u,
+    const char *block, int trait0, int trait1, int snp0, int snp1,
+    char *dst)
+{
+    struct Layout *out = c->out;
+    unsigned long offset;
+    const char *src;
+    int trait, snp, end, run, nvalue;
+
+    nvalue = p->record_size / p->layout.bytes_per_double;
+    src = block;
+    for (trait = trait0; trait < trait1; trait++)
+        for (snp = snp0; snp < snp1; snp += run) {
+            end = snp - snp % out->snps_per_tile + out->snps_per_tile;
+            run = (end < snp1 ? end : snp1) - snp;
+            index2offset(snp, trait, &offset, out);
+            if (p->decode != NULL)
+                p->decode((double *) (dst + (offset - u->offset)
+                        * c->nbytes), src, run * nvalue);
+            else
+                memcpy(dst + (offset - u->offset) * c->nbytes, src,
+                    run * c->nbytes);
+            src += run * p->record_size;
+        }
+}
+
+/* Read the records of a unit from every piece that holds some of them
+   and put them into chunk in the order of the merged data file. */
+static int copy_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Copy *c = (struct Copy *) arg;
+    struct Unit *u;
+    struct Piece *p;
+    struct RecordSource *src;
+    int i, trait0, trait1, snp0, snp1;
+    size_t n;
+    char *t;
+    double start;
+
+    u = &c->units[unit];
+    n = (size_t) (u->trait1 - u->trait0) * (u->snp1 - u->snp0);
+    if (chunk->size < n * c->nbytes) {
+        if ((t = (char *) realloc(chunk->data, n * c->nbytes)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (n * c->nbytes));
+            return 0;
+        }
+        chunk->data = t;
+        chunk->size = n * c->nbytes;
+    }
+    chunk->len = n * c->nbytes;
+
+    for (i = 0; i < c->npiece; i++) {
+        p = &c->pieces[i];
+        trait0 = u->trait0 > p->trait0 ? u->trait0 : p->trait0;
+        trait1 = u->trait1 < p->trait0 + p->layout.ntrait ? u->trait1
+            : p->trait0 + p->layout.ntrait;
+        snp0 = u->snp0 > p->snp0 ? u->snp0 : p->snp0;
+        snp1 = u->snp1 < p->snp0 + p->layout.nsnp ? u->snp1
+            : p->snp0 + p->layout.nsnp;
+        if (trait0 >= trait1  ||  snp0 >= snp1)
+            continue;
+
+        n = (size_t) (trait1 - trait0) * (snp1 - snp0) * p->record_size;
+        if (c->block_size[worker] < n) {
+            if ((t = (char *) realloc(c->block[worker], n)) == NULL) {
+                set_err_msg("failed to allocate %lu bytes",
+                    (unsigned long) n);
+                return 0;
+            }
+            c->block[worker] = t;
+            c->block_size[worker] = n;
+        }
+
+        start = Stats_Start(c->stats);
+        src = &c->src[worker * c->npiece + i];
+        if (!read_block(src, &p->layout, trait0 - p->trait0,
+                trait1 - p->trait0, snp0 - p->snp0, snp1 - p->snp0,
+                c->block[worker]))
+            return 0;
+        Stats_Stop(c->stats, STATS_READ, start);
+
+        start = Stats_Start(c->stats);
+        copy_block(c, p, u, c->block[worker], trait0, trait1, snp0, snp1,
+            chunk->data);
+        Stats_Stop(c->stats, STATS_FORMAT, start);
+    }
+
+    return 1;
+}
+
+static int write_unit(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    struct Copy *c = (struct Copy *) arg;
+    double t;
+
+    (void) unit;
+    t = Stats_Start(c->stats);
+    if (fwrite(chunk->data, chunk->len, 1, c->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", c->file);
+        return 0;
+    }
+    Stats_Stop(c->stats, STATS_WRITE, t);
+    Stats_AddWrites(c->stats, chunk->len, 1);
+    Stats_AddRecords(c->stats, chunk->len / c->nbytes);
+    return 1;
+}
+
+/* Write the records of the pieces, which must cover every snp and
+   trait of the layout out, to fp in the file order of out.  Records
+   are written as native doubles if any piece is decoded. */
+int write_pieces(struct Params *params, struct Layout *out,
+    struct Piece *pieces, int npiece, FILE *fp, const char *file)
+{
+    struct Copy c;
+    struct RecordSource *src;
+    unsigned long max_bytes;
+    int i, n, status;
+
+    c.out = out;
+    c.pieces = pieces;
+    c.npiece = npiece;
+    c.nbytes = (2 * out->nvar + out->ncov) * (size_t) out->bytes_per_double;
+    c.fp = fp;
+    c.file = file;
+    c.stats = params->stats;
+
+    max_bytes = params->max_memory / UNITS_PER_THREAD / params->nthread;
+    if (max_bytes > MAX_UNIT_BYTES)
+        max_bytes = MAX_UNIT_BYTES;
+    if ((c.nunit = make_units(out, max_bytes / c.nbytes, &c.units)) == 0)
+        return 0;
+
+    status = 0;
+    n = params->nthread * npiece;
+    c.src = (struct RecordSource *) malloc(n * sizeof(*c.src));
+    c.block = (char **) calloc(params->nthread, sizeof(char *));
+    c.block_size = (size_t *) calloc(params->nthread, sizeof(size_t));
+    if (c.src == NULL  ||  c.block == NULL  ||  c.block_size == NULL) {
+        set_err_msg("failed to allocate memory for %d threads",
+            params->nthread);
+        goto FREE_BUFFERS;
+    }
+    for (i = 0; i < n; i++)
+        init_record_source(&c.src[i], pieces[i % npiece].file,
+            pieces[i % npiece].map != NULL
+            ? MappedFile_Data(pieces[i % npiece].map) : NULL,
+            pieces[i % npiece].fd, pieces[i % npiece].record_size);
+
+    Stats_SetTotal(c.stats, out, (unsigned long) out->nsnp * out->ntrait,
+        c.nbytes);
+    status = run_ordered(params->nthread, c.nunit, copy_unit, write_unit,
+        &c);
+
+    for (i = 0; i < n; i++) {
+        src = &c.src[i];
+        Stats_AddReads(c.stats, src->bytes_read, src->nread);
+        free_record_source(src);
+    }
+    for (i = 0; i < params->nthread; i++)
+        free(c.block[i]);
+FREE_BUFFERS:
+    free(c.block_size);
+    free(c.block);
+    free(c.src);
+    free(c.units);
+    return status;
+}
+
+/* Return column j of a layout, where the betas come first, then the
+   standard errors, and then the covariances. */
+static const char *column_label(const struct Layout *layout, int j)
+{
+    if (j < layout->nvar)
+        return layout->beta_labels[j];
+    if (j < 2 * layout->nvar)
+        return layout->se_labels[j - layout->nvar];
+    return layout->cov_labels[j - 2 * layout->nvar];
+}
+
+/* Compare labels of layouts with different max_char. */
+static int same_label(const char *a, const struct Layout *la,
+    const char *b, const struct Layout *lb)
+{
+    size_t n;
+
+    n = strnlen(a, la->max_char);
+    return n == strnlen(b, lb->max_char)  &&  memcmp(a, b, n) == 0;
+}
+
+static int same_columns(const struct Layout *a, const struct Layout *b)
+{
+    int j;
+
+    if (a->nvar != b->nvar)
+        return 0;
+    for (j = 0; j < 2 * a->nvar + a->ncov; j++)
+        if (!same_label(column_label(a, j), a, column_label(b, j), b))
+            return 0;
+    return 1;
+}
+
+static int same_snps(const struct Layout *a, const struct Layout *b)
+{
+    int i;
+
+    if (a->nsnp != b->nsnp)
+        return 0;
+    for (i = 0; i < a->nsnp; i++)
+        if (!same_label(snp_label(a, i), a, snp_label(b, i), b))
+            return 0;
+    return 1;
+}
+
+static int same_traits(const struct Layout *a, const struct Layout *b)
+{
+    int i;
+
+    if (a->ntrait != b->ntrait)
+        return 0;
+    for (i = 0; i < a->ntrait; i++)
+        if (!same_label(trait_label(a, i), a, trait_label(b, i), b))
+            return 0;
+    return 1;
+}
+
+/* Fail if a snp (or trait) label of the merged result set occurs
+   more than once, which would make label lookups find only one of the
+   copies.  The index keeps the first occurrence of every label, so a
+   position that it doesn't find is a later copy. */
+static int check_unique_labels(struct Params *params, struct Layout *out,
+    struct Piece *pieces, int npiece, int by_snp)
+{
+    struct LabelIndex index;
+    LabelFunc label;
+    const char *s;
+    int i, k, n, status;
+
+    label = by_snp ? snp_label : trait_label;
+    n = by_snp ? out->nsnp : out->ntrait;
+    if (!build_label_index(&index, out, label, n))
+        return 0;
+    status = 1;
+    for (i = 0; i < n; i++)
+        if (lookup_label(&index, s = label(out, i)) != i) {
+            for (k = npiece - 1; k > 0; k--)
+                if ((by_snp ? pieces[k].snp0 : pieces[k].trait0) <= i)
+                    break;
+            set_err_msg("duplicate %s %s in %s", by_snp ? "snp" : "trait",
+                s, params->inputs[k]);
+            status = 0;
+            break;
+        }
+    free_label_index(&index);
+    return status;
+}
+
+/* Place the pieces side by side in the merged result set and set up
+   its layout, whose snp and trait labels point to those of the
+   pieces. */
+static int place_pieces(struct Params *params, struct Layout *out,
+    struct Piece *pieces, int npiece)
+{
+    struct Layout *first;
+    long long nsnp, ntrait;
+    size_t n;
+    int i, j, by_snp, by_trait, decode;
+
+    first = &pieces[0].layout;
+    by_snp = by_trait = 1;
+    decode = 0;
+    for (i = 0; i < npiece; i++) {
+        if (!same_columns(first, &pieces[i].layout)) {
+            set_err_msg("columns of %s differ from those of %s",
+                params->inputs[i], params->inputs[0]);
+            return 0;
+        }
+        by_snp = by_snp  &&  same_traits(first, &pieces[i].layout);
+        by_trait = by_trait  &&  same_snps(first, &pieces[i].layout);
+        decode = decode  ||  pieces[i].decode != NULL
+            ||  pieces[i].layout.bytes_per_double
+            != first->bytes_per_double;
+    }
+    if (!by_snp  &&  !by_trait) {
+        set_err_msg("result sets share neither their snps nor their "
+            "traits: %s", params->inputs[0]);
+        return 0;
+    }
+    if (by_snp  &&  by_trait  &&  npiece > 1) {
+        set_err_msg("result sets share both their snps and their "
+            "traits: %s", params->inputs[0]);
+        return 0;
+    }
+
+    *out = *first;
+    out->map = NULL;
+    out->label_data = NULL;
+    out->swapped = 0;
+    out->snp_labels = out->trait_labels = NULL;
+    if (params->snps_per_tile > 0)
+        out->snps_per_tile = params->snps_per_tile;
+    if (params->traits_per_tile > 0)
+        out->traits_per_tile = params->traits_per_tile;
+    nsnp = ntrait = 0;
+    for (i = 0; i < npiece; i++) {
+        if (by_snp) {
+            pieces[i].snp0 = nsnp;
+            nsnp += pieces[i].layout.nsnp;
+        }
+        else {
+            pieces[i].trait0 = ntrait;
+            ntrait += pieces[i].layout.ntrait;
+        }
+        if (pieces[i].layout.max_char > out->max_char)
+            out->max_char = pieces[i].layout.max_char;
+
+        /* Pieces that were copied as they are must be decoded, too. */
+        if (decode  &&  pieces[i].decode == NULL)
+            pieces[i].decode = find_decoder(
+                pieces[i].layout.bytes_per_double, 0, DECODE_BEST);
+    }
+    if (by_snp  ? nsnp > INT_MAX  :  ntrait > INT_MAX) {
+        set_err_msg("too many %s in merged result set: %lld",
+            by_snp ? "snps" : "traits", by_snp ? nsnp : ntrait);
+        return 0;
+    }
+    if (by_snp)
+        out->nsnp = nsnp;
+    else
+        out->ntrait = ntrait;
+    if (decode)
+        out->bytes_per_double = sizeof(double);
+    if (!validate_layout(out))
+        return 0;
+
+    n = ((size_t) out->nsnp + out->ntrait) * sizeof(char *);
+    if ((out->snp_labels = (char **) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return 0;
+    }
+    out->trait_labels = out->snp_labels + out->nsnp;
+    for (i = 0; i < npiece; i++) {
+        for (j = 0; j < pieces[i].layout.nsnp; j++)
+            out->snp_labels[pieces[i].snp0 + j] =
+                (char *) snp_label(&pieces[i].layout, j);
+        for (j = 0; j < pieces[i].layout.ntrait; j++)
+            out->trait_labels[pieces[i].trait0 + j] =
+                (char *) trait_label(&pieces[i].layout, j);
+    }
+
+    /* A single result set is only retiled and keeps its labels. */
+    if (npiece > 1
+        &&  !check_unique_labels(params, out, pieces, npiece, by_snp))
+        return 0;
+    return 1;
+}
+
+/* Merge the result sets given by params->inputs into the result set
+   params->output_file.  A single result set is just retiled. */
+int merge_result_sets(struct Params *params)
+{
+    struct Piece *pieces;
+    struct Layout out;
+    char *layout_file, *data_file;
+    FILE *fp;
+    double t;
+    int i, n, status;
+
+    status = 0;
+    if ((pieces = (struct Piece *) calloc(params->ninput,
+                sizeof(struct Piece))) == NULL) {
+        set_err_msg("failed to allocate memory for %d result sets",
+            params->ninput);
+        return 0;
+    }
+
+    out.snp_labels = NULL;
+    t = Stats_Start(params->stats);
+    for (n = 0; n < params->ninput; n++)
+        if (!open_piece(params, params->inputs[n], &pieces[n]))
+            goto CLOSE_PIECES;
+    if (!place_pieces(params, &out, pieces, n))
+        goto CLOSE_PIECES;
+
+    layout_file = file_name(params->output_file, ".iout");
+    data_file = file_name(params->output_file, ".out");
+    if (layout_file == NULL  ||  data_file == NULL)
+        goto FREE_NAMES;
+    if (!write_layout_file(layout_file, &out))
+        goto FREE_NAMES;
+    Stats_Stop(params->stats, STATS_LAYOUT, t);
+
+    if ((fp = fopen(data_file, "wb")) == NULL) {
+        set_err_msg("failed to open file for writing: %s", data_file);
+        goto FREE_NAMES;
+    }
+    status = write_pieces(params, &out, pieces, n, fp, data_file);
+    if (fclose(fp)  &&  status) {
+        set_err_msg("failed to close file: %s", data_file);
+        status = 0;
+    }
+
+FREE_NAMES:
+    free(layout_file);
+    free(data_file);
+CLOSE_PIECES:
+    free(out.snp_labels);
+    for (i = 0; i < n; i++)
+        close_piece(&pieces[i]);
+    free(pieces);
+    return status;
+}
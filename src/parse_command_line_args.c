@@ -1,9 +1,11 @@
 #include "parse_command_line_args.h"
 #include "err_msg.h"
+#include "format_double.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -14,12 +16,38 @@
 
 void initialize_parameters(struct Params *params)
 {
+    params->command = COMMAND_CONVERT;
+    params->inputs = NULL;
+    params->ninput = 0;
+    params->snps_per_tile = 0;
+    params->traits_per_tile = 0;
     params->ncolumn = 0;
     params->columns = NULL;
     params->ucp2acp = NULL;
     params->ndigit  = 8;
     params->help    = 0;
     params->print_columns = 0;
+    params->use_mmap = 1;
+    params->nthread = 1;
+    params->order = ORDER_FILE;
+    params->max_memory = DEFAULT_MAX_MEMORY;
+    params->snps_file = NULL;
+    params->traits_file = NULL;
+    params->where = NULL;
+    params->filter = NULL;
+    params->top_k = 0;
+    params->rank_by = NULL;
+    params->rank = NULL;
+    params->summary = NULL;
+    params->io_report = 0;
+    params->format = FORMAT_TEXT;
+    params->compress = COMPRESS_NONE;
+    params->queue_depth = DEFAULT_QUEUE_DEPTH;
+    params->stats_report = 0;
+    params->endian = ENDIAN_AUTO;
+    params->manifest = NULL;
+    params->socket_path = NULL;
+    params->stats = NULL;
     params->output_file = NULL;
     params->layout_file = NULL;
     params->data_file   = NULL;
@@ -28,8 +56,9 @@ void initialize_parameters(struct Params *params)
 int parse_command_line_args(int argc, char *argv[],
     struct Params *params)
 {
-    int c, *p, i;
+    int c, *p, i, shift;
     long v;
+    unsigned long m;
     char *s, **t;
     size_t n;
 
@@ -37,10 +66,30 @@ int parse_command_line_args(int argc, char *argv[],
 
         static struct option long_options[] = {
             {"column",        required_argument, 0, 'c'},
+            {"compress",      required_argument, 0, 'z'},
             {"digits",        required_argument, 0, 'd'},
+            {"endian",        required_argument, 0, 'E'},
+            {"format",        required_argument, 0, 'F'},
             {"help",          no_argument,       0, 'h'},
+            {"io-report",     no_argument,       0, 'I'},
+            {"manifest",      required_argument, 0, 'B'},
+            {"max-memory",    required_argument, 0, 'M'},
+            {"no-mmap",       no_argument,       0, 'm'},
+            {"order",         required_argument, 0, 'O'},
             {"output",        required_argument, 0, 'o'},
             {"print-columns", no_argument,       0, 'p'},
+            {"queue-depth",   required_argument, 0, 'Q'},
+            {"rank-by",       required_argument, 0, 'R'},
+            {"snps-file",     required_argument, 0, 'S'},
+            {"socket",        required_argument, 0, 'k'},
+            {"snps-per-tile", required_argument, 0, 'U'},
+            {"stats",         no_argument,       0, 'P'},
+            {"summary",       required_argument, 0, 'Y'},
+            {"threads",       required_argument, 0, 't'},
+            {"top-k",         required_argument, 0, 'K'},
+            {"traits-file",   required_argument, 0, 'T'},
+            {"traits-per-tile", required_argument, 0, 'V'},
+            {"where",         required_argument, 0, 'w'},
             {0, 0, 0, 0}
         };
 
@@ -50,6 +99,14 @@ int parse_command_line_args(int argc, char *argv[],
 
         switch (c) {
 
+        case 'B':
+            params->manifest = optarg;
+            break;
+
+        case 'k':
+            params->socket_path = optarg;
+            break;
+
         case 'c':
             /* Every time we find a new column we extend our storage
                of pointers to char by one and store the label of the
@@ -64,6 +121,18 @@ int parse_command_line_args(int argc, char *argv[],
             params->columns[params->ncolumn++] = optarg;
             break;
 
+        case 'z':
+            if (!strcmp(optarg, "none"))
+                params->compress = COMPRESS_NONE;
+            else if (!strcmp(optarg, "bgzf"))
+                params->compress = COMPRESS_BGZF;
+            else {
+                set_err_msg("argument to --compress must be none or "
+                    "bgzf: %s", optarg);
+                return 0;
+            }
+            break;
+
         case 'd':
             /* If the call to strtol results in underflow or overflow,
                errno is set to ERANGE.  It can also happen that strtol
@@ -72,7 +141,13 @@ int parse_command_line_args(int argc, char *argv[],
                set errno.  We can detect this situation for certain by
                checking whether, after the call to strtol, the pointer
                passed as the second argument points to the same
-               address as the pointer passed as the first argument. */
+               address as the pointer passed as the first argument.
+               The special value "shortest" asks for the shortest
+               output that reads back as the same double. */
+            if (!strcmp(optarg, "shortest")) {
+                params->ndigit = FORMAT_DOUBLE_SHORTEST;
+                break;
+            }
             errno = 0;
             v = strtol(optarg, &s, 10);
             if (errno  ||  s == optarg) {
@@ -80,21 +155,185 @@ int parse_command_line_args(int argc, char *argv[],
                     "%s", optarg);
                 return 0;
             }
+
+            /* Check the range before v becomes an int, and before a
+               negative v could pass for FORMAT_DOUBLE_SHORTEST. */
+            if (v < 0) {
+                set_err_msg("argument to --digits must be >=0");
+                return 0;
+            }
+            if (v > 99) {
+                set_err_msg("argument to --digits must be <100");
+                return 0;
+            }
             params->ndigit = v;
             break;
 
+        case 'E':
+            if (!strcmp(optarg, "auto"))
+                params->endian = ENDIAN_AUTO;
+            else if (!strcmp(optarg, "little"))
+                params->endian = ENDIAN_LITTLE;
+            else if (!strcmp(optarg, "big"))
+                params->endian = ENDIAN_BIG;
+            else {
+                set_err_msg("argument to --endian must be auto, little, "
+                    "or big: %s", optarg);
+                return 0;
+            }
+            break;
+
+        case 'F':
+            if (!strcmp(optarg, "text"))
+                params->format = FORMAT_TEXT;
+            else if (!strcmp(optarg, "arrow"))
+                params->format = FORMAT_ARROW;
+            else {
+                set_err_msg("argument to --format must be text or "
+                    "arrow: %s", optarg);
+                return 0;
+            }
+            break;
+
         case 'h':
             params->help = 1;
             break;
 
+        case 'm':
+            params->use_mmap = 0;
+            break;
+
+        case 'I':
+            params->io_report = 1;
+            break;
+
+        case 'M':
+            /* A size in bytes with an optional binary suffix K, M,
+               or G. */
+            errno = 0;
+            m = strtoul(optarg, &s, 10);
+            shift = 0;
+            switch (*s) {
+            case 'K': shift = 10; s++; break;
+            case 'M': shift = 20; s++; break;
+            case 'G': shift = 30; s++; break;
+            }
+            if (errno  ||  s == optarg  ||  *s != '\0'  ||  *optarg == '-'
+                ||  m > (unsigned long) -1 >> shift) {
+                set_err_msg("failed to convert --max-memory to a size: "
+                    "%s", optarg);
+                return 0;
+            }
+            params->max_memory = m << shift;
+            break;
+
         case 'o':
             params->output_file = optarg;
             break;
 
+        case 'O':
+            if (!strcmp(optarg, "file"))
+                params->order = ORDER_FILE;
+            else if (!strcmp(optarg, "trait"))
+                params->order = ORDER_TRAIT;
+            else if (!strcmp(optarg, "snp"))
+                params->order = ORDER_SNP;
+            else {
+                set_err_msg("argument to --order must be file, trait, "
+                    "or snp: %s", optarg);
+                return 0;
+            }
+            break;
+
         case 'p':
             params->print_columns = 1;
             break;
 
+        case 'P':
+            params->stats_report = 1;
+            break;
+
+        case 'S':
+            params->snps_file = optarg;
+            break;
+
+        case 'T':
+            params->traits_file = optarg;
+            break;
+
+        case 't':
+            errno = 0;
+            v = strtol(optarg, &s, 10);
+            if (errno  ||  s == optarg  ||  *s != '\0') {
+                set_err_msg("failed to convert --threads to integer: "
+                    "%s", optarg);
+                return 0;
+            }
+            if (v < 1  ||  v > MAX_THREADS) {
+                set_err_msg("argument to --threads must be between 1 "
+                    "and %d", MAX_THREADS);
+                return 0;
+            }
+            params->nthread = v;
+            break;
+
+        case 'Q':
+            errno = 0;
+            v = strtol(optarg, &s, 10);
+            if (errno  ||  s == optarg  ||  *s != '\0') {
+                set_err_msg("failed to convert --queue-depth to integer: "
+                    "%s", optarg);
+                return 0;
+            }
+            if (v < 1  ||  v > MAX_QUEUE_DEPTH) {
+                set_err_msg("argument to --queue-depth must be between 1 "
+                    "and %d", MAX_QUEUE_DEPTH);
+                return 0;
+            }
+            params->queue_depth = v;
+            break;
+
+        case 'K':
+            errno = 0;
+            v = strtol(optarg, &s, 10);
+            if (errno  ||  s == optarg  ||  *s != '\0'  ||  v <= 0
+                ||  v > INT_MAX) {
+                set_err_msg("argument to --top-k must be a positive "
+                    "integer: %s", optarg);
+                return 0;
+            }
+            params->top_k = v;
+            break;
+
+        case 'R':
+            params->rank_by = optarg;
+            break;
+
+        case 'Y':
+            params->summary = optarg;
+            break;
+
+        case 'U':
+        case 'V':
+            errno = 0;
+            v = strtol(optarg, &s, 10);
+            if (errno  ||  s == optarg  ||  *s != '\0'  ||  v <= 0
+                ||  v > INT_MAX) {
+                set_err_msg("argument to --%s must be a positive integer: "
+                    "%s", c == 'U' ? "snps-per-tile" : "traits-per-tile",
+                    optarg);
+                return 0;
+            }
+            if (c == 'U')
+                params->snps_per_tile = v;
+            else
+                params->traits_per_tile = v;
+            break;
+
+        case 'w':
+            params->where = optarg;
+            break;
+
         case ':':
             set_err_msg("missing argument: %s", argv[optind - 1]);
             return 0;
@@ -124,6 +363,21 @@ int parse_command_line_args(int argc, char *argv[],
     p[params->ncolumn] = -9;
     params->ucp2acp = p;
 
+    /* "r3shuffle merge" takes the FILEs of all result sets to merge,
+       "r3shuffle retile" the FILE to rewrite, and "r3shuffle serve"
+       the FILE to answer queries about.  getopt_long has moved all
+       options in front of them. */
+    if (optind < argc  &&  (!strcmp(argv[optind], "merge")
+            ||  !strcmp(argv[optind], "retile")
+            ||  !strcmp(argv[optind], "serve"))) {
+        params->command = !strcmp(argv[optind], "merge") ? COMMAND_MERGE
+            : !strcmp(argv[optind], "retile") ? COMMAND_RETILE
+            : COMMAND_SERVE;
+        params->inputs = argv + optind + 1;
+        params->ninput = argc - optind - 1;
+        return 1;
+    }
+
     /* Get path to layout and data files. */
     if (optind < argc) {
         char *s;
@@ -148,13 +402,64 @@ int parse_command_line_args(int argc, char *argv[],
     return 1;
 }
 
+/* Check the arguments of "r3shuffle merge", "r3shuffle retile" and
+   "r3shuffle serve".  Options that select or format records don't
+   apply.  The result sets are checked when we open them. */
+static int validate_subcommand_args(struct Params *params)
+{
+    const char *command;
+
+    command = params->command == COMMAND_MERGE ? "merge"
+        : params->command == COMMAND_RETILE ? "retile" : "serve";
+    if (params->ninput == 0) {
+        set_err_msg("missing command-line argument: FILE to %s", command);
+        return 0;
+    }
+    if (params->command != COMMAND_MERGE  &&  params->ninput > 1) {
+        set_err_msg("%s takes a single FILE", command);
+        return 0;
+    }
+    if (params->command == COMMAND_SERVE) {
+        if (params->socket_path == NULL
+            ||  params->socket_path[0] == '\0') {
+            set_err_msg("serve requires --socket");
+            return 0;
+        }
+        if (params->output_file != NULL  ||  params->snps_per_tile > 0
+            ||  params->traits_per_tile > 0) {
+            set_err_msg("serve cannot be combined with --output, "
+                "--snps-per-tile or --traits-per-tile");
+            return 0;
+        }
+    } else if (params->output_file == NULL
+        ||  params->output_file[0] == '\0') {
+        set_err_msg("%s requires --output", command);
+        return 0;
+    } else if (params->socket_path != NULL) {
+        set_err_msg("--socket requires serve");
+        return 0;
+    }
+    if (params->manifest != NULL  ||  params->print_columns
+        ||  params->ncolumn > 0  ||  params->where != NULL
+        ||  params->top_k > 0  ||  params->rank_by != NULL
+        ||  params->summary != NULL
+        ||  params->snps_file != NULL  ||  params->traits_file != NULL
+        ||  params->order != ORDER_FILE  ||  params->format != FORMAT_TEXT
+        ||  params->compress != COMPRESS_NONE) {
+        set_err_msg("%s cannot be combined with options that select "
+            "or format records", command);
+        return 0;
+    }
+    return 1;
+}
+
 int validate_command_line_args(struct Params *params)
 {
     FILE *fp;
     const char *file;
     int output_file_exists;
     struct stat buf;
-    int status;
+    int status, i;
 
     /* We arbitrarily require that the number of significant digits be
        between 0 and 99 inclusive. */
@@ -162,11 +467,108 @@ int validate_command_line_args(struct Params *params)
         set_err_msg("argument to --digits must be <100");
         return 0;
     }
-    if (params->ndigit < 0) {
+    if (params->ndigit < 0
+        &&  params->ndigit != FORMAT_DOUBLE_SHORTEST) {
         set_err_msg("argument to --digits must be >=0");
         return 0;
     }
 
+    /* More threads than this would only add overhead. */
+    if (params->nthread < 1  ||  params->nthread > MAX_THREADS) {
+        set_err_msg("argument to --threads must be between 1 and %d",
+            MAX_THREADS);
+        return 0;
+    }
+
+    if (params->queue_depth < 1  ||  params->queue_depth > MAX_QUEUE_DEPTH) {
+        set_err_msg("argument to --queue-depth must be between 1 and %d",
+            MAX_QUEUE_DEPTH);
+        return 0;
+    }
+
+    /* We need room for at least one record. */
+    if (params->max_memory == 0) {
+        set_err_msg("argument to --max-memory must be positive");
+        return 0;
+    }
+
+    /* Arrow output is written tile by tile in file order. */
+    if (params->format == FORMAT_ARROW  &&  params->order != ORDER_FILE) {
+        set_err_msg("--format=arrow requires --order=file");
+        return 0;
+    }
+    if (params->format == FORMAT_ARROW
+        &&  (params->snps_file != NULL  ||  params->traits_file != NULL)) {
+        set_err_msg("--format=arrow cannot be combined with --snps-file "
+            "or --traits-file");
+        return 0;
+    }
+
+    /* Only text output is compressed. */
+    if (params->compress == COMPRESS_BGZF  &&  params->format != FORMAT_TEXT) {
+        set_err_msg("--compress=bgzf requires --format=text");
+        return 0;
+    }
+
+    /* --top-k writes the records that rank highest for every trait,
+       trait by trait, as text. */
+    if ((params->top_k > 0) != (params->rank_by != NULL)) {
+        set_err_msg("--top-k and --rank-by must be given together");
+        return 0;
+    }
+    if (params->top_k > 0  &&  (params->order != ORDER_FILE
+            ||  params->format != FORMAT_TEXT
+            ||  params->compress != COMPRESS_NONE
+            ||  params->snps_file != NULL  ||  params->traits_file != NULL)) {
+        set_err_msg("--top-k cannot be combined with --order, --format, "
+            "--compress, --snps-file or --traits-file");
+        return 0;
+    }
+
+    /* --summary writes a table of statistics per trait instead of
+       records. */
+    if (params->summary != NULL  &&  (params->top_k > 0
+            ||  params->ncolumn > 0  ||  params->order != ORDER_FILE
+            ||  params->format != FORMAT_TEXT
+            ||  params->compress != COMPRESS_NONE
+            ||  params->snps_file != NULL  ||  params->traits_file != NULL)) {
+        set_err_msg("--summary cannot be combined with --top-k, --column, "
+            "--order, --format, --compress, --snps-file or --traits-file");
+        return 0;
+    }
+
+    /* A merge writes a result set of its own, binary to binary, and
+       serve writes no file at all. */
+    if (params->command != COMMAND_CONVERT)
+        return validate_subcommand_args(params);
+    if (params->snps_per_tile > 0  ||  params->traits_per_tile > 0) {
+        set_err_msg("--snps-per-tile and --traits-per-tile require merge "
+            "or retile");
+        return 0;
+    }
+    if (params->socket_path != NULL) {
+        set_err_msg("--socket requires serve");
+        return 0;
+    }
+
+    /* With --manifest, the output file holds the text of all result
+       sets, one after another under a single header. */
+    if (params->manifest != NULL  &&  params->layout_file != NULL) {
+        set_err_msg("--manifest cannot be combined with a FILE argument");
+        return 0;
+    }
+    if (params->manifest != NULL  &&  params->print_columns) {
+        set_err_msg("--manifest cannot be combined with --print-columns");
+        return 0;
+    }
+    if (params->manifest != NULL  &&  params->output_file != NULL
+        &&  (params->format != FORMAT_TEXT
+            ||  params->compress != COMPRESS_NONE)) {
+        set_err_msg("--manifest with --output requires --format=text "
+            "and --compress=none");
+        return 0;
+    }
+
     /* Check that output file is writable. */
     if ((file = params->output_file) != NULL) {
 
@@ -253,28 +655,43 @@ int validate_command_line_args(struct Params *params)
         }
     }
 
-    /* Check that layout and data file are readable. */
-    if (params->layout_file == NULL  ||  params->data_file == NULL) {
+    /* Check that the manifest or layout and data file are readable.
+       The files listed in the manifest are checked when we get to
+       them. */
+    if (params->manifest == NULL
+        &&  (params->layout_file == NULL  ||  params->data_file == NULL)) {
         set_err_msg("missing command-line argument: FILE");
         return 0;
     }
-    file = params->layout_file;
-    if ((fp = fopen(file, "rb")) == NULL) {
-        set_err_msg("failed to open file for reading: %s", file);
-        return 0;
-    }
-    if (fclose(fp)) {
-        set_err_msg("failed to close file: %s\n", file);
-        return 0;
-    }
-    file = params->data_file;
-    if ((fp = fopen(file, "rb")) == NULL) {
-        set_err_msg("failed to open file for reading: %s", file);
-        return 0;
+    for (i = 0; i < 2; i++) {
+        if (params->manifest != NULL)
+            file = i ? NULL : params->manifest;
+        else
+            file = i ? params->data_file : params->layout_file;
+        if (file == NULL)
+            continue;
+        if ((fp = fopen(file, "rb")) == NULL) {
+            set_err_msg("failed to open file for reading: %s", file);
+            return 0;
+        }
+        if (fclose(fp)) {
+            set_err_msg("failed to close file: %s\n", file);
+            return 0;
+        }
     }
-    if (fclose(fp)) {
-        set_err_msg("failed to close file: %s\n", file);
-        return 0;
+
+    /* Check that label files are readable. */
+    for (i = 0; i < 2; i++) {
+        if ((file = i ? params->traits_file : params->snps_file) == NULL)
+            continue;
+        if ((fp = fopen(file, "r")) == NULL) {
+            set_err_msg("failed to open file for reading: %s", file);
+            return 0;
+        }
+        if (fclose(fp)) {
+            set_err_msg("failed to close file: %s\n", file);
+            return 0;
+        }
     }
 
     return 1;
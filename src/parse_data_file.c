@@ -1,9 +1,27 @@
 #include "parse_data_file.h"
 #include "parse_layout_file.h"
 #include "err_msg.h"
+#include "MappedFile.h"
+#include "Stream.h"
+#include "Lookup.h"
+#include "LabelPool.h"
+#include "format_double.h"
+#include "run_ordered.h"
+#include "read_block.h"
+#include "label_index.h"
+#include "Filter.h"
+#include "ArrowWriter.h"
+#include "Bgzf.h"
+#include "result_index.h"
+#include "TopK.h"
+#include "trait_summary.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <assert.h>
+#include <math.h>
 
 /* The binary data file contains the estimates that result from
    regressing ntrait traits on nsnp snps.  We can imagine all the
@@ -138,11 +156,14 @@
           Figure 3. Mapping offset 47 to trait 4 and snp 5. */
 
 
-/* Map an offset to a snp index and a trait index. */
+/* Map an offset to a snp index and a trait index.  Data files can
+   hold more than 2^32 records, so all counts of records are unsigned
+   long, which validate_layout makes sure is wide enough. */
 void offset2index(unsigned long offset, int *snp, int *trait,
     struct Layout *layout)
 {
-    int elts_per_tile_row, elts_per_tile, snps_in_this_tile;
+    unsigned long elts_per_tile_row, elts_per_tile;
+    int snps_in_this_tile;
     int tile_row, tile_col, row_within_tile, col_within_tile;
     int snps_per_tile, traits_per_tile, nsnp, ntrait;
     unsigned long x;
@@ -164,7 +185,7 @@ void offset2index(unsigned long offset, int *snp, int *trait,
        irrelevant for finding the tile row.)  After finding the tile
        row we update the offset such that it becomes a valid offset
        into the tile row. */
-    elts_per_tile_row = nsnp * traits_per_tile;
+    elts_per_tile_row = (unsigned long) nsnp * traits_per_tile;
     tile_row = x / elts_per_tile_row;
     x %= elts_per_tile_row;
 
@@ -185,9 +206,9 @@ void offset2index(unsigned long offset, int *snp, int *trait,
        becomes a valid offset into the tile determine by tile row and
        tile column. */
     if (traits_per_tile <= ntrait - tile_row * traits_per_tile)
-        elts_per_tile = snps_per_tile * traits_per_tile;
+        elts_per_tile = (unsigned long) snps_per_tile * traits_per_tile;
     else
-        elts_per_tile = snps_per_tile
+        elts_per_tile = (unsigned long) snps_per_tile
             * (ntrait - tile_row * traits_per_tile);
     tile_col = x / elts_per_tile;
     x %= elts_per_tile;
@@ -263,22 +284,23 @@ void index2offset(int snp, int trait, unsigned long *offset,
     x = 0;
 
     /* Advance offset until just after tile row tile_row. */
-    x += tile_row * nsnp * traits_per_tile;
+    x += (unsigned long) tile_row * nsnp * traits_per_tile;
 
     /* Advance offset until just after tile column tile_col.  For an
        explanation of the if-condition see offset2index. */
     if (traits_per_tile <= ntrait - tile_row * traits_per_tile)
-        x += tile_col * snps_per_tile * traits_per_tile;
+        x += (unsigned long) tile_col * snps_per_tile * traits_per_tile;
     else
-        x += tile_col * snps_per_tile
+        x += (unsigned long) tile_col * snps_per_tile
             * (ntrait - tile_row * traits_per_tile);
 
     /* Advance offset until just after row row_within_tile.  For an
        explanation of the if-condition see offset2index. */
     if (snps_per_tile <= nsnp - tile_col * snps_per_tile)
-        x += row_within_tile * snps_per_tile;
+        x += (unsigned long) row_within_tile * snps_per_tile;
     else
-        x += row_within_tile * (nsnp - tile_col * snps_per_tile);
+        x += (unsigned long) row_within_tile
+            * (nsnp - tile_col * snps_per_tile);
 
     /* Advance offset until just after column col_within_tile. */
     x += col_within_tile;
@@ -286,105 +308,2199 @@ void index2offset(int snp, int trait, unsigned long *offset,
     *offset = x;
 }
 
-int parse_data_file(struct Params *params, struct Layout *layout)
+/* Scanning the data file in file order with offset2index would cost
+   three divisions per record just to find out where we already are.
+   A tile cursor instead moves from one record to the next like an
+   odometer: first along a row of the tile, then to the next row of
+   the tile, then to the next tile of the tile row, and finally to the
+   first tile of the next tile row.  The undersized tiles at the right
+   and bottom margins simply have smaller bounds. */
+
+/* Set up c at the record at the given offset. */
+void init_tile_cursor(struct TileCursor *c, struct Layout *layout,
+    unsigned long offset)
+{
+    c->layout = layout;
+    c->offset = offset;
+    offset2index(offset, &c->snp, &c->trait, layout);
+    c->snp0 = c->snp - c->snp % layout->snps_per_tile;
+    c->snp1 = layout->nsnp - c->snp0 < layout->snps_per_tile
+        ? layout->nsnp : c->snp0 + layout->snps_per_tile;
+    c->trait0 = c->trait - c->trait % layout->traits_per_tile;
+    c->trait1 = layout->ntrait - c->trait0 < layout->traits_per_tile
+        ? layout->ntrait : c->trait0 + layout->traits_per_tile;
+}
+
+/* Move c on to the record at the next offset. */
+void next_tile_cursor(struct TileCursor *c)
+{
+    struct Layout *layout;
+
+    c->offset++;
+    if (++c->snp < c->snp1)
+        return;
+    c->snp = c->snp0;
+    if (++c->trait < c->trait1)
+        return;
+
+    layout = c->layout;
+    c->trait = c->trait0;
+    if (c->snp1 < layout->nsnp) {
+        c->snp = c->snp0 = c->snp1;
+        c->snp1 = layout->nsnp - c->snp0 < layout->snps_per_tile
+            ? layout->nsnp : c->snp0 + layout->snps_per_tile;
+        return;
+    }
+
+    c->snp = c->snp0 = 0;
+    c->snp1 = layout->nsnp < layout->snps_per_tile
+        ? layout->nsnp : layout->snps_per_tile;
+    c->trait = c->trait0 = c->trait1;
+    c->trait1 = layout->ntrait - c->trait0 < layout->traits_per_tile
+        ? layout->ntrait : c->trait0 + layout->traits_per_tile;
+}
+
+/* Every worker formats lines with labels from its own pools of the
+   labels of the current snp tile and trait tile (see LabelPool.c). */
+struct Labels {
+    struct Layout *layout;
+    LabelPool snps;
+    LabelPool traits;
+};
+
+/* Output is collected in a buffer and handed to fwrite(3) in large
+   blocks.  Lines are formatted directly into the buffer, so we flush
+   the buffer whenever it has less than max_line bytes left. */
+struct Output {
+    FILE *fp;                   /* output file */
+    const char *file;           /* name of output file */
+    char *buf;                  /* pending output */
+    size_t len;                 /* number of pending bytes */
+    size_t size;                /* capacity of buf */
+    size_t max_line;            /* maximum length of an output line */
+    unsigned long long bytes_read;  /* bytes read from data file */
+    unsigned long long nread;   /* number of reads from data file */
+    struct Labels *labels;      /* label pools of every worker */
+    int nlabels;                /* number of label pools */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+enum { OUTPUT_BUFFER_SIZE = 1 << 16 };
+
+static void free_labels(struct Output *out)
+{
+    int i;
+
+    for (i = 0; i < out->nlabels; i++) {
+        if (out->labels[i].snps != NULL)
+            LabelPool_Destroy(out->labels[i].snps);
+        if (out->labels[i].traits != NULL)
+            LabelPool_Destroy(out->labels[i].traits);
+    }
+    free(out->labels);
+    out->labels = NULL;
+    out->nlabels = 0;
+}
+
+/* Create label pools for n workers. */
+static int init_labels(struct Output *out, struct Layout *layout, int n)
 {
-    FILE *ifp, *ofp;
-    int nrecord;      /* number of result records in data file */
-    int nrec;         /* number of records read so far */
-    int ncolumn;      /* number of columns in regression results */
-    size_t nbytes;    /* number of bytes used by regression results */
-    char *buf;        /* buffer to hold regression result bytes */
-    double *v;        /* buffer to hold actual regression results */
-    int snp;          /* index of snp in current trait-snp pair */
-    int trait;        /* index of trait in current trait-snp pair */
     int i;
 
-    if ((ifp = fopen(params->data_file, "rb")) == NULL) {
-        set_err_msg("failed to open file for reading: %s",
+    out->nlabels = 0;
+    if ((out->labels = (struct Labels *) malloc(n * sizeof(struct Labels)))
+        == NULL) {
+        set_err_msg("failed to allocate memory for %d threads", n);
+        return 0;
+    }
+    for (i = 0; i < n; i++) {
+        out->nlabels++;
+        out->labels[i].layout = layout;
+        out->labels[i].traits = NULL;
+        if ((out->labels[i].snps = LabelPool_Create(layout, snp_label,
+                    layout->nsnp, layout->snps_per_tile)) == NULL
+            ||  (out->labels[i].traits = LabelPool_Create(layout,
+                    trait_label, layout->ntrait,
+                    layout->traits_per_tile)) == NULL) {
+            free_labels(out);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int flush_output(struct Output *out)
+{
+    double t;
+
+    if (out->len == 0)
+        return 1;
+    t = Stats_Start(out->stats);
+    if (fwrite(out->buf, out->len, 1, out->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", out->file);
+        return 0;
+    }
+    Stats_Stop(out->stats, STATS_WRITE, t);
+    Stats_AddWrites(out->stats, out->len, 1);
+    out->len = 0;
+    return 1;
+}
+
+/* Make sure there is room for at least one more line. */
+static int reserve_line(struct Output *out)
+{
+    if (out->len + out->max_line > out->size)
+        return flush_output(out);
+    return 1;
+}
+
+/* Make sure there is room for n <= FILTER_BATCH more lines. */
+static int reserve_lines(struct Output *out, unsigned long n)
+{
+    if (out->len + n * out->max_line > out->size)
+        return flush_output(out);
+    return 1;
+}
+
+/* Format the labels of the given trait-snp pair into s.  Return a
+   pointer just past the trait label. */
+static char *format_labels(char *s, struct Labels *lab, int snp,
+    int trait)
+{
+    const char *label;
+    size_t n;
+
+    label = LabelPool_Get(lab->snps, snp, &n);
+    memcpy(s, label, n);
+    s += n;
+    *s++ = ' ';
+    label = LabelPool_Get(lab->traits, trait, &n);
+    memcpy(s, label, n);
+    return s + n;
+}
+
+/* Format the labels and the selected regression results of the given
+   trait-snp pair into s.  The regression results are passed as a
+   pointer to the first of the record's doubles.  Return a pointer
+   just past the end of the line. */
+static char *format_record(char *s, struct Params *params,
+    struct Labels *lab, int snp, int trait, const double *v)
+{
+    int i;
+
+    s = format_labels(s, lab, snp, trait);
+    for (i = 0; i < params->ncolumn; i++) {
+        *s++ = ' ';
+        s = format_double(s, v[params->ucp2acp[i]], params->ndigit);
+    }
+    *s++ = '\n';
+
+    return s;
+}
+
+/* With --where, records are collected in batches of FILTER_BATCH
+   records and the filter is applied to a whole batch at once.  Only
+   records that pass the filter are formatted.  The records of a batch
+   must stay in place until the batch is flushed. */
+struct Pending {
+    int n;                      /* number of records in batch */
+    int snp[FILTER_BATCH];
+    int trait[FILTER_BATCH];
+    const double *v[FILTER_BATCH];
+};
+
+static char *flush_pending(char *s, struct Params *params,
+    struct Labels *lab, struct Pending *q)
+{
+    unsigned char keep[FILTER_BATCH];
+    int k;
+
+    if (q->n > 0  &&  Filter_Apply(params->filter, q->n, q->v, keep))
+        for (k = 0; k < q->n; k++)
+            if (keep[k])
+                s = format_record(s, params, lab, q->snp[k],
+                    q->trait[k], q->v[k]);
+    q->n = 0;
+
+    return s;
+}
+
+/* Format a record into s unless it is filtered out, possibly later,
+   when the batch is complete. */
+static char *add_record(char *s, struct Params *params,
+    struct Labels *lab, struct Pending *q, int snp, int trait,
+    const double *v)
+{
+    if (params->filter == NULL)
+        return format_record(s, params, lab, snp, trait, v);
+
+    q->snp[q->n] = snp;
+    q->trait[q->n] = trait;
+    q->v[q->n] = v;
+    if (++q->n == FILTER_BATCH)
+        s = flush_pending(s, params, lab, q);
+    return s;
+}
+
+/* Format the n consecutive records that start at the cursor c and
+   whose regression results start at p.  Leave c after the last of
+   them. */
+static char *format_records(char *s, struct Params *params,
+    struct Labels *lab, struct TileCursor *c, unsigned long n,
+    const char *p, size_t nbytes)
+{
+    struct Pending q;
+
+    q.n = 0;
+    for (; n > 0; n--, p += nbytes) {
+        s = add_record(s, params, lab, &q, c->snp, c->trait,
+            (const double *) p);
+        next_tile_cursor(c);
+    }
+    return flush_pending(s, params, lab, &q);
+}
+
+static void print_records(struct Output *out, struct Params *params,
+    struct TileCursor *c, unsigned long n, const char *p, size_t nbytes)
+{
+    double t;
+
+    t = Stats_Start(out->stats);
+    out->len = format_records(out->buf + out->len, params, out->labels,
+        c, n, p, nbytes) - out->buf;
+    Stats_Stop(out->stats, STATS_FORMAT, t);
+    Stats_AddRecords(out->stats, n);
+}
+
+/* Add the reads of src to the I/O statistics. */
+static void count_reads(struct Output *out, struct RecordSource *src)
+{
+    out->bytes_read += src->bytes_read;
+    out->nread += src->nread;
+}
+
+/* Check that a mapped data file holds all records. */
+static int check_mapped_size(struct Params *params, MappedFile mf,
+    unsigned long nrecord, size_t nbytes)
+{
+    if (MappedFile_Size(mf) < nrecord * nbytes) {
+        set_err_msg("data file too short: expected %lu bytes, got %lu: "
+            "%s", nrecord * nbytes, (unsigned long) MappedFile_Size(mf),
             params->data_file);
-        goto RETURN_ZERO;
+        return 0;
     }
+    return 1;
+}
 
-    if (params->output_file == NULL)
-        ofp = stdout;
-    else if ((ofp = fopen(params->output_file, "wb")) == NULL) {
-        set_err_msg("failed to open file for writing: %s",
-            params->output_file);
-        goto CLOSE_DATA_FILE;
+/* Data files are typically hundreds of gigabytes large.  Reading them
+   record by record with fread(3) costs one library call plus one copy
+   per record.  Whenever possible we therefore map the data file into
+   memory and hand out pointers straight into the mapping.  Pipes and
+   files on filesystems that don't support mmap(2) cannot be mapped.
+   For those we fall back to a Stream, which reads the data file in
+   chunks of about STREAM_CHUNK_BYTES on a separate thread while we
+   format the previous chunk.  We also read regular files with
+   pread(2) through a record source if we skip the pages of unused
+   columns. */
+static int print_source_records(struct Output *out,
+    struct Params *params, const struct RecordSource *proto,
+    unsigned long nrecord)
+{
+    struct RecordSource src;
+    struct TileCursor c;
+    const char *p;
+    unsigned long nrec, n;
+    double t;
+    int status;
+
+    src = *proto;
+    init_tile_cursor(&c, out->labels->layout, 0);
+    status = 1;
+    for (nrec = 0; status  &&  nrec < nrecord; nrec += n) {
+        n = nrecord - nrec < FILTER_BATCH ? nrecord - nrec : FILTER_BATCH;
+        t = Stats_Start(out->stats);
+        status = read_records(&src, nrec, n, &p)
+            &&  decode_records(&src, n, &p);
+        Stats_Stop(out->stats, STATS_READ, t);
+        if (status  &&  (status = reserve_lines(out, n)))
+            print_records(out, params, &c, n, p, src.record_size);
+    }
+    count_reads(out, &src);
+    free_record_source(&src);
+
+    return status;
+}
+
+/* Number of bytes per read from a data file that we read
+   sequentially.  See bench/bench_stream.c. */
+enum { STREAM_CHUNK_BYTES = 1 << 20 };
+
+/* Open a data file for sequential reads.  Chunks hold a multiple of
+   FILTER_BATCH records, so that batches never straddle two chunks. */
+static Stream open_data_stream(const char *file, size_t nbytes)
+{
+    Stream st;
+    unsigned long n;
+
+    if ((st = Stream_Create(file)) == NULL)
+        return NULL;
+    n = STREAM_CHUNK_BYTES / nbytes / FILTER_BATCH * FILTER_BATCH;
+    Stream_SetRecordSize(st, nbytes);
+    Stream_SetChunkSize(st, n > FILTER_BATCH ? n : FILTER_BATCH);
+    return st;
+}
+
+/* Close a data stream after adding its reads to the I/O statistics.
+   Pass on status, unless closing fails. */
+static int close_data_stream(struct Output *out, Stream st, int status)
+{
+    out->bytes_read += Stream_BytesRead(st);
+    out->nread += Stream_Reads(st);
+    if (!status) {
+        Stream_Close(st);
+        return 0;
+    }
+    return Stream_Close(st);
+}
+
+static int print_streamed_records(struct Output *out,
+    struct Params *params, const struct RecordSource *proto,
+    unsigned long nrecord)
+{
+    struct RecordSource src;
+    Stream st;
+    struct TileCursor c;
+    const char *p;
+    unsigned long nrec, n;
+    double t;
+    int status;
+
+    if ((st = open_data_stream(params->data_file, proto->nbytes)) == NULL)
+        return 0;
+    init_tile_cursor(&c, out->labels->layout, 0);
+
+    src = *proto;
+    status = 1;
+    for (nrec = 0; status  &&  nrec < nrecord; nrec += n) {
+        n = nrecord - nrec < FILTER_BATCH ? nrecord - nrec : FILTER_BATCH;
+        t = Stats_Start(out->stats);
+        status = Stream_Read(st, n, &p)  &&  decode_records(&src, n, &p);
+        Stats_Stop(out->stats, STATS_READ, t);
+        if (status  &&  (status = reserve_lines(out, n)))
+            print_records(out, params, &c, n, p, src.record_size);
+    }
+    free_record_source(&src);
+
+    return close_data_stream(out, st, status);
+}
+
+/* With --threads=N, worker threads convert independent parts of the
+   data file into private buffers, which the calling thread writes to
+   the output file in file order.  The output is therefore identical to
+   that of a single-threaded run.  The parts (units) are the tiles in
+   file order, where tiles with more than max_unit records are cut into
+   slices of about equal size.  Since workers pick up the next unit as
+   soon as they are done with the previous one, the smaller tiles at
+   the bottom and right margins don't leave threads idle. */
+struct Convert {
+    struct Params *params;
+    FILE *fp;                   /* output file */
+    const char *file;           /* name of output file */
+    size_t nbytes;              /* number of bytes per decoded record */
+    size_t max_line;            /* maximum length of an output line */
+    unsigned long *start;       /* first record of every unit */
+    unsigned long nunit;        /* number of units */
+    struct RecordSource *src;   /* per-worker data file readers */
+    struct Labels *labels;      /* per-worker label pools */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+/* Output of a unit should fit into about this many bytes. */
+enum { UNIT_BUFFER_SIZE = 1 << 20 };
+
+/* Cut the data file into units of at most max_unit records.  Store
+   the first record of every unit in (*start)[0] to (*start)[nunit - 1]
+   and the total number of records in (*start)[nunit].  Return the
+   number of units or 0 on failure. */
+static unsigned long make_units(struct Layout *layout,
+    unsigned long max_unit, unsigned long **start)
+{
+    unsigned long n, size, offset, nslice, k, *p;
+    int pass, row, col, nrow, ncol;
+
+    p = NULL;
+    for (pass = 0; pass < 2; pass++) {
+        n = 0;
+        offset = 0;
+        for (row = 0; row < layout->ntrait; row += nrow) {
+            nrow = layout->ntrait - row < layout->traits_per_tile
+                ? layout->ntrait - row : layout->traits_per_tile;
+            for (col = 0; col < layout->nsnp; col += ncol) {
+                ncol = layout->nsnp - col < layout->snps_per_tile
+                    ? layout->nsnp - col : layout->snps_per_tile;
+                size = (unsigned long) nrow * ncol;
+                nslice = (size + max_unit - 1) / max_unit;
+                for (k = 0; k < nslice; k++, n++)
+                    if (p != NULL)
+                        p[n] = offset + k * size / nslice;
+                offset += size;
+            }
+        }
+        if (p != NULL)
+            p[n] = offset;
+        else if ((p = (unsigned long *) malloc((n + 1)
+                    * sizeof(unsigned long))) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) ((n + 1) * sizeof(unsigned long)));
+            return 0;
+        }
+    }
+
+    *start = p;
+    return n;
+}
+
+static int convert_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Convert *c = (struct Convert *) arg;
+    struct TileCursor cur;
+    unsigned long b, e;
+    const char *p;
+    char *t;
+    size_t n;
+    double start;
+
+    b = c->start[unit];
+    e = c->start[unit + 1];
+
+    n = (e - b) * c->max_line;
+    if (chunk->size < n) {
+        if ((t = (char *) realloc(chunk->data, n)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+            return 0;
+        }
+        chunk->data = t;
+        chunk->size = n;
+    }
+
+    start = Stats_Start(c->stats);
+    if (!read_records(&c->src[worker], b, e - b, &p)
+        ||  !decode_records(&c->src[worker], e - b, &p))
+        return 0;
+    Stats_Stop(c->stats, STATS_READ, start);
+
+    start = Stats_Start(c->stats);
+    init_tile_cursor(&cur, c->labels[worker].layout, b);
+    chunk->len = format_records(chunk->data, c->params,
+        &c->labels[worker], &cur, e - b, p, c->nbytes) - chunk->data;
+    Stats_Stop(c->stats, STATS_FORMAT, start);
+
+    return 1;
+}
+
+static int write_unit(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    struct Convert *c = (struct Convert *) arg;
+    double t;
+
+    t = Stats_Start(c->stats);
+    if (chunk->len  &&  fwrite(chunk->data, chunk->len, 1, c->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", c->file);
+        return 0;
+    }
+    Stats_Stop(c->stats, STATS_WRITE, t);
+    Stats_AddWrites(c->stats, chunk->len, 1);
+    Stats_AddRecords(c->stats, c->start[unit + 1] - c->start[unit]);
+    return 1;
+}
+
+static int print_records_in_parallel(struct Output *out,
+    struct Params *params, struct Layout *layout,
+    const struct RecordSource *proto)
+{
+    struct Convert c;
+    unsigned long max_unit;
+    int i, status;
+
+    c.params = params;
+    c.fp = out->fp;
+    c.file = out->file;
+    c.nbytes = proto->record_size;
+    c.max_line = out->max_line;
+    c.labels = out->labels;
+    c.stats = out->stats;
+
+    max_unit = UNIT_BUFFER_SIZE / out->max_line;
+    if (max_unit == 0)
+        max_unit = 1;
+    if ((c.nunit = make_units(layout, max_unit, &c.start)) == 0)
+        return 0;
+
+    status = 0;
+    if ((c.src = (struct RecordSource *) malloc(params->nthread
+                * sizeof(struct RecordSource))) == NULL) {
+        set_err_msg("failed to allocate memory for %d threads",
+            params->nthread);
+        goto FREE_UNITS;
+    }
+    for (i = 0; i < params->nthread; i++)
+        c.src[i] = *proto;
+
+    status = run_ordered(params->nthread, c.nunit, convert_unit,
+        write_unit, &c);
+
+    for (i = 0; i < params->nthread; i++) {
+        count_reads(out, &c.src[i]);
+        free_record_source(&c.src[i]);
+    }
+    free(c.src);
+FREE_UNITS:
+    free(c.start);
+    return status;
+}
+
+/* With --order=trait or --order=snp, records must be written grouped
+   by trait or by snp.  In the data file, however, the records of a
+   trait are spread over all tiles of a tile row and the records of a
+   snp over all tiles of a tile column.  Seeking to every record with
+   index2offset would turn the conversion into one small random read
+   per record.  Instead we read whole blocks of the trait-snp matrix
+   with read_block, which reads large contiguous ranges in file order,
+   and transpose them in memory.  The block size is bounded by
+   --max-memory.
+
+   With --order=trait a block holds as many complete traits as fit
+   into max_memory, preferably whole tile rows.  If not even a single
+   trait fits, a block holds as many snps of a single trait as fit.
+   With --order=snp a block holds as many complete snps as fit,
+   preferably whole tile columns, or else as many traits of a single
+   snp as fit. */
+struct Blocks {
+    int order;                  /* ORDER_TRAIT or ORDER_SNP */
+    int bt;                     /* traits per block */
+    int bs;                     /* snps per block */
+    int trait0, trait1;         /* traits of current block */
+    int snp0, snp1;             /* snps of current block */
+    char *buf;                  /* records of current block */
+    const char *rec;            /* decoded records of current block */
+};
+
+/* Return how many items of nbytes bytes each fit into max_memory,
+   rounded down to a multiple of per_tile if that's possible, but no
+   more than nitem. */
+static int fit_items(unsigned long max_memory, unsigned long nbytes,
+    int per_tile, int nitem)
+{
+    unsigned long n;
+
+    n = max_memory / nbytes;
+    if (n >= (unsigned long) per_tile)
+        n -= n % per_tile;
+    if (n > (unsigned long) nitem)
+        n = nitem;
+    return n > 0 ? (int) n : 1;
+}
+
+static void size_blocks(struct Blocks *b, struct Params *params,
+    struct Layout *layout, size_t nbytes)
+{
+    unsigned long trait_bytes, snp_bytes;
+
+    trait_bytes = (unsigned long) layout->nsnp * nbytes;
+    snp_bytes = (unsigned long) layout->ntrait * nbytes;
+
+    b->order = params->order;
+    if (b->order == ORDER_TRAIT  &&  trait_bytes <= params->max_memory) {
+        b->bt = fit_items(params->max_memory, trait_bytes,
+            layout->traits_per_tile, layout->ntrait);
+        b->bs = layout->nsnp;
+    }
+    else if (b->order == ORDER_TRAIT) {
+        b->bt = 1;
+        b->bs = fit_items(params->max_memory, nbytes,
+            layout->snps_per_tile, layout->nsnp);
+    }
+    else if (snp_bytes <= params->max_memory) {
+        b->bt = layout->ntrait;
+        b->bs = fit_items(params->max_memory, snp_bytes,
+            layout->snps_per_tile, layout->nsnp);
+    }
+    else {
+        b->bt = fit_items(params->max_memory, nbytes,
+            layout->traits_per_tile, layout->ntrait);
+        b->bs = 1;
+    }
+}
+
+/* Advance to the next block.  Return 0 after the last block. */
+static int next_block(struct Blocks *b, struct Layout *layout)
+{
+    if (b->trait1 == 0) {
+        b->trait0 = b->snp0 = 0;
+    }
+    else if (b->order == ORDER_TRAIT) {
+        if ((b->snp0 = b->snp1) == layout->nsnp) {
+            b->snp0 = 0;
+            if ((b->trait0 = b->trait1) == layout->ntrait)
+                return 0;
+        }
+    }
+    else if ((b->trait0 = b->trait1) == layout->ntrait) {
+        b->trait0 = 0;
+        if ((b->snp0 = b->snp1) == layout->nsnp)
+            return 0;
+    }
+    b->trait1 = layout->ntrait - b->trait0 < b->bt
+        ? layout->ntrait : b->trait0 + b->bt;
+    b->snp1 = layout->nsnp - b->snp0 < b->bs
+        ? layout->nsnp : b->snp0 + b->bs;
+    return 1;
+}
+
+/* Format lines first to last - 1 of the current block into s, where
+   lines are numbered in output order.  Return a pointer just past the
+   end of the last line. */
+static char *format_block(char *s, struct Params *params,
+    struct Labels *lab, struct Blocks *b, size_t nbytes,
+    unsigned long first, unsigned long last)
+{
+    struct Pending q;
+    unsigned long k, width, height;
+    int snp, trait;
+
+    q.n = 0;
+    width = b->snp1 - b->snp0;
+    height = b->trait1 - b->trait0;
+
+    if (b->order == ORDER_TRAIT) {
+        /* Lines come in the order of records in the block. */
+        trait = b->trait0 + first / width;
+        snp = b->snp0 + first % width;
+        for (k = first; k < last; k++) {
+            s = add_record(s, params, lab, &q, snp, trait,
+                (const double *) (b->rec + k * nbytes));
+            if (++snp == b->snp1) {
+                snp = b->snp0;
+                trait++;
+            }
+        }
+    }
+    else {
+        snp = b->snp0 + first / height;
+        trait = b->trait0 + first % height;
+        for (k = first; k < last; k++) {
+            s = add_record(s, params, lab, &q, snp, trait,
+                (const double *) (b->rec + ((trait - b->trait0) * width
+                        + (snp - b->snp0)) * nbytes));
+            if (++trait == b->trait1) {
+                trait = b->trait0;
+                snp++;
+            }
+        }
+    }
+
+    return flush_pending(s, params, lab, &q);
+}
+
+/* Both blocks and selections (see below) are written by formatting
+   lines first to last - 1 of the current block or batch, where lines
+   are numbered in output order.  With --threads=N, worker threads
+   format units of at most max_unit lines. */
+struct Lines {
+    struct Params *params;
+    FILE *fp;                   /* output file */
+    const char *file;           /* name of output file */
+    size_t nbytes;              /* number of bytes per decoded record */
+    size_t max_line;            /* maximum length of an output line */
+    unsigned long max_unit;     /* maximum number of lines per unit */
+    unsigned long nline;        /* number of lines */
+    char *(*format)(char *s, struct Lines *x, struct Labels *lab,
+        unsigned long first, unsigned long last);
+    struct Labels *labels;      /* per-worker label pools */
+    struct Blocks *blocks;      /* current block */
+    struct Batch *batch;        /* current batch of selected records */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+static void init_lines(struct Lines *x, struct Output *out,
+    struct Params *params, size_t nbytes)
+{
+    x->params = params;
+    x->fp = out->fp;
+    x->file = out->file;
+    x->nbytes = nbytes;
+    x->max_line = out->max_line;
+    x->labels = out->labels;
+    x->stats = out->stats;
+    x->max_unit = UNIT_BUFFER_SIZE / out->max_line;
+    if (x->max_unit == 0)
+        x->max_unit = 1;
+    x->blocks = NULL;
+    x->batch = NULL;
+}
+
+static int format_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Lines *x = (struct Lines *) arg;
+    unsigned long first, last;
+    char *t;
+    size_t n;
+    double start;
+
+    first = unit * x->max_unit;
+    last = first + x->max_unit < x->nline ? first + x->max_unit
+        : x->nline;
+
+    n = (last - first) * x->max_line;
+    if (chunk->size < n) {
+        if ((t = (char *) realloc(chunk->data, n)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+            return 0;
+        }
+        chunk->data = t;
+        chunk->size = n;
+    }
+
+    start = Stats_Start(x->stats);
+    chunk->len = x->format(chunk->data, x, &x->labels[worker], first, last)
+        - chunk->data;
+    Stats_Stop(x->stats, STATS_FORMAT, start);
+
+    return 1;
+}
+
+static int write_formatted(void *arg, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Lines *x = (struct Lines *) arg;
+    unsigned long first, last;
+    double t;
+
+    t = Stats_Start(x->stats);
+    if (chunk->len  &&  fwrite(chunk->data, chunk->len, 1, x->fp) != 1) {
+        set_err_msg("failed to write to output file: %s", x->file);
+        return 0;
+    }
+    Stats_Stop(x->stats, STATS_WRITE, t);
+    Stats_AddWrites(x->stats, chunk->len, 1);
+    first = unit * x->max_unit;
+    last = first + x->max_unit < x->nline ? first + x->max_unit
+        : x->nline;
+    Stats_AddRecords(x->stats, last - first);
+    return 1;
+}
+
+/* Write all x->nline lines. */
+static int print_lines(struct Output *out, struct Lines *x)
+{
+    unsigned long first, last;
+    double t;
+
+    if (x->params->nthread > 1)
+        return flush_output(out)  &&  run_ordered(x->params->nthread,
+            (x->nline + x->max_unit - 1) / x->max_unit, format_unit,
+            write_formatted, x);
+
+    for (first = 0; first < x->nline; first = last) {
+        if (!reserve_line(out))
+            return 0;
+        last = first + (out->size - out->len) / out->max_line;
+        if (last > x->nline)
+            last = x->nline;
+        t = Stats_Start(x->stats);
+        out->len = x->format(out->buf + out->len, x, x->labels, first,
+            last) - out->buf;
+        Stats_Stop(x->stats, STATS_FORMAT, t);
+        Stats_AddRecords(x->stats, last - first);
+    }
+    return 1;
+}
+
+static char *format_block_lines(char *s, struct Lines *x,
+    struct Labels *lab, unsigned long first, unsigned long last)
+{
+    return format_block(s, x->params, lab, x->blocks, x->nbytes, first,
+        last);
+}
+
+static int print_blocks(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct RecordSource *proto)
+{
+    struct Blocks b;
+    struct Lines x;
+    struct RecordSource src;
+    unsigned long size;
+    size_t nbytes;
+    double t;
+    int status;
+
+    /* Decoded records take memory of their own. */
+    nbytes = proto->nbytes;
+    size_blocks(&b, params, layout, proto->decode != NULL
+        ? nbytes + proto->record_size : nbytes);
+    size = (unsigned long) b.bt * b.bs * nbytes;
+    if ((b.buf = (char *) malloc(size)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", size);
+        return 0;
+    }
+    b.trait1 = b.snp1 = 0;
+
+    init_lines(&x, out, params, proto->record_size);
+    x.format = format_block_lines;
+    x.blocks = &b;
+
+    src = *proto;
+
+    status = 1;
+    while (status  &&  next_block(&b, layout)) {
+        x.nline = (unsigned long) (b.trait1 - b.trait0)
+            * (b.snp1 - b.snp0);
+        t = Stats_Start(out->stats);
+        b.rec = b.buf;
+        status = read_block(&src, layout, b.trait0, b.trait1, b.snp0,
+            b.snp1, b.buf)  &&  decode_records(&src, x.nline, &b.rec);
+        Stats_Stop(out->stats, STATS_READ, t);
+        status = status  &&  print_lines(out, &x);
+    }
+
+    count_reads(out, &src);
+    free_record_source(&src);
+    free(b.buf);
+    return status;
+}
+
+/* With --snps-file or --traits-file, only the records of the selected
+   snps and traits are converted.  If only a few records are selected,
+   scanning the whole data file would be a waste.  Instead we jump to
+   the selected records with index2offset.
+
+   Selected records are processed in batches of at most max_memory
+   bytes, in the order requested with --order.  The records of a batch
+   are read in file order: we sort their offsets, and offsets that lie
+   close together are read with a single read of the range between
+   them.  Reading a few unneeded records is cheaper than issuing
+   another system call.  With a mapped data file, the records are
+   copied straight from the mapping.  Otherwise a Lookup keeps up to
+   --queue-depth of these reads in flight, unless we skip the pages of
+   unused columns.
+
+   Within a batch, line k holds the record of pair[k], which we copy
+   to buf + k * nbytes. */
+struct Pair {
+    int snp;
+    int trait;
+};
+
+struct Read {
+    unsigned long offset;       /* offset of record in data file */
+    unsigned long line;         /* line of record in batch */
+};
+
+struct Batch {
+    int order;                  /* ORDER_FILE, ORDER_TRAIT, ORDER_SNP */
+    int *snps, nsnp;            /* selected snps in increasing order */
+    int *traits, ntrait;        /* selected traits in increasing order */
+    int *snp_start;     /* first selected snp of every tile column */
+    int *trait_start;   /* first selected trait of every tile row */
+    int nrow, ncol;     /* number of tile rows and tile columns */
+    int row, col;               /* current tile with ORDER_FILE */
+    int si, ti;                 /* next pair: snps[si], traits[ti] */
+    unsigned long max_pair;     /* maximum number of pairs per batch */
+    struct Pair *pair;          /* pairs in output order */
+    struct Read *read;          /* records sorted by offset */
+    struct LookupRead *range;   /* ranges to read with a Lookup */
+    char *buf;                  /* records in output order */
+    const char *rec;            /* decoded records in output order */
+};
+
+/* Records that are at most this many bytes apart are read together. */
+enum { MAX_READ_GAP = 1 << 16 };
+
+/* Reads never span more than this many bytes. */
+enum { MAX_READ_SIZE = 1 << 22 };
+
+/* A Lookup reads ranges into a staging buffer of at most this many
+   bytes, unless a single range is larger. */
+enum { MAX_STAGED = 1 << 24 };
+
+/* Generate the next selected pair in output order.  Return 0 after
+   the last pair.  In file order, we visit the tiles in file order, the
+   selected traits of a tile in increasing order, and for every trait
+   the selected snps of the tile in increasing order. */
+static int next_pair(struct Batch *b, struct Pair *p)
+{
+    switch (b->order) {
+
+    case ORDER_TRAIT:
+        if (b->ti == b->ntrait  ||  b->nsnp == 0)
+            return 0;
+        p->snp = b->snps[b->si];
+        p->trait = b->traits[b->ti];
+        if (++b->si == b->nsnp) {
+            b->si = 0;
+            b->ti++;
+        }
+        return 1;
+
+    case ORDER_SNP:
+        if (b->si == b->nsnp  ||  b->ntrait == 0)
+            return 0;
+        p->snp = b->snps[b->si];
+        p->trait = b->traits[b->ti];
+        if (++b->ti == b->ntrait) {
+            b->ti = 0;
+            b->si++;
+        }
+        return 1;
+    }
+
+    while (b->row < b->nrow) {
+        if (b->ti < b->trait_start[b->row + 1]
+            &&  b->si < b->snp_start[b->col + 1]) {
+            p->snp = b->snps[b->si++];
+            p->trait = b->traits[b->ti];
+            return 1;
+        }
+        if (b->ti + 1 < b->trait_start[b->row + 1]
+            &&  b->snp_start[b->col] < b->snp_start[b->col + 1]) {
+            b->ti++;
+            b->si = b->snp_start[b->col];
+            continue;
+        }
+        if (++b->col == b->ncol) {
+            b->col = 0;
+            b->row++;
+        }
+        b->ti = b->trait_start[b->row];
+        b->si = b->snp_start[b->col];
+    }
+    return 0;
+}
+
+static int compare_reads(const void *x, const void *y)
+{
+    const struct Read *a = (const struct Read *) x;
+    const struct Read *b = (const struct Read *) y;
+
+    return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+/* Return the end of the range of sorted reads that starts with read
+   i: the reads up to the next gap of more than max_gap records, but
+   spanning less than max_span records. */
+static unsigned long range_end(struct Batch *b, unsigned long i,
+    unsigned long n, unsigned long max_gap, unsigned long max_span)
+{
+    unsigned long j;
+
+    for (j = i + 1; j < n
+             &&  b->read[j].offset - b->read[j - 1].offset <= max_gap
+             &&  b->read[j].offset - b->read[i].offset < max_span;
+         j++)
+        ;
+    return j;
+}
+
+/* Read the ranges of the n sorted reads of the current batch with lk,
+   in groups that fit into MAX_STAGED bytes of staging buffer, and copy
+   the records to their lines. */
+static int lookup_batch(struct RecordSource *src, Lookup lk,
+    struct Batch *b, unsigned long n, unsigned long max_gap,
+    unsigned long max_span)
+{
+    unsigned long i, j, k, g, ng, first;
+    size_t nbytes, staged, size;
+    char *t;
+
+    nbytes = src->nbytes;
+    for (i = 0; i < n; ) {
+        first = i;
+        staged = 0;
+        for (ng = 0; i < n; ng++, i = j) {
+            j = range_end(b, i, n, max_gap, max_span);
+            size = (b->read[j - 1].offset - b->read[i].offset + 1) * nbytes;
+            if (ng > 0  &&  staged + size > MAX_STAGED)
+                break;
+            b->range[ng].offset = b->read[i].offset;
+            b->range[ng].n = size / nbytes;
+            staged += size;
+        }
+
+        if (src->staging_size < staged) {
+            if ((t = (char *) realloc(src->staging, staged)) == NULL) {
+                set_err_msg("failed to allocate %lu bytes",
+                    (unsigned long) staged);
+                return 0;
+            }
+            src->staging = t;
+            src->staging_size = staged;
+        }
+        for (t = src->staging, g = 0; g < ng; g++) {
+            b->range[g].buf = t;
+            t += b->range[g].n * nbytes;
+        }
+        if (!Lookup_Run(lk, b->range, ng))
+            return 0;
+
+        for (g = 0, k = first; k < i; k++) {
+            while (b->read[k].offset
+                   >= b->range[g].offset + b->range[g].n)
+                g++;
+            memcpy(b->buf + b->read[k].line * nbytes, b->range[g].buf
+                + (b->read[k].offset - b->range[g].offset) * nbytes,
+                nbytes);
+        }
+    }
+
+    return 1;
+}
+
+/* Read the records of the first n pairs of the current batch, with lk
+   if it isn't NULL. */
+static int read_batch(struct RecordSource *src, Lookup lk,
+    struct Layout *layout, struct Batch *b, unsigned long n)
+{
+    unsigned long i, j, k, max_gap, max_span;
+    const char *p;
+    int sorted;
+
+    sorted = 1;
+    for (k = 0; k < n; k++) {
+        index2offset(b->pair[k].snp, b->pair[k].trait,
+            &b->read[k].offset, layout);
+        b->read[k].line = k;
+        if (k > 0  &&  b->read[k].offset < b->read[k - 1].offset)
+            sorted = 0;
+    }
+    if (!sorted)
+        qsort(b->read, n, sizeof(struct Read), compare_reads);
+
+    max_gap = MAX_READ_GAP / src->nbytes + 1;
+    max_span = MAX_READ_SIZE / src->nbytes;
+    if (max_span < 1)
+        max_span = 1;
+
+    if (lk != NULL)
+        return lookup_batch(src, lk, b, n, max_gap, max_span);
+
+    for (i = 0; i < n; i = j) {
+        j = range_end(b, i, n, max_gap, max_span);
+        if (!read_records(src, b->read[i].offset,
+                b->read[j - 1].offset - b->read[i].offset + 1, &p))
+            return 0;
+        for (k = i; k < j; k++)
+            memcpy(b->buf + b->read[k].line * src->nbytes,
+                p + (b->read[k].offset - b->read[i].offset) * src->nbytes,
+                src->nbytes);
+    }
+
+    return 1;
+}
+
+static char *format_batch_lines(char *s, struct Lines *x,
+    struct Labels *lab, unsigned long first, unsigned long last)
+{
+    struct Batch *b = x->batch;
+    struct Pending q;
+    unsigned long k;
+
+    q.n = 0;
+    for (k = first; k < last; k++)
+        s = add_record(s, x->params, lab, &q, b->pair[k].snp,
+            b->pair[k].trait, (const double *) (b->rec + k * x->nbytes));
+    return flush_pending(s, x->params, lab, &q);
+}
+
+/* Return in (*start)[i] the position of the first of the n selected
+   items in sel that is >= i * per_tile, for i = 0 to ntile. */
+static int make_starts(int *sel, int n, int per_tile, int ntile,
+    int **start)
+{
+    int i, k;
+
+    if ((*start = (int *) malloc((ntile + 1) * sizeof(int))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) ((ntile + 1) * sizeof(int)));
+        return 0;
+    }
+    for (i = k = 0; i <= ntile; i++) {
+        while (k < n  &&  sel[k] < i * per_tile)
+            k++;
+        (*start)[i] = i == ntile ? n : k;
+    }
+    return 1;
+}
+
+/* Select all n items. */
+static int select_all(int n, int **selected, int *nselected)
+{
+    int i;
+
+    if ((*selected = (int *) malloc(n * sizeof(int))) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (n * sizeof(int)));
+        return 0;
+    }
+    for (i = 0; i < n; i++)
+        (*selected)[i] = i;
+    *nselected = n;
+    return 1;
+}
+
+static int print_selection(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct RecordSource *proto)
+{
+    struct Batch b;
+    struct Lines x;
+    struct RecordSource src;
+    Lookup lk;
+    unsigned long n, per_pair;
+    size_t nbytes;
+    double t;
+    int status;
+
+    nbytes = proto->nbytes;
+    status = 0;
+    b.snps = b.traits = b.snp_start = b.trait_start = NULL;
+    b.pair = NULL;
+    b.read = NULL;
+    b.range = NULL;
+    b.buf = NULL;
+    lk = NULL;
+
+    if (!(params->snps_file != NULL
+            ? read_label_file(params->snps_file, "snp",
+                layout, snp_label, layout->nsnp, &b.snps, &b.nsnp)
+            : select_all(layout->nsnp, &b.snps, &b.nsnp)))
+        goto FREE_BATCH;
+    if (!(params->traits_file != NULL
+            ? read_label_file(params->traits_file, "trait",
+                layout, trait_label, layout->ntrait, &b.traits,
+                &b.ntrait)
+            : select_all(layout->ntrait, &b.traits, &b.ntrait)))
+        goto FREE_BATCH;
+
+    b.order = params->order;
+    b.nrow = (layout->ntrait + layout->traits_per_tile - 1)
+        / layout->traits_per_tile;
+    b.ncol = (layout->nsnp + layout->snps_per_tile - 1)
+        / layout->snps_per_tile;
+    if (!make_starts(b.traits, b.ntrait, layout->traits_per_tile, b.nrow,
+            &b.trait_start)
+        ||  !make_starts(b.snps, b.nsnp, layout->snps_per_tile, b.ncol,
+            &b.snp_start))
+        goto FREE_BATCH;
+    b.row = b.col = b.si = b.ti = 0;
+
+    if (proto->data == NULL  &&  proto->fd != -1
+        &&  (proto->proj == NULL  ||  !proto->proj->skip)
+        &&  params->queue_depth > 1
+        &&  (lk = Lookup_Create(proto->fd, proto->file, nbytes,
+                params->queue_depth, LOOKUP_AUTO)) == NULL)
+        goto FREE_BATCH;
+
+    per_pair = nbytes + sizeof(struct Pair) + sizeof(struct Read)
+        + (lk != NULL ? sizeof(struct LookupRead) : 0)
+        + (proto->decode != NULL ? proto->record_size : 0);
+    b.max_pair = params->max_memory / per_pair;
+    if (b.max_pair < 1)
+        b.max_pair = 1;
+    if (b.max_pair > (unsigned long) b.nsnp * b.ntrait)
+        b.max_pair = b.nsnp > 0  &&  b.ntrait > 0
+            ? (unsigned long) b.nsnp * b.ntrait : 1;
+    if ((b.pair = (struct Pair *) malloc(b.max_pair
+                * sizeof(struct Pair))) == NULL
+        ||  (b.read = (struct Read *) malloc(b.max_pair
+                * sizeof(struct Read))) == NULL
+        ||  (b.buf = (char *) malloc(b.max_pair * nbytes)) == NULL
+        ||  (lk != NULL  &&  (b.range = (struct LookupRead *) malloc(
+                    b.max_pair * sizeof(struct LookupRead))) == NULL)) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (b.max_pair * per_pair));
+        goto FREE_BATCH;
+    }
+
+    init_lines(&x, out, params, proto->record_size);
+    x.format = format_batch_lines;
+    x.batch = &b;
+    Stats_SetTotal(out->stats, layout, (unsigned long) b.nsnp * b.ntrait,
+        nbytes);
+
+    src = *proto;
+
+    status = 1;
+    while (status) {
+        for (n = 0; n < b.max_pair  &&  next_pair(&b, &b.pair[n]); n++)
+            ;
+        if (n == 0)
+            break;
+        x.nline = n;
+        t = Stats_Start(out->stats);
+        b.rec = b.buf;
+        status = read_batch(&src, lk, layout, &b, n)
+            &&  decode_records(&src, n, &b.rec);
+        Stats_Stop(out->stats, STATS_READ, t);
+        status = status  &&  print_lines(out, &x);
+    }
+
+    count_reads(out, &src);
+    free_record_source(&src);
+    if (lk != NULL) {
+        out->bytes_read += Lookup_BytesRead(lk);
+        out->nread += Lookup_Reads(lk);
+    }
+FREE_BATCH:
+    if (lk != NULL)
+        Lookup_Destroy(lk);
+    free(b.range);
+    free(b.buf);
+    free(b.read);
+    free(b.pair);
+    free(b.snp_start);
+    free(b.trait_start);
+    free(b.snps);
+    free(b.traits);
+    return status;
+}
+
+/* Read the n records that start at the given offset either from src
+   or, if st is not NULL, sequentially from st. */
+static int next_records(struct RecordSource *src, Stream st,
+    unsigned long offset, unsigned long n, const char **p)
+{
+    if (st == NULL)
+        return read_records(src, offset, n, p);
+    return Stream_Read(st, n, p);
+}
+
+/* With --format=arrow, the selected columns of the records that pass
+   the filter are gathered column by column into record batches.  A
+   batch never crosses a tile boundary: every tile becomes one batch
+   unless it holds more records than fit into --max-memory, in which
+   case it is split into several batches. */
+static int write_arrow(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct RecordSource *proto)
+{
+    struct RecordSource src;
+    ArrowWriter w;
+    Stream st;
+    const double *v[FILTER_BATCH];
+    unsigned char keep[FILTER_BATCH];
+    int idx[FILTER_BATCH];
+    const char *p;
+    double *columns, *c;
+    int *snp, *trait;
+    unsigned long cap, k, n, offset;
+    int t0, s0, nt, ns, m, i, j, a, kept, nkeep, status;
+    size_t nbytes, size;
+    double t;
+
+    status = 0;
+    nbytes = proto->nbytes;
+
+    /* Room for at least FILTER_BATCH and at most a tile of records. */
+    cap = params->max_memory
+        / (2 * sizeof(int) + params->ncolumn * sizeof(double));
+    if (cap < FILTER_BATCH)
+        cap = FILTER_BATCH;
+    if (cap > (unsigned long) layout->snps_per_tile
+            * layout->traits_per_tile)
+        cap = (unsigned long) layout->snps_per_tile
+            * layout->traits_per_tile;
+    size = cap * (2 * sizeof(int) + params->ncolumn * sizeof(double));
+    snp = (int *) malloc(cap * sizeof(int));
+    trait = (int *) malloc(cap * sizeof(int));
+    columns = (double *) malloc(cap * params->ncolumn * sizeof(double));
+    if (snp == NULL  ||  trait == NULL  ||  columns == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) size);
+        goto FREE_COLUMNS;
+    }
+
+    /* Pipes are read sequentially. */
+    st = NULL;
+    if (proto->data == NULL  &&  proto->fd == -1
+        &&  (st = open_data_stream(params->data_file, nbytes)) == NULL)
+        goto FREE_COLUMNS;
+
+    if ((w = ArrowWriter_Create(out->fp, out->file, params, layout))
+        == NULL)
+        goto CLOSE_DATA_STREAM;
+
+    src = *proto;
+    status = 1;
+    offset = 0;
+    for (t0 = 0; status  &&  t0 < layout->ntrait;
+         t0 += layout->traits_per_tile) {
+        nt = layout->ntrait - t0 < layout->traits_per_tile
+            ? layout->ntrait - t0 : layout->traits_per_tile;
+        for (s0 = 0; status  &&  s0 < layout->nsnp;
+             s0 += layout->snps_per_tile) {
+            ns = layout->nsnp - s0 < layout->snps_per_tile
+                ? layout->nsnp - s0 : layout->snps_per_tile;
+            n = (unsigned long) nt * ns;
+            kept = 0;
+            for (k = 0; status  &&  k < n; k += m) {
+                m = n - k < FILTER_BATCH ? n - k : FILTER_BATCH;
+                t = Stats_Start(out->stats);
+                if (!next_records(&src, st, offset + k, m, &p)
+                    ||  !decode_records(&src, m, &p)) {
+                    status = 0;
+                    break;
+                }
+                Stats_Stop(out->stats, STATS_READ, t);
+                t = Stats_Start(out->stats);
+                for (i = 0; i < m; i++)
+                    v[i] = (const double *) (p + i * src.record_size);
+                if (params->filter != NULL)
+                    Filter_Apply(params->filter, m, v, keep);
+                else
+                    memset(keep, 1, m);
+                for (nkeep = i = 0; i < m; i++)
+                    if (keep[i])
+                        idx[nkeep++] = i;
+
+                if (kept + nkeep > (long) cap) {
+                    Stats_Stop(out->stats, STATS_FORMAT, t);
+                    t = Stats_Start(out->stats);
+                    status = ArrowWriter_WriteBatch(w, kept, snp, trait,
+                        columns, cap);
+                    Stats_Stop(out->stats, STATS_WRITE, t);
+                    t = Stats_Start(out->stats);
+                    kept = 0;
+                }
+                for (i = 0; i < nkeep; i++) {
+                    snp[kept + i] = s0 + (k + idx[i]) % ns;
+                    trait[kept + i] = t0 + (k + idx[i]) / ns;
+                }
+                for (j = 0; j < params->ncolumn; j++) {
+                    a = params->ucp2acp[j];
+                    c = columns + j * cap + kept;
+                    for (i = 0; i < nkeep; i++)
+                        c[i] = v[idx[i]][a];
+                }
+                kept += nkeep;
+                Stats_Stop(out->stats, STATS_FORMAT, t);
+            }
+            t = Stats_Start(out->stats);
+            if (status  &&  kept > 0)
+                status = ArrowWriter_WriteBatch(w, kept, snp, trait,
+                    columns, cap);
+            Stats_Stop(out->stats, STATS_WRITE, t);
+            Stats_AddRecords(out->stats, n);
+            offset += n;
+        }
+    }
+    count_reads(out, &src);
+    free_record_source(&src);
+
+    status = status  &&  ArrowWriter_Finish(w);
+    Stats_AddWrites(out->stats, ArrowWriter_BytesWritten(w),
+        ArrowWriter_Writes(w));
+    ArrowWriter_Destroy(w);
+
+CLOSE_DATA_STREAM:
+    if (st != NULL)
+        status = close_data_stream(out, st, status);
+FREE_COLUMNS:
+    free(snp);
+    free(trait);
+    free(columns);
+    return status;
+}
+
+/* With --top-k=K, we keep the K records of every trait that rank
+   highest by the --rank-by expression in a TopK (see TopK.c) and
+   write nothing until the whole data file has been read, once, in
+   file order.  Records rank by the absolute value of the expression.
+   The expression p(COV) is ranked as beta / se of COV instead, which
+   puts the smallest p-values first and, unlike p, doesn't underflow
+   for the strongest associations.  Records for which the expression
+   is NaN and records that fail --where are dropped.  With --threads=N,
+   every worker ranks the units of print_records_in_parallel that it
+   picks up into a TopK of its own, and the TopKs are merged at the
+   end.  Since ties go to the smaller snp, the output doesn't depend
+   on N.  It lists the traits in order and the records of a trait from
+   the highest to the lowest rank. */
+struct Rank {
+    struct Params *params;
+    struct Layout *layout;
+    unsigned long *start;       /* first record of every unit */
+    struct RecordSource *src;   /* per-worker data file readers */
+    TopK *top;                  /* per-worker hits */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+/* Records of a unit of the parallel ranking. */
+enum { RANK_UNIT_RECORDS = 1 << 16 };
+
+/* Rank the n <= FILTER_BATCH consecutive records that start at the
+   cursor c and whose regression results start at p.  Leave c after
+   the last of them. */
+static void rank_records(struct Rank *r, TopK top, struct TileCursor *c,
+    unsigned long n, const char *p, size_t nbytes)
+{
+    const double *v[FILTER_BATCH];
+    unsigned char keep[FILTER_BATCH];
+    double x[FILTER_BATCH];
+    int k;
+
+    for (k = 0; k < (int) n; k++)
+        v[k] = (const double *) (p + k * nbytes);
+    if (r->params->filter != NULL)
+        Filter_Apply(r->params->filter, n, v, keep);
+    else
+        memset(keep, 1, n);
+    Filter_Evaluate(r->params->rank, n, v, x);
+    for (k = 0; k < (int) n; k++) {
+        if (keep[k])
+            TopK_Add(top, c->trait, c->snp, fabs(x[k]), v[k]);
+        next_tile_cursor(c);
+    }
+}
+
+static int rank_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Rank *r = (struct Rank *) arg;
+    struct RecordSource *src;
+    struct TileCursor cur;
+    unsigned long b, e, k, m;
+    const char *p;
+    double t;
+
+    (void) chunk;
+    src = &r->src[worker];
+    b = r->start[unit];
+    e = r->start[unit + 1];
+    init_tile_cursor(&cur, r->layout, b);
+    for (k = b; k < e; k += m) {
+        m = e - k < FILTER_BATCH ? e - k : FILTER_BATCH;
+        t = Stats_Start(r->stats);
+        if (!read_records(src, k, m, &p)  ||  !decode_records(src, m, &p))
+            return 0;
+        Stats_Stop(r->stats, STATS_READ, t);
+        t = Stats_Start(r->stats);
+        rank_records(r, r->top[worker], &cur, m, p, src->record_size);
+        Stats_Stop(r->stats, STATS_FORMAT, t);
+    }
+    return 1;
+}
+
+static int count_unit(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    struct Rank *r = (struct Rank *) arg;
+
+    (void) chunk;
+    Stats_AddRecords(r->stats, r->start[unit + 1] - r->start[unit]);
+    return 1;
+}
+
+/* Rank all records into r->top[0], reading them sequentially from st
+   if it is not NULL, and else from src. */
+static int rank_sequentially(struct Rank *r,
+    const struct RecordSource *proto, Stream st)
+{
+    struct RecordSource src;
+    struct TileCursor c;
+    const char *p;
+    unsigned long nrecord, nrec, n;
+    double t;
+    int status;
+
+    src = *proto;
+    nrecord = (unsigned long) r->layout->nsnp * r->layout->ntrait;
+    init_tile_cursor(&c, r->layout, 0);
+    status = 1;
+    for (nrec = 0; status  &&  nrec < nrecord; nrec += n) {
+        n = nrecord - nrec < FILTER_BATCH ? nrecord - nrec : FILTER_BATCH;
+        t = Stats_Start(r->stats);
+        status = next_records(&src, st, nrec, n, &p)
+            &&  decode_records(&src, n, &p);
+        Stats_Stop(r->stats, STATS_READ, t);
+        if (status) {
+            t = Stats_Start(r->stats);
+            rank_records(r, r->top[0], &c, n, p, src.record_size);
+            Stats_Stop(r->stats, STATS_FORMAT, t);
+            Stats_AddRecords(r->stats, n);
+        }
+    }
+    r->src[0] = src;
+
+    return status;
+}
+
+/* Format a line like format_record, but from the values v of the
+   selected columns that a TopK kept. */
+static char *format_hit(char *s, struct Params *params,
+    struct Labels *lab, int snp, int trait, const double *v)
+{
+    int i;
+
+    s = format_labels(s, lab, snp, trait);
+    for (i = 0; i < params->ncolumn; i++) {
+        *s++ = ' ';
+        s = format_double(s, v[i], params->ndigit);
+    }
+    *s++ = '\n';
+
+    return s;
+}
+
+static int print_top_records(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct RecordSource *proto)
+{
+    struct Rank r;
+    Stream st;
+    unsigned long nunit;
+    const double *v;
+    double t;
+    int i, nworker, k, trait, snp, status;
+
+    if (Filter_PValueToZ(params->rank) < 0)
+        return 0;
+    r.params = params;
+    r.layout = layout;
+    r.stats = out->stats;
+    r.start = NULL;
+
+    /* Pipes are ranked sequentially by a single thread. */
+    st = NULL;
+    nworker = params->nthread;
+    if (proto->data == NULL  &&  proto->fd == -1) {
+        if ((st = open_data_stream(params->data_file, proto->nbytes))
+            == NULL)
+            return 0;
+        nworker = 1;
+    }
+
+    status = 0;
+    k = params->top_k < layout->nsnp ? params->top_k : layout->nsnp;
+    r.src = (struct RecordSource *) malloc(nworker
+        * sizeof(struct RecordSource));
+    r.top = (TopK *) calloc(nworker, sizeof(TopK));
+    if (r.src == NULL  ||  r.top == NULL) {
+        set_err_msg("failed to allocate memory for %d threads", nworker);
+        goto FREE_WORKERS;
+    }
+    for (i = 0; i < nworker; i++) {
+        r.src[i] = *proto;
+        if ((r.top[i] = TopK_Create(layout->ntrait, k, params->ncolumn,
+                    params->ucp2acp)) == NULL)
+            goto FREE_WORKERS;
     }
 
-    /* Allocate a buffer large enough to hold the bytes containing the
-       regression results of a single trait-snp pair.  There are nvar
-       betas, nvar standard errors, and ncov covariances.  Each value
-       represents a double of bytes_per_double bytes. */
+    if (nworker == 1)
+        status = rank_sequentially(&r, proto, st);
+    else if ((nunit = make_units(layout, RANK_UNIT_RECORDS, &r.start)) > 0)
+        status = run_ordered(nworker, nunit, rank_unit, count_unit, &r);
+    for (i = 0; i < nworker; i++) {
+        count_reads(out, &r.src[i]);
+        free_record_source(&r.src[i]);
+    }
+
+    t = Stats_Start(out->stats);
+    for (i = 1; status  &&  i < nworker; i++)
+        TopK_Merge(r.top[0], r.top[i]);
+    if (status)
+        TopK_Sort(r.top[0]);
+    Stats_Stop(out->stats, STATS_FORMAT, t);
+
+    for (trait = 0; status  &&  trait < layout->ntrait; trait++)
+        for (i = 0; status  &&  i < TopK_Count(r.top[0], trait); i++) {
+            if (!(status = reserve_line(out)))
+                break;
+            v = TopK_Get(r.top[0], trait, i, &snp);
+            t = Stats_Start(out->stats);
+            out->len = format_hit(out->buf + out->len, params,
+                out->labels, snp, trait, v) - out->buf;
+            Stats_Stop(out->stats, STATS_FORMAT, t);
+        }
+
+FREE_WORKERS:
+    for (i = 0; r.top != NULL  &&  i < nworker; i++)
+        TopK_Destroy(r.top[i]);
+    free(r.top);
+    free(r.src);
+    free(r.start);
+    if (st != NULL)
+        status = close_data_stream(out, st, status);
+    return status;
+}
+
+/* With --summary=COV, we summarize the statistics z = beta / se of
+   COV of every trait in a TraitSummary (see trait_summary.c) in a
+   single pass over the data file in file order and write a table with
+   a line per trait.  With --threads=N, units are whole tiles.  A
+   worker summarizes the traits of its tile into its chunk, and the
+   calling thread adds the chunks to the summaries of all traits.
+   Memory therefore grows with the number of traits and threads, but
+   not with the number of snps. */
+struct Summarize {
+    struct Params *params;
+    struct Layout *layout;
+    Filter z;                   /* beta / se of COV */
+    struct SummaryEdges edges;
+    unsigned long *start;       /* first record of every unit */
+    struct RecordSource *src;   /* per-worker data file readers */
+    struct TraitSummary *traits;    /* summaries of all traits */
+    Stats stats;                /* runtime statistics or NULL */
+};
+
+/* Compile beta / se of the covariate cov. */
+static Filter compile_statistic(const char *cov, struct Layout *layout)
+{
+    char *expr;
+    size_t n;
+    Filter z;
+
+    n = strlen(cov) + sizeof "p()";
+    if ((expr = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return NULL;
+    }
+    sprintf(expr, "p(%s)", cov);
+    if ((z = Filter_Compile(expr, layout)) == NULL)
+        set_err_msg("unknown covariate in --summary: %.100s", cov);
+    else if (Filter_PValueToZ(z) < 0) {
+        Filter_Destroy(z);
+        z = NULL;
+    }
+    free(expr);
+    return z;
+}
+
+/* Add the n <= FILTER_BATCH consecutive records that start at the
+   cursor c and whose regression results start at p to the summaries
+   t of the traits from trait0 on.  Leave c after the last of them. */
+static void summarize_records(struct Summarize *m, struct TraitSummary *t,
+    int trait0, struct TileCursor *c, unsigned long n, const char *p,
+    size_t nbytes)
+{
+    const double *v[FILTER_BATCH];
+    unsigned char keep[FILTER_BATCH];
+    double z[FILTER_BATCH];
+    int k;
+
+    for (k = 0; k < (int) n; k++)
+        v[k] = (const double *) (p + k * nbytes);
+    if (m->params->filter != NULL)
+        Filter_Apply(m->params->filter, n, v, keep);
+    else
+        memset(keep, 1, n);
+    Filter_Evaluate(m->z, n, v, z);
+    for (k = 0; k < (int) n; k++) {
+        if (keep[k])
+            add_to_trait_summary(&t[c->trait - trait0], &m->edges, z[k]);
+        next_tile_cursor(c);
+    }
+}
+
+static int summarize_unit(void *arg, int worker, unsigned long unit,
+    struct Chunk *chunk)
+{
+    struct Summarize *m = (struct Summarize *) arg;
+    struct RecordSource *src;
+    struct TileCursor cur;
+    unsigned long b, e, k, n;
+    const char *p;
+    char *t;
+    size_t size;
+    double start;
+
+    src = &m->src[worker];
+    b = m->start[unit];
+    e = m->start[unit + 1];
+    init_tile_cursor(&cur, m->layout, b);
+
+    size = (cur.trait1 - cur.trait0) * sizeof(struct TraitSummary);
+    if (chunk->size < size) {
+        if ((t = (char *) realloc(chunk->data, size)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) size);
+            return 0;
+        }
+        chunk->data = t;
+        chunk->size = size;
+    }
+    memset(chunk->data, 0, size);
+    chunk->len = size;
+
+    for (k = b; k < e; k += n) {
+        n = e - k < FILTER_BATCH ? e - k : FILTER_BATCH;
+        start = Stats_Start(m->stats);
+        if (!read_records(src, k, n, &p)  ||  !decode_records(src, n, &p))
+            return 0;
+        Stats_Stop(m->stats, STATS_READ, start);
+        start = Stats_Start(m->stats);
+        summarize_records(m, (struct TraitSummary *) chunk->data,
+            cur.trait0, &cur, n, p, src->record_size);
+        Stats_Stop(m->stats, STATS_FORMAT, start);
+    }
+    return 1;
+}
+
+static int merge_unit(void *arg, unsigned long unit, struct Chunk *chunk)
+{
+    struct Summarize *m = (struct Summarize *) arg;
+    const struct TraitSummary *t;
+    int snp, trait, i, n;
+
+    offset2index(m->start[unit], &snp, &trait, m->layout);
+    t = (const struct TraitSummary *) chunk->data;
+    n = chunk->len / sizeof(struct TraitSummary);
+    for (i = 0; i < n; i++)
+        merge_trait_summary(&m->traits[trait + i], &t[i]);
+    Stats_AddRecords(m->stats, m->start[unit + 1] - m->start[unit]);
+    return 1;
+}
+
+/* Summarize all records into m->traits, reading them sequentially
+   from st if it is not NULL, and else from src. */
+static int summarize_sequentially(struct Summarize *m,
+    const struct RecordSource *proto, Stream st)
+{
+    struct RecordSource src;
+    struct TileCursor c;
+    const char *p;
+    unsigned long nrecord, nrec, n;
+    double t;
+    int status;
+
+    src = *proto;
+    nrecord = (unsigned long) m->layout->nsnp * m->layout->ntrait;
+    init_tile_cursor(&c, m->layout, 0);
+    status = 1;
+    for (nrec = 0; status  &&  nrec < nrecord; nrec += n) {
+        n = nrecord - nrec < FILTER_BATCH ? nrecord - nrec : FILTER_BATCH;
+        t = Stats_Start(m->stats);
+        status = next_records(&src, st, nrec, n, &p)
+            &&  decode_records(&src, n, &p);
+        Stats_Stop(m->stats, STATS_READ, t);
+        if (status) {
+            t = Stats_Start(m->stats);
+            summarize_records(m, m->traits, 0, &c, n, p, src.record_size);
+            Stats_Stop(m->stats, STATS_FORMAT, t);
+            Stats_AddRecords(m->stats, n);
+        }
+    }
+    m->src[0] = src;
+
+    return status;
+}
+
+/* Format x into s, or NA if x is NaN. */
+static char *format_stat(char *s, double x, int ndigit)
+{
+    *s++ = ' ';
+    if (x != x) {
+        memcpy(s, "NA", 2);
+        return s + 2;
+    }
+    return format_double(s, x, ndigit);
+}
+
+/* Write the summary of every trait as a line of the trait label, the
+   number of statistics, lambda, the largest -log10(p), the hits at
+   every threshold, the histogram of -log10(p), and the observed
+   -log10(p) where 1 to SUMMARY_NQQ are expected. */
+static int write_summary_table(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct TraitSummary *traits, int header)
+{
+    const struct TraitSummary *t;
+    const char *label;
+    char *s;
+    size_t n;
+    int trait, k;
+
+    if (header) {
+        fprintf(out->fp, "trait n lambda max_logp");
+        for (k = 0; k < SUMMARY_NHIT; k++)
+            fprintf(out->fp, " hits_%g", summary_thresholds[k]);
+        for (k = 0; k < SUMMARY_NHIST; k++)
+            fprintf(out->fp, " logp_%d", k);
+        for (k = 1; k <= SUMMARY_NQQ; k++)
+            fprintf(out->fp, " qq_%d", k);
+        fprintf(out->fp, "\n");
+    }
+
+    /* A line holds a label and the fields, separated by blanks. */
+    for (trait = 0; trait < layout->ntrait; trait++) {
+        t = &traits[trait];
+        if (out->len + layout->max_char + (4 + SUMMARY_NHIT + SUMMARY_NHIST
+                + SUMMARY_NQQ) * (1 + FORMAT_DOUBLE_MAXLEN) + 1 > out->size
+            &&  !flush_output(out))
+            return 0;
+        s = out->buf + out->len;
+        label = LabelPool_Get(out->labels->traits, trait, &n);
+        memcpy(s, label, n);
+        s += n;
+        s += sprintf(s, " %llu", t->n);
+        s = format_stat(s, trait_summary_lambda(t), params->ndigit);
+        s = format_stat(s, t->n ? minus_log10_p(sqrt(t->max_chi2)) : NAN,
+            params->ndigit);
+        for (k = 0; k < SUMMARY_NHIT; k++)
+            s += sprintf(s, " %llu", t->hits[k]);
+        for (k = 0; k < SUMMARY_NHIST; k++)
+            s += sprintf(s, " %llu", t->hist[k]);
+        for (k = 1; k <= SUMMARY_NQQ; k++)
+            s = format_stat(s, trait_summary_qq(t, k), params->ndigit);
+        *s++ = '\n';
+        out->len = s - out->buf;
+    }
+    return 1;
+}
+
+static int print_summary(struct Output *out, struct Params *params,
+    struct Layout *layout, const struct RecordSource *proto, Filter z,
+    int header)
+{
+    struct Summarize m;
+    Stream st;
+    unsigned long nunit;
+    int i, nworker, status;
+
+    m.params = params;
+    m.layout = layout;
+    m.z = z;
+    m.stats = out->stats;
+    m.start = NULL;
+    init_summary_edges(&m.edges);
+
+    /* Pipes are summarized sequentially by a single thread. */
+    st = NULL;
+    nworker = params->nthread;
+    if (proto->data == NULL  &&  proto->fd == -1) {
+        if ((st = open_data_stream(params->data_file, proto->nbytes))
+            == NULL)
+            return 0;
+        nworker = 1;
+    }
+
+    status = 0;
+    m.src = (struct RecordSource *) malloc(nworker
+        * sizeof(struct RecordSource));
+    m.traits = (struct TraitSummary *) calloc(layout->ntrait,
+        sizeof(struct TraitSummary));
+    if (m.src == NULL  ||  m.traits == NULL) {
+        set_err_msg("failed to allocate memory for the summaries of %d "
+            "traits", layout->ntrait);
+        goto FREE_SUMMARIES;
+    }
+    for (i = 0; i < nworker; i++)
+        m.src[i] = *proto;
+
+    if (nworker == 1)
+        status = summarize_sequentially(&m, proto, st);
+    else if ((nunit = make_units(layout, (unsigned long)
+                layout->snps_per_tile * layout->traits_per_tile,
+                &m.start)) > 0)
+        status = run_ordered(nworker, nunit, summarize_unit, merge_unit,
+            &m);
+    for (i = 0; i < nworker; i++) {
+        count_reads(out, &m.src[i]);
+        free_record_source(&m.src[i]);
+    }
+
+    status = status
+        &&  write_summary_table(out, params, layout, m.traits, header);
+
+FREE_SUMMARIES:
+    free(m.traits);
+    free(m.src);
+    free(m.start);
+    if (st != NULL)
+        status = close_data_stream(out, st, status);
+    return status;
+}
+
+/* Compute which parts of a record we need: the columns that we write
+   and the columns that the filter, the rank expression, and the
+   statistic of --summary read. */
+static int project_columns(struct Projection *proj, struct Params *params,
+    struct Layout *layout, Filter z)
+{
+    unsigned char *used;
+    int i, ncolumn, status;
+
+    ncolumn = layout->nvar + layout->nvar + layout->ncov;
+    if ((used = (unsigned char *) calloc(ncolumn, 1)) == NULL) {
+        set_err_msg("failed to allocate %d bytes", ncolumn);
+        return 0;
+    }
+    for (i = 0; z == NULL  &&  i < params->ncolumn; i++)
+        used[params->ucp2acp[i]] = 1;
+    if (params->filter != NULL)
+        Filter_MarkColumns(params->filter, used);
+    if (params->rank != NULL)
+        Filter_MarkColumns(params->rank, used);
+    if (z != NULL)
+        Filter_MarkColumns(z, used);
+    status = make_projection(proj, used, ncolumn,
+        layout->bytes_per_double, sysconf(_SC_PAGESIZE));
+    free(used);
+
+    return status;
+}
+
+/* Write the index of the BGZF-compressed output file to the output
+   file name plus ".r3i". */
+static int write_index(const struct ResultIndex *index,
+    const char *output_file)
+{
+    char *file;
+    size_t n;
+    int status;
+
+    n = strlen(output_file) + sizeof ".r3i";
+    if ((file = (char *) malloc(n)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes", (unsigned long) n);
+        return 0;
+    }
+    sprintf(file, "%s.r3i", output_file);
+    status = write_result_index(index, file);
+    free(file);
+    return status;
+}
+
+/* Convert the data file into the open output file fp called file,
+   starting with a header line unless header is 0 or the output is an
+   Arrow file.  The output file stays open. */
+int convert_data_file(struct Params *params, struct Layout *layout,
+    FILE *fp, const char *file, int header)
+{
+    struct Output out;
+    struct Projection proj;
+    struct RecordSource src;
+    MappedFile mf;
+    unsigned long nrecord; /* number of result records in data file */
+    int ncolumn;      /* number of columns in regression results */
+    size_t nbytes;    /* number of bytes used by regression results */
+    DecodeFunc decode; /* converts records to native doubles or NULL */
+    Filter z;         /* statistic of --summary or NULL */
+    int i, fd, status, selection, swap;
+
+    out.fp = fp;
+    out.file = file;
+
+    /* The regression results of a single trait-snp pair consist of
+       nvar betas, nvar standard errors, and ncov covariances.  Each
+       value represents a double of bytes_per_double bytes. */
     ncolumn = layout->nvar + layout->nvar + layout->ncov;
     nbytes = ncolumn * layout->bytes_per_double;
-    if ((buf = (char *) malloc(nbytes)) == NULL) {
+
+    /* A line holds two labels of less than max_char characters each
+       and ncolumn numbers, all separated by blanks, plus a newline. */
+    out.stats = params->stats;
+    out.max_line = 2 * layout->max_char
+        + params->ncolumn * (1 + FORMAT_DOUBLE_MAXLEN) + 1;
+    out.size = OUTPUT_BUFFER_SIZE + FILTER_BATCH * out.max_line;
+    out.len = 0;
+    if ((out.buf = (char *) malloc(out.size)) == NULL) {
         set_err_msg("failed to allocate %lu bytes",
-            (unsigned long) nbytes);
-        goto CLOSE_OUTPUT_FILE;
+            (unsigned long) out.size);
+        return 0;
     }
+    if (!init_labels(&out, layout, params->nthread))
+        goto FREE_BUFFER;
 
     /* Print header. */
-    fprintf(ofp, "snp trait");
-    if (params->columns != NULL)
-        for (i = 0; i < params->ncolumn; i++)
-            fprintf(ofp, " %s", params->columns[i]);
-    else {
-        for (i = 0; i < layout->nvar; i++)
-            fprintf(ofp, " %s", layout->beta_labels[i]);
-        for (i = 0; i < layout->nvar; i++)
-            fprintf(ofp, " %s", layout->se_labels[i]);
-        for (i = 0; i < layout->ncov; i++)
-            fprintf(ofp, " %s", layout->cov_labels[i]);
-    }
-    fprintf(ofp, "\n");
-
-    nrecord = layout->nsnp * layout->ntrait;
-    nrec = 0;
-    while (nrec < nrecord) {
-        assert(1 == fread(buf, nbytes, 1, ifp));
-        v = (double *) buf;
-        offset2index(nrec, &snp, &trait, layout);
-        fprintf(ofp, "%s %s", layout->snp_labels[snp],
-            layout->trait_labels[trait]);
-        if (params->ncolumn)
+    if (params->format == FORMAT_TEXT  &&  header
+        &&  params->summary == NULL) {
+        fprintf(out.fp, "snp trait");
+        if (params->columns != NULL)
             for (i = 0; i < params->ncolumn; i++)
-                fprintf(ofp, " %.*g", params->ndigit,
-                    v[params->ucp2acp[i]]);
-        else
-            for (i = 0; i < ncolumn; i++)
-                fprintf(ofp, " %.*g", params->ndigit, v[i]);
-        fprintf(ofp, "\n");
-        ++nrec;
+                fprintf(out.fp, " %s", params->columns[i]);
+        else {
+            for (i = 0; i < layout->nvar; i++)
+                fprintf(out.fp, " %s", layout->beta_labels[i]);
+            for (i = 0; i < layout->nvar; i++)
+                fprintf(out.fp, " %s", layout->se_labels[i]);
+            for (i = 0; i < layout->ncov; i++)
+                fprintf(out.fp, " %s", layout->cov_labels[i]);
+        }
+        fprintf(out.fp, "\n");
     }
 
-    free(buf);
+    nrecord = (unsigned long) layout->nsnp * layout->ntrait;
+    mf = params->use_mmap ? MappedFile_Open(params->data_file) : NULL;
+    if (mf != NULL  &&  !check_mapped_size(params, mf, nrecord, nbytes))
+        goto CLOSE_MAPPING;
 
-    if (params->output_file != NULL  &&  fclose(ofp)) {
-        set_err_msg("failed to close file: %s",
+    z = NULL;
+    if (params->summary != NULL
+        &&  (z = compile_statistic(params->summary, layout)) == NULL)
+        goto CLOSE_MAPPING;
+    if (!project_columns(&proj, params, layout, z))
+        goto DESTROY_STATISTIC;
+
+    /* Values of float32 files and files written with the other byte
+       order must be decoded to native doubles.  Decoding touches whole
+       records, so there are no pages left to skip. */
+    swap = params->endian == ENDIAN_AUTO ? layout->swapped
+        : (params->endian == ENDIAN_BIG) != is_big_endian();
+    decode = layout->bytes_per_double != sizeof(double)  ||  swap
+        ? find_decoder(layout->bytes_per_double, swap, DECODE_BEST) : NULL;
+    if (decode != NULL)
+        proj.skip = 0;
+
+    /* Without a mapping, worker threads, block reads, selections, and
+       reads that skip unused columns use pread(2), which requires a
+       seekable data file.  Pipes are converted by a single thread,
+       completely, and in file order. */
+    selection = params->snps_file != NULL  ||  params->traits_file != NULL;
+    fd = -1;
+    if ((params->nthread > 1  ||  params->order != ORDER_FILE
+            ||  selection  ||  proj.skip)
+        &&  mf == NULL
+        &&  (fd = open(params->data_file, O_RDONLY)) != -1
+        &&  lseek(fd, 0, SEEK_CUR) == -1) {
+        close(fd);
+        fd = -1;
+    }
+
+    /* Read-ahead would read the pages that we skip. */
+    if (proj.skip  &&  mf != NULL)
+        MappedFile_SetRandomAccess(mf);
+    else if (proj.skip  &&  fd != -1)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+
+    init_record_source(&src, params->data_file,
+        mf != NULL ? MappedFile_Data(mf) : NULL, fd, nbytes);
+    src.proj = &proj;
+    if (decode != NULL)
+        set_record_decoder(&src, decode, ncolumn);
+    out.bytes_read = out.nread = 0;
+    Stats_SetTotal(out.stats, layout, nrecord, nbytes);
+
+    if (selection  &&  mf == NULL  &&  fd == -1) {
+        set_err_msg("--snps-file and --traits-file require a seekable "
+            "data file: %s", params->data_file);
+        status = 0;
+    }
+    else if (params->order != ORDER_FILE  &&  mf == NULL  &&  fd == -1) {
+        set_err_msg("--order=%s requires a seekable data file: %s",
+            params->order == ORDER_TRAIT ? "trait" : "snp",
+            params->data_file);
+        status = 0;
+    }
+    else if (params->format == FORMAT_ARROW)
+        status = write_arrow(&out, params, layout, &src);
+    else if (params->rank != NULL)
+        status = print_top_records(&out, params, layout, &src);
+    else if (z != NULL)
+        status = print_summary(&out, params, layout, &src, z, header);
+    else if (selection)
+        status = print_selection(&out, params, layout, &src);
+    else if (params->order != ORDER_FILE)
+        status = print_blocks(&out, params, layout, &src);
+    else if (params->nthread > 1  &&  (mf != NULL  ||  fd != -1))
+        status = print_records_in_parallel(&out, params, layout, &src);
+    else if (mf != NULL  ||  fd != -1)
+        status = print_source_records(&out, params, &src, nrecord);
+    else
+        status = print_streamed_records(&out, params, &src, nrecord);
+
+    if (status  &&  params->io_report)
+        fprintf(stderr, "read %llu of %llu bytes (%.1f%%) from data "
+            "file in %llu requests%s\n", out.bytes_read,
+            (unsigned long long) nrecord * nbytes, nrecord
+            ? 100.0 * out.bytes_read / ((double) nrecord * nbytes) : 0.0,
+            out.nread, proj.skip ? ", skipping unused columns" : "");
+    Stats_AddReads(out.stats, out.bytes_read, out.nread);
+
+    free_projection(&proj);
+    Filter_Destroy(z);
+    if (fd != -1)
+        close(fd);
+    if (mf != NULL)
+        MappedFile_Close(mf);
+    status = status  &&  flush_output(&out);
+
+    free_labels(&out);
+    free(out.buf);
+    return status;
+
+DESTROY_STATISTIC:
+    Filter_Destroy(z);
+CLOSE_MAPPING:
+    if (mf != NULL)
+        MappedFile_Close(mf);
+    free_labels(&out);
+FREE_BUFFER:
+    free(out.buf);
+    return 0;
+}
+
+int parse_data_file(struct Params *params, struct Layout *layout)
+{
+    BgzfWriter w;
+    struct ResultIndex index;
+    FILE *fp;         /* output file */
+    FILE *out;        /* output file or BGZF stream on top of it */
+    const char *file; /* name of output file */
+    int status, indexed;
+
+    if (params->output_file == NULL) {
+        fp = stdout;
+        file = "stdout";
+    }
+    else if ((fp = fopen(params->output_file, "wb")) == NULL) {
+        set_err_msg("failed to open file for writing: %s",
             params->output_file);
-        goto CLOSE_DATA_FILE;
+        return 0;
     }
+    else
+        file = params->output_file;
 
-    if (fclose(ifp)) {
+    /* With --compress=bgzf, we write to a stream that compresses
+       blocks and passes them on to the output file.  An output file
+       other than stdout gets an index of its blocks. */
+    out = fp;
+    indexed = params->compress == COMPRESS_BGZF
+        &&  params->output_file != NULL;
+    if (indexed  &&  !init_result_index(&index, layout, params->order))
+        goto CLOSE_OUTPUT_FILE;
+    if (params->compress == COMPRESS_BGZF
+        &&  ((w = BgzfWriter_Open(fp, file, params->nthread,
+                    indexed ? add_result_line : NULL, &index)) == NULL
+            ||  (out = BgzfWriter_OpenStream(w)) == NULL))
+        goto FREE_INDEX;
+
+    if (!convert_data_file(params, layout, out, file, 1))
+        goto CLOSE_BGZF_STREAM;
+
+    /* Closing the BGZF stream writes the pending blocks. */
+    if (out != fp  &&  fclose(out))
+        goto FREE_INDEX;
+
+    status = 1;
+    if (params->output_file != NULL  &&  fclose(fp)) {
         set_err_msg("failed to close file: %s",
-            params->data_file);
-        goto RETURN_ZERO;
+            params->output_file);
+        status = 0;
     }
+    else if (indexed)
+        status = write_index(&index, params->output_file);
+    if (indexed)
+        free_result_index(&index);
 
-    return 1;
+    return status;
 
     /* Don't use set_err_msg from here on: if we got here, it means
        there already was a problem and set_err_msg was used.  Using it
        again would overwrite the error message which states the
        initial problem and thus the actual reason behind the 0 return
        value. */
+CLOSE_BGZF_STREAM:
+    if (out != fp)
+        fclose(out);
+FREE_INDEX:
+    if (indexed)
+        free_result_index(&index);
 CLOSE_OUTPUT_FILE:
     if (params->output_file != NULL)
-        fclose(ofp);
-CLOSE_DATA_FILE:
-    fclose(ifp);
-RETURN_ZERO:
+        fclose(fp);
     return 0;
 }
@@ -5,31 +5,73 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #define NELEMS(x) (sizeof (x) / sizeof (x[0]))
 
+/* Read the header of the layout file into a, either from the mapping
+   or from fp. */
+static int read_header(const char *file, struct Layout *layout, FILE *fp,
+    int *a, size_t n)
+{
+    if (layout->map != NULL) {
+        if (MappedFile_Size(layout->map) < n * sizeof(int)) {
+            set_err_msg("unexpectedly reached end of layout file: %s",
+                file);
+            return 0;
+        }
+        memcpy(a, MappedFile_Data(layout->map), n * sizeof(int));
+        return 1;
+    }
+
+    if (fread(a, sizeof(int), n, fp) != n) {
+        if (ferror(fp))
+            set_err_msg("error while reading layout file: %s", file);
+        else
+            set_err_msg("unexpectedly reached end of layout file: %s",
+                file);
+        return 0;
+    }
+    return 1;
+}
+
+/* Parse the layout file.  We map the file and leave its labels where
+   they are.  Only the few beta, standard error, and covariance labels
+   get pointers into the mapping.  The snp and trait labels are found
+   on demand by snp_label and trait_label, so a page of labels is only
+   read when we print a record that needs it.  With tens of millions
+   of snps, this saves gigabytes of memory and seconds of startup.  If
+   the file cannot be mapped, e.g., because it is a pipe, we read the
+   labels into memory instead. */
 int parse_layout_file(const char *file, struct Layout *layout)
 {
     int a[8], i;
     FILE *fp;
-    int nlabel;                 /* number of labels in layout file */
+    size_t nlabel;              /* number of labels in layout file */
     size_t n;                   /* number of bytes used by labels */
-    char *buf, *s, **t;
+    char *buf, **t;
+    const char *s;
 
-    if ((fp = fopen(file, "rb")) == NULL) {
+    fp = NULL;
+    buf = NULL;
+    if ((layout->map = MappedFile_Open(file)) != NULL)
+        MappedFile_SetRandomAccess(layout->map);
+    else if ((fp = fopen(file, "rb")) == NULL) {
         set_err_msg("failed to open layout file for reading: %s", file);
         return 0;
     }
 
-    assert(fread(a, sizeof(int), NELEMS(a), fp) == NELEMS(a));
-    if (feof(fp)) {
-        set_err_msg("unexpectedly reached end of layout file: %s", file);
-        return 0;
-    }
-    if (ferror(fp)) {
-        set_err_msg("error while reading layout file: %s", file);
-        return 0;
-    }
+    if (!read_header(file, layout, fp, a, NELEMS(a)))
+        goto CLOSE_FILE;
+
+    /* A layout file written on a machine of the other byte order has
+       a byte-swapped magic number.  Its data file most likely has
+       byte-swapped values too (see parse_data_file). */
+    layout->swapped = a[0] != 6
+        &&  (int) __builtin_bswap32((unsigned) a[0]) == 6;
+    if (layout->swapped)
+        for (i = 0; i < (int) NELEMS(a); i++)
+            a[i] = (int) __builtin_bswap32((unsigned) a[i]);
 
     layout->magic_number     = a[0];
     layout->bytes_per_double = a[1];
@@ -47,75 +89,125 @@ int parse_layout_file(const char *file, struct Layout *layout)
        (nvar - 1) * nvar / 2 elements. */
     layout->ncov = ((layout->nvar - 1) * layout->nvar) / 2;
 
-    /* Read labels from layout file.
+    /* We can only locate the labels in a valid layout. */
+    if (!validate_layout(layout))
+        goto CLOSE_FILE;
+
+    /* Locate the labels in the layout file.
 
        We have nvar beta labels, nvar standard error labels, ncov
        covariances, nsnp snp labels, and ntrait trait labels.  Each
        label occupies max_char bytes. */
-    nlabel = layout->nvar + layout->nvar + layout->ncov + layout->nsnp
-        + layout->ntrait;
+    nlabel = (size_t) layout->nvar + layout->nvar + layout->ncov
+        + layout->nsnp + layout->ntrait;
     n = nlabel * layout->max_char;
-    if ((buf = (char *) malloc(n)) == NULL) {
-        set_err_msg("failed to allocate %lu bytes",
-            (unsigned long) n);
-        return 0;
+    if (layout->map != NULL) {
+        if (MappedFile_Size(layout->map) - sizeof(a) < n) {
+            set_err_msg("unexpectedly reached end of layout file: %s",
+                file);
+            goto CLOSE_FILE;
+        }
+        layout->label_data = MappedFile_Data(layout->map) + sizeof(a);
+    } else {
+        if ((buf = (char *) malloc(n)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) n);
+            goto CLOSE_FILE;
+        }
+        if (fread(buf, 1, n, fp) != n) {
+            set_err_msg("unexpectedly reached end of layout file: %s",
+                file);
+            goto CLOSE_FILE;
+        }
+        layout->label_data = buf;
     }
-    assert(fread(buf, n, 1, fp) == 1);
 
-    /* Since all labels are contained in buf, the label members of the
-       layout struct will be nothing but pointers into buf.  Before we
-       can set those pointers we have to allocate space for them. */
-    if ((t = (char **) malloc(nlabel * sizeof(char *))) == NULL) {
+    /* The first nvar strings, each of length max_char, correspond to
+       the beta coefficient labels.  Then come nvar standard error
+       labels, followed by ncov covariance labels, nsnp snp labels,
+       and finally ntrait trait labels.  Only the column labels get
+       pointers of their own. */
+    n = layout->nvar + layout->nvar + layout->ncov;
+    if ((t = (char **) malloc(n * sizeof(char *))) == NULL) {
         set_err_msg("failed to allocate %lu bytes for labels",
-            (unsigned long) n);
-        return 0;
+            (unsigned long) (n * sizeof(char *)));
+        goto CLOSE_FILE;
     }
     layout->beta_labels  = t;
     layout->se_labels    = layout->beta_labels + layout->nvar;
     layout->cov_labels   = layout->se_labels   + layout->nvar;
-    layout->snp_labels   = layout->cov_labels  + layout->ncov;
-    layout->trait_labels = layout->snp_labels  + layout->nsnp;
+    layout->snp_labels   = NULL;
+    layout->trait_labels = NULL;
+    for (s = layout->label_data, i = 0; i < (int) n;
+         i++, s += layout->max_char)
+        t[i] = (char *) s;
 
-    /* The first nvar strings, each of length max_char, correspond to
-       the beta coefficient labels.  Then come nvar standard error
-       labels, followed by ncov covariance labels, nsnp snp labels,
-       and finally ntrait trait labels.  We move a pointer to char
-       over buf in jumps of max_char bytes.  Hence, the pointer will
-       always point to the address of the first character of some
-       label.  The label addresses and thus the labels themselves are
-       stored in the corresponding label pointer bucket. */
-    s = buf;
-    for (i = 0; i < layout->nvar; i++, s += layout->max_char)
-        layout->beta_labels[i] = s;
-    for (i = 0; i < layout->nvar; i++, s += layout->max_char)
-        layout->se_labels[i] = s;
-    for (i = 0; i < layout->ncov; i++, s += layout->max_char)
-        layout->cov_labels[i] = s;
-    for (i = 0; i < layout->nsnp; i++, s += layout->max_char)
-        layout->snp_labels[i] = s;
-    for (i = 0; i < layout->ntrait; i++, s += layout->max_char)
-        layout->trait_labels[i] = s;
-
-    if (fclose(fp)) {
+    if (fp != NULL  &&  fclose(fp)) {
         set_err_msg("failed to close layout file after reading: %s",
             file);
-        return 0;
+        fp = NULL;
+        goto CLOSE_FILE;
     }
 
     return 1;
+
+CLOSE_FILE:
+    free(buf);
+    if (fp != NULL)
+        fclose(fp);
+    if (layout->map != NULL)
+        MappedFile_Close(layout->map);
+    layout->map = NULL;
+    layout->label_data = NULL;
+    return 0;
+}
+
+/* Return the label of the given snp.  Layouts built in memory have an
+   array of snp labels; parsed layouts leave the labels in the layout
+   file. */
+const char *snp_label(const struct Layout *layout, int snp)
+{
+    if (layout->snp_labels != NULL)
+        return layout->snp_labels[snp];
+    return layout->label_data + ((size_t) 2 * layout->nvar + layout->ncov
+        + snp) * layout->max_char;
+}
+
+const char *trait_label(const struct Layout *layout, int trait)
+{
+    if (layout->trait_labels != NULL)
+        return layout->trait_labels[trait];
+    return layout->label_data + ((size_t) 2 * layout->nvar + layout->ncov
+        + layout->nsnp + trait) * layout->max_char;
+}
+
+/* Free the labels of a layout returned by parse_layout_file. */
+void free_layout(struct Layout *layout)
+{
+    if (layout->map != NULL)
+        MappedFile_Close(layout->map);
+    else
+        free((char *) layout->label_data);
+    free(layout->beta_labels);
+    layout->map = NULL;
+    layout->label_data = NULL;
+    layout->beta_labels = layout->se_labels = layout->cov_labels = NULL;
 }
 
 int validate_layout(struct Layout *layout)
 {
+    unsigned long long nrecord, nbytes;
+
     if (layout->magic_number != 6) {
         set_err_msg("bad magic number in layout file: expected 6, got %d",
             layout->magic_number);
         return 0;
     }
 
-    if (layout->bytes_per_double <= 0) {
+    /* Values are stored in single or double precision. */
+    if (layout->bytes_per_double != 4  &&  layout->bytes_per_double != 8) {
         set_err_msg("bad number of bytes per double in layout file: "
-            "expected >0, got %d", layout->bytes_per_double);
+            "expected 4 or 8, got %d", layout->bytes_per_double);
         return 0;
     }
 
@@ -158,6 +250,17 @@ int validate_layout(struct Layout *layout)
         return 0;
     }
 
+    /* Records are addressed by unsigned long offsets, and so are their
+       bytes in the data file.  With 64-bit longs, this leaves room for
+       any number of snps and traits that fits into the layout file. */
+    nrecord = (unsigned long long) layout->nsnp * layout->ntrait;
+    nbytes = (2ULL * layout->nvar + layout->ncov) * layout->bytes_per_double;
+    if (nrecord > ULONG_MAX / nbytes) {
+        set_err_msg("too many records in layout file: %llu records of "
+            "%llu bytes each", nrecord, nbytes);
+        return 0;
+    }
+
     return 1;
 }
 
@@ -166,7 +269,7 @@ int write_layout_file(const char *file, struct Layout *layout)
     int a[8], i;
     FILE *fp;
     char *buf, *s;
-    int nlabel;                 /* number of labels in layout file */
+    size_t nlabel;              /* number of labels in layout file */
     size_t n;                   /* number of bytes used by labels */
 
     if ((fp = fopen(file, "wb")) == NULL) {
@@ -218,8 +321,8 @@ int write_layout_file(const char *file, struct Layout *layout)
        We have nvar beta labels, nvar standard error labels, ncov
        covariances, nsnp snp labels, and ntrait trait labels.  Each
        label occupies max_char bytes. */
-    nlabel = layout->nvar + layout->nvar + layout->ncov + layout->nsnp
-        + layout->ntrait;
+    nlabel = (size_t) layout->nvar + layout->nvar + layout->ncov
+        + layout->nsnp + layout->ntrait;
     n = nlabel * layout->max_char;
 
     if ((buf = (char *) malloc(n * sizeof(char))) == NULL) {
@@ -228,8 +331,7 @@ int write_layout_file(const char *file, struct Layout *layout)
     }
     /* Since we are going to use [[buf]] for storing NUL terminated
        strings we initialize it with NUL characters. */
-    for (i = 0; (unsigned) i < n; i++)
-        buf[i] = '\0';
+    memset(buf, 0, n);
 
     /* Copy labels into buf.  To be on the safe side we explicitly
        terminate every label with a NUL character. */
@@ -247,11 +349,11 @@ int write_layout_file(const char *file, struct Layout *layout)
         s[layout->max_char - 1] = '\0';
     }
     for (i = 0; i < layout->nsnp; i++, s += layout->max_char) {
-        strncpy(s, layout->snp_labels[i], layout->max_char);
+        strncpy(s, snp_label(layout, i), layout->max_char);
         s[layout->max_char - 1] = '\0';
     }
     for (i = 0; i < layout->ntrait; i++, s += layout->max_char) {
-        strncpy(s, layout->trait_labels[i], layout->max_char);
+        strncpy(s, trait_label(layout, i), layout->max_char);
         s[layout->max_char - 1] = '\0';
     }
 
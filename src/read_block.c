@@ -0,0 +1,324 @@
+#include "read_block.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* Records hold nvar betas, nvar standard errors, and ncov covariances.
+   With many covariates, the covariances make up most of a record, but
+   they are rarely selected with --column.  If a record spans several
+   pages, the pages between the used columns of consecutive records
+   need not be read at all.  Skipping them only pays off if it saves a
+   good part of the pages, though: every skipped range costs an extra
+   system call, and the kernel can no longer read ahead for us. */
+
+/* Records in the sample that decides whether skipping pays off. */
+enum { PROJECTION_SAMPLE = 4096 };
+
+/* Compute the spans of the ncolumn columns of a record for which
+   used[j] is set and decide whether skipping unneeded pages pays off:
+   it does if fewer than half the pages of a sample of consecutive
+   records hold used bytes. */
+int make_projection(struct Projection *proj, const unsigned char *used,
+    int ncolumn, size_t bytes_per_double, size_t page_size)
+{
+    unsigned long k, page, last, ntouched, npage;
+    size_t nbytes, a, b;
+    int j, n;
+
+    for (n = j = 0; j < ncolumn; j++)
+        if (used[j]  &&  (j == 0  ||  !used[j - 1]))
+            n++;
+
+    proj->nspan = 0;
+    proj->page_size = page_size;
+    proj->skip = 0;
+    proj->start = (size_t *) malloc((n + 1) * sizeof(size_t));
+    proj->len = (size_t *) malloc((n + 1) * sizeof(size_t));
+    if (proj->start == NULL  ||  proj->len == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) (2 * (n + 1) * sizeof(size_t)));
+        free_projection(proj);
+        return 0;
+    }
+
+    for (j = 0; j < ncolumn; j++)
+        if (used[j]  &&  (j == 0  ||  !used[j - 1])) {
+            proj->start[proj->nspan] = j * bytes_per_double;
+            proj->len[proj->nspan] = 0;
+            proj->nspan++;
+        }
+        else if (!used[j]  &&  j > 0  &&  used[j - 1])
+            proj->len[proj->nspan - 1] = j * bytes_per_double
+                - proj->start[proj->nspan - 1];
+    if (proj->nspan > 0  &&  used[ncolumn - 1])
+        proj->len[proj->nspan - 1] = ncolumn * bytes_per_double
+            - proj->start[proj->nspan - 1];
+
+    /* Count the pages touched by the sample. */
+    nbytes = ncolumn * bytes_per_double;
+    ntouched = 0;
+    last = (unsigned long) -1;
+    for (k = 0; k < PROJECTION_SAMPLE; k++)
+        for (j = 0; j < proj->nspan; j++) {
+            a = k * nbytes + proj->start[j];
+            b = a + proj->len[j];
+            for (page = a / page_size; page * page_size < b; page++)
+                if (page != last) {
+                    ntouched++;
+                    last = page;
+                }
+        }
+    npage = (PROJECTION_SAMPLE * nbytes + page_size - 1) / page_size;
+    proj->skip = 2 * ntouched < npage;
+
+    return 1;
+}
+
+void free_projection(struct Projection *proj)
+{
+    free(proj->start);
+    free(proj->len);
+    proj->start = proj->len = NULL;
+}
+
+void init_record_source(struct RecordSource *src, const char *file,
+    const char *data, int fd, size_t nbytes)
+{
+    src->file = file;
+    src->data = data;
+    src->fd = fd;
+    src->nbytes = nbytes;
+    src->proj = NULL;
+    src->staging = NULL;
+    src->staging_size = 0;
+    src->bytes_read = 0;
+    src->nread = 0;
+    src->decode = NULL;
+    src->record_size = nbytes;
+    src->decoded = NULL;
+    src->decoded_size = 0;
+}
+
+void free_record_source(struct RecordSource *src)
+{
+    free(src->staging);
+    src->staging = NULL;
+    src->staging_size = 0;
+    free(src->decoded);
+    src->decoded = NULL;
+    src->decoded_size = 0;
+}
+
+/* Decode records of nvalue values each with decode from now on. */
+void set_record_decoder(struct RecordSource *src, DecodeFunc decode,
+    int nvalue)
+{
+    src->decode = decode;
+    src->record_size = nvalue * sizeof(double);
+}
+
+/* Decode the n records at *p into native doubles and point *p to the
+   decoded records, which stay valid until the next call.  Without a
+   decoder, leave *p alone. */
+int decode_records(struct RecordSource *src, unsigned long n,
+    const char **p)
+{
+    size_t size;
+    char *t;
+
+    if (src->decode == NULL)
+        return 1;
+    size = n * src->record_size;
+    if (src->decoded_size < size) {
+        if ((t = (char *) realloc(src->decoded, size)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) size);
+            return 0;
+        }
+        src->decoded = t;
+        src->decoded_size = size;
+    }
+    src->decode((double *) src->decoded, *p,
+        n * (src->record_size / sizeof(double)));
+    *p = src->decoded;
+    return 1;
+}
+
+/* Fetch bytes a to b - 1 of the data file, the first byte of which
+   belongs to the first of the n records starting at offset. */
+static int fetch(struct RecordSource *src, unsigned long offset,
+    unsigned long n, size_t a, size_t b)
+{
+    size_t base, page;
+    ssize_t nread;
+
+    src->bytes_read += b - a;
+    src->nread++;
+
+    /* Ask the kernel to read the pages in the background. */
+    if (src->data != NULL) {
+        page = src->proj != NULL ? src->proj->page_size : 1;
+        if (src->proj != NULL  &&  src->proj->skip)
+            madvise((void *) (src->data + a / page * page),
+                b - a / page * page, MADV_WILLNEED);
+        return 1;
+    }
+
+    base = offset * src->nbytes;
+    nread = pread(src->fd, src->staging + (a - base), b - a, a);
+    if (nread < 0  ||  (size_t) nread != b - a) {
+        set_err_msg("failed to read records %lu to %lu from data file: "
+            "%s", offset, offset + n - 1, src->file);
+        return 0;
+    }
+    return 1;
+}
+
+/* With a projection that skips pages, fetch only the pages of the
+   n records starting at offset that hold needed bytes.  Adjacent
+   pages are fetched together. */
+static int fetch_projected(struct RecordSource *src,
+    unsigned long offset, unsigned long n)
+{
+    const struct Projection *proj = src->proj;
+    size_t base, end, a, b, ra, rb, page;
+    unsigned long k;
+    int j;
+
+    page = proj->page_size;
+    base = offset * src->nbytes;
+    end = base + n * src->nbytes;
+    ra = rb = base;
+    for (k = 0; k < n; k++)
+        for (j = 0; j < proj->nspan; j++) {
+            a = base + k * src->nbytes + proj->start[j];
+            b = a + proj->len[j];
+            a = a / page * page;
+            b = (b + page - 1) / page * page;
+            if (a < base)
+                a = base;
+            if (b > end)
+                b = end;
+            if (a <= rb  &&  ra < rb) {
+                if (b > rb)
+                    rb = b;
+                continue;
+            }
+            if (ra < rb  &&  !fetch(src, offset, n, ra, rb))
+                return 0;
+            ra = a;
+            rb = b;
+        }
+    return ra == rb  ||  fetch(src, offset, n, ra, rb);
+}
+
+/* Make the n records starting at the given offset available at *p.
+   For a mapped data file *p points into the mapping.  Otherwise the
+   records are read into the staging buffer, which stays valid until
+   the next call.  With a projection that skips pages, only the bytes
+   of the projection's spans are guaranteed to be valid. */
+int read_records(struct RecordSource *src, unsigned long offset,
+    unsigned long n, const char **p)
+{
+    size_t nbytes;
+    char *t;
+
+    nbytes = n * src->nbytes;
+    if (src->data == NULL  &&  src->staging_size < nbytes) {
+        if ((t = (char *) realloc(src->staging, nbytes)) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) nbytes);
+            return 0;
+        }
+        src->staging = t;
+        src->staging_size = nbytes;
+    }
+
+    if (src->proj != NULL  &&  src->proj->skip) {
+        if (!fetch_projected(src, offset, n))
+            return 0;
+    }
+    else if (!fetch(src, offset, n, offset * src->nbytes,
+            offset * src->nbytes + nbytes))
+        return 0;
+
+    *p = src->data != NULL ? src->data + offset * src->nbytes
+        : src->staging;
+    return 1;
+}
+
+/* Reads of pieces of tile rows shorter than this many bytes are
+   merged into one read of the tile range that contains them. */
+enum { MIN_READ_SIZE = 1 << 16 };
+
+/* Copy the records of traits trait0 to trait1 - 1 and snps snp0 to
+   snp1 - 1 into buf, trait by trait: the record of trait t and snp s
+   ends up at record index (t - trait0) * (snp1 - snp0) + (s - snp0).
+
+   Within a tile, consecutive traits are stored one after the other,
+   so the records that we need from a tile lie in a single contiguous
+   range of the data file.  We usually read that range at once and
+   pick out the pieces that we need.  Tiles are visited in file order,
+   so all reads go forward.  If the block covers whole tile rows, the
+   range holds exactly the records in the block.  Otherwise the range
+   also holds records of snps outside the block.  For a mapped data
+   file we don't care, since we only touch the pages that we copy
+   from.  With pread(2) we read the pieces separately, unless they are
+   so small that reading them one by one would cost more than reading
+   the records in between. */
+int read_block(struct RecordSource *src, struct Layout *layout,
+    int trait0, int trait1, int snp0, int snp1, char *buf)
+{
+    unsigned long first, last, offset;
+    int row, col, nrow, ncol, ta, tb, sa, sb, t, width, by_row;
+    const char *p;
+    char *q;
+    size_t nbytes;
+
+    nbytes = src->nbytes;
+    width = snp1 - snp0;
+
+    row = trait0 - trait0 % layout->traits_per_tile;
+    for (; row < trait1; row += layout->traits_per_tile) {
+        nrow = layout->ntrait - row < layout->traits_per_tile
+            ? layout->ntrait - row : layout->traits_per_tile;
+        ta = trait0 > row ? trait0 : row;
+        tb = trait1 < row + nrow ? trait1 : row + nrow;
+
+        col = snp0 - snp0 % layout->snps_per_tile;
+        for (; col < snp1; col += layout->snps_per_tile) {
+            ncol = layout->nsnp - col < layout->snps_per_tile
+                ? layout->nsnp - col : layout->snps_per_tile;
+            sa = snp0 > col ? snp0 : col;
+            sb = snp1 < col + ncol ? snp1 : col + ncol;
+
+            by_row = src->data == NULL  &&  sb - sa < ncol
+                &&  (sb - sa) * nbytes >= MIN_READ_SIZE;
+
+            index2offset(sa, ta, &first, layout);
+            index2offset(sb - 1, tb - 1, &last, layout);
+            if (!by_row  &&  !read_records(src, first,
+                    last - first + 1, &p))
+                return 0;
+
+            /* Rows within a tile are ncol records apart. */
+            for (t = ta, offset = first; t < tb; t++, offset += ncol) {
+                q = buf + ((unsigned long) (t - trait0) * width
+                    + (sa - snp0)) * nbytes;
+                if (!by_row)
+                    memcpy(q, p + (offset - first) * nbytes,
+                        (sb - sa) * nbytes);
+                else if (!read_records(src, offset, sb - sa, &p))
+                    return 0;
+                else
+                    memcpy(q, p, (sb - sa) * nbytes);
+            }
+        }
+    }
+
+    return 1;
+}
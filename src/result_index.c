@@ -0,0 +1,314 @@
+#include "result_index.h"
+#include "parse_data_file.h"
+#include "parse_command_line_args.h"
+#include "Bgzf.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* With --compress=bgzf, lines are written in a known order: file,
+   trait, or snp order (see --order), also with --where and label
+   files, which only leave out lines.  Every snp-trait pair therefore
+   has a key that increases from line to line:
+
+       file order    index2offset(snp, trait)
+       trait order   trait * nsnp + snp
+       snp order     snp * ntrait + trait
+
+   For every BGZF block, the index records the key and the virtual
+   offset of the first line that lies completely within the block.
+   To fetch a pair, we look up the last entry whose key is not larger
+   than the pair's key and scan the lines up to the next entry, which
+   decompresses about one block.
+
+   The index file holds a header of 8 magic bytes and four 32-bit
+   integers (order, nsnp, ntrait, and 0), the number of entries as a
+   64-bit integer, and the entries as pairs of 64-bit integers (key,
+   virtual offset), all in native byte order. */
+
+static const char magic[8] = "R3SIDX1";
+
+enum { HEADER_SIZE = 8 + 4 * 4 + 8, ENTRY_SIZE = 16 };
+
+static unsigned long long key_of(struct Layout *layout, int order,
+    int snp, int trait)
+{
+    unsigned long offset;
+
+    if (order == ORDER_TRAIT)
+        return (unsigned long long) trait * layout->nsnp + snp;
+    if (order == ORDER_SNP)
+        return (unsigned long long) snp * layout->ntrait + trait;
+    index2offset(snp, trait, &offset, layout);
+    return offset;
+}
+
+int init_result_index(struct ResultIndex *index, struct Layout *layout,
+    int order)
+{
+    index->layout = layout;
+    index->order = order;
+    index->entry = NULL;
+    index->n = index->size = 0;
+    index->snps.slots = index->traits.slots = NULL;
+    if ((index->label = (char *) malloc(layout->max_char + 1)) == NULL) {
+        set_err_msg("failed to allocate %d bytes", layout->max_char + 1);
+        return 0;
+    }
+    if (!build_label_index(&index->snps, layout, snp_label, layout->nsnp)
+        ||  !build_label_index(&index->traits, layout, trait_label,
+            layout->ntrait)) {
+        free_result_index(index);
+        return 0;
+    }
+    return 1;
+}
+
+/* Copy the blank-terminated label at *s into the scratch buffer and
+   advance *s past the blank.  Return 0 if there is no such label. */
+static int next_label(struct ResultIndex *index, const char **s,
+    const char *end)
+{
+    const char *p;
+
+    for (p = *s; p < end  &&  *p != ' '  &&  *p != '\n'; p++)
+        ;
+    if (p == end  ||  p - *s > index->layout->max_char)
+        return 0;
+    memcpy(index->label, *s, p - *s);
+    index->label[p - *s] = '\0';
+    *s = p + 1;
+    return 1;
+}
+
+/* Add an entry for the line at voffset.  Lines that don't start with
+   a snp and a trait label, like the header, are skipped.  Called as
+   a BgzfLineHook. */
+int add_result_line(void *arg, unsigned long long voffset,
+    const char *line, size_t len)
+{
+    struct ResultIndex *index = (struct ResultIndex *) arg;
+    const char *end;
+    unsigned long long *t;
+    unsigned long n;
+    int snp, trait;
+
+    end = line + len;
+    if (!next_label(index, &line, end)
+        ||  (snp = lookup_label(&index->snps, index->label)) == -1
+        ||  !next_label(index, &line, end)
+        ||  (trait = lookup_label(&index->traits, index->label)) == -1)
+        return 1;
+
+    if (index->n == index->size) {
+        n = index->size ? 2 * index->size : 1024;
+        if ((t = (unsigned long long *) realloc(index->entry,
+                    2 * n * sizeof(unsigned long long))) == NULL) {
+            set_err_msg("failed to allocate %lu bytes",
+                (unsigned long) (2 * n * sizeof(unsigned long long)));
+            return 0;
+        }
+        index->entry = t;
+        index->size = n;
+    }
+    index->entry[2 * index->n] = key_of(index->layout, index->order, snp,
+        trait);
+    index->entry[2 * index->n + 1] = voffset;
+    index->n++;
+
+    return 1;
+}
+
+int write_result_index(const struct ResultIndex *index, const char *file)
+{
+    FILE *fp;
+    unsigned int h[4];
+    unsigned long long n;
+
+    if ((fp = fopen(file, "wb")) == NULL) {
+        set_err_msg("failed to open file for writing: %s", file);
+        return 0;
+    }
+    h[0] = index->order;
+    h[1] = index->layout->nsnp;
+    h[2] = index->layout->ntrait;
+    h[3] = 0;
+    n = index->n;
+    if (fwrite(magic, sizeof magic, 1, fp) != 1
+        ||  fwrite(h, sizeof h, 1, fp) != 1
+        ||  fwrite(&n, sizeof n, 1, fp) != 1
+        ||  (n > 0  &&  fwrite(index->entry, ENTRY_SIZE, n, fp) != n)) {
+        set_err_msg("failed to write to index file: %s", file);
+        fclose(fp);
+        return 0;
+    }
+    if (fclose(fp)) {
+        set_err_msg("failed to close file: %s", file);
+        return 0;
+    }
+    return 1;
+}
+
+void free_result_index(struct ResultIndex *index)
+{
+    free(index->label);
+    free(index->entry);
+    free_label_index(&index->snps);
+    free_label_index(&index->traits);
+    index->label = NULL;
+    index->entry = NULL;
+}
+
+/* Read entry i of the index file into e[0] (key) and e[1] (virtual
+   offset). */
+static int read_entry(FILE *fp, const char *file, unsigned long long i,
+    unsigned long long *e)
+{
+    if (fseeko(fp, (off_t) (HEADER_SIZE + i * ENTRY_SIZE), SEEK_SET) != 0
+        ||  fread(e, ENTRY_SIZE, 1, fp) != 1) {
+        set_err_msg("failed to read entry %llu of index file: %s", i,
+            file);
+        return 0;
+    }
+    return 1;
+}
+
+/* Find the lines between which the line of the given pair must be
+   if it is in the output: from *start up to but excluding *end. */
+static int find_range(const char *index_file, struct Layout *layout,
+    int snp, int trait, unsigned long long *start, unsigned long long *end)
+{
+    FILE *fp;
+    char m[sizeof magic];
+    unsigned int h[4];
+    unsigned long long n, lo, hi, mid, key, e[2];
+    int status;
+
+    if ((fp = fopen(index_file, "rb")) == NULL) {
+        set_err_msg("failed to open file for reading: %s", index_file);
+        return 0;
+    }
+    status = 0;
+    if (fread(m, sizeof m, 1, fp) != 1  ||  memcmp(m, magic, sizeof m)
+        ||  fread(h, sizeof h, 1, fp) != 1  ||  fread(&n, sizeof n, 1, fp)
+        != 1) {
+        set_err_msg("not an index file: %s", index_file);
+        goto CLOSE_INDEX_FILE;
+    }
+    if (h[1] != (unsigned int) layout->nsnp
+        ||  h[2] != (unsigned int) layout->ntrait) {
+        set_err_msg("index file doesn't match layout: %s", index_file);
+        goto CLOSE_INDEX_FILE;
+    }
+
+    /* Find the number lo of entries whose key is not larger. */
+    key = key_of(layout, h[0], snp, trait);
+    for (lo = 0, hi = n; lo < hi; ) {
+        mid = lo + (hi - lo) / 2;
+        if (!read_entry(fp, index_file, mid, e))
+            goto CLOSE_INDEX_FILE;
+        if (e[0] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *start = 0;
+    *end = (unsigned long long) -1;
+    if (lo > 0  &&  !read_entry(fp, index_file, lo - 1, e))
+        goto CLOSE_INDEX_FILE;
+    if (lo > 0)
+        *start = e[1];
+    if (lo < n  &&  !read_entry(fp, index_file, lo, e))
+        goto CLOSE_INDEX_FILE;
+    if (lo < n)
+        *end = e[1];
+    status = 1;
+
+CLOSE_INDEX_FILE:
+    fclose(fp);
+    return status;
+}
+
+/* Copy the line of the given snp and trait from the BGZF-compressed
+   output file into line, which holds size bytes, without its newline.
+   Longer lines are truncated. */
+int fetch_result(const char *output_file, const char *index_file,
+    struct Layout *layout, int snp, int trait, char *line, size_t size)
+{
+    FILE *fp;
+    char *buf;
+    const char *snp_name, *trait_name;
+    unsigned long long start, end, coffset, next, voffset;
+    size_t len, pos, n, nsnp_label, ntrait_label;
+    int status, skip_header, found;
+
+    if (!find_range(index_file, layout, snp, trait, &start, &end))
+        return 0;
+    if ((fp = fopen(output_file, "rb")) == NULL) {
+        set_err_msg("failed to open file for reading: %s", output_file);
+        return 0;
+    }
+    if ((buf = (char *) malloc(BGZF_MAX_BLOCK)) == NULL) {
+        set_err_msg("failed to allocate %lu bytes",
+            (unsigned long) BGZF_MAX_BLOCK);
+        fclose(fp);
+        return 0;
+    }
+
+    snp_name = snp_label(layout, snp);
+    trait_name = trait_label(layout, trait);
+    nsnp_label = strlen(snp_name);
+    ntrait_label = strlen(trait_name);
+
+    /* Scan the lines from start to end.  A line starts at voffset and
+       its first n bytes are in line. */
+    status = 0;
+    found = 0;
+    skip_header = start == 0;
+    coffset = start >> 16;
+    pos = start & 0xffff;
+    voffset = start;
+    n = 0;
+    while (!found) {
+        if (!Bgzf_ReadBlock(fp, coffset, buf, &len, &next))
+            goto FREE_BUFFER;
+        if (len == 0)
+            break;              /* end of file */
+        for (; pos < len  &&  !found; pos++) {
+            if (n + 1 < size)
+                line[n++] = buf[pos];
+            if (buf[pos] != '\n')
+                continue;
+            line[n - 1] = '\0';
+            found = !skip_header
+                &&  !strncmp(line, snp_name, nsnp_label)
+                &&  line[nsnp_label] == ' '
+                &&  !strncmp(line + nsnp_label + 1, trait_name,
+                    ntrait_label)
+                &&  (line[nsnp_label + 1 + ntrait_label] == ' '
+                    ||  line[nsnp_label + 1 + ntrait_label] == '\0');
+            skip_header = 0;
+            n = 0;
+            voffset = pos + 1 < len ? coffset << 16 | (pos + 1)
+                : next << 16;
+            if (voffset >= end)
+                break;
+        }
+        if (voffset >= end  &&  !found)
+            break;
+        coffset = next;
+        pos = 0;
+    }
+
+    if (!found)
+        set_err_msg("no line for snp %s and trait %s in %s", snp_name,
+            trait_name, output_file);
+    status = found;
+
+FREE_BUFFER:
+    free(buf);
+    fclose(fp);
+    return status;
+}
@@ -0,0 +1,175 @@
+#include "run_ordered.h"
+#include "err_msg.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* run_ordered processes units 0 to nunit - 1 on nthread worker threads
+   and hands the results to emit in unit order.  Workers grab the next
+   unprocessed unit as soon as they are done with the previous one, so
+   units of different sizes are balanced automatically.  Each unit is
+   processed into one of nslot chunks, where unit u always uses slot
+   u % nslot.  A worker may only start on unit u once the unit that
+   last used the slot has been emitted.  This bounds the amount of
+   memory held by units that are done but cannot be emitted yet because
+   an earlier unit is still being processed.
+
+   Once a unit fails, workers take no new units, but units that are
+   already taken are finished.  If several of them fail, we keep the
+   message of the earliest unit, which is the one that a single thread
+   would have failed on, whichever thread happens to fail first. */
+
+enum { SLOTS_PER_THREAD = 4 };
+
+enum SlotState { SLOT_FREE, SLOT_BUSY, SLOT_DONE };
+
+struct Slot {
+    struct Chunk chunk;
+    enum SlotState state;
+};
+
+struct Pool {
+    pthread_mutex_t lock;
+    pthread_cond_t done;        /* signaled when a slot becomes done */
+    pthread_cond_t free;        /* signaled when a slot becomes free */
+    struct Slot *slot;
+    int nslot;
+    unsigned long nunit;
+    unsigned long next_unit;    /* next unit to hand to a worker */
+    int failed;                 /* Did a worker or emit fail? */
+    unsigned long failed_unit;  /* earliest unit that failed */
+    char err[ERR_MSG_MAXLEN];   /* message of its failure */
+    Work work;
+    void *arg;
+};
+
+struct Worker {
+    struct Pool *pool;
+    int id;
+    pthread_t thread;
+};
+
+/* Record the failure of unit with the calling thread's error message,
+   unless an earlier unit failed.  Must be called with the lock
+   held. */
+static void fail(struct Pool *p, unsigned long unit)
+{
+    if (!p->failed  ||  unit < p->failed_unit) {
+        p->failed = 1;
+        p->failed_unit = unit;
+        memcpy(p->err, err_msg, ERR_MSG_MAXLEN);
+    }
+    pthread_cond_broadcast(&p->done);
+    pthread_cond_broadcast(&p->free);
+}
+
+static void *work_loop(void *arg)
+{
+    struct Worker *w = (struct Worker *) arg;
+    struct Pool *p = w->pool;
+    struct Slot *s;
+    unsigned long unit;
+    int ok;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->failed  &&  p->next_unit < p->nunit) {
+        unit = p->next_unit;
+        s = &p->slot[unit % p->nslot];
+        if (s->state != SLOT_FREE) {
+            pthread_cond_wait(&p->free, &p->lock);
+            continue;
+        }
+        s->state = SLOT_BUSY;
+        ++p->next_unit;
+        pthread_mutex_unlock(&p->lock);
+
+        s->chunk.len = 0;
+        ok = p->work(p->arg, w->id, unit, &s->chunk);
+
+        pthread_mutex_lock(&p->lock);
+        if (!ok)
+            fail(p, unit);
+        s->state = SLOT_DONE;
+        pthread_cond_broadcast(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+int run_ordered(int nthread, unsigned long nunit, Work work, Emit emit,
+    void *arg)
+{
+    struct Pool p;
+    struct Worker *w;
+    struct Slot *s;
+    unsigned long unit;
+    int i, nstarted, ok;
+
+    p.nslot = SLOTS_PER_THREAD * nthread;
+    p.nunit = nunit;
+    p.next_unit = 0;
+    p.failed = 0;
+    p.failed_unit = 0;
+    p.work = work;
+    p.arg = arg;
+
+    if ((p.slot = (struct Slot *) calloc(p.nslot, sizeof(struct Slot)))
+        == NULL
+        ||  (w = (struct Worker *) calloc(nthread, sizeof(struct Worker)))
+        == NULL) {
+        free(p.slot);
+        set_err_msg("failed to allocate memory for %d threads", nthread);
+        return 0;
+    }
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.done, NULL);
+    pthread_cond_init(&p.free, NULL);
+
+    pthread_mutex_lock(&p.lock);
+    for (nstarted = 0; nstarted < nthread; nstarted++) {
+        w[nstarted].pool = &p;
+        w[nstarted].id = nstarted;
+        if (pthread_create(&w[nstarted].thread, NULL, work_loop,
+                &w[nstarted])) {
+            set_err_msg("failed to create worker thread");
+            fail(&p, 0);
+            break;
+        }
+    }
+
+    /* Emit chunks in unit order as they become available. */
+    for (unit = 0; unit < nunit  &&  !p.failed; unit++) {
+        s = &p.slot[unit % p.nslot];
+        while (s->state != SLOT_DONE  &&  !p.failed)
+            pthread_cond_wait(&p.done, &p.lock);
+        if (p.failed)
+            break;
+        pthread_mutex_unlock(&p.lock);
+        ok = emit(arg, unit, &s->chunk);
+        pthread_mutex_lock(&p.lock);
+        if (!ok)
+            fail(&p, unit);
+        s->state = SLOT_FREE;
+        pthread_cond_broadcast(&p.free);
+    }
+    pthread_mutex_unlock(&p.lock);
+
+    for (i = 0; i < nstarted; i++)
+        pthread_join(w[i].thread, NULL);
+
+    pthread_cond_destroy(&p.free);
+    pthread_cond_destroy(&p.done);
+    pthread_mutex_destroy(&p.lock);
+    for (i = 0; i < p.nslot; i++)
+        free(p.slot[i].chunk.data);
+    free(p.slot);
+    free(w);
+
+    if (p.failed) {
+        memcpy(err_msg, p.err, ERR_MSG_MAXLEN);
+        return 0;
+    }
+
+    return 1;
+}
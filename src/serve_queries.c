@@ -0,0 +1,610 @@
+#include "serve_queries.h"
+#include "reader_layout.h"
+#include "TileCache.h"
+#include "Histogram.h"
+#include "err_msg.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+/* Interactive tools look up a few records at a time, thousands of
+   times a minute.  Starting r3shuffle for every lookup would parse the
+   layout file every time and start with a cold page cache.  "r3shuffle
+   serve" instead opens a result set once, with a Reader, and answers
+   queries from clients on a Unix domain socket until a client asks it
+   to shut down.  The protocol is described in serve_queries.h.
+
+   Every client connection gets a thread of its own.  Records are
+   looked up in decoded tiles that a TileCache keeps, up to --max-memory
+   bytes of them, so records of the same tile as an earlier one cost a
+   copy of their columns.  The latency of every query goes into a
+   Histogram, whose percentiles clients get with SERVE_STATS.
+
+   The functions serve_connect, serve_query, serve_stats and
+   serve_shutdown are the client side of the protocol. */
+
+/* Clients beyond this many are turned away. */
+enum { MAX_CONNECTIONS = 64 };
+
+struct Server {
+    Reader reader;
+    const struct Layout *layout;
+    int nvalue;                 /* number of values per record */
+    int ntile_col;              /* number of tiles per tile row */
+    TileCache cache;            /* decoded tiles */
+    Histogram latency;          /* nanoseconds per query */
+    unsigned long long nrecord; /* records returned */
+    int listen_fd;
+    int conn[MAX_CONNECTIONS];  /* client sockets or -1 */
+    int nconn;                  /* number of clients */
+    int stop;                   /* Did a client ask to shut down? */
+    pthread_mutex_t lock;       /* guards everything from cache on */
+    pthread_cond_t idle;        /* signaled when a client leaves */
+};
+
+/* A client of the server and the buffers for its queries. */
+struct Client {
+    struct Server *s;
+    int slot;                   /* index into s->conn */
+    int fd;
+    uint32_t *columns;
+    int32_t *queries;
+    double *values;
+    size_t nquery_max;          /* queries that the buffers hold */
+};
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Read len bytes into buf.  Return 0 at end of file or on error. */
+static int read_fully(int fd, void *buf, size_t len)
+{
+    char *p = (char *) buf;
+    ssize_t k;
+
+    while (len > 0) {
+        if ((k = read(fd, p, len)) <= 0) {
+            if (k < 0  &&  errno == EINTR)
+                continue;
+            return 0;
+        }
+        p += k;
+        len -= k;
+    }
+    return 1;
+}
+
+/* Send all n buffers in iov as a single message if possible.  A
+   client that went away must not kill us with SIGPIPE. */
+static int send_fully(int fd, struct iovec *iov, int n)
+{
+    struct msghdr msg;
+    ssize_t k;
+
+    memset(&msg, 0, sizeof msg);
+    while (n > 0) {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        if ((k = sendmsg(fd, &msg, MSG_NOSIGNAL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return 0;
+        }
+        for (; n > 0  &&  (size_t) k >= iov->iov_len; iov++, n--)
+            k -= iov->iov_len;
+        if (n > 0) {
+            iov->iov_base = (char *) iov->iov_base + k;
+            iov->iov_len -= k;
+        }
+    }
+    return 1;
+}
+
+static int send_reply(int fd, uint32_t status, const void *data,
+    uint32_t n, size_t size)
+{
+    struct ServeReply reply;
+    struct iovec iov[2];
+
+    reply.status = status;
+    reply.n = n;
+    iov[0].iov_base = &reply;
+    iov[0].iov_len = sizeof reply;
+    iov[1].iov_base = (void *) data;
+    iov[1].iov_len = n * size;
+    return send_fully(fd, iov, n > 0 ? 2 : 1);
+}
+
+/* Send err_msg as the reply. */
+static int send_error(int fd)
+{
+    return send_reply(fd, SERVE_ERROR, err_msg, strlen(err_msg), 1);
+}
+
+static int grow_buffers(struct Client *c, size_t nquery, size_t ncolumn)
+{
+    size_t n;
+
+    n = c->nquery_max;
+    if (nquery <= n)
+        return 1;
+    while (n < nquery)
+        n = n == 0 ? 256 : 2 * n;
+    free(c->queries);
+    free(c->values);
+    c->queries = (int32_t *) malloc(2 * n * sizeof(int32_t));
+    c->values = (double *) malloc(n * ncolumn * sizeof(double));
+    c->nquery_max = c->queries != NULL  &&  c->values != NULL ? n : 0;
+    if (c->nquery_max == 0) {
+        set_err_msg("failed to allocate memory for %lu queries",
+            (unsigned long) n);
+        return 0;
+    }
+    return 1;
+}
+
+/* Return the decoded records of the tile of snp and trait, from the
+   cache if possible.  Must be called with the lock held. */
+static const double *find_tile(struct Server *s, int snp, int trait)
+{
+    const struct Layout *layout;
+    struct ReaderTile t;
+    unsigned long tile;
+    double *values;
+
+    layout = s->layout;
+    tile = (unsigned long) (trait / layout->traits_per_tile)
+        * s->ntile_col + snp / layout->snps_per_tile;
+    if ((values = TileCache_Get(s->cache, tile)) != NULL)
+        return values;
+    if (!Reader_GetTile(s->reader, tile, &t))
+        return NULL;
+    if ((values = TileCache_Put(s->cache, tile, (size_t) (t.snp1 - t.snp0)
+                * (t.trait1 - t.trait0) * s->nvalue)) == NULL)
+        return NULL;
+    Reader_DecodeTile(s->reader, &t, values);
+    return values;
+}
+
+/* Look up the nquery records of the client's query and put their
+   ncolumn columns into its values. */
+static int answer_query(struct Client *c, uint32_t nquery,
+    uint32_t ncolumn)
+{
+    struct Server *s = c->s;
+    const struct Layout *layout;
+    const double *tile, *record;
+    double *v;
+    uint32_t i, j;
+    int snp, trait, snp0, trait0, width;
+
+    layout = s->layout;
+    for (j = 0; j < ncolumn; j++)
+        if (c->columns[j] >= (uint32_t) s->nvalue) {
+            set_err_msg("column index out of range: %lu",
+                (unsigned long) c->columns[j]);
+            return 0;
+        }
+
+    v = c->values;
+    pthread_mutex_lock(&s->lock);
+    for (i = 0; i < nquery; i++) {
+        snp = c->queries[2 * i];
+        trait = c->queries[2 * i + 1];
+        if (snp < 0  ||  snp >= layout->nsnp) {
+            set_err_msg("snp index out of range: %d", snp);
+            goto UNLOCK;
+        }
+        if (trait < 0  ||  trait >= layout->ntrait) {
+            set_err_msg("trait index out of range: %d", trait);
+            goto UNLOCK;
+        }
+        if ((tile = find_tile(s, snp, trait)) == NULL)
+            goto UNLOCK;
+
+        /* Records of a tile are ordered by trait, then by snp. */
+        snp0 = snp - snp % layout->snps_per_tile;
+        trait0 = trait - trait % layout->traits_per_tile;
+        width = layout->nsnp - snp0 < layout->snps_per_tile
+            ? layout->nsnp - snp0 : layout->snps_per_tile;
+        record = tile + ((size_t) (trait - trait0) * width + snp - snp0)
+            * s->nvalue;
+        for (j = 0; j < ncolumn; j++)
+            *v++ = record[c->columns[j]];
+    }
+    s->nrecord += nquery;
+    pthread_mutex_unlock(&s->lock);
+    return 1;
+
+UNLOCK:
+    pthread_mutex_unlock(&s->lock);
+    return 0;
+}
+
+static void get_stats(struct Server *s, double *stats)
+{
+    Histogram h;
+
+    pthread_mutex_lock(&s->lock);
+    h = s->latency;
+    stats[SERVE_STAT_QUERIES] = Histogram_Count(h);
+    stats[SERVE_STAT_RECORDS] = s->nrecord;
+    stats[SERVE_STAT_MEAN] = Histogram_Mean(h) / 1e3;
+    stats[SERVE_STAT_P50] = Histogram_Percentile(h, 50) / 1e3;
+    stats[SERVE_STAT_P90] = Histogram_Percentile(h, 90) / 1e3;
+    stats[SERVE_STAT_P99] = Histogram_Percentile(h, 99) / 1e3;
+    stats[SERVE_STAT_P999] = Histogram_Percentile(h, 99.9) / 1e3;
+    stats[SERVE_STAT_MAX] = Histogram_Max(h) / 1e3;
+    stats[SERVE_STAT_HITS] = TileCache_Hits(s->cache);
+    stats[SERVE_STAT_MISSES] = TileCache_Misses(s->cache);
+    stats[SERVE_STAT_TILES] = TileCache_Tiles(s->cache);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* Answer the requests of a client until it goes away, sends a request
+   that we cannot make sense of, or asks us to shut down. */
+static void *serve_client(void *arg)
+{
+    struct Client *c = (struct Client *) arg;
+    struct Server *s = c->s;
+    struct ServeRequest req;
+    double stats[SERVE_NSTAT];
+    unsigned long long t;
+    int ok;
+
+    ok = 1;
+    while (ok  &&  read_fully(c->fd, &req, sizeof req)) {
+        t = now_ns();
+        switch (req.op) {
+
+        case SERVE_QUERY:
+            if (req.nquery > SERVE_MAX_QUERIES  ||  req.ncolumn == 0
+                ||  req.ncolumn > (uint32_t) s->nvalue) {
+                set_err_msg("bad query: %lu records of %lu columns",
+                    (unsigned long) req.nquery,
+                    (unsigned long) req.ncolumn);
+                send_error(c->fd);
+                ok = 0;
+                break;
+            }
+            if (!grow_buffers(c, req.nquery, s->nvalue)) {
+                send_error(c->fd);
+                ok = 0;
+                break;
+            }
+            if (!read_fully(c->fd, c->columns,
+                    req.ncolumn * sizeof(uint32_t))
+                ||  !read_fully(c->fd, c->queries,
+                    2 * req.nquery * sizeof(int32_t))) {
+                ok = 0;
+                break;
+            }
+            if (!answer_query(c, req.nquery, req.ncolumn)) {
+                ok = send_error(c->fd);
+                break;
+            }
+            ok = send_reply(c->fd, SERVE_OK, c->values,
+                req.nquery * req.ncolumn, sizeof(double));
+            pthread_mutex_lock(&s->lock);
+            Histogram_Record(s->latency, now_ns() - t);
+            pthread_mutex_unlock(&s->lock);
+            break;
+
+        case SERVE_STATS:
+            get_stats(s, stats);
+            ok = send_reply(c->fd, SERVE_OK, stats, SERVE_NSTAT,
+                sizeof(double));
+            break;
+
+        case SERVE_SHUTDOWN:
+            send_reply(c->fd, SERVE_OK, NULL, 0, 0);
+            pthread_mutex_lock(&s->lock);
+            s->stop = 1;
+            shutdown(s->listen_fd, SHUT_RDWR);
+            pthread_mutex_unlock(&s->lock);
+            ok = 0;
+            break;
+
+        default:
+            set_err_msg("unknown request: %lu", (unsigned long) req.op);
+            send_error(c->fd);
+            ok = 0;
+        }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    close(c->fd);
+    s->conn[c->slot] = -1;
+    s->nconn--;
+    pthread_cond_signal(&s->idle);
+    pthread_mutex_unlock(&s->lock);
+    free(c->columns);
+    free(c->queries);
+    free(c->values);
+    free(c);
+
+    return NULL;
+}
+
+static int set_address(struct sockaddr_un *addr, const char *path)
+{
+    if (strlen(path) >= sizeof addr->sun_path) {
+        set_err_msg("socket path too long: %s", path);
+        return 0;
+    }
+    memset(addr, 0, sizeof *addr);
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return 1;
+}
+
+/* Is path a socket that nobody listens on, left behind by a server
+   that didn't shut down? */
+static int is_stale_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat buf;
+    int fd, stale;
+
+    if (lstat(path, &buf) == -1  ||  !S_ISSOCK(buf.st_mode)
+        ||  !set_address(&addr, path)
+        ||  (fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+        return 0;
+    stale = connect(fd, (struct sockaddr *) &addr, sizeof addr) == -1
+        &&  errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+static int open_socket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!set_address(&addr, path))
+        return -1;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        set_err_msg("failed to create socket: %s", path);
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *) &addr, sizeof addr) == -1
+        &&  (errno != EADDRINUSE  ||  !is_stale_socket(path)
+            ||  unlink(path) == -1
+            ||  bind(fd, (struct sockaddr *) &addr, sizeof addr) == -1)) {
+        set_err_msg("failed to bind socket: %s", path);
+        goto CLOSE_SOCKET;
+    }
+    if (listen(fd, SOMAXCONN) == -1) {
+        set_err_msg("failed to listen on socket: %s", path);
+        unlink(path);
+        goto CLOSE_SOCKET;
+    }
+    return fd;
+
+CLOSE_SOCKET:
+    close(fd);
+    return -1;
+}
+
+/* Hand a new client to a thread of its own. */
+static void start_client(struct Server *s, int fd, pthread_attr_t *attr)
+{
+    struct Client *c;
+    pthread_t thread;
+    int slot;
+
+    pthread_mutex_lock(&s->lock);
+    for (slot = 0; slot < MAX_CONNECTIONS; slot++)
+        if (s->conn[slot] == -1)
+            break;
+    if (s->stop  ||  slot == MAX_CONNECTIONS) {
+        pthread_mutex_unlock(&s->lock);
+        set_err_msg("too many clients");
+        send_error(fd);
+        close(fd);
+        return;
+    }
+    c = (struct Client *) calloc(1, sizeof(*c));
+    if (c != NULL  &&  (c->columns = (uint32_t *) malloc(s->nvalue
+                * sizeof(uint32_t))) != NULL) {
+        c->s = s;
+        c->slot = slot;
+        c->fd = fd;
+        s->conn[slot] = fd;
+        s->nconn++;
+        if (pthread_create(&thread, attr, serve_client, c) == 0) {
+            pthread_mutex_unlock(&s->lock);
+            return;
+        }
+        s->conn[slot] = -1;
+        s->nconn--;
+    }
+    pthread_mutex_unlock(&s->lock);
+    set_err_msg("failed to start a thread for a client");
+    send_error(fd);
+    close(fd);
+    if (c != NULL)
+        free(c->columns);
+    free(c);
+}
+
+/* Serve the result set FILE on the socket given by --socket until a
+   client sends SERVE_SHUTDOWN. */
+int serve_queries(struct Params *params)
+{
+    struct Server s;
+    pthread_attr_t attr;
+    int fd, i, status;
+
+    status = 0;
+    memset(&s, 0, sizeof s);
+    if ((s.reader = Reader_Open(params->inputs[0])) == NULL)
+        return 0;
+    s.layout = reader_layout(s.reader);
+    s.nvalue = Reader_ValuesPerRecord(s.reader);
+    s.ntile_col = (s.layout->nsnp + s.layout->snps_per_tile - 1)
+        / s.layout->snps_per_tile;
+    if ((s.cache = TileCache_Create(params->max_memory)) == NULL)
+        goto CLOSE_READER;
+    if ((s.latency = Histogram_Create()) == NULL)
+        goto DESTROY_CACHE;
+    if ((s.listen_fd = open_socket(params->socket_path)) == -1)
+        goto DESTROY_HISTOGRAM;
+    for (i = 0; i < MAX_CONNECTIONS; i++)
+        s.conn[i] = -1;
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.idle, NULL);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    status = 1;
+    for (;;) {
+        if ((fd = accept(s.listen_fd, NULL, NULL)) != -1) {
+            start_client(&s, fd, &attr);
+            continue;
+        }
+        pthread_mutex_lock(&s.lock);
+        i = s.stop;
+        pthread_mutex_unlock(&s.lock);
+        if (i)
+            break;
+        if (errno != EINTR  &&  errno != ECONNABORTED) {
+            set_err_msg("failed to accept a client on socket: %s",
+                params->socket_path);
+            status = 0;
+            break;
+        }
+    }
+
+    /* Wake up all clients and wait for their threads to finish. */
+    pthread_mutex_lock(&s.lock);
+    for (i = 0; i < MAX_CONNECTIONS; i++)
+        if (s.conn[i] != -1)
+            shutdown(s.conn[i], SHUT_RDWR);
+    while (s.nconn > 0)
+        pthread_cond_wait(&s.idle, &s.lock);
+    pthread_mutex_unlock(&s.lock);
+
+    pthread_attr_destroy(&attr);
+    pthread_cond_destroy(&s.idle);
+    pthread_mutex_destroy(&s.lock);
+    close(s.listen_fd);
+    unlink(params->socket_path);
+DESTROY_HISTOGRAM:
+    Histogram_Destroy(s.latency);
+DESTROY_CACHE:
+    TileCache_Destroy(s.cache);
+CLOSE_READER:
+    Reader_Close(s.reader);
+
+    return status;
+}
+
+/* Return a socket connected to the server at path or -1 on failure. */
+int serve_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (!set_address(&addr, path))
+        return -1;
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+        ||  connect(fd, (struct sockaddr *) &addr, sizeof addr) == -1) {
+        set_err_msg("failed to connect to socket: %s", path);
+        if (fd != -1)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Read a reply of n doubles into values, or the server's error
+   message into err_msg. */
+static int receive_reply(int fd, double *values, uint32_t n)
+{
+    struct ServeReply reply;
+    char msg[ERR_MSG_MAXLEN];
+    uint32_t len;
+
+    if (!read_fully(fd, &reply, sizeof reply)) {
+        set_err_msg("lost connection to server");
+        return 0;
+    }
+    if (reply.status == SERVE_ERROR) {
+        len = reply.n < ERR_MSG_MAXLEN ? reply.n : ERR_MSG_MAXLEN - 1;
+        if (!read_fully(fd, msg, len)) {
+            set_err_msg("lost connection to server");
+            return 0;
+        }
+        msg[len] = '\0';
+        set_err_msg("%s", msg);
+        return 0;
+    }
+    if (reply.status != SERVE_OK  ||  reply.n != n) {
+        set_err_msg("unexpected reply from server");
+        return 0;
+    }
+    if (!read_fully(fd, values, n * sizeof(double))) {
+        set_err_msg("lost connection to server");
+        return 0;
+    }
+    return 1;
+}
+
+static int send_request(int fd, uint32_t op, uint32_t ncolumn,
+    const uint32_t *columns, uint32_t nquery, const int32_t *queries)
+{
+    struct ServeRequest req;
+    struct iovec iov[3];
+
+    req.op = op;
+    req.nquery = nquery;
+    req.ncolumn = ncolumn;
+    iov[0].iov_base = &req;
+    iov[0].iov_len = sizeof req;
+    iov[1].iov_base = (void *) columns;
+    iov[1].iov_len = ncolumn * sizeof(uint32_t);
+    iov[2].iov_base = (void *) queries;
+    iov[2].iov_len = 2 * nquery * sizeof(int32_t);
+    if (!send_fully(fd, iov, op == SERVE_QUERY ? 3 : 1)) {
+        set_err_msg("failed to send request to server");
+        return 0;
+    }
+    return 1;
+}
+
+/* Look up the records of the nquery pairs of snp and trait in queries
+   and store their ncolumn columns in values. */
+int serve_query(int fd, uint32_t ncolumn, const uint32_t *columns,
+    uint32_t nquery, const int32_t *queries, double *values)
+{
+    return send_request(fd, SERVE_QUERY, ncolumn, columns, nquery, queries)
+        &&  receive_reply(fd, values, nquery * ncolumn);
+}
+
+/* Store the SERVE_NSTAT statistics of the server in stats. */
+int serve_stats(int fd, double *stats)
+{
+    return send_request(fd, SERVE_STATS, 0, NULL, 0, NULL)
+        &&  receive_reply(fd, stats, SERVE_NSTAT);
+}
+
+int serve_shutdown(int fd)
+{
+    return send_request(fd, SERVE_SHUTDOWN, 0, NULL, 0, NULL)
+        &&  receive_reply(fd, NULL, 0);
+}
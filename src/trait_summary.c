@@ -0,0 +1,217 @@
+#include "trait_summary.h"
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+/* --summary condenses the association statistics z = beta / se of
+   every trait into counts whose number doesn't depend on the number
+   of snps.  Hits and histogram bins are counted exactly: the
+   two-sided p-value erfc(|z| / sqrt(2)) falls as z^2 grows, so
+   comparing z^2 with the precomputed z^2 of every threshold and bin
+   edge classifies a record without computing its p-value.  Strong
+   associations would have us compare with all of them, so we look
+   them up by the bucket of z^2 in the sketch below instead.
+
+   Quantiles of chi-square = z^2, which give the genomic inflation
+   factor lambda (the median chi-square over its expected value of
+   0.4549) and the QQ plot, come from a sketch: a histogram with
+   logarithmically spaced buckets, much like Histogram.c, but indexed
+   by the exponent and the top SKETCH_SUB_BITS bits of the mantissa
+   of the double itself.  A bucket is at most 3% wide, and
+   quantiles are interpolated linearly within a bucket.  The bucket
+   above 2^SKETCH_MAX_EXP is open, so quantiles that fall into it are
+   unknown rather than guessed.  Sketches of parts of the records are
+   merged by adding their counts. */
+
+/* p-value thresholds at which hits are counted, from the largest down. */
+const double summary_thresholds[SUMMARY_NHIT] = {
+    1e-3, 1e-5, 1e-6, 5e-8, 1e-10
+};
+
+/* Median of the chi-square distribution with one degree of freedom. */
+#define CHI2_MEDIAN 0.45493642311957283
+
+/* Return the |z| whose two-sided p-value is p by bisection. */
+static double z_of_p(double p)
+{
+    double lo, hi, mid;
+    int i;
+
+    lo = 0;
+    hi = 40;
+    for (i = 0; i < 100; i++) {
+        mid = (lo + hi) / 2;
+        if (erfc(mid * M_SQRT1_2) > p)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return hi;
+}
+
+/* Return the bucket of the chi-square value x >= 0. */
+static int bucket_of(double x)
+{
+    uint64_t bits;
+    int e;
+
+    memcpy(&bits, &x, sizeof bits);
+    e = (int) (bits >> 52) - 1023;
+    if (e < SKETCH_MIN_EXP)
+        return 0;
+    if (e >= SKETCH_MAX_EXP)
+        return SKETCH_NBUCKET - 1;
+    return 1 + ((e - SKETCH_MIN_EXP) << SKETCH_SUB_BITS)
+        + (int) ((bits >> (52 - SKETCH_SUB_BITS))
+            & ((1 << SKETCH_SUB_BITS) - 1));
+}
+
+/* Return the smallest value of bucket b. */
+static double bucket_start(int b)
+{
+    int e, sub;
+
+    if (b == 0)
+        return 0;
+    if (b == SKETCH_NBUCKET - 1)
+        return ldexp(1, SKETCH_MAX_EXP);
+    e = (b - 1) >> SKETCH_SUB_BITS;
+    sub = (b - 1) & ((1 << SKETCH_SUB_BITS) - 1);
+    return ldexp(1 + (double) sub / (1 << SKETCH_SUB_BITS),
+        e + SKETCH_MIN_EXP);
+}
+
+/* Return the z^2 of the p-value p. */
+static double chi2_of_p(double p)
+{
+    double z;
+
+    z = z_of_p(p);
+    return z * z;
+}
+
+void init_summary_edges(struct SummaryEdges *e)
+{
+    double lo, hi, x;
+    int b, k;
+
+    for (b = 0; b < SKETCH_NBUCKET; b++) {
+        lo = bucket_start(b);
+        hi = b < SKETCH_NBUCKET - 1 ? bucket_start(b + 1) : INFINITY;
+        e->nhit[b] = e->bin[b] = 0;
+        e->hit[b] = e->edge[b] = INFINITY;
+
+        /* p < threshold if z^2 > x. */
+        for (k = 0; k < SUMMARY_NHIT; k++) {
+            x = chi2_of_p(summary_thresholds[k]);
+            if (x < lo)
+                e->nhit[b]++;
+            else if (x < hi)
+                e->hit[b] = x;
+        }
+
+        /* -log10(p) >= k if z^2 >= x. */
+        for (k = 1; k < SUMMARY_NHIST; k++) {
+            x = chi2_of_p(pow(10, -k));
+            if (x <= lo)
+                e->bin[b]++;
+            else if (x < hi)
+                e->edge[b] = x;
+        }
+    }
+}
+
+/* Add the statistic z to s.  NaNs are skipped. */
+void add_to_trait_summary(struct TraitSummary *s,
+    const struct SummaryEdges *e, double z)
+{
+    double x;
+    int b, k, n;
+
+    if (z != z)
+        return;
+    x = z * z;
+    b = bucket_of(x);
+    s->n++;
+    if (x > s->max_chi2)
+        s->max_chi2 = x;
+    n = e->nhit[b] + (x > e->hit[b]);
+    for (k = 0; k < n; k++)
+        s->hits[k]++;
+    s->hist[e->bin[b] + (x >= e->edge[b])]++;
+    s->sketch[b]++;
+}
+
+void merge_trait_summary(struct TraitSummary *dst,
+    const struct TraitSummary *src)
+{
+    int k;
+
+    dst->n += src->n;
+    if (src->max_chi2 > dst->max_chi2)
+        dst->max_chi2 = src->max_chi2;
+    for (k = 0; k < SUMMARY_NHIT; k++)
+        dst->hits[k] += src->hits[k];
+    for (k = 0; k < SUMMARY_NHIST; k++)
+        dst->hist[k] += src->hist[k];
+    for (k = 0; k < SKETCH_NBUCKET; k++)
+        dst->sketch[k] += src->sketch[k];
+}
+
+/* Return the q-quantile of the chi-square values of s, or NaN if s is
+   empty or the quantile lies beyond 2^SKETCH_MAX_EXP. */
+double trait_summary_quantile(const struct TraitSummary *s, double q)
+{
+    double rank, lo, hi;
+    unsigned long long below;
+    int b;
+
+    if (s->n == 0)
+        return NAN;
+    rank = q * s->n;
+    below = 0;
+    for (b = 0; b < SKETCH_NBUCKET - 1; b++) {
+        if (below + s->sketch[b] >= rank  &&  s->sketch[b] > 0)
+            break;
+        below += s->sketch[b];
+    }
+    if (b == SKETCH_NBUCKET - 1)
+        return NAN;
+    lo = bucket_start(b);
+    hi = bucket_start(b + 1);
+    if (hi > s->max_chi2)
+        hi = s->max_chi2;
+    if (s->sketch[b] == 0  ||  hi < lo)
+        return lo;
+    return lo + (hi - lo) * (rank - below) / s->sketch[b];
+}
+
+/* Return the genomic inflation factor of s. */
+double trait_summary_lambda(const struct TraitSummary *s)
+{
+    return trait_summary_quantile(s, 0.5) / CHI2_MEDIAN;
+}
+
+/* Return the observed -log10(p) where k is expected, that is, of the
+   record at the 10^-k quantile of the p-values, or NaN if there are
+   fewer than 10^k records. */
+double trait_summary_qq(const struct TraitSummary *s, int k)
+{
+    if (s->n < pow(10, k))
+        return NAN;
+    return minus_log10_p(sqrt(trait_summary_quantile(s, 1 - pow(10,
+                    -k))));
+}
+
+/* Return -log10 of the two-sided p-value of z.  From |z| = 36.8 on,
+   before erfc underflows, use the asymptotic expansion of erfc. */
+double minus_log10_p(double z)
+{
+    double x;
+
+    x = fabs(z) * M_SQRT1_2;
+    if (x < 26)
+        return -log10(erfc(x));
+    return (x * x + log(x * sqrt(M_PI)) - log1p(-0.5 / (x * x)))
+        / M_LN10;
+}
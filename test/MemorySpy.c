@@ -2,7 +2,7 @@
 #include <stddef.h>
 #include <stdio.h>
 
-#define MAXALLOCSIZE 32
+#define MAXALLOCSIZE 1024
 
 static char buf[MAXALLOCSIZE];
 static char *buf_beg = NULL;
@@ -36,6 +36,13 @@ void *MemorySpy_Malloc(size_t nbytes)
     return s;
 }
 
+/* Memory handed out by MemorySpy_Malloc is reclaimed all at once by
+   MemorySpy_MallocReset. */
+void MemorySpy_Free(void *p)
+{
+    (void) p;
+}
+
 void MemorySpy_MallocReset(void)
 {
     buf_beg = buf_cur = buf;
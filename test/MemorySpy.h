@@ -5,6 +5,7 @@
 #include <stddef.h>
 
 void *MemorySpy_Malloc(size_t);
+void MemorySpy_Free(void *);
 void MemorySpy_MallocReset(void);
 void MemorySpy_MallocReturnNULL(void);
 
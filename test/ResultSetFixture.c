@@ -0,0 +1,74 @@
+#include "unity_fixture.h"
+#include "ResultSetFixture.h"
+#include "parse_layout_file.h"
+#include "parse_data_file.h"
+#include <stdio.h>
+
+static char *beta_labels[] = {"b0", "b1"};
+static char *se_labels[] = {"s0", "s1"};
+static char *snp_labels[] = {"rs0", "rs1", "rs2", "rs3", "rs4", "rs5",
+    "rs6"};
+static char *trait_labels[] = {"t0", "t1", "t2", "t3", "t4"};
+
+char *ResultSetFixture_CovLabels[] = {"c01"};
+
+double ResultSetFixture_Value(int snp, int trait, int j)
+{
+    return snp * 100.0 + trait + j / 16.0;
+}
+
+/* Write the result set prefix that holds snps snp0 to snp0 + nsnp - 1
+   and traits trait0 to trait0 + ntrait - 1 of the whole result set in
+   tiles of spt snps by tpt traits, with values of bpd bytes. */
+void ResultSetFixture_Write(const char *prefix, int snp0, int nsnp,
+    int trait0, int ntrait, int spt, int tpt, int bpd)
+{
+    struct Layout layout;
+    char file[64];
+    unsigned long k;
+    double x;
+    float f;
+    FILE *fp;
+    int snp, trait, j;
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = bpd;
+    layout.swapped          = 0;
+    layout.nvar             = FIXTURE_NVAR;
+    layout.ncov             = 1;
+    layout.nsnp             = nsnp;
+    layout.ntrait           = ntrait;
+    layout.snps_per_tile    = spt;
+    layout.traits_per_tile  = tpt;
+    layout.max_char         = 8;
+    layout.beta_labels      = beta_labels;
+    layout.se_labels        = se_labels;
+    layout.cov_labels       = ResultSetFixture_CovLabels;
+    layout.snp_labels       = snp_labels + snp0;
+    layout.trait_labels     = trait_labels + trait0;
+
+    sprintf(file, "%s.iout", prefix);
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(file, &layout));
+    sprintf(file, "%s.out", prefix);
+    TEST_ASSERT_NOT_NULL(fp = fopen(file, "wb"));
+    for (k = 0; k < (unsigned long) nsnp * ntrait; k++) {
+        offset2index(k, &snp, &trait, &layout);
+        for (j = 0; j < FIXTURE_NVALUE; j++) {
+            x = ResultSetFixture_Value(snp0 + snp, trait0 + trait, j);
+            f = (float) x;
+            TEST_ASSERT_TRUE(bpd == 4 ? fwrite(&f, 4, 1, fp) == 1
+                : fwrite(&x, 8, 1, fp) == 1);
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+}
+
+void ResultSetFixture_Remove(const char *prefix)
+{
+    char file[64];
+
+    sprintf(file, "%s.iout", prefix);
+    remove(file);
+    sprintf(file, "%s.out", prefix);
+    remove(file);
+}
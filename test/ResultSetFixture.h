@@ -0,0 +1,20 @@
+#ifndef RESULTSETFIXTURE_H
+#define RESULTSETFIXTURE_H
+
+/* Tests that read result sets write parts of one whole result set of
+   FIXTURE_NSNP snps by FIXTURE_NTRAIT traits, with FIXTURE_NVAR betas
+   and standard errors and one covariance.  Value j of the record of
+   snp and trait is snp * 100 + trait + j / 16, which is exact in
+   single precision too.  Tests may change the covariance label to
+   write result sets with other columns. */
+enum { FIXTURE_NSNP = 7, FIXTURE_NTRAIT = 5, FIXTURE_NVAR = 2,
+    FIXTURE_NVALUE = 2 * FIXTURE_NVAR + 1 };
+
+extern char *ResultSetFixture_CovLabels[];
+
+double ResultSetFixture_Value(int snp, int trait, int j);
+void ResultSetFixture_Write(const char *prefix, int snp0, int nsnp,
+    int trait0, int ntrait, int spt, int tpt, int bpd);
+void ResultSetFixture_Remove(const char *prefix);
+
+#endif
@@ -0,0 +1,344 @@
+#include "unity_fixture.h"
+#include "ArrowWriter.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct Layout layout;
+static struct Params params;
+static char *beta_labels[] = {"b0"};
+static char *se_labels[] = {"s0"};
+static char *snp_labels[] = {"snp0", "snp1", "snp2", "snp3", "snp4",
+                             "snp5", "snp6", "snp7", "snp8", "snp9"};
+static char *trait_labels[] = {"t0", "t1", "t2", "t3", "t4", "t5", "t6",
+                               "t7"};
+static int ucp2acp[] = {1, 0, -9};
+
+static const char *arrow_file = "test/tmp/data.arrow";
+static const char *layout_file = "test/tmp/arrow.iout";
+static const char *data_file = "test/tmp/arrow.out";
+
+/* The file written by the test, read back into memory. */
+static unsigned char *file;
+static long file_len;
+
+TEST_GROUP(ArrowWriter);
+
+TEST_SETUP(ArrowWriter)
+{
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 1;
+    layout.ncov             = 0;
+    layout.nsnp             = 3;
+    layout.ntrait           = 2;
+    layout.snps_per_tile    = 4;
+    layout.traits_per_tile  = 3;
+    layout.max_char         = 8;
+    layout.beta_labels      = beta_labels;
+    layout.se_labels        = se_labels;
+    layout.cov_labels       = NULL;
+    layout.snp_labels       = snp_labels;
+    layout.trait_labels     = trait_labels;
+
+    initialize_parameters(&params);
+    params.ncolumn = 2;
+    params.ucp2acp = ucp2acp;
+    params.format  = FORMAT_ARROW;
+
+    file = NULL;
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(ArrowWriter)
+{
+    free(file);
+}
+
+static void read_arrow_file(void)
+{
+    FILE *fp;
+
+    TEST_ASSERT_TRUE((fp = fopen(arrow_file, "rb")) != NULL);
+    TEST_ASSERT_TRUE(fseek(fp, 0, SEEK_END) == 0);
+    TEST_ASSERT_TRUE((file_len = ftell(fp)) > 0);
+    rewind(fp);
+    TEST_ASSERT_NOT_NULL(file = (unsigned char *) malloc(file_len));
+    TEST_ASSERT_TRUE(fread(file, file_len, 1, fp) == 1);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
+
+/* A minimal flatbuffer reader: positions are relative to the start
+   of the flatbuffer fb. */
+static unsigned long long le(const unsigned char *p, int n)
+{
+    unsigned long long x;
+
+    for (x = 0; n > 0; n--)
+        x = x << 8 | p[n - 1];
+    return x;
+}
+
+static size_t root(const unsigned char *fb)
+{
+    return le(fb, 4);
+}
+
+/* Return the position of field slot of the table at t or 0 if the
+   field is absent. */
+static size_t field(const unsigned char *fb, size_t t, int slot)
+{
+    size_t vtable, offset;
+
+    vtable = t - (int) le(fb + t, 4);
+    if (4 + 2 * (size_t) slot >= le(fb + vtable, 2))
+        return 0;
+    offset = le(fb + vtable + 4 + 2 * slot, 2);
+    return offset ? t + offset : 0;
+}
+
+/* Follow the offset in field slot of the table at t. */
+static size_t child(const unsigned char *fb, size_t t, int slot)
+{
+    size_t pos;
+
+    TEST_ASSERT_TRUE((pos = field(fb, t, slot)) != 0);
+    return pos + le(fb + pos, 4);
+}
+
+static const unsigned char *footer(void)
+{
+    unsigned long len;
+
+    TEST_ASSERT_EQUAL_MEMORY("ARROW1\0\0", file, 8);
+    TEST_ASSERT_EQUAL_MEMORY("ARROW1", file + file_len - 6, 6);
+    len = le(file + file_len - 10, 4);
+    TEST_ASSERT_TRUE(len + 18 <= (unsigned long) file_len);
+    TEST_ASSERT_TRUE(le(file + file_len - 18 - len, 4) == 0xffffffff);
+    TEST_ASSERT_TRUE(le(file + file_len - 14 - len, 4) == 0);
+    return file + file_len - 10 - len;
+}
+
+/* Return the metadata of the message described by block i of the
+   footer's list of dictionaries (slot 2) or record batches (slot 3)
+   and its body through *body. */
+static const unsigned char *message(int slot, int i, int *n,
+    const unsigned char **body)
+{
+    const unsigned char *fb, *block, *msg;
+    size_t v;
+
+    fb = footer();
+    v = child(fb, root(fb), slot);
+    *n = le(fb + v, 4);
+    TEST_ASSERT_TRUE(i < *n);
+    block = fb + v + 4 + 24 * i;
+    TEST_ASSERT_EQUAL_INT(0, le(block, 8) % 8);
+    msg = file + le(block, 8);
+    TEST_ASSERT_TRUE(le(msg, 4) == 0xffffffff);
+    TEST_ASSERT_EQUAL_INT(le(block + 8, 4), 8 + le(msg + 4, 4));
+    TEST_ASSERT_EQUAL_INT(0, le(block + 8, 4) % 8);
+    *body = msg + le(block + 8, 4);
+    TEST_ASSERT_TRUE(*body + le(block + 16, 8) <= file + file_len);
+    return msg + 8;
+}
+
+/* Return the record batch of message fb and buffer k through *p. */
+static unsigned long batch(const unsigned char *fb, int header_type,
+    const unsigned char *body, int k, const unsigned char **p)
+{
+    size_t m, b, buffers;
+
+    m = root(fb);
+    TEST_ASSERT_EQUAL_INT(header_type, fb[field(fb, m, 1)]);
+    b = child(fb, m, 2);
+    if (header_type == 2)       /* DictionaryBatch */
+        b = child(fb, b, 1);
+    buffers = child(fb, b, 2);
+    TEST_ASSERT_TRUE(k < (int) le(fb + buffers, 4));
+    TEST_ASSERT_EQUAL_INT(0, le(fb + buffers + 4 + 16 * k, 8) % 8);
+    *p = body + le(fb + buffers + 4 + 16 * k, 8);
+    return le(fb + field(fb, b, 0), 8);
+}
+
+/* Test that the schema names and types the fields. */
+TEST(ArrowWriter, schema)
+{
+    static const char *names[] = {"snp", "trait", "s0", "b0"};
+    const unsigned char *fb;
+    ArrowWriter w;
+    FILE *fp;
+    size_t fields, f, name;
+    int i;
+
+    TEST_ASSERT_TRUE((fp = fopen(arrow_file, "wb")) != NULL);
+    TEST_ASSERT_NOT_NULL_MESSAGE(w = ArrowWriter_Create(fp, arrow_file,
+            &params, &layout), err_msg);
+    TEST_ASSERT_EQUAL_INT(1, ArrowWriter_Finish(w));
+    ArrowWriter_Destroy(w);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    read_arrow_file();
+
+    fb = footer();
+    fields = child(fb, child(fb, root(fb), 1), 1);
+    TEST_ASSERT_EQUAL_INT(4, le(fb + fields, 4));
+    for (i = 0; i < 4; i++) {
+        f = fields + 4 + 4 * i;
+        f += le(fb + f, 4);
+        name = child(fb, f, 0);
+        TEST_ASSERT_EQUAL_STRING(names[i], (const char *) fb + name + 4);
+        TEST_ASSERT_EQUAL_INT(i < 2 ? 5 : 3, fb[field(fb, f, 2)]);
+        TEST_ASSERT_EQUAL_INT(i < 2, field(fb, f, 4) != 0);
+    }
+}
+
+/* Test that the dictionaries hold the snp and trait labels. */
+TEST(ArrowWriter, dictionaries)
+{
+    const unsigned char *fb, *body, *offsets, *chars;
+    ArrowWriter w;
+    FILE *fp;
+    int i, n;
+
+    TEST_ASSERT_TRUE((fp = fopen(arrow_file, "wb")) != NULL);
+    TEST_ASSERT_NOT_NULL_MESSAGE(w = ArrowWriter_Create(fp, arrow_file,
+            &params, &layout), err_msg);
+    TEST_ASSERT_EQUAL_INT(1, ArrowWriter_Finish(w));
+    ArrowWriter_Destroy(w);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    read_arrow_file();
+
+    fb = message(2, 0, &n, &body);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT(0, le(fb + field(fb, child(fb, root(fb), 2),
+                0), 8));
+    TEST_ASSERT_EQUAL_INT(3, batch(fb, 2, body, 1, &offsets));
+    batch(fb, 2, body, 2, &chars);
+    for (i = 0; i < 3; i++)
+        TEST_ASSERT_EQUAL_INT(0, strncmp(snp_labels[i],
+                (const char *) chars + le(offsets + 4 * i, 4),
+                le(offsets + 4 * i + 4, 4) - le(offsets + 4 * i, 4)));
+
+    fb = message(2, 1, &n, &body);
+    TEST_ASSERT_EQUAL_INT(2, batch(fb, 2, body, 1, &offsets));
+    batch(fb, 2, body, 2, &chars);
+    TEST_ASSERT_EQUAL_MEMORY("t0t1", chars, 4);
+}
+
+/* Test that record batches hold the given rows. */
+TEST(ArrowWriter, record_batches)
+{
+    static const int snp[] = {0, 2}, trait[] = {1, 0};
+    static const double columns[] = {1.5, 2.5, 0, 0, -1, -2};
+    const unsigned char *fb, *body, *p;
+    const double *x;
+    ArrowWriter w;
+    FILE *fp;
+    int n;
+
+    TEST_ASSERT_TRUE((fp = fopen(arrow_file, "wb")) != NULL);
+    TEST_ASSERT_NOT_NULL_MESSAGE(w = ArrowWriter_Create(fp, arrow_file,
+            &params, &layout), err_msg);
+    TEST_ASSERT_EQUAL_INT(1, ArrowWriter_WriteBatch(w, 2, snp, trait,
+            columns, 4));
+    TEST_ASSERT_EQUAL_INT(1, ArrowWriter_WriteBatch(w, 1, snp + 1,
+            trait + 1, columns + 1, 4));
+    TEST_ASSERT_EQUAL_INT(1, ArrowWriter_Finish(w));
+    ArrowWriter_Destroy(w);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    read_arrow_file();
+
+    fb = message(3, 0, &n, &body);
+    TEST_ASSERT_EQUAL_INT(2, n);
+    TEST_ASSERT_EQUAL_INT(2, batch(fb, 3, body, 1, &p));
+    TEST_ASSERT_EQUAL_MEMORY(snp, p, sizeof snp);
+    batch(fb, 3, body, 3, &p);
+    TEST_ASSERT_EQUAL_MEMORY(trait, p, sizeof trait);
+    batch(fb, 3, body, 5, &p);
+    x = (const double *) p;
+    TEST_ASSERT_EQUAL_DOUBLE(1.5, x[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(2.5, x[1]);
+    batch(fb, 3, body, 7, &p);
+    x = (const double *) p;
+    TEST_ASSERT_EQUAL_DOUBLE(-1, x[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(-2, x[1]);
+
+    fb = message(3, 1, &n, &body);
+    TEST_ASSERT_EQUAL_INT(1, batch(fb, 3, body, 7, &p));
+    TEST_ASSERT_EQUAL_DOUBLE(-2, *(const double *) p);
+}
+
+/* Test that converting a data file with --format=arrow writes one
+   record batch per tile (see Figure 1 in parse_data_file.c) and only
+   the records that pass the filter. */
+TEST(ArrowWriter, one_batch_per_tile)
+{
+    static const unsigned long lengths[] = {12, 12, 6, 12, 12, 6, 8, 8, 4};
+    const unsigned char *fb, *body, *p;
+    unsigned long offset, i, n;
+    int k, nbatch, snp, trait, use_mmap;
+    FILE *fp;
+    double x[2];
+
+    layout.nsnp = 10;
+    layout.ntrait = 8;
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    for (i = 0; i < 80; i++) {
+        x[0] = i;
+        x[1] = i + 0.5;
+        TEST_ASSERT_TRUE(fwrite(x, sizeof x, 1, fp) == 1);
+    }
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    params.layout_file = (char *) layout_file;
+    params.data_file = (char *) data_file;
+    params.output_file = (char *) arrow_file;
+
+    for (use_mmap = 0; use_mmap <= 1; use_mmap++) {
+        params.use_mmap = use_mmap;
+        TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params,
+                &layout), err_msg);
+        read_arrow_file();
+        for (offset = k = 0; k < 9; k++, offset += n) {
+            fb = message(3, k, &nbatch, &body);
+            TEST_ASSERT_EQUAL_INT(9, nbatch);
+            n = batch(fb, 3, body, 1, &p);
+            TEST_ASSERT_EQUAL_INT(lengths[k], n);
+            for (i = 0; i < n; i++) {
+                offset2index(offset + i, &snp, &trait, &layout);
+                batch(fb, 3, body, 1, &p);
+                TEST_ASSERT_EQUAL_INT(snp, le(p + 4 * i, 4));
+                batch(fb, 3, body, 3, &p);
+                TEST_ASSERT_EQUAL_INT(trait, le(p + 4 * i, 4));
+                batch(fb, 3, body, 5, &p);
+                TEST_ASSERT_EQUAL_DOUBLE(offset + i + 0.5,
+                    ((const double *) p)[i]);
+                batch(fb, 3, body, 7, &p);
+                TEST_ASSERT_EQUAL_DOUBLE(offset + i,
+                    ((const double *) p)[i]);
+            }
+        }
+        free(file);
+        file = NULL;
+    }
+
+    /* Only records 20 to 49 pass: 4 of tile 2, all of tiles 3 and
+       4, and 8 of tile 5. */
+    TEST_ASSERT_NOT_NULL_MESSAGE(params.filter = Filter_Compile(
+            "b0 >= 20 && b0 < 50", &layout), err_msg);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params, &layout),
+        err_msg);
+    Filter_Destroy(params.filter);
+    read_arrow_file();
+    fb = message(3, 0, &nbatch, &body);
+    TEST_ASSERT_EQUAL_INT(4, nbatch);
+    TEST_ASSERT_EQUAL_INT(4, batch(fb, 3, body, 7, &p));
+    TEST_ASSERT_EQUAL_DOUBLE(20, *(const double *) p);
+    fb = message(3, 3, &nbatch, &body);
+    TEST_ASSERT_EQUAL_INT(8, batch(fb, 3, body, 7, &p));
+    TEST_ASSERT_EQUAL_DOUBLE(49, ((const double *) p)[7]);
+}
@@ -0,0 +1,184 @@
+#include "unity_fixture.h"
+#include "Bgzf.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *bgzf_file = "test/tmp/data.gz";
+
+enum { NLINE = 20000, MAX_HOOK = 16 };
+
+/* Text written by the tests and the text read back. */
+static char *text, *back;
+static size_t text_len, back_len;
+
+/* Arguments of the calls to the line hook. */
+static unsigned long long hook_voffset[MAX_HOOK];
+static char hook_line[MAX_HOOK][32];
+static int nhook;
+
+TEST_GROUP(Bgzf);
+
+TEST_SETUP(Bgzf)
+{
+    size_t i;
+
+    /* Lines of varying length that span several blocks. */
+    text = (char *) malloc(NLINE * 32);
+    back = (char *) malloc(NLINE * 32 + BGZF_MAX_BLOCK);
+    for (text_len = i = 0; i < NLINE; i++)
+        text_len += sprintf(text + text_len, "line %lu %.*s\n",
+            (unsigned long) i, (int) (i % 7), "xxxxxxx");
+    back_len = 0;
+    nhook = 0;
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(Bgzf)
+{
+    free(text);
+    free(back);
+}
+
+static int record_line(void *arg, unsigned long long voffset,
+    const char *line, size_t len)
+{
+    (void) arg;
+    TEST_ASSERT_TRUE(nhook < MAX_HOOK);
+    TEST_ASSERT_TRUE(len < sizeof hook_line[0]);
+    hook_voffset[nhook] = voffset;
+    memcpy(hook_line[nhook], line, len);
+    hook_line[nhook][len] = '\0';
+    nhook++;
+    return 1;
+}
+
+/* Decompress the blocks of bgzf_file into back and return the number
+   of blocks including the empty end-of-file block. */
+static int read_back(void)
+{
+    FILE *fp;
+    unsigned long long coffset, next;
+    size_t len;
+    int nblock;
+
+    TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "rb")) != NULL);
+    coffset = 0;
+    nblock = 0;
+    do {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(1, Bgzf_ReadBlock(fp, coffset,
+                back + back_len, &len, &next), err_msg);
+        TEST_ASSERT_TRUE(len <= BGZF_BLOCK_SIZE);
+        back_len += len;
+        coffset = next;
+        nblock++;
+    } while (len > 0);
+
+    /* The empty block is the last one. */
+    TEST_ASSERT_TRUE(fseek(fp, 0, SEEK_END) == 0);
+    TEST_ASSERT_TRUE((unsigned long long) ftell(fp) == coffset);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    return nblock;
+}
+
+/* Test that writing in pieces of any size and reading back the
+   blocks gives the original text, whatever the number of threads. */
+TEST(Bgzf, write_and_read_blocks)
+{
+    BgzfWriter w;
+    FILE *fp;
+    size_t i, k;
+    int nthread;
+
+    for (nthread = 1; nthread <= 3; nthread++) {
+        TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "wb")) != NULL);
+        TEST_ASSERT_NOT_NULL_MESSAGE(w = BgzfWriter_Open(fp, bgzf_file,
+                nthread, NULL, NULL), err_msg);
+        for (i = 0; i < text_len; i += k) {
+            k = i % 1000 + 1;
+            if (k > text_len - i)
+                k = text_len - i;
+            TEST_ASSERT_EQUAL_INT(1, BgzfWriter_Write(w, text + i, k));
+        }
+        TEST_ASSERT_EQUAL_INT_MESSAGE(1, BgzfWriter_Close(w), err_msg);
+        TEST_ASSERT_TRUE(fclose(fp) == 0);
+
+        back_len = 0;
+        TEST_ASSERT_EQUAL_INT((text_len + BGZF_BLOCK_SIZE - 1)
+            / BGZF_BLOCK_SIZE + 1, read_back());
+        TEST_ASSERT_TRUE(back_len == text_len);
+        TEST_ASSERT_EQUAL_MEMORY(text, back, text_len);
+    }
+}
+
+/* Test that the line hook gets the first complete line of every
+   block and its virtual offset. */
+TEST(Bgzf, first_line_of_every_block)
+{
+    BgzfWriter w;
+    FILE *fp;
+    size_t start, pos;
+    int i, nblock;
+
+    TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "wb")) != NULL);
+    TEST_ASSERT_NOT_NULL(w = BgzfWriter_Open(fp, bgzf_file, 2,
+            record_line, NULL));
+    TEST_ASSERT_EQUAL_INT(1, BgzfWriter_Write(w, text, text_len));
+    TEST_ASSERT_EQUAL_INT(1, BgzfWriter_Close(w));
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+
+    nblock = read_back();
+    TEST_ASSERT_EQUAL_INT(nblock - 1, nhook);
+    TEST_ASSERT_TRUE(hook_voffset[0] == 0);
+    TEST_ASSERT_EQUAL_STRING("line 0 \n", hook_line[0]);
+    for (i = 1; i < nhook; i++) {
+        /* Block i starts at uncompressed position i * BGZF_BLOCK_SIZE
+           and its first complete line follows the first newline. */
+        start = (size_t) i * BGZF_BLOCK_SIZE;
+        pos = start + (hook_voffset[i] & 0xffff);
+        TEST_ASSERT_TRUE(hook_voffset[i] >> 16 > hook_voffset[i - 1] >> 16);
+        TEST_ASSERT_EQUAL_INT('\n', text[pos - 1]);
+        if (pos > start)
+            TEST_ASSERT_NULL(memchr(text + start, '\n', pos - 1 - start));
+        TEST_ASSERT_EQUAL_MEMORY(text + pos, hook_line[i],
+            strlen(hook_line[i]));
+    }
+}
+
+/* Test that a stream writes through to the BGZF writer and that
+   closing the stream finishes the file. */
+TEST(Bgzf, write_through_stream)
+{
+    BgzfWriter w;
+    FILE *fp, *stream;
+
+    TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "wb")) != NULL);
+    TEST_ASSERT_NOT_NULL(w = BgzfWriter_Open(fp, bgzf_file, 1, NULL,
+            NULL));
+    TEST_ASSERT_NOT_NULL(stream = BgzfWriter_OpenStream(w));
+    TEST_ASSERT_TRUE(fprintf(stream, "%s", text) == (int) text_len);
+    TEST_ASSERT_TRUE(fclose(stream) == 0);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+
+    read_back();
+    TEST_ASSERT_TRUE(back_len == text_len);
+    TEST_ASSERT_EQUAL_MEMORY(text, back, text_len);
+}
+
+/* Test that reading something other than a BGZF block fails. */
+TEST(Bgzf, read_non_bgzf_file)
+{
+    FILE *fp;
+    unsigned long long next;
+    size_t len;
+
+    TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite(text, 1000, 1, fp) == 1);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+
+    TEST_ASSERT_TRUE((fp = fopen(bgzf_file, "rb")) != NULL);
+    TEST_ASSERT_EQUAL_INT(0, Bgzf_ReadBlock(fp, 0, back, &len, &next));
+    TEST_ASSERT_EQUAL_STRING("no BGZF block at offset 0", err_msg);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
@@ -0,0 +1,210 @@
+#include "unity_fixture.h"
+#include "Filter.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NELEMS(x) (sizeof (x) / sizeof (x[0]))
+
+static struct Layout layout;
+static char *beta_labels[] = {"beta_intercept", "beta_snp"};
+static char *se_labels[] = {"se_intercept", "se_snp"};
+static char *cov_labels[] = {"cov_intercept_snp"};
+
+/* Records with columns beta_intercept, beta_snp, se_intercept,
+   se_snp, and cov_intercept_snp.  The p-value of beta_snp / se_snp
+   is about 5.7e-7 for record 0, 0.3173 for record 1, 1.5e-8 for
+   record 2, and 1 for record 3. */
+static const double records[][5] = {
+    {1.0,  0.10, 0.5, 0.02, 0.0},
+    {2.0, -1.00, 0.5, 1.00, 1.0},
+    {3.0, -0.04, 0.5, 0.0071428571428571, 2.0},
+    {4.0,  0.00, 0.5, 0.10, 3.0}
+};
+
+static const double *rec[NELEMS(records)];
+static unsigned char keep[FILTER_BATCH];
+
+TEST_GROUP(Filter);
+
+TEST_SETUP(Filter)
+{
+    size_t i;
+
+    layout.nvar        = 2;
+    layout.ncov        = 1;
+    layout.beta_labels = beta_labels;
+    layout.se_labels   = se_labels;
+    layout.cov_labels  = cov_labels;
+    for (i = 0; i < NELEMS(records); i++)
+        rec[i] = records[i];
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(Filter)
+{
+}
+
+/* Apply expr to all records and return the kept records as a bit
+   mask, where bit k stands for record k. */
+static int apply(const char *expr)
+{
+    Filter f;
+    int k, mask;
+
+    f = Filter_Compile(expr, &layout);
+    TEST_ASSERT_NOT_NULL_MESSAGE(f, err_msg);
+    Filter_Apply(f, NELEMS(records), rec, keep);
+    Filter_Destroy(f);
+
+    for (k = mask = 0; k < (int) NELEMS(records); k++)
+        mask |= keep[k] << k;
+    return mask;
+}
+
+static void assert_compile_error(const char *expr, const char *msg)
+{
+    TEST_ASSERT_NULL(Filter_Compile(expr, &layout));
+    TEST_ASSERT_EQUAL_STRING(msg, err_msg);
+}
+
+TEST(Filter, comparisons)
+{
+    TEST_ASSERT_EQUAL_INT(0x3, apply("beta_intercept < 3"));
+    TEST_ASSERT_EQUAL_INT(0x7, apply("beta_intercept <= 3"));
+    TEST_ASSERT_EQUAL_INT(0x8, apply("beta_intercept > 3"));
+    TEST_ASSERT_EQUAL_INT(0xc, apply("beta_intercept >= 3"));
+    TEST_ASSERT_EQUAL_INT(0x2, apply("beta_intercept == 2"));
+    TEST_ASSERT_EQUAL_INT(0xd, apply("beta_intercept != 2"));
+}
+
+TEST(Filter, arithmetic_and_precedence)
+{
+    TEST_ASSERT_EQUAL_INT(0x4, apply("1 + 2 * beta_intercept == 7"));
+    TEST_ASSERT_EQUAL_INT(0x4, apply("(1 + beta_intercept) * 2 == 8"));
+    TEST_ASSERT_EQUAL_INT(0x2, apply("beta_intercept - 6 / 3 == 0"));
+    TEST_ASSERT_EQUAL_INT(0x1, apply("-beta_intercept == -1"));
+    TEST_ASSERT_EQUAL_INT(0x8, apply("2 - 1 - 1 == beta_snp"));
+}
+
+TEST(Filter, logical_operators)
+{
+    TEST_ASSERT_EQUAL_INT(0x9, apply("beta_intercept < 2 || "
+            "beta_intercept > 3"));
+    TEST_ASSERT_EQUAL_INT(0x6, apply("beta_intercept > 1 && "
+            "beta_intercept < 4"));
+    TEST_ASSERT_EQUAL_INT(0x6, apply("!(beta_intercept < 2 || "
+            "beta_intercept > 3)"));
+    TEST_ASSERT_EQUAL_INT(0x7, apply("beta_intercept < 2 || "
+            "beta_intercept > 1 && beta_intercept < 4"));
+}
+
+TEST(Filter, functions)
+{
+    TEST_ASSERT_EQUAL_INT(0x7, apply("abs(beta_snp) > 0.01"));
+    TEST_ASSERT_EQUAL_INT(0x8, apply("sqrt(4 * beta_intercept) == 4 "
+            "&& log10(100) == 2"));
+    TEST_ASSERT_EQUAL_INT(0x5, apply("p(snp) < 5e-6"));
+    TEST_ASSERT_EQUAL_INT(0x4, apply("p(beta_snp) < 5e-8"));
+    TEST_ASSERT_EQUAL_INT(0x4, apply("-log10(p(se_snp)) > 7.3"));
+    TEST_ASSERT_EQUAL_INT(0x1, apply("p(snp) < 5e-6 && "
+            "abs(beta_snp) > 0.05"));
+}
+
+/* Test that a filter can use every column, whether it is written to
+   the output or not, and also short batches. */
+TEST(Filter, all_columns_and_short_batch)
+{
+    Filter f;
+
+    TEST_ASSERT_EQUAL_INT(0x2, apply("cov_intercept_snp == 1 && "
+            "se_intercept == 0.5 && se_snp == 1"));
+
+    f = Filter_Compile("beta_intercept > 0", &layout);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(2, Filter_Apply(f, 2, rec, keep));
+    Filter_Destroy(f);
+}
+
+/* Test that an expression evaluates to its value, as --rank-by
+   needs, and that only p(COV) turns into beta / se of COV. */
+TEST(Filter, evaluate_values)
+{
+    double values[NELEMS(records)];
+    Filter f;
+
+    f = Filter_Compile("beta_snp / se_snp", &layout);
+    TEST_ASSERT_NOT_NULL(f);
+    Filter_Evaluate(f, NELEMS(records), rec, values);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, values[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, values[1]);
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, values[3]);
+    TEST_ASSERT_EQUAL_INT(0, Filter_PValueToZ(f));
+    Filter_Destroy(f);
+
+    f = Filter_Compile("p(snp)", &layout);
+    TEST_ASSERT_NOT_NULL(f);
+    Filter_Evaluate(f, 2, rec, values);
+    TEST_ASSERT_TRUE(fabs(values[0] - 5.733e-7) < 1e-9);
+    TEST_ASSERT_TRUE(fabs(values[1] - 0.3173) < 1e-4);
+    TEST_ASSERT_EQUAL_INT(1, Filter_PValueToZ(f));
+    Filter_Evaluate(f, 2, rec, values);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, values[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(-1.0, values[1]);
+    TEST_ASSERT_EQUAL_INT(0, Filter_PValueToZ(f));
+    Filter_Evaluate(f, 2, rec, values);
+    TEST_ASSERT_EQUAL_DOUBLE(5.0, values[0]);
+    Filter_Destroy(f);
+
+    f = Filter_Compile("-log10(p(snp))", &layout);
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL_INT(0, Filter_PValueToZ(f));
+    Filter_Destroy(f);
+}
+
+TEST(Filter, errors)
+{
+    assert_compile_error("beta_x > 1",
+        "unknown column in --where: beta_x");
+    assert_compile_error("foo(beta_snp) > 1",
+        "unknown function in --where: foo");
+    assert_compile_error("p(x) < 1",
+        "unknown covariate in --where: p(x)");
+    assert_compile_error("beta_snp > ",
+        "syntax error in --where at character 12: beta_snp > ");
+    assert_compile_error("(beta_snp > 1",
+        "syntax error in --where at character 14: (beta_snp > 1");
+    assert_compile_error("beta_snp > 1 1",
+        "syntax error in --where at character 14: beta_snp > 1 1");
+}
+
+/* Test that deeply nested expressions fail instead of overflowing the
+   stack of the parser. */
+TEST(Filter, nesting_limit)
+{
+    char *expr;
+    int i, n;
+
+    TEST_ASSERT_NOT_NULL(expr = (char *) malloc(130000 + 16));
+    for (n = 0, i = 0; i < 200; i++)
+        n += sprintf(expr + n, "abs(");
+    n += sprintf(expr + n, "beta_snp");
+    for (i = 0; i < 200; i++)
+        expr[n++] = ')';
+    strcpy(expr + n, " > 1");
+    TEST_ASSERT_EQUAL_INT(apply("abs(beta_snp) > 1"), apply(expr));
+
+    for (n = 0; n < 300; n++)
+        expr[n] = "(-!"[n % 3];
+    strcpy(expr + n, "beta_snp");
+    assert_compile_error(expr, "expression too deeply nested in --where");
+
+    memset(expr, '(', 130000);
+    strcpy(expr + 130000, "beta_snp");
+    assert_compile_error(expr, "expression too deeply nested in --where");
+    free(expr);
+}
@@ -0,0 +1,74 @@
+#include "unity_fixture.h"
+#include "Histogram.h"
+#include <math.h>
+
+static Histogram h;
+
+TEST_GROUP(Histogram);
+
+TEST_SETUP(Histogram)
+{
+    TEST_ASSERT_NOT_NULL(h = Histogram_Create());
+}
+
+TEST_TEAR_DOWN(Histogram)
+{
+    Histogram_Destroy(h);
+}
+
+TEST(Histogram, empty_histogram_gives_zeros)
+{
+    TEST_ASSERT_EQUAL_INT(0, Histogram_Count(h));
+    TEST_ASSERT_EQUAL_INT(0, Histogram_Max(h));
+    TEST_ASSERT_EQUAL_DOUBLE(0, Histogram_Mean(h));
+    TEST_ASSERT_EQUAL_INT(0, Histogram_Percentile(h, 50));
+}
+
+/* Test that small values are counted exactly. */
+TEST(Histogram, small_values_are_exact)
+{
+    unsigned long long v;
+
+    for (v = 1; v <= 100; v++)
+        Histogram_Record(h, v);
+    TEST_ASSERT_EQUAL_INT(100, Histogram_Count(h));
+    TEST_ASSERT_EQUAL_INT(100, Histogram_Max(h));
+    TEST_ASSERT_EQUAL_DOUBLE(50.5, Histogram_Mean(h));
+    TEST_ASSERT_EQUAL_INT(1, Histogram_Percentile(h, 0));
+    TEST_ASSERT_EQUAL_INT(50, Histogram_Percentile(h, 50));
+    TEST_ASSERT_EQUAL_INT(99, Histogram_Percentile(h, 99));
+    TEST_ASSERT_EQUAL_INT(100, Histogram_Percentile(h, 100));
+}
+
+/* Test that percentiles of values over many orders of magnitude are
+   within 1% of the exact ones. */
+TEST(Histogram, percentiles_are_within_one_percent)
+{
+    static const double percents[] = {1, 10, 50, 90, 99, 99.9};
+    unsigned long long v, exact, got;
+    size_t i;
+    int k;
+
+    /* Value k is 1000 times 1.001^k rounded down, for k = 0 to 19999. */
+    for (k = 0; k < 20000; k++)
+        Histogram_Record(h, (unsigned long long) (1000 * pow(1.001, k)));
+    for (i = 0; i < sizeof percents / sizeof percents[0]; i++) {
+        k = (int) ceil(percents[i] / 100 * 20000) - 1;
+        exact = (unsigned long long) (1000 * pow(1.001, k));
+        got = Histogram_Percentile(h, percents[i]);
+        TEST_ASSERT_TRUE(got >= exact);
+        TEST_ASSERT_TRUE(got - exact <= exact / 100);
+    }
+    v = (unsigned long long) (1000 * pow(1.001, 19999));
+    TEST_ASSERT_TRUE(Histogram_Max(h) == v);
+    TEST_ASSERT_TRUE(Histogram_Percentile(h, 100) == v);
+}
+
+/* Test that the largest values fall into the last bucket. */
+TEST(Histogram, record_largest_values)
+{
+    Histogram_Record(h, ~0ULL);
+    Histogram_Record(h, 1ULL << 63);
+    TEST_ASSERT_TRUE(Histogram_Percentile(h, 50) >= 1ULL << 63);
+    TEST_ASSERT_TRUE(Histogram_Percentile(h, 100) == ~0ULL);
+}
@@ -0,0 +1,131 @@
+#include "unity_fixture.h"
+#include "LabelPool.h"
+#include "parse_layout_file.h"
+#include "Memory.h"
+#include "MemorySpy.h"
+#include "err_msg.h"
+#include <stddef.h>
+#include <string.h>
+
+#define NELEMS(x) (sizeof (x) / sizeof (x[0]))
+
+static char *snp_labels[] = {"rs1", "rs22", "rs333", "rs4444", "rs55555",
+                             "rs6", "rs77"};
+static struct Layout layout;
+static LabelPool pool;
+
+static void *(*Old_Memory_Malloc)(size_t nbytes) = NULL;
+
+TEST_GROUP(LabelPool);
+
+TEST_SETUP(LabelPool)
+{
+    layout.nsnp = NELEMS(snp_labels);
+    layout.max_char = 8;
+    layout.snp_labels = snp_labels;
+    pool = LabelPool_Create(&layout, snp_label, layout.nsnp, 3);
+}
+
+TEST_TEAR_DOWN(LabelPool)
+{
+    if (pool != NULL)
+        LabelPool_Destroy(pool);
+    clear_err_msg();
+}
+
+static void check_label(int i)
+{
+    const char *s;
+    size_t len;
+
+    s = LabelPool_Get(pool, i, &len);
+    TEST_ASSERT_EQUAL_INT(strlen(snp_labels[i]), len);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(snp_labels[i], s, len));
+}
+
+/* Test that every label comes with its length, in any order. */
+TEST(LabelPool, get_labels_with_lengths)
+{
+    static const int order[] = {0, 2, 1, 1, 6, 3, 5, 4, 0, 6};
+    int k;
+
+    TEST_ASSERT_NOT_NULL(pool);
+    for (k = 0; k < (int) NELEMS(order); k++)
+        check_label(order[k]);
+}
+
+/* Test that the pool only holds the labels of the current tile, in
+   as many bytes as the labels of a tile take. */
+TEST(LabelPool, pool_holds_one_tile)
+{
+    size_t base;
+
+    base = LabelPool_Size(pool);
+    check_label(0);
+    check_label(2);
+    check_label(2);
+    TEST_ASSERT_EQUAL_INT(base, LabelPool_Size(pool));
+
+    /* The second tile gets the bytes that the first one needed, which
+       leave no room for rs4444. */
+    check_label(4);
+    TEST_ASSERT_EQUAL_INT(base + strlen("rs1") + strlen("rs333"),
+        LabelPool_Size(pool));
+    check_label(3);
+    check_label(4);
+    check_label(3);
+    check_label(6);
+    TEST_ASSERT_EQUAL_INT(base + strlen("rs4444") + strlen("rs55555"),
+        LabelPool_Size(pool));
+    check_label(6);
+}
+
+/* Test that labels are right if the pool can't grow. */
+TEST(LabelPool, labels_stay_in_layout_if_malloc_fails)
+{
+    size_t base;
+
+    base = LabelPool_Size(pool);
+    check_label(0);
+    check_label(1);
+    Old_Memory_Malloc = Memory_Malloc;
+    Memory_Malloc = MemorySpy_Malloc;
+    MemorySpy_MallocReturnNULL();
+    check_label(3);
+    check_label(4);
+    Memory_Malloc = Old_Memory_Malloc;
+    MemorySpy_MallocReset();
+
+    TEST_ASSERT_EQUAL_INT(base, LabelPool_Size(pool));
+    check_label(5);
+    check_label(3);
+}
+
+/* Test that a label without NUL among its max_char bytes is cut
+   short. */
+TEST(LabelPool, labels_are_at_most_max_char_long)
+{
+    const char *s;
+    size_t len;
+
+    layout.max_char = 4;
+    LabelPool_Destroy(pool);
+    pool = LabelPool_Create(&layout, snp_label, layout.nsnp, 3);
+    s = LabelPool_Get(pool, 4, &len);
+    TEST_ASSERT_EQUAL_INT(4, len);
+    TEST_ASSERT_EQUAL_INT(0, memcmp("rs55", s, len));
+}
+
+TEST(LabelPool, return_null_if_malloc_fails)
+{
+    LabelPool p;
+
+    Old_Memory_Malloc = Memory_Malloc;
+    Memory_Malloc = MemorySpy_Malloc;
+    MemorySpy_MallocReturnNULL();
+    p = LabelPool_Create(&layout, snp_label, layout.nsnp, 3);
+    Memory_Malloc = Old_Memory_Malloc;
+    MemorySpy_MallocReset();
+
+    TEST_ASSERT_NULL(p);
+}
@@ -0,0 +1,187 @@
+#include "unity_fixture.h"
+#include "Lookup.h"
+#include "err_msg.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* File of NRECORD records of two unsigned ints each, the record
+   number and its square. */
+static const char *record_file = "test/tmp/lookup.bin";
+enum { NRECORD = 1000, RECORD_SIZE = 2 * sizeof(unsigned int) };
+
+static int fd = -1;
+
+static int (*Old_Lookup_Enter)(int, unsigned, unsigned, unsigned) = NULL;
+static int nenter;              /* calls of Lookup_Enter that submit */
+static int fail_errno;          /* errno of failing calls */
+
+/* Fail every other call that submits reads with fail_errno, without
+   submitting any of them. */
+static int FailingEnter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags)
+{
+    if (to_submit > 0  &&  nenter++ % 2 == 1) {
+        errno = fail_errno;
+        return -1;
+    }
+    return Old_Lookup_Enter(fd, to_submit, min_complete, flags);
+}
+
+static void fail_enter(int err)
+{
+    Old_Lookup_Enter = Lookup_Enter;
+    Lookup_Enter = FailingEnter;
+    nenter = 0;
+    fail_errno = err;
+}
+
+TEST_GROUP(Lookup);
+
+TEST_SETUP(Lookup)
+{
+    FILE *fp;
+    unsigned int x[2], i;
+
+    TEST_ASSERT_TRUE((fp = fopen(record_file, "wb")) != NULL);
+    for (i = 0; i < NRECORD; i++) {
+        x[0] = i;
+        x[1] = i * i;
+        TEST_ASSERT_TRUE(fwrite(x, sizeof x, 1, fp) == 1);
+    }
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_TRUE((fd = open(record_file, O_RDONLY)) != -1);
+}
+
+TEST_TEAR_DOWN(Lookup)
+{
+    if (Old_Lookup_Enter != NULL)
+        Lookup_Enter = Old_Lookup_Enter;
+    Old_Lookup_Enter = NULL;
+    close(fd);
+    fd = -1;
+    clear_err_msg();
+}
+
+/* Read NREAD ranges scattered over the file, in an order that is not
+   the file order, and check that every range holds its records. */
+static void check_reads(int depth, int engine)
+{
+    enum { NREAD = 100 };
+    struct LookupRead reads[NREAD];
+    const unsigned int *x;
+    unsigned long i, j, nbytes;
+    char *buf;
+    Lookup lk;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(lk = Lookup_Create(fd, record_file,
+            RECORD_SIZE, depth, engine), err_msg);
+    TEST_ASSERT_NOT_NULL(buf = (char *) malloc(NREAD * 3 * RECORD_SIZE));
+    for (i = 0; i < NREAD; i++) {
+        reads[i].offset = (i * 37) % (NRECORD - 3);
+        reads[i].n = i % 3 + 1;
+        reads[i].buf = buf + i * 3 * RECORD_SIZE;
+    }
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, Lookup_Run(lk, reads, NREAD),
+        err_msg);
+    nbytes = 0;
+    for (i = 0; i < NREAD; i++) {
+        x = (const unsigned int *) reads[i].buf;
+        for (j = 0; j < reads[i].n; j++) {
+            TEST_ASSERT_EQUAL_INT(reads[i].offset + j, x[2 * j]);
+            TEST_ASSERT_EQUAL_INT((reads[i].offset + j)
+                * (reads[i].offset + j), x[2 * j + 1]);
+        }
+        nbytes += reads[i].n * RECORD_SIZE;
+    }
+    TEST_ASSERT_EQUAL_INT(NREAD, Lookup_Reads(lk));
+    TEST_ASSERT_TRUE(Lookup_BytesRead(lk) == nbytes);
+    if (engine == LOOKUP_PREAD)
+        TEST_ASSERT_EQUAL_INT(0, Lookup_UsesIoUring(lk));
+
+    free(buf);
+    Lookup_Destroy(lk);
+}
+
+TEST(Lookup, read_ranges_in_any_order)
+{
+    static const int depths[] = {1, 4, 64, 4096};
+    int k;
+
+    for (k = 0; k < (int) (sizeof depths / sizeof depths[0]); k++) {
+        check_reads(depths[k], LOOKUP_AUTO);
+        check_reads(depths[k], LOOKUP_PREAD);
+    }
+}
+
+/* Test that a range past the end of the file gives an error message
+   for that range. */
+TEST(Lookup, read_past_end_of_file_gives_error)
+{
+    struct LookupRead reads[2];
+    char buf[2][2 * RECORD_SIZE];
+    Lookup lk;
+    int engine;
+
+    for (engine = LOOKUP_AUTO; engine <= LOOKUP_PREAD; engine++) {
+        reads[0].offset = 0;
+        reads[1].offset = NRECORD - 1;
+        reads[0].n = reads[1].n = 2;
+        reads[0].buf = buf[0];
+        reads[1].buf = buf[1];
+        TEST_ASSERT_NOT_NULL(lk = Lookup_Create(fd, record_file,
+                RECORD_SIZE, 8, engine));
+        TEST_ASSERT_EQUAL_INT(0, Lookup_Run(lk, reads, 2));
+        TEST_ASSERT_EQUAL_STRING("failed to read records 999 to 1000 from "
+            "data file: test/tmp/lookup.bin", err_msg);
+        Lookup_Destroy(lk);
+        clear_err_msg();
+    }
+}
+
+/* Test that reads are submitted again while the kernel is short of
+   resources for them. */
+TEST(Lookup, retry_while_kernel_is_busy)
+{
+    static const int depths[] = {1, 4, 64};
+    int k;
+
+    for (k = 0; k < (int) (sizeof depths / sizeof depths[0]); k++) {
+        fail_enter(k % 2 ? EBUSY : EAGAIN);
+        check_reads(depths[k], LOOKUP_AUTO);
+        Lookup_Enter = Old_Lookup_Enter;
+    }
+}
+
+/* Test that other failures of io_uring_enter(2) give an error after
+   the reads in flight completed. */
+TEST(Lookup, failed_submission_gives_error)
+{
+    enum { NREAD = 64 };
+    struct LookupRead reads[NREAD];
+    char buf[NREAD][RECORD_SIZE];
+    Lookup lk;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(lk = Lookup_Create(fd, record_file, RECORD_SIZE,
+            4, LOOKUP_AUTO));
+    if (!Lookup_UsesIoUring(lk)) {     /* nothing to submit */
+        Lookup_Destroy(lk);
+        return;
+    }
+    for (i = 0; i < NREAD; i++) {
+        reads[i].offset = i;
+        reads[i].n = 1;
+        reads[i].buf = buf[i];
+    }
+    fail_enter(EINVAL);
+    TEST_ASSERT_EQUAL_INT(0, Lookup_Run(lk, reads, NREAD));
+    TEST_ASSERT_EQUAL_STRING("failed to submit reads of data file: "
+        "test/tmp/lookup.bin", err_msg);
+    TEST_ASSERT_TRUE(Lookup_Reads(lk) > 0  &&  Lookup_Reads(lk) < NREAD);
+    Lookup_Destroy(lk);
+}
@@ -0,0 +1,225 @@
+#include "unity_fixture.h"
+#include "ResultSetFixture.h"
+#include "Reader.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* The result set of ResultSetFixture.h, in tiles of 3 snps by 2
+   traits. */
+enum { NSNP = FIXTURE_NSNP, NTRAIT = FIXTURE_NTRAIT,
+    NVALUE = FIXTURE_NVALUE };
+
+static const char *prefix = "test/tmp/reader";
+static char msg[ERR_MSG_MAXLEN];   /* for Reader_ErrMsg */
+
+static double value(int snp, int trait, int j)
+{
+    return ResultSetFixture_Value(snp, trait, j);
+}
+
+TEST_GROUP(Reader);
+
+TEST_SETUP(Reader)
+{
+    ResultSetFixture_Write(prefix, 0, NSNP, 0, NTRAIT, 3, 2, 8);
+}
+
+TEST_TEAR_DOWN(Reader)
+{
+    ResultSetFixture_Remove(prefix);
+    clear_err_msg();
+}
+
+/* Return the number of records of r that don't have the expected
+   values. */
+static int count_wrong_records(Reader r)
+{
+    double values[NVALUE];
+    int snp, trait, j, nwrong;
+
+    nwrong = 0;
+    for (trait = 0; trait < NTRAIT; trait++)
+        for (snp = 0; snp < NSNP; snp++) {
+            if (!Reader_GetRecord(r, snp, trait, values)) {
+                nwrong++;
+                continue;
+            }
+            for (j = 0; j < NVALUE; j++)
+                if (values[j] != value(snp, trait, j)) {
+                    nwrong++;
+                    break;
+                }
+        }
+    return nwrong;
+}
+
+TEST(Reader, get_records_by_snp_and_trait)
+{
+    Reader r;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(r = Reader_Open(prefix), err_msg);
+    TEST_ASSERT_EQUAL_INT(NSNP, Reader_NumSnps(r));
+    TEST_ASSERT_EQUAL_INT(NTRAIT, Reader_NumTraits(r));
+    TEST_ASSERT_EQUAL_STRING("rs4", Reader_SnpLabel(r, 4));
+    TEST_ASSERT_EQUAL_STRING("t2", Reader_TraitLabel(r, 2));
+    TEST_ASSERT_NULL(Reader_SnpLabel(r, NSNP));
+    TEST_ASSERT_EQUAL_STRING("snp index out of range: 7",
+        Reader_ErrMsg(r, msg, sizeof msg));
+    TEST_ASSERT_NULL(Reader_TraitLabel(r, -1));
+    TEST_ASSERT_EQUAL_INT(NVALUE, Reader_ValuesPerRecord(r));
+    TEST_ASSERT_EQUAL_INT(0, count_wrong_records(r));
+    Reader_Close(r);
+}
+
+/* Test that single precision values come out as doubles. */
+TEST(Reader, get_records_in_single_precision)
+{
+    Reader r;
+
+    ResultSetFixture_Write(prefix, 0, NSNP, 0, NTRAIT, 3, 2, 4);
+    TEST_ASSERT_NOT_NULL_MESSAGE(r = Reader_Open(prefix), err_msg);
+    TEST_ASSERT_EQUAL_INT(0, count_wrong_records(r));
+    Reader_Close(r);
+}
+
+/* Test that the tiles cover every record once and point into a single
+   mapping of the data file. */
+TEST(Reader, get_tiles_in_file_order)
+{
+    struct ReaderTile t;
+    const double *x;
+    const char *next;
+    unsigned long k, nrecord;
+    int snp, trait, j;
+    Reader r;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(r = Reader_Open(prefix), err_msg);
+    TEST_ASSERT_EQUAL_INT(9, Reader_NumTiles(r));
+    nrecord = 0;
+    next = NULL;
+    for (k = 0; k < Reader_NumTiles(r); k++) {
+        TEST_ASSERT_EQUAL_INT_MESSAGE(1, Reader_GetTile(r, k, &t),
+            Reader_ErrMsg(r, msg, sizeof msg));
+        TEST_ASSERT_TRUE(k == 0  ||  t.data == next);
+        x = (const double *) t.data;
+        for (trait = t.trait0; trait < t.trait1; trait++)
+            for (snp = t.snp0; snp < t.snp1; snp++) {
+                for (j = 0; j < NVALUE; j++)
+                    TEST_ASSERT_EQUAL_DOUBLE(value(snp, trait, j), *x++);
+                nrecord++;
+            }
+        next = (const char *) x;
+    }
+    TEST_ASSERT_EQUAL_INT(NSNP * NTRAIT, nrecord);
+    TEST_ASSERT_EQUAL_INT(6, t.snp0);
+    TEST_ASSERT_EQUAL_INT(7, t.snp1);
+    TEST_ASSERT_EQUAL_INT(4, t.trait0);
+    TEST_ASSERT_EQUAL_INT(5, t.trait1);
+    Reader_Close(r);
+}
+
+/* Test that every reader keeps its own error message. */
+TEST(Reader, errors_belong_to_reader)
+{
+    double values[NVALUE];
+    struct ReaderTile t;
+    Reader r1, r2;
+
+    TEST_ASSERT_NOT_NULL(r1 = Reader_Open(prefix));
+    TEST_ASSERT_NOT_NULL(r2 = Reader_Open(prefix));
+    TEST_ASSERT_EQUAL_INT(0, Reader_GetRecord(r1, NSNP, 0, values));
+    TEST_ASSERT_EQUAL_INT(0, Reader_GetTile(r2, 9, &t));
+    TEST_ASSERT_EQUAL_STRING("snp index out of range: 7",
+        Reader_ErrMsg(r1, msg, sizeof msg));
+    TEST_ASSERT_EQUAL_STRING("tile index out of range: 9",
+        Reader_ErrMsg(r2, msg, sizeof msg));
+    Reader_Close(r1);
+    Reader_Close(r2);
+
+    TEST_ASSERT_NULL(Reader_Open("test/tmp/missing"));
+    TEST_ASSERT_EQUAL_STRING("failed to open layout file for reading: "
+        "test/tmp/missing.iout", Reader_ErrMsg(NULL, msg, sizeof msg));
+}
+
+TEST(Reader, truncated_data_file_gives_error)
+{
+    FILE *fp;
+
+    TEST_ASSERT_NOT_NULL(fp = fopen("test/tmp/reader.out", "wb"));
+    TEST_ASSERT_TRUE(fwrite("12345678", 8, 1, fp) == 1);
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+    TEST_ASSERT_NULL(Reader_Open(prefix));
+    TEST_ASSERT_EQUAL_STRING("data file too short: expected 1400 bytes, "
+        "got 8: test/tmp/reader.out", err_msg);
+}
+
+/* Every thread of the stress test reads all records ROUNDS times, from
+   a reader that all threads share or from one of its own, and fails on
+   purpose after every round with a message of its own. */
+enum { NTHREAD = 8, ROUNDS = 200 };
+
+struct Job {
+    Reader shared;              /* reader of all threads or NULL */
+    int id;
+    int nwrong;                 /* number of wrong records */
+    int nwrong_msg;             /* number of wrong error messages */
+};
+
+static void *stress(void *arg)
+{
+    struct Job *job = (struct Job *) arg;
+    double values[NVALUE];
+    char expected[ERR_MSG_MAXLEN], last[ERR_MSG_MAXLEN];
+    Reader r;
+    int i, id;
+
+    if ((r = job->shared) == NULL  &&  (r = Reader_Open(prefix)) == NULL) {
+        job->nwrong = -1;
+        return NULL;
+    }
+    sprintf(expected, "trait index out of range: %d", NTRAIT + job->id);
+    for (i = 0; i < ROUNDS; i++) {
+        job->nwrong += count_wrong_records(r);
+        if (Reader_GetRecord(r, 0, NTRAIT + job->id, values)
+            ||  strcmp(err_msg, expected) != 0)
+            job->nwrong_msg++;
+
+        /* A shared reader keeps the message of any thread's failure. */
+        Reader_ErrMsg(r, last, sizeof last);
+        if (job->shared == NULL ? strcmp(last, expected) != 0
+            : sscanf(last, "trait index out of range: %d", &id) != 1
+                ||  id < NTRAIT  ||  id >= NTRAIT + NTHREAD)
+            job->nwrong_msg++;
+    }
+    if (job->shared == NULL)
+        Reader_Close(r);
+    return NULL;
+}
+
+TEST(Reader, many_threads_read_at_once)
+{
+    struct Job jobs[NTHREAD];
+    pthread_t threads[NTHREAD];
+    Reader shared;
+    int i;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(shared = Reader_Open(prefix), err_msg);
+    for (i = 0; i < NTHREAD; i++) {
+        jobs[i].shared = i % 2 == 0 ? shared : NULL;
+        jobs[i].id = i;
+        jobs[i].nwrong = jobs[i].nwrong_msg = 0;
+        TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, stress,
+                &jobs[i]));
+    }
+    for (i = 0; i < NTHREAD; i++)
+        pthread_join(threads[i], NULL);
+    for (i = 0; i < NTHREAD; i++) {
+        TEST_ASSERT_EQUAL_INT(0, jobs[i].nwrong);
+        TEST_ASSERT_EQUAL_INT(0, jobs[i].nwrong_msg);
+    }
+    TEST_ASSERT_EQUAL_STRING("", err_msg);
+    Reader_Close(shared);
+}
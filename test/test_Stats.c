@@ -0,0 +1,168 @@
+#include "unity_fixture.h"
+#include "Stats.h"
+#include "parse_layout_file.h"
+#include "Memory.h"
+#include "MemorySpy.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *report_file = "test/tmp/stats.txt";
+static struct Layout layout;
+static Stats stats;
+static FILE *fp;
+
+static void *(*Old_Memory_Malloc)(size_t nbytes) = NULL;
+
+TEST_GROUP(Stats);
+
+TEST_SETUP(Stats)
+{
+    /* 10 snps by 8 traits in tiles of 4 snps by 3 traits make 3 rows
+       of 3 tiles each. */
+    layout.nsnp = 10;
+    layout.ntrait = 8;
+    layout.snps_per_tile = 4;
+    layout.traits_per_tile = 3;
+    fp = fopen(report_file, "w+");
+    stats = Stats_Create(fp);
+}
+
+TEST_TEAR_DOWN(Stats)
+{
+    if (stats != NULL)
+        Stats_Destroy(stats);
+    if (fp != NULL)
+        fclose(fp);
+    remove(report_file);
+    clear_err_msg();
+}
+
+/* Return what was written to the report file so far. */
+static const char *report(void)
+{
+    static char buf[1024];
+    size_t n;
+
+    fflush(fp);
+    rewind(fp);
+    n = fread(buf, 1, sizeof buf - 1, fp);
+    buf[n] = '\0';
+    return buf;
+}
+
+/* Test that the time of every phase and the records add up. */
+TEST(Stats, phases_and_records_add_up)
+{
+    double t;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(stats);
+    for (i = 0; i < 3; i++) {
+        t = Stats_Start(stats);
+        while (Stats_Start(stats) == t)
+            ;
+        Stats_Stop(stats, STATS_FORMAT, t);
+        Stats_AddRecords(stats, 7);
+    }
+    TEST_ASSERT_TRUE(Stats_Seconds(stats, STATS_FORMAT) > 0.0);
+    TEST_ASSERT_TRUE(Stats_Seconds(stats, STATS_READ) == 0.0);
+    TEST_ASSERT_EQUAL_INT(21, Stats_Records(stats));
+    TEST_ASSERT_EQUAL_STRING("", report());
+}
+
+/* Test that progress reports count completed tiles. */
+TEST(Stats, report_progress_in_tiles)
+{
+    Stats_SetInterval(stats, 0.0);
+    Stats_SetTotal(stats, &layout, 80, 72);
+    Stats_AddRecords(stats, 30);
+    TEST_ASSERT_NOT_NULL(strstr(report(),
+            "r3shuffle: 37.5%, 3 of 9 tiles, "));
+    TEST_ASSERT_NOT_NULL(strstr(report(), " records/s, "));
+    TEST_ASSERT_NOT_NULL(strstr(report(), " MB/s, ETA "));
+}
+
+/* Test that progress reports of a selection don't mention tiles. */
+TEST(Stats, report_progress_of_selection)
+{
+    Stats_SetInterval(stats, 0.0);
+    Stats_SetTotal(stats, &layout, 16, 72);
+    Stats_AddRecords(stats, 4);
+    TEST_ASSERT_NOT_NULL(strstr(report(), "r3shuffle: 25.0%, "));
+    TEST_ASSERT_NULL(strstr(report(), "tiles"));
+}
+
+/* Test that progress reports of a batch count result sets. */
+TEST(Stats, report_progress_in_result_sets)
+{
+    Stats_SetInterval(stats, 0.0);
+    Stats_SetBatch(stats, 2);
+    Stats_SetTotal(stats, &layout, 80, 72);
+    Stats_AddSet(stats);
+    Stats_AddRecords(stats, 80);
+    TEST_ASSERT_NOT_NULL(strstr(report(),
+            "r3shuffle: 50.0%, 1 of 2 result sets, "));
+    TEST_ASSERT_NULL(strstr(report(), "tiles"));
+}
+
+/* Test that the summary is a single line of JSON. */
+TEST(Stats, print_summary_as_json)
+{
+    const char *s;
+
+    Stats_SetTotal(stats, &layout, 80, 72);
+    Stats_AddRecords(stats, 80);
+    Stats_AddReads(stats, 5760, 3);
+    Stats_AddWrites(stats, 1000, 2);
+    Stats_AddWrites(stats, 500, 1);
+    TEST_ASSERT_EQUAL_INT(1, Stats_Print(stats, fp, 4));
+
+    s = report();
+    TEST_ASSERT_EQUAL_INT(0, strncmp(s, "{\"threads\":4,\"records\":80,",
+            strlen("{\"threads\":4,\"records\":80,")));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"layout_seconds\":"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"read_seconds\":"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"format_seconds\":"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"write_seconds\":"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"bytes_read\":5760,"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"bytes_written\":1500,"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"data_reads\":3,"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"output_writes\":3,"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"peak_rss_kb\":"));
+    TEST_ASSERT_NOT_NULL(strstr(s, ",\"read_syscalls\":"));
+    TEST_ASSERT_EQUAL_STRING("}\n", s + strlen(s) - 2);
+    TEST_ASSERT_TRUE(strchr(s, '\n') == s + strlen(s) - 1);
+}
+
+/* Test that all functions accept NULL for runs without --stats. */
+TEST(Stats, null_stats_do_nothing)
+{
+    Stats_SetInterval(NULL, 0.0);
+    Stats_SetTotal(NULL, &layout, 80, 72);
+    Stats_SetBatch(NULL, 2);
+    Stats_Stop(NULL, STATS_READ, Stats_Start(NULL));
+    Stats_AddRecords(NULL, 80);
+    Stats_AddSet(NULL);
+    Stats_AddReads(NULL, 1, 1);
+    Stats_AddWrites(NULL, 1, 1);
+    TEST_ASSERT_TRUE(Stats_Seconds(NULL, STATS_READ) == 0.0);
+    TEST_ASSERT_EQUAL_INT(0, Stats_Records(NULL));
+    TEST_ASSERT_EQUAL_INT(1, Stats_Print(NULL, fp, 1));
+    Stats_Destroy(NULL);
+    TEST_ASSERT_EQUAL_STRING("", report());
+}
+
+TEST(Stats, return_null_if_malloc_fails)
+{
+    Stats s;
+
+    Old_Memory_Malloc = Memory_Malloc;
+    Memory_Malloc = MemorySpy_Malloc;
+    MemorySpy_MallocReturnNULL();
+    s = Stats_Create(fp);
+    Memory_Malloc = Old_Memory_Malloc;
+    MemorySpy_MallocReset();
+
+    TEST_ASSERT_NULL(s);
+}
@@ -4,16 +4,23 @@
 #include "IOSpy.h"
 #include "Memory.h"
 #include "MemorySpy.h"
+#include "err_msg.h"
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 static Stream stream;
 static const char *filename = "foobar";
-static const char *line = NULL;
 
 static FILE *(*Old_IO_OpenFile)(const char *, const char *) = NULL;
 static int (*Old_IO_CloseFile)(FILE *) = NULL;
 static void *(*Old_Memory_Malloc)(size_t nbytes) = NULL;
+static void (*Old_Memory_Free)(void *) = NULL;
+
+/* File of NRECORD records of two unsigned ints each, the record
+   number and its square, read by the tests that use a real file. */
+static const char *record_file = "test/tmp/stream.bin";
+enum { NRECORD = 1000 };
 
 TEST_GROUP(Stream);
 
@@ -28,6 +35,9 @@ TEST_SETUP(Stream)
     Old_Memory_Malloc = Memory_Malloc;
     Memory_Malloc = MemorySpy_Malloc;
 
+    Old_Memory_Free = Memory_Free;
+    Memory_Free = MemorySpy_Free;
+
     stream = Stream_Create(filename);
 }
 
@@ -36,8 +46,30 @@ TEST_TEAR_DOWN(Stream)
     IO_OpenFile = Old_IO_OpenFile;
     IO_CloseFile = Old_IO_CloseFile;
     Memory_Malloc = Old_Memory_Malloc;
+    Memory_Free = Old_Memory_Free;
 
     MemorySpy_MallocReset();
+    clear_err_msg();
+}
+
+/* Undo the spies and write the record file. */
+static void use_record_file(void)
+{
+    FILE *fp;
+    unsigned int x[2], i;
+
+    IO_OpenFile = Old_IO_OpenFile;
+    IO_CloseFile = Old_IO_CloseFile;
+    Memory_Malloc = Old_Memory_Malloc;
+    Memory_Free = Old_Memory_Free;
+
+    TEST_ASSERT_TRUE((fp = fopen(record_file, "wb")) != NULL);
+    for (i = 0; i < NRECORD; i++) {
+        x[0] = i;
+        x[1] = i * i;
+        TEST_ASSERT_TRUE(fwrite(x, sizeof x, 1, fp) == 1);
+    }
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
 }
 
 TEST(Stream, return_null_if_file_cannot_be_opened)
@@ -85,3 +117,87 @@ TEST(Stream, return_null_if_malloc_fails)
 
     TEST_ASSERT_TRUE(st == NULL);
 }
+
+TEST(Stream, default_record_size_is_one)
+{
+    TEST_ASSERT_EQUAL_INT(1, Stream_GetRecordSize(stream));
+}
+
+TEST(Stream, record_size_can_be_changed)
+{
+    Stream_SetRecordSize(stream, 24);
+    TEST_ASSERT_EQUAL_INT(24, Stream_GetRecordSize(stream));
+}
+
+TEST(Stream, close_reports_failure_to_close_file)
+{
+    TEST_ASSERT_EQUAL_INT(0, Stream_Close(stream));
+    TEST_ASSERT_EQUAL_STRING("failed to close file: foobar", err_msg);
+}
+
+/* Test that reads of any size up to the chunk size, including reads
+   that straddle two chunks, give the records in file order, and that
+   reading past the end of the file fails. */
+TEST(Stream, read_records_in_chunks)
+{
+    static const int chunk_sizes[] = {1, 7, 64, NRECORD, 4 * NRECORD};
+    const unsigned int *x;
+    const char *p;
+    Stream st;
+    unsigned long i, n, expected;
+    int k;
+
+    use_record_file();
+    for (k = 0; k < (int) (sizeof chunk_sizes / sizeof chunk_sizes[0]);
+         k++) {
+        TEST_ASSERT_NOT_NULL_MESSAGE(st = Stream_Create(record_file),
+            err_msg);
+        Stream_SetRecordSize(st, 2 * sizeof(unsigned int));
+        Stream_SetChunkSize(st, chunk_sizes[k]);
+        for (i = 0; i < NRECORD; i += n) {
+            n = i % chunk_sizes[k] + 1;
+            if (n > NRECORD - i)
+                n = NRECORD - i;
+            TEST_ASSERT_EQUAL_INT_MESSAGE(1, Stream_Read(st, n, &p),
+                err_msg);
+            x = (const unsigned int *) p;
+            TEST_ASSERT_EQUAL_INT(i, x[0]);
+            TEST_ASSERT_EQUAL_INT(i * i, x[1]);
+            TEST_ASSERT_EQUAL_INT(i + n - 1, x[2 * (n - 1)]);
+        }
+        TEST_ASSERT_EQUAL_INT(0, Stream_Read(st, 1, &p));
+        TEST_ASSERT_EQUAL_STRING("failed to read record 1000 from data "
+            "file: test/tmp/stream.bin", err_msg);
+
+        /* Every read but the last one fills a chunk. */
+        expected = NRECORD / chunk_sizes[k] + 1;
+        TEST_ASSERT_EQUAL_INT(expected, Stream_Reads(st));
+        TEST_ASSERT_TRUE(Stream_BytesRead(st)
+            == NRECORD * 2 * sizeof(unsigned int));
+        TEST_ASSERT_EQUAL_INT(1, Stream_Close(st));
+    }
+}
+
+/* Test that a stream can be closed while the reader thread waits for
+   a free buffer. */
+TEST(Stream, close_before_end_of_file)
+{
+    const char *p;
+    Stream st;
+
+    use_record_file();
+    TEST_ASSERT_NOT_NULL(st = Stream_Create(record_file));
+    Stream_SetRecordSize(st, 2 * sizeof(unsigned int));
+    Stream_SetChunkSize(st, 10);
+    TEST_ASSERT_EQUAL_INT(1, Stream_Read(st, 5, &p));
+    TEST_ASSERT_EQUAL_INT(1, Stream_Close(st));
+}
+
+/* Test that a file that cannot be opened gives an error message. */
+TEST(Stream, missing_file_gives_error)
+{
+    use_record_file();
+    TEST_ASSERT_NULL(Stream_Create("test/tmp/no/such/file"));
+    TEST_ASSERT_EQUAL_STRING("failed to open file for reading: "
+        "test/tmp/no/such/file", err_msg);
+}
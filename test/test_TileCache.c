@@ -0,0 +1,100 @@
+#include "unity_fixture.h"
+#include "TileCache.h"
+
+/* Tiles of NVALUE doubles, where value j of tile t is 1000 * t + j. */
+enum { NVALUE = 10, TILE_BYTES = NVALUE * sizeof(double) };
+
+static TileCache cache;
+
+static void put(unsigned long tile)
+{
+    double *v;
+    int j;
+
+    TEST_ASSERT_NULL(TileCache_Get(cache, tile));
+    TEST_ASSERT_NOT_NULL(v = TileCache_Put(cache, tile, NVALUE));
+    for (j = 0; j < NVALUE; j++)
+        v[j] = 1000.0 * tile + j;
+}
+
+static int is_cached(unsigned long tile)
+{
+    double *v;
+    int j;
+
+    if ((v = TileCache_Get(cache, tile)) == NULL)
+        return 0;
+    for (j = 0; j < NVALUE; j++)
+        TEST_ASSERT_EQUAL_DOUBLE(1000.0 * tile + j, v[j]);
+    return 1;
+}
+
+TEST_GROUP(TileCache);
+
+TEST_SETUP(TileCache)
+{
+    TEST_ASSERT_NOT_NULL(cache = TileCache_Create(3 * TILE_BYTES));
+}
+
+TEST_TEAR_DOWN(TileCache)
+{
+    TileCache_Destroy(cache);
+}
+
+TEST(TileCache, get_tiles_that_were_put)
+{
+    put(7);
+    put(3);
+    TEST_ASSERT_TRUE(is_cached(7));
+    TEST_ASSERT_TRUE(is_cached(3));
+    TEST_ASSERT_FALSE(is_cached(5));
+    TEST_ASSERT_EQUAL_INT(2, TileCache_Tiles(cache));
+    TEST_ASSERT_EQUAL_INT(2 * TILE_BYTES, TileCache_Bytes(cache));
+    TEST_ASSERT_EQUAL_INT(2, TileCache_Hits(cache));
+    TEST_ASSERT_EQUAL_INT(3, TileCache_Misses(cache));
+}
+
+/* Test that the least recently used tile makes room for a new one. */
+TEST(TileCache, evict_least_recently_used_tile)
+{
+    put(0);
+    put(1);
+    put(2);
+    TEST_ASSERT_TRUE(is_cached(0));
+    put(3);
+    TEST_ASSERT_FALSE(is_cached(1));
+    TEST_ASSERT_TRUE(is_cached(2));
+    TEST_ASSERT_TRUE(is_cached(0));
+    TEST_ASSERT_TRUE(is_cached(3));
+    TEST_ASSERT_EQUAL_INT(3, TileCache_Tiles(cache));
+    TEST_ASSERT_EQUAL_INT(3 * TILE_BYTES, TileCache_Bytes(cache));
+}
+
+/* Test that a tile larger than the cache is kept on its own. */
+TEST(TileCache, keep_tile_larger_than_cache)
+{
+    put(0);
+    put(1);
+    TEST_ASSERT_NOT_NULL(TileCache_Put(cache, 2, 4 * NVALUE));
+    TEST_ASSERT_EQUAL_INT(1, TileCache_Tiles(cache));
+    TEST_ASSERT_NOT_NULL(TileCache_Get(cache, 2));
+    put(3);
+    TEST_ASSERT_EQUAL_INT(1, TileCache_Tiles(cache));
+    TEST_ASSERT_TRUE(is_cached(3));
+}
+
+/* Test that many tiles are found after the hash table grew. */
+TEST(TileCache, find_many_tiles)
+{
+    unsigned long tile;
+
+    TileCache_Destroy(cache);
+    TEST_ASSERT_NOT_NULL(cache = TileCache_Create(1000 * TILE_BYTES));
+    for (tile = 0; tile < 2000; tile++)
+        put(tile * 64);
+    TEST_ASSERT_EQUAL_INT(1000, TileCache_Tiles(cache));
+    for (tile = 0; tile < 1000; tile++)
+        TEST_ASSERT_FALSE(is_cached(tile * 64));
+    for (tile = 1000; tile < 2000; tile++)
+        TEST_ASSERT_TRUE(is_cached(tile * 64));
+}
@@ -0,0 +1,112 @@
+#include "unity_fixture.h"
+#include "TopK.h"
+#include <math.h>
+
+/* Records of three columns, of which the TopK keeps columns 2 and 0. */
+enum { NTRAIT = 3, K = 4 };
+
+static const int columns[] = {2, 0};
+static TopK top;
+
+/* Offer the record of snp and trait with score and columns snp,
+   trait, and score. */
+static void add(TopK t, int trait, int snp, double score)
+{
+    double record[3];
+
+    record[0] = snp;
+    record[1] = trait;
+    record[2] = score;
+    TopK_Add(t, trait, snp, score, record);
+}
+
+/* Check that hit i of trait is snp with its score. */
+static void assert_hit(TopK t, int trait, int i, int snp, double score)
+{
+    const double *v;
+    int s;
+
+    v = TopK_Get(t, trait, i, &s);
+    TEST_ASSERT_EQUAL_INT(snp, s);
+    TEST_ASSERT_EQUAL_DOUBLE(score, v[0]);
+    TEST_ASSERT_EQUAL_DOUBLE(snp, v[1]);
+}
+
+TEST_GROUP(TopK);
+
+TEST_SETUP(TopK)
+{
+    TEST_ASSERT_NOT_NULL(top = TopK_Create(NTRAIT, K, 2, columns));
+}
+
+TEST_TEAR_DOWN(TopK)
+{
+    TopK_Destroy(top);
+}
+
+/* Test that the K highest scores of every trait are kept in order,
+   whatever order they come in. */
+TEST(TopK, keep_highest_scores)
+{
+    int snp;
+
+    for (snp = 0; snp < 100; snp++) {
+        add(top, 0, snp, (snp * 37) % 100);
+        add(top, 2, snp, -snp);
+    }
+    add(top, 1, 5, 1.5);
+    add(top, 1, 6, NAN);
+    TopK_Sort(top);
+
+    TEST_ASSERT_EQUAL_INT(K, TopK_Count(top, 0));
+    assert_hit(top, 0, 0, 27, 99);
+    assert_hit(top, 0, 1, 54, 98);
+    assert_hit(top, 0, 2, 81, 97);
+    assert_hit(top, 0, 3, 8, 96);
+    TEST_ASSERT_EQUAL_INT(1, TopK_Count(top, 1));
+    assert_hit(top, 1, 0, 5, 1.5);
+    TEST_ASSERT_EQUAL_INT(K, TopK_Count(top, 2));
+    for (snp = 0; snp < K; snp++)
+        assert_hit(top, 2, snp, snp, -snp);
+}
+
+/* Test that of equal scores, the smaller snps win. */
+TEST(TopK, ties_go_to_smaller_snps)
+{
+    int snp;
+
+    for (snp = 9; snp >= 0; snp--)
+        add(top, 0, snp, 1.0);
+    TopK_Sort(top);
+    for (snp = 0; snp < K; snp++)
+        assert_hit(top, 0, snp, snp, 1.0);
+}
+
+/* Test that merging the TopKs of parts of the records gives the TopK
+   of all of them. */
+TEST(TopK, merge_parts)
+{
+    TopK part[3];
+    int i, snp, trait;
+
+    for (i = 0; i < 3; i++)
+        TEST_ASSERT_NOT_NULL(part[i] = TopK_Create(NTRAIT, K, 2,
+                columns));
+    for (snp = 0; snp < 50; snp++)
+        for (trait = 0; trait < NTRAIT; trait++)
+            add(part[snp % 3], trait, snp, (snp * 13 + trait) % 50);
+    for (i = 0; i < 3; i++) {
+        TopK_Merge(top, part[i]);
+        TopK_Destroy(part[i]);
+    }
+    TopK_Sort(top);
+
+    /* Scores 49 to 46 of trait t belong to snps (49 - t) * 27 % 50 and
+       so on, since 27 is the inverse of 13 modulo 50. */
+    for (trait = 0; trait < NTRAIT; trait++) {
+        TEST_ASSERT_EQUAL_INT(K, TopK_Count(top, trait));
+        for (i = 0; i < K; i++)
+            assert_hit(top, trait, i, (49 - i - trait) * 27 % 50,
+                49 - i);
+    }
+}
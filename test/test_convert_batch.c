@@ -0,0 +1,243 @@
+#include "unity_fixture.h"
+#include "convert_batch.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct Layout layout;
+static struct Params params;
+
+static char *beta_labels[] = {"b0", "b1"};
+static char *se_labels[] = {"s0", "s1"};
+static char *cov_labels[] = {"c01"};
+static char *other_cov_labels[] = {"c10"};
+static char *snp_labels[] = {"snp0", "snp1", "snp2", "snp3", "snp4"};
+static char *trait_labels[] = {"trait0", "trait1", "trait2"};
+
+static const char *manifest = "test/tmp/manifest.txt";
+static const char *output_file = "test/tmp/batch.txt";
+static const char *prefixes[] = {"test/tmp/chunk1", "test/tmp/chunk2"};
+
+TEST_GROUP(convert_batch);
+
+TEST_SETUP(convert_batch)
+{
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.swapped          = 0;
+    layout.nvar             = 2;
+    layout.nsnp             = 5;
+    layout.ntrait           = 3;
+    layout.snps_per_tile    = 2;
+    layout.traits_per_tile  = 2;
+    layout.max_char         = 8;
+    layout.ncov             = 1;
+    layout.beta_labels      = beta_labels;
+    layout.se_labels        = se_labels;
+    layout.cov_labels       = cov_labels;
+    layout.snp_labels       = snp_labels;
+    layout.trait_labels     = trait_labels;
+
+    initialize_parameters(&params);
+    params.manifest = (char *) manifest;
+    TEST_ASSERT_NOT_NULL(params.ucp2acp = (int *) malloc(sizeof(int)));
+
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(convert_batch)
+{
+    char file[64];
+    size_t i;
+
+    free(params.ucp2acp);
+    for (i = 0; i < sizeof prefixes / sizeof prefixes[0]; i++) {
+        sprintf(file, "%s.iout", prefixes[i]);
+        remove(file);
+        sprintf(file, "%s.out", prefixes[i]);
+        remove(file);
+        sprintf(file, "%s.txt", prefixes[i]);
+        remove(file);
+    }
+    remove(manifest);
+    remove(output_file);
+}
+
+static void write_file(const char *file, const char *content)
+{
+    FILE *fp;
+
+    TEST_ASSERT_NOT_NULL(fp = fopen(file, "w"));
+    TEST_ASSERT_TRUE(fputs(content, fp) >= 0);
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+}
+
+/* Return the content of a file as a NUL-terminated string, which the
+   caller must free. */
+static char *read_file(const char *file)
+{
+    FILE *fp;
+    char *s;
+    long n;
+
+    TEST_ASSERT_NOT_NULL(fp = fopen(file, "rb"));
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    rewind(fp);
+    TEST_ASSERT_NOT_NULL(s = (char *) malloc(n + 1));
+    TEST_ASSERT_TRUE(n == 0  ||  fread(s, n, 1, fp) == 1);
+    s[n] = '\0';
+    fclose(fp);
+    return s;
+}
+
+/* Write the layout and data file of a result set whose values start at
+   first. */
+static void write_result_set(const char *prefix, double first)
+{
+    char file[64];
+    FILE *fp;
+    double x;
+    int i, n;
+
+    sprintf(file, "%s.iout", prefix);
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(file, &layout));
+    sprintf(file, "%s.out", prefix);
+    TEST_ASSERT_NOT_NULL(fp = fopen(file, "wb"));
+    n = layout.nsnp * layout.ntrait * (2 * layout.nvar + layout.ncov);
+    for (i = 0; i < n; i++) {
+        x = first + i / 4.0;
+        TEST_ASSERT_TRUE(fwrite(&x, sizeof x, 1, fp) == 1);
+    }
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+}
+
+/* Return what converting a single result set on its own gives. */
+static char *convert_alone(const char *prefix)
+{
+    struct Params p;
+    char layout_file[64], data_file[64];
+    struct Layout in;
+    char *s;
+
+    sprintf(layout_file, "%s.iout", prefix);
+    sprintf(data_file, "%s.out", prefix);
+    initialize_parameters(&p);
+    p.layout_file = layout_file;
+    p.data_file = data_file;
+    p.output_file = "test/tmp/alone.txt";
+    TEST_ASSERT_EQUAL_INT(1, parse_layout_file(layout_file, &in));
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&p, &in));
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&p, &in), err_msg);
+    free_layout(&in);
+    free(p.ucp2acp);
+    s = read_file(p.output_file);
+    remove(p.output_file);
+    return s;
+}
+
+/* Test that blank lines and comments in a manifest are skipped and
+   that blanks around a FILE are dropped. */
+TEST(convert_batch, read_manifest)
+{
+    struct Manifest m;
+
+    write_file(manifest, "# chunks\n  a/chunk1 \n\nchunk2\n\t\n");
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, read_manifest(manifest, &m), err_msg);
+    TEST_ASSERT_EQUAL_INT(2, m.n);
+    TEST_ASSERT_EQUAL_STRING("a/chunk1", m.prefix[0]);
+    TEST_ASSERT_EQUAL_STRING("chunk2", m.prefix[1]);
+    free_manifest(&m);
+    TEST_ASSERT_NULL(m.prefix);
+}
+
+TEST(convert_batch, empty_manifest_gives_error)
+{
+    struct Manifest m;
+
+    write_file(manifest, "# nothing\n\n");
+    TEST_ASSERT_EQUAL_INT(0, read_manifest(manifest, &m));
+    TEST_ASSERT_EQUAL_STRING("manifest lists no result sets: "
+        "test/tmp/manifest.txt", err_msg);
+}
+
+/* Test that every result set gets an output file of its own that is
+   the same as when converting it on its own. */
+TEST(convert_batch, convert_into_separate_files)
+{
+    char *expected, *actual;
+
+    write_result_set(prefixes[0], 0.0);
+    write_result_set(prefixes[1], 1000.0);
+    write_file(manifest, "test/tmp/chunk1\ntest/tmp/chunk2\n");
+    params.nthread = 2;
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, convert_batch(&params), err_msg);
+    expected = convert_alone(prefixes[0]);
+    actual = read_file("test/tmp/chunk1.txt");
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+    expected = convert_alone(prefixes[1]);
+    actual = read_file("test/tmp/chunk2.txt");
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+/* Test that --output gets the lines of all result sets in manifest
+   order under a single header. */
+TEST(convert_batch, concatenate_under_one_header)
+{
+    char *first, *second, *expected, *actual;
+
+    write_result_set(prefixes[0], 0.0);
+    write_result_set(prefixes[1], 1000.0);
+    write_file(manifest, "test/tmp/chunk2\ntest/tmp/chunk1\n");
+    params.output_file = (char *) output_file;
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, convert_batch(&params), err_msg);
+    first = convert_alone(prefixes[1]);
+    second = convert_alone(prefixes[0]);
+    TEST_ASSERT_NOT_NULL(expected = (char *) malloc(strlen(first)
+            + strlen(second) + 1));
+    strcpy(expected, first);
+    strcat(expected, strchr(second, '\n') + 1);
+    actual = read_file(output_file);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(first);
+    free(second);
+    free(expected);
+    free(actual);
+}
+
+/* Test that result sets with different columns can't share a header,
+   unless --column selects columns that all of them have. */
+TEST(convert_batch, different_columns_give_error)
+{
+    static char *columns[] = {"b1"};
+    char *actual;
+
+    write_result_set(prefixes[0], 0.0);
+    layout.cov_labels = other_cov_labels;
+    write_result_set(prefixes[1], 1000.0);
+    write_file(manifest, "test/tmp/chunk1\ntest/tmp/chunk2\n");
+    params.output_file = (char *) output_file;
+
+    TEST_ASSERT_EQUAL_INT(0, convert_batch(&params));
+    TEST_ASSERT_EQUAL_STRING("columns of test/tmp/chunk2 differ from "
+        "those of test/tmp/chunk1", err_msg);
+
+    params.ncolumn = 1;
+    params.columns = columns;
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, convert_batch(&params), err_msg);
+    actual = read_file(output_file);
+    TEST_ASSERT_EQUAL_INT(0, strncmp(actual, "snp trait b1\nsnp0 trait0 "
+            "0.25\n", strlen("snp trait b1\nsnp0 trait0 0.25\n")));
+    TEST_ASSERT_NOT_NULL(strstr(actual, "\nsnp0 trait0 1000.25\n"));
+    free(actual);
+}
@@ -0,0 +1,85 @@
+#include "unity_fixture.h"
+#include "decode.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Long enough for several vectors plus a tail of odd length. */
+enum { NVALUE = 37 };
+
+static char src[NVALUE * sizeof(double)];
+static double expected[NVALUE], actual[NVALUE];
+
+TEST_GROUP(decode);
+
+TEST_SETUP(decode)
+{
+    memset(actual, 0, sizeof(actual));
+}
+
+TEST_TEAR_DOWN(decode)
+{
+}
+
+/* Fill src with NVALUE values of the given size, byte-swapped if swap
+   is set, and expected with the same values as native doubles. */
+static void make_values(int size, int swap)
+{
+    uint32_t u;
+    uint64_t v;
+    float f;
+    double x;
+    int i;
+
+    for (i = 0; i < NVALUE; i++) {
+        x = (i - 17) * 1.25 + (i % 3 ? 1e-3 : 1e30);
+        f = (float) x;
+        expected[i] = size == 4 ? (double) f : x;
+        if (size == 4) {
+            memcpy(&u, &f, 4);
+            if (swap)
+                u = __builtin_bswap32(u);
+            memcpy(src + 4 * i, &u, 4);
+        }
+        else {
+            memcpy(&v, &x, 8);
+            if (swap)
+                v = __builtin_bswap64(v);
+            memcpy(src + 8 * i, &v, 8);
+        }
+    }
+}
+
+/* Test that every kernel the CPU supports decodes floats and doubles
+   of either byte order, for all lengths up to NVALUE. */
+TEST(decode, all_kernels_give_native_doubles)
+{
+    DecodeFunc decode;
+    int level, size, swap, n;
+
+    for (level = DECODE_SCALAR; level <= best_decode_level(); level++)
+        for (size = 4; size <= 8; size += 4)
+            for (swap = 0; swap <= 1; swap++) {
+                make_values(size, swap);
+                TEST_ASSERT_NOT_NULL(decode = find_decoder(size, swap,
+                        level));
+                for (n = 0; n <= NVALUE; n++) {
+                    memset(actual, 0, sizeof(actual));
+                    decode(actual, src, n);
+                    TEST_ASSERT_EQUAL_MEMORY(expected, actual,
+                        n * sizeof(double));
+                    if (n < NVALUE)
+                        TEST_ASSERT_TRUE(actual[n] == 0.0);
+                }
+            }
+}
+
+/* Test that unsupported sizes and kernel levels give no decoder. */
+TEST(decode, no_decoder_for_unsupported_sizes)
+{
+    TEST_ASSERT_NULL(find_decoder(2, 0, DECODE_BEST));
+    TEST_ASSERT_NULL(find_decoder(16, 1, DECODE_SCALAR));
+    TEST_ASSERT_NOT_NULL(find_decoder(4, 0, DECODE_BEST));
+    if (best_decode_level() < DECODE_AVX2)
+        TEST_ASSERT_NULL(find_decoder(8, 1, DECODE_AVX2));
+}
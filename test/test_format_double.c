@@ -0,0 +1,183 @@
+#include "unity_fixture.h"
+#include "format_double.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define NELEMS(x) (sizeof (x) / sizeof (x[0]))
+
+/* format_double promises byte-identical output to printf("%.*g").  We
+   test this differentially against glibc's snprintf on special values,
+   on random bit patterns, which mostly exercise extreme exponents, and
+   on random numbers of the magnitude typically found in regression
+   results. */
+
+static char actual[FORMAT_DOUBLE_MAXLEN + 1];
+static char expected[FORMAT_DOUBLE_MAXLEN + 1];
+static uint64_t state;
+
+static double special[] = {
+    0.0, -0.0, 1.0, -1.0, 0.5, 1.5, 2.5, 0.25, 0.125, 9.5, 99.5,
+    0.1, 0.3, 1.0 / 3.0, 1e-5, 1e-4, 5e-8, 100.0, 123456789.0,
+    1e15, 1e16, 1e17, 1e22, 1e23, 9.999999999999999e22,
+    1.7976931348623157e308, 2.2250738585072014e-308, 4.9e-324
+};
+
+/* xorshift64 */
+static uint64_t next_random(void)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static double random_bits(void)
+{
+    uint64_t bits;
+    double x;
+
+    /* Exclude infinities and NaNs. */
+    do
+        bits = next_random();
+    while (((bits >> 52) & 0x7ff) == 0x7ff);
+    memcpy(&x, &bits, sizeof x);
+
+    return x;
+}
+
+/* Return a random number with up to 7 significant digits and a
+   decimal exponent between -12 and 6. */
+static double random_typical(void)
+{
+    double x;
+    int i, n;
+
+    x = (double) (next_random() % 10000000);
+    n = next_random() % 19;
+    for (i = 0; i < n; i++)
+        x /= 10.0;
+    for (i = 0; i < 6; i++)
+        x /= 10.0;
+    return next_random() % 2 ? x : -x;
+}
+
+static void check(double x, int ndigit)
+{
+    *format_double(actual, x, ndigit) = '\0';
+    snprintf(expected, sizeof expected, "%.*g", ndigit, x);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+/* Return the shortest output of %.*g that reads back as x. */
+static const char *shortest(double x)
+{
+    int ndigit;
+
+    for (ndigit = 1; ndigit < 17; ndigit++) {
+        snprintf(expected, sizeof expected, "%.*g", ndigit, x);
+        if (strtod(expected, NULL) == x)
+            break;
+    }
+    snprintf(expected, sizeof expected, "%.*g", ndigit, x);
+    return expected;
+}
+
+TEST_GROUP(format_double);
+
+TEST_SETUP(format_double)
+{
+    state = 88172645463325252ULL;
+}
+
+TEST_TEAR_DOWN(format_double)
+{
+}
+
+/* Test special values for all valid numbers of digits. */
+TEST(format_double, special_values_match_printf)
+{
+    unsigned i;
+    int ndigit;
+
+    for (ndigit = 0; ndigit < 100; ndigit++)
+        for (i = 0; i < NELEMS(special); i++) {
+            check(special[i], ndigit);
+            check(-special[i], ndigit);
+        }
+}
+
+/* Test that ties are broken by rounding to an even digit. */
+TEST(format_double, ties_round_to_even)
+{
+    *format_double(actual, 0.5, 0) = '\0';
+    TEST_ASSERT_EQUAL_STRING("0.5", actual);
+    *format_double(actual, 2.5, 1) = '\0';
+    TEST_ASSERT_EQUAL_STRING("2", actual);
+    *format_double(actual, 3.5, 1) = '\0';
+    TEST_ASSERT_EQUAL_STRING("4", actual);
+    *format_double(actual, 0.125, 2) = '\0';
+    TEST_ASSERT_EQUAL_STRING("0.12", actual);
+    *format_double(actual, 0.375, 2) = '\0';
+    TEST_ASSERT_EQUAL_STRING("0.38", actual);
+}
+
+TEST(format_double, infinity_and_nan)
+{
+    double zero = 0.0;
+
+    *format_double(actual, 1.0 / zero, 8) = '\0';
+    TEST_ASSERT_EQUAL_STRING("inf", actual);
+    *format_double(actual, -1.0 / zero, 8) = '\0';
+    TEST_ASSERT_EQUAL_STRING("-inf", actual);
+    check(zero / zero, 8);
+    check(-(zero / zero), 8);
+}
+
+TEST(format_double, random_bits_match_printf)
+{
+    int i, ndigit;
+
+    for (ndigit = 0; ndigit < 100; ndigit++)
+        for (i = 0; i < 500; i++)
+            check(random_bits(), ndigit);
+}
+
+TEST(format_double, typical_values_match_printf)
+{
+    int i, ndigit;
+
+    for (ndigit = 0; ndigit < 100; ndigit++)
+        for (i = 0; i < 2000; i++)
+            check(random_typical(), ndigit);
+}
+
+/* Test that the shortest output reads back as the same double and
+   agrees with the shortest %.*g that does so. */
+TEST(format_double, shortest_round_trips)
+{
+    double x;
+    int i;
+
+    for (i = 0; i < 100000; i++) {
+        x = i % 2 ? random_bits() : random_typical();
+        *format_double(actual, x, FORMAT_DOUBLE_SHORTEST) = '\0';
+        TEST_ASSERT_TRUE(strtod(actual, NULL) == x);
+        TEST_ASSERT_EQUAL_STRING(shortest(x), actual);
+    }
+}
+
+TEST(format_double, shortest_special_values)
+{
+    unsigned i;
+
+    for (i = 0; i < NELEMS(special); i++) {
+        *format_double(actual, special[i], FORMAT_DOUBLE_SHORTEST) = '\0';
+        TEST_ASSERT_EQUAL_STRING(shortest(special[i]), actual);
+    }
+    *format_double(actual, 0.1, FORMAT_DOUBLE_SHORTEST) = '\0';
+    TEST_ASSERT_EQUAL_STRING("0.1", actual);
+    *format_double(actual, 5e-324, FORMAT_DOUBLE_SHORTEST) = '\0';
+    TEST_ASSERT_EQUAL_STRING("5e-324", actual);
+}
@@ -0,0 +1,106 @@
+#include "unity_fixture.h"
+#include "label_index.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NELEMS(x) (sizeof (x) / sizeof (x[0]))
+
+static char *labels[] = {"rs10", "rs7", "rs123", "rs7", "", "rs8"};
+static const char *label_file = "test/tmp/labels.txt";
+static struct Layout layout;    /* with labels as snp labels */
+
+TEST_GROUP(label_index);
+
+TEST_SETUP(label_index)
+{
+    layout.snp_labels = labels;
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(label_index)
+{
+}
+
+static void write_label_file(const char *content)
+{
+    FILE *fp;
+
+    TEST_ASSERT_TRUE((fp = fopen(label_file, "w")) != NULL);
+    TEST_ASSERT_TRUE(fputs(content, fp) >= 0);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
+
+/* Test that every label is found at its first position. */
+TEST(label_index, lookup_finds_labels)
+{
+    struct LabelIndex index;
+
+    TEST_ASSERT_EQUAL_INT(1, build_label_index(&index, &layout,
+            snp_label, NELEMS(labels)));
+    TEST_ASSERT_EQUAL_INT(0, lookup_label(&index, "rs10"));
+    TEST_ASSERT_EQUAL_INT(1, lookup_label(&index, "rs7"));
+    TEST_ASSERT_EQUAL_INT(2, lookup_label(&index, "rs123"));
+    TEST_ASSERT_EQUAL_INT(4, lookup_label(&index, ""));
+    TEST_ASSERT_EQUAL_INT(5, lookup_label(&index, "rs8"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup_label(&index, "rs1"));
+    TEST_ASSERT_EQUAL_INT(-1, lookup_label(&index, "rs12"));
+    free_label_index(&index);
+}
+
+/* Test lookups in an index large enough to have many collisions. */
+TEST(label_index, lookup_in_large_index)
+{
+    struct LabelIndex index;
+    char **many, buf[32];
+    int i, n = 100000;
+
+    TEST_ASSERT_NOT_NULL(many = (char **) malloc(n * sizeof(char *)));
+    for (i = 0; i < n; i++) {
+        sprintf(buf, "rs%d", 3 * i);
+        TEST_ASSERT_NOT_NULL(many[i] = (char *) malloc(strlen(buf) + 1));
+        strcpy(many[i], buf);
+    }
+    layout.snp_labels = many;
+    TEST_ASSERT_EQUAL_INT(1, build_label_index(&index, &layout, snp_label,
+            n));
+    for (i = 0; i < 3 * n; i++) {
+        sprintf(buf, "rs%d", i);
+        TEST_ASSERT_EQUAL_INT(i % 3 ? -1 : i / 3,
+            lookup_label(&index, buf));
+    }
+    free_label_index(&index);
+    for (i = 0; i < n; i++)
+        free(many[i]);
+    free(many);
+}
+
+/* Test that labels are read in sorted order without duplicates. */
+TEST(label_index, read_label_file)
+{
+    int *selected, nselected;
+
+    write_label_file("rs8\n\n rs10\t\nrs7\r\nrs8\n");
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, read_label_file(label_file, "snp",
+            &layout, snp_label, NELEMS(labels), &selected, &nselected),
+        err_msg);
+    TEST_ASSERT_EQUAL_INT(3, nselected);
+    TEST_ASSERT_EQUAL_INT(0, selected[0]);
+    TEST_ASSERT_EQUAL_INT(1, selected[1]);
+    TEST_ASSERT_EQUAL_INT(5, selected[2]);
+    free(selected);
+}
+
+/* Test that an unknown label results in an error. */
+TEST(label_index, unknown_label_gives_error)
+{
+    int *selected, nselected;
+
+    write_label_file("rs8\nrs9\n");
+    TEST_ASSERT_EQUAL_INT(0, read_label_file(label_file, "trait",
+            &layout, snp_label, NELEMS(labels), &selected, &nselected));
+    TEST_ASSERT_EQUAL_STRING("unknown trait in line 2 of "
+        "test/tmp/labels.txt: rs9", err_msg);
+}
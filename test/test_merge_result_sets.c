@@ -0,0 +1,222 @@
+#include "unity_fixture.h"
+#include "ResultSetFixture.h"
+#include "merge_result_sets.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every test cuts parts out of the result set of ResultSetFixture.h,
+   writes them as result sets of their own, merges them, and compares
+   with the result set written in one piece. */
+enum { NSNP = FIXTURE_NSNP, NTRAIT = FIXTURE_NTRAIT };
+
+static struct Params params;
+
+static char *inputs[] = {"test/tmp/part1", "test/tmp/part2",
+    "test/tmp/part3"};
+static char output[] = "test/tmp/merged";
+static const char *expected = "test/tmp/whole";
+
+TEST_GROUP(merge_result_sets);
+
+TEST_SETUP(merge_result_sets)
+{
+    initialize_parameters(&params);
+    params.command = COMMAND_MERGE;
+    params.inputs = inputs;
+    params.output_file = output;
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(merge_result_sets)
+{
+    const char *prefixes[] = {inputs[0], inputs[1], inputs[2], output,
+        expected};
+    size_t i;
+
+    for (i = 0; i < sizeof prefixes / sizeof prefixes[0]; i++)
+        ResultSetFixture_Remove(prefixes[i]);
+}
+
+/* Return the content of a file, which the caller must free. */
+static char *read_file(const char *file, long *n)
+{
+    FILE *fp;
+    char *s;
+
+    TEST_ASSERT_NOT_NULL_MESSAGE(fp = fopen(file, "rb"), file);
+    fseek(fp, 0, SEEK_END);
+    *n = ftell(fp);
+    rewind(fp);
+    TEST_ASSERT_NOT_NULL(s = (char *) malloc(*n + 1));
+    TEST_ASSERT_TRUE(*n == 0  ||  fread(s, *n, 1, fp) == 1);
+    fclose(fp);
+    return s;
+}
+
+static void assert_same_file(const char *expected_file,
+    const char *actual_file)
+{
+    char *a, *b;
+    long m, n;
+
+    a = read_file(expected_file, &m);
+    b = read_file(actual_file, &n);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(m, n, actual_file);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(a, b, m, actual_file);
+    free(a);
+    free(b);
+}
+
+/* Merge params.ninput parts and compare with the whole result set. */
+static void assert_merged_like_whole(void)
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, merge_result_sets(&params), err_msg);
+    assert_same_file("test/tmp/whole.iout", "test/tmp/merged.iout");
+    assert_same_file("test/tmp/whole.out", "test/tmp/merged.out");
+}
+
+/* Test that result sets with the same traits are merged by snp, into
+   the tiles of the first result set. */
+TEST(merge_result_sets, merge_by_snps)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_Write(inputs[1], 4, 2, 0, NTRAIT, 3, 3, 8);
+    ResultSetFixture_Write(inputs[2], 6, 1, 0, NTRAIT, 1, 5, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 2, 8);
+    params.ninput = 3;
+    assert_merged_like_whole();
+}
+
+/* Test that result sets with the same snps are merged by trait. */
+TEST(merge_result_sets, merge_by_traits)
+{
+    ResultSetFixture_Write(inputs[0], 0, NSNP, 0, 3, 3, 2, 8);
+    ResultSetFixture_Write(inputs[1], 0, NSNP, 3, 2, 4, 1, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 3, 2, 8);
+    params.ninput = 2;
+    assert_merged_like_whole();
+}
+
+/* Test that the merged data file doesn't depend on the number of
+   threads. */
+TEST(merge_result_sets, merge_with_threads)
+{
+    ResultSetFixture_Write(inputs[0], 0, 3, 0, NTRAIT, 2, 3, 8);
+    ResultSetFixture_Write(inputs[1], 3, 4, 0, NTRAIT, 4, 2, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 3, 8);
+    params.ninput = 2;
+    params.nthread = 3;
+    assert_merged_like_whole();
+}
+
+/* Test that single precision stays single precision, unless it is
+   merged with double precision. */
+TEST(merge_result_sets, merge_single_precision)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 4);
+    ResultSetFixture_Write(inputs[1], 4, 3, 0, NTRAIT, 2, 2, 4);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 2, 4);
+    params.ninput = 2;
+    assert_merged_like_whole();
+
+    ResultSetFixture_Write(inputs[1], 4, 3, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 2, 8);
+    assert_merged_like_whole();
+}
+
+/* Test that units of single tiles and reads with pread(2) give the
+   same result. */
+TEST(merge_result_sets, merge_in_small_units)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_Write(inputs[1], 4, 3, 0, NTRAIT, 3, 4, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 3, 8);
+    params.ninput = 2;
+    params.traits_per_tile = 3;
+    params.max_memory = 1;
+    params.use_mmap = 0;
+    params.nthread = 2;
+    assert_merged_like_whole();
+}
+
+/* Test that retiling with a single trait per tile puts all snps of a
+   trait next to each other, whatever the size of the units. */
+TEST(merge_result_sets, retile_to_one_trait_per_tile)
+{
+    unsigned long sizes[] = {1, 400, 2000, DEFAULT_MAX_MEMORY};
+    size_t i;
+
+    ResultSetFixture_Write(inputs[0], 0, NSNP, 0, NTRAIT, 3, 2, 8);
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, NSNP, 1, 8);
+    params.command = COMMAND_RETILE;
+    params.ninput = 1;
+    params.snps_per_tile = NSNP;
+    params.traits_per_tile = 1;
+    for (i = 0; i < sizeof sizes / sizeof sizes[0]; i++) {
+        params.max_memory = sizes[i];
+        assert_merged_like_whole();
+    }
+
+    ResultSetFixture_Write(expected, 0, NSNP, 0, NTRAIT, 2, 5, 8);
+    params.snps_per_tile = 2;
+    params.traits_per_tile = 5;
+    params.max_memory = 800;
+    assert_merged_like_whole();
+}
+
+TEST(merge_result_sets, different_columns_give_error)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_CovLabels[0] = "c10";
+    ResultSetFixture_Write(inputs[1], 4, 3, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_CovLabels[0] = "c01";
+    params.ninput = 2;
+
+    TEST_ASSERT_EQUAL_INT(0, merge_result_sets(&params));
+    TEST_ASSERT_EQUAL_STRING("columns of test/tmp/part2 differ from "
+        "those of test/tmp/part1", err_msg);
+}
+
+TEST(merge_result_sets, unrelated_result_sets_give_error)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, 3, 2, 2, 8);
+    ResultSetFixture_Write(inputs[1], 4, 3, 3, 2, 2, 2, 8);
+    params.ninput = 2;
+
+    TEST_ASSERT_EQUAL_INT(0, merge_result_sets(&params));
+    TEST_ASSERT_EQUAL_STRING("result sets share neither their snps nor "
+        "their traits: test/tmp/part1", err_msg);
+}
+
+/* Test that a result set can't be merged with itself and that no snp
+   may be merged twice. */
+TEST(merge_result_sets, duplicate_labels_give_error)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 8);
+    inputs[1] = inputs[0];
+    params.ninput = 2;
+    TEST_ASSERT_EQUAL_INT(0, merge_result_sets(&params));
+    TEST_ASSERT_EQUAL_STRING("result sets share both their snps and "
+        "their traits: test/tmp/part1", err_msg);
+    inputs[1] = "test/tmp/part2";
+
+    ResultSetFixture_Write(inputs[1], 5, 2, 0, NTRAIT, 2, 2, 8);
+    ResultSetFixture_Write(inputs[2], 3, 3, 0, NTRAIT, 2, 2, 8);
+    params.ninput = 3;
+    TEST_ASSERT_EQUAL_INT(0, merge_result_sets(&params));
+    TEST_ASSERT_EQUAL_STRING("duplicate snp rs3 in test/tmp/part3",
+        err_msg);
+}
+
+TEST(merge_result_sets, missing_result_set_gives_error)
+{
+    ResultSetFixture_Write(inputs[0], 0, 4, 0, NTRAIT, 2, 2, 8);
+    params.ninput = 2;
+
+    TEST_ASSERT_EQUAL_INT(0, merge_result_sets(&params));
+    TEST_ASSERT_EQUAL_STRING("failed to open layout file for reading: "
+        "test/tmp/part2.iout", err_msg);
+}
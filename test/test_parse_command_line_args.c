@@ -1,6 +1,7 @@
 #include "unity_fixture.h"
 #include "parse_command_line_args.h"
 #include "err_msg.h"
+#include "format_double.h"
 #include <getopt.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -80,6 +81,24 @@ TEST(parse_command_line_args, short_digits)
     TEST_ASSERT_EQUAL_INT_MESSAGE(4, params.ndigit, "ndigit");
 }
 
+/* Test that --digits=shortest is recognized and passes validation. */
+TEST(parse_command_line_args, shortest_digits)
+{
+    char *argv[] = {"ignore", "--digits=shortest"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT_MESSAGE(FORMAT_DOUBLE_SHORTEST, params.ndigit,
+        "ndigit");
+
+    params.layout_file = "test/data/input.iout";
+    params.data_file = "test/data/input.out";
+    status = validate_command_line_args(&params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "validate status");
+}
+
 /* Test that an all-alphabetical argument to --digits results in an
    error message. */
 TEST(parse_command_line_args, bad_digits_gives_error)
@@ -123,6 +142,440 @@ TEST(parse_command_line_args, digits_under_0_gives_error)
         err_msg);
 }
 
+/* Test that --digits=-1 is an error and not --digits=shortest, and
+   that values that don't fit an int don't wrap around. */
+TEST(parse_command_line_args, negative_digits_give_error)
+{
+    char *argv[] = {"ignore", "--digits=-1"};
+    char *huge[] = {"ignore", "--digits=4294967297"};
+
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line_args(NELEMS(argv), argv,
+            &params));
+    TEST_ASSERT_EQUAL_STRING("argument to --digits must be >=0", err_msg);
+
+    optind = 1;
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line_args(NELEMS(huge), huge,
+            &params));
+    TEST_ASSERT_EQUAL_STRING("argument to --digits must be <100", err_msg);
+}
+
+/* Test that the number of threads gets set correctly. */
+TEST(parse_command_line_args, threads_are_set)
+{
+    char *argv[] = {"ignore", "--threads=4"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT_MESSAGE(4, params.nthread, "nthread");
+}
+
+/* Test that a non-positive number of threads causes an error. */
+TEST(parse_command_line_args, zero_threads_give_error)
+{
+    params.nthread = 0;
+    params.layout_file = params.data_file = "foobar";
+
+    status = validate_command_line_args(&params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "validate status");
+    TEST_ASSERT_EQUAL_STRING("argument to --threads must be between 1 "
+        "and 1024", err_msg);
+}
+
+/* Test that --threads and --queue-depth reject values that don't fit
+   an int instead of letting them wrap around. */
+TEST(parse_command_line_args, huge_threads_give_error)
+{
+    char *threads[] = {"ignore", "--threads=4294967297"};
+    char *depth[] = {"ignore", "--queue-depth=4294967297"};
+
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line_args(NELEMS(threads),
+            threads, &params));
+    TEST_ASSERT_EQUAL_STRING("argument to --threads must be between 1 "
+        "and 1024", err_msg);
+
+    optind = 1;
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line_args(NELEMS(depth), depth,
+            &params));
+    TEST_ASSERT_EQUAL_STRING("argument to --queue-depth must be between 1 "
+        "and 4096", err_msg);
+}
+
+/* Test that --order and --max-memory get set correctly. */
+TEST(parse_command_line_args, order_and_max_memory_are_set)
+{
+    char *argv[] = {"ignore", "--order=snp", "--max-memory=3M"};
+
+    TEST_ASSERT_EQUAL_INT(ORDER_FILE, params.order);
+    TEST_ASSERT_TRUE(params.max_memory == DEFAULT_MAX_MEMORY);
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT_MESSAGE(ORDER_SNP, params.order, "order");
+    TEST_ASSERT_TRUE(params.max_memory == 3UL << 20);
+}
+
+/* Test that an unknown order causes an error. */
+TEST(parse_command_line_args, bad_order_gives_error)
+{
+    char *argv[] = {"ignore", "--order=random"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("argument to --order must be file, trait, "
+        "or snp: random", err_msg);
+}
+
+/* Test that a malformed size causes an error. */
+TEST(parse_command_line_args, bad_max_memory_gives_error)
+{
+    char *argv[] = {"ignore", "--max-memory=12X"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("failed to convert --max-memory to a size: "
+        "12X", err_msg);
+}
+
+/* Test that label files get set correctly. */
+TEST(parse_command_line_args, label_files_are_set)
+{
+    char *argv[] = {"ignore", "--snps-file=snps.txt",
+                    "--traits-file", "traits.txt"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("snps.txt", params.snps_file);
+    TEST_ASSERT_EQUAL_STRING("traits.txt", params.traits_file);
+}
+
+/* Test that --io-report gets set correctly. */
+TEST(parse_command_line_args, io_report_is_set)
+{
+    char *argv[] = {"ignore", "--io-report"};
+
+    TEST_ASSERT_EQUAL_INT(0, params.io_report);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(1, params.io_report);
+}
+
+/* Test that --format gets set correctly. */
+TEST(parse_command_line_args, format_is_set)
+{
+    char *argv[] = {"ignore", "--format=arrow"};
+
+    TEST_ASSERT_EQUAL_INT(FORMAT_TEXT, params.format);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(FORMAT_ARROW, params.format);
+}
+
+/* Test that an unknown format causes an error. */
+TEST(parse_command_line_args, bad_format_gives_error)
+{
+    char *argv[] = {"ignore", "--format=csv"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("argument to --format must be text or "
+        "arrow: csv", err_msg);
+}
+
+/* Test that Arrow output is only written in file order. */
+TEST(parse_command_line_args, arrow_in_trait_order_gives_error)
+{
+    params.format = FORMAT_ARROW;
+    params.order = ORDER_TRAIT;
+    params.layout_file = params.data_file = "foobar";
+
+    status = validate_command_line_args(&params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "validate status");
+    TEST_ASSERT_EQUAL_STRING("--format=arrow requires --order=file",
+        err_msg);
+}
+
+/* Test that --manifest takes the place of FILE and that all result
+   sets written to a single output file must be plain text. */
+TEST(parse_command_line_args, manifest_replaces_file)
+{
+    char *argv[] = {"ignore", "--manifest=test/tmp/manifest.txt"};
+    FILE *fp;
+
+    TEST_ASSERT_NOT_NULL(fp = fopen("test/tmp/manifest.txt", "w"));
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("test/tmp/manifest.txt", params.manifest);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.output_file = "test/tmp/batch.txt";
+    params.compress = COMPRESS_BGZF;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--manifest with --output requires "
+        "--format=text and --compress=none", err_msg);
+
+    params.layout_file = params.data_file = "foobar";
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--manifest cannot be combined with a FILE "
+        "argument", err_msg);
+    remove("test/tmp/manifest.txt");
+}
+
+/* Test that "merge" takes the FILEs of the result sets to merge. */
+TEST(parse_command_line_args, merge_takes_files)
+{
+    char *argv[] = {"ignore", "merge", "a", "-o", "test/tmp/merged",
+        "b", "--threads=2"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(COMMAND_MERGE, params.command);
+    TEST_ASSERT_EQUAL_INT(2, params.ninput);
+    TEST_ASSERT_EQUAL_STRING("a", params.inputs[0]);
+    TEST_ASSERT_EQUAL_STRING("b", params.inputs[1]);
+    TEST_ASSERT_EQUAL_INT(2, params.nthread);
+    TEST_ASSERT_NULL(params.layout_file);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.where = "b1 > 0";
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("merge cannot be combined with options that "
+        "select or format records", err_msg);
+
+    params.output_file = NULL;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("merge requires --output", err_msg);
+
+    params.ninput = 0;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("missing command-line argument: FILE to "
+        "merge", err_msg);
+}
+
+/* Test that "retile" takes a single FILE and the new tiles. */
+TEST(parse_command_line_args, retile_takes_file_and_tiles)
+{
+    char *argv[] = {"ignore", "retile", "--traits-per-tile=1",
+        "--snps-per-tile", "5000", "-o", "test/tmp/retiled", "a"};
+    char *bad[] = {"ignore", "--snps-per-tile=0"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(COMMAND_RETILE, params.command);
+    TEST_ASSERT_EQUAL_INT(1, params.ninput);
+    TEST_ASSERT_EQUAL_STRING("a", params.inputs[0]);
+    TEST_ASSERT_EQUAL_INT(5000, params.snps_per_tile);
+    TEST_ASSERT_EQUAL_INT(1, params.traits_per_tile);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.ninput = 2;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("retile takes a single FILE", err_msg);
+
+    params.command = COMMAND_CONVERT;
+    params.layout_file = params.data_file = "test/data/test.iout";
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--snps-per-tile and --traits-per-tile "
+        "require merge or retile", err_msg);
+
+    optind = 1;
+    status = parse_command_line_args(NELEMS(bad), bad, &params);
+    TEST_ASSERT_EQUAL_INT(0, status);
+    TEST_ASSERT_EQUAL_STRING("argument to --snps-per-tile must be a "
+        "positive integer: 0", err_msg);
+}
+
+/* Test that "serve" takes a single FILE and a socket. */
+TEST(parse_command_line_args, serve_takes_file_and_socket)
+{
+    char *argv[] = {"ignore", "serve", "--socket=test/tmp/sock",
+        "--max-memory=1G", "a"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(COMMAND_SERVE, params.command);
+    TEST_ASSERT_EQUAL_INT(1, params.ninput);
+    TEST_ASSERT_EQUAL_STRING("a", params.inputs[0]);
+    TEST_ASSERT_EQUAL_STRING("test/tmp/sock", params.socket_path);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.output_file = "test/tmp/out";
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("serve cannot be combined with --output, "
+        "--snps-per-tile or --traits-per-tile", err_msg);
+
+    params.output_file = NULL;
+    params.socket_path = NULL;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("serve requires --socket", err_msg);
+
+    params.socket_path = "test/tmp/sock";
+    params.command = COMMAND_CONVERT;
+    params.layout_file = params.data_file = "test/data/test.iout";
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--socket requires serve", err_msg);
+}
+
+/* Test that --top-k and --rank-by get set, go together, and only go
+   with plain text in file order. */
+TEST(parse_command_line_args, top_k_is_set)
+{
+    char *argv[] = {"ignore", "--top-k=100", "--rank-by=p(snp)",
+        "test/data/input"};
+    char *bad[] = {"ignore", "--top-k=0"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(100, params.top_k);
+    TEST_ASSERT_EQUAL_STRING("p(snp)", params.rank_by);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.order = ORDER_SNP;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--top-k cannot be combined with --order, "
+        "--format, --compress, --snps-file or --traits-file", err_msg);
+
+    params.order = ORDER_FILE;
+    params.rank_by = NULL;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--top-k and --rank-by must be given "
+        "together", err_msg);
+
+    optind = 1;
+    TEST_ASSERT_EQUAL_INT(0, parse_command_line_args(NELEMS(bad), bad,
+            &params));
+    TEST_ASSERT_EQUAL_STRING("argument to --top-k must be a positive "
+        "integer: 0", err_msg);
+}
+
+/* Test that --summary gets set and refuses to write records. */
+TEST(parse_command_line_args, summary_is_set)
+{
+    char *argv[] = {"ignore", "--summary=snp", "--where=p(snp) < 0.01",
+        "test/data/input"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("snp", params.summary);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_command_line_args(&params),
+        err_msg);
+
+    params.format = FORMAT_ARROW;
+    TEST_ASSERT_EQUAL_INT(0, validate_command_line_args(&params));
+    TEST_ASSERT_EQUAL_STRING("--summary cannot be combined with --top-k, "
+        "--column, --order, --format, --compress, --snps-file or "
+        "--traits-file", err_msg);
+}
+
+/* Test that --compress gets set correctly. */
+TEST(parse_command_line_args, compress_is_set)
+{
+    char *argv[] = {"ignore", "--compress=bgzf"};
+
+    TEST_ASSERT_EQUAL_INT(COMPRESS_NONE, params.compress);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(COMPRESS_BGZF, params.compress);
+}
+
+/* Test that an unknown compression method causes an error. */
+TEST(parse_command_line_args, bad_compress_gives_error)
+{
+    char *argv[] = {"ignore", "--compress=xz"};
+
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("argument to --compress must be none or "
+        "bgzf: xz", err_msg);
+}
+
+/* Test that Arrow output isn't compressed. */
+TEST(parse_command_line_args, compressed_arrow_gives_error)
+{
+    params.format = FORMAT_ARROW;
+    params.compress = COMPRESS_BGZF;
+    params.layout_file = params.data_file = "foobar";
+
+    status = validate_command_line_args(&params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "validate status");
+    TEST_ASSERT_EQUAL_STRING("--compress=bgzf requires --format=text",
+        err_msg);
+}
+
+/* Test that --queue-depth gets set correctly. */
+TEST(parse_command_line_args, queue_depth_is_set)
+{
+    char *argv[] = {"ignore", "--queue-depth=64"};
+
+    TEST_ASSERT_EQUAL_INT(DEFAULT_QUEUE_DEPTH, params.queue_depth);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(64, params.queue_depth);
+}
+
+TEST(parse_command_line_args, stats_is_set)
+{
+    char *argv[] = {"ignore", "--stats"};
+
+    TEST_ASSERT_EQUAL_INT(0, params.stats_report);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(1, params.stats_report);
+    TEST_ASSERT_NULL(params.stats);
+}
+
+/* Test that --endian gets set and an unknown byte order causes an
+   error. */
+TEST(parse_command_line_args, endian_is_set)
+{
+    char *argv[] = {"ignore", "--endian=big"};
+    char *bad[] = {"ignore", "--endian=middle"};
+
+    TEST_ASSERT_EQUAL_INT(ENDIAN_AUTO, params.endian);
+    status = parse_command_line_args(NELEMS(argv), argv, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, status, "parse status");
+    TEST_ASSERT_EQUAL_INT(ENDIAN_BIG, params.endian);
+
+    optind = 1;
+    status = parse_command_line_args(NELEMS(bad), bad, &params);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "parse status");
+    TEST_ASSERT_EQUAL_STRING("argument to --endian must be auto, little, "
+        "or big: middle", err_msg);
+}
+
+/* Test that a queue depth of zero causes an error. */
+TEST(parse_command_line_args, zero_queue_depth_gives_error)
+{
+    params.queue_depth = 0;
+    params.layout_file = params.data_file = "foobar";
+
+    status = validate_command_line_args(&params);
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(0, status, "validate status");
+    TEST_ASSERT_EQUAL_STRING("argument to --queue-depth must be between 1 "
+        "and 4096", err_msg);
+}
+
 /* Test that output file gets set correctly. */
 TEST(parse_command_line_args, output_file_is_set)
 {
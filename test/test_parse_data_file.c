@@ -1,6 +1,17 @@
 #include "unity_fixture.h"
 #include "parse_data_file.h"
 #include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "Filter.h"
+#include "decode.h"
+#include "trait_summary.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
 
 #define NELEMS(x) (sizeof (x) / sizeof (x[0]))
 
@@ -18,6 +29,20 @@
    offset at which the regression results for the given trait-snp pair
    can be found.*/
 static struct Layout layout;
+static struct Params params;
+
+static char *beta_labels[] = {"b0", "b1"};
+static char *se_labels[] = {"s0", "s1"};
+static char *cov_labels[] = {"c01"};
+static char *snp_labels[] = {"snp0", "snp1", "snp2", "snp3", "snp4",
+                             "snp5", "snp6", "snp7", "snp8", "snp9"};
+static char *trait_labels[] = {"trait0", "trait1", "trait2", "trait3",
+                               "trait4", "trait5", "trait6", "trait7"};
+
+/* Files used by the test cases that convert an actual data file. */
+static const char *layout_file = "test/tmp/data.iout";
+static const char *data_file = "test/tmp/data.out";
+static const char *output_file = "test/tmp/data.txt";
 
 static int snp_index[] = {
     0, 1, 2, 3, 0, 1, 2, 3, 0, 1, 2, 3,  /* tile 1 */
@@ -62,24 +87,184 @@ TEST_SETUP(parse_data_file)
 {
     /* Initialize as much of the layout structure of the (virtual)
        layout file as needed for the test cases. */
-    layout.magic_number     = -1;
-    layout.bytes_per_double = -1;
-    layout.nvar             = -1;
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.swapped          = 0;
+    layout.nvar             = NELEMS(beta_labels);
     layout.nsnp             = 10;
     layout.ntrait           = 8;
     layout.snps_per_tile    = 4;
     layout.traits_per_tile  = 3;
-    layout.max_char         = -1;
-    layout.ncov             = -1;
-    layout.beta_labels      = NULL;
-    layout.se_labels        = NULL;
-    layout.cov_labels       = NULL;
-    layout.snp_labels       = NULL;
-    layout.trait_labels     = NULL;
+    layout.max_char         = 8;
+    layout.ncov             = NELEMS(cov_labels);
+    layout.beta_labels      = beta_labels;
+    layout.se_labels        = se_labels;
+    layout.cov_labels       = cov_labels;
+    layout.snp_labels       = snp_labels;
+    layout.trait_labels     = trait_labels;
+
+    initialize_parameters(&params);
+    params.layout_file = (char *) layout_file;
+    params.data_file   = (char *) data_file;
+    params.output_file = (char *) output_file;
+
+    clear_err_msg();
 }
 
 TEST_TEAR_DOWN(parse_data_file)
 {
+    free(params.ucp2acp);
+}
+
+/* Write a data file matching the layout set up in TEST_SETUP.  The
+   value in column j of the record at offset i is i + j / 4, which is
+   exactly representable as a double and as a float.  Values take
+   layout.bytes_per_double bytes each and are byte-swapped if
+   layout.swapped is set. */
+static void write_data_file(void)
+{
+    FILE *fp;
+    unsigned long i, n;
+    int j, k, ncolumn, size;
+    unsigned char b[sizeof(double)], t;
+    double x;
+    float f;
+
+    ncolumn = layout.nvar + layout.nvar + layout.ncov;
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    size = layout.bytes_per_double;
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    for (i = 0; i < n; i++)
+        for (j = 0; j < ncolumn; j++) {
+            x = i + j / 4.0;
+            f = (float) x;
+            memcpy(b, size == sizeof(float) ? (void *) &f : (void *) &x,
+                size);
+            for (k = 0; layout.swapped  &&  k < size / 2; k++) {
+                t = b[k];
+                b[k] = b[size - 1 - k];
+                b[size - 1 - k] = t;
+            }
+            TEST_ASSERT_TRUE(fwrite(b, size, 1, fp) == 1);
+        }
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
+
+/* Return the content of the given file as a NUL-terminated string.
+   The caller is responsible for freeing the string. */
+static char *read_file(const char *file)
+{
+    FILE *fp;
+    char *s;
+    long n;
+
+    TEST_ASSERT_TRUE((fp = fopen(file, "rb")) != NULL);
+    fseek(fp, 0, SEEK_END);
+    n = ftell(fp);
+    rewind(fp);
+    TEST_ASSERT_TRUE((s = (char *) malloc(n + 1)) != NULL);
+    TEST_ASSERT_TRUE(n == 0  ||  fread(s, n, 1, fp) == 1);
+    s[n] = '\0';
+    fclose(fp);
+
+    return s;
+}
+
+/* Return the output we expect when converting the data file written
+   by write_data_file with all columns and default precision. */
+static char *expected_output(void)
+{
+    char *s, *t;
+    unsigned long i, n;
+
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    TEST_ASSERT_TRUE((s = (char *) malloc(64 * (n + 1))) != NULL);
+    t = s + sprintf(s, "snp trait b0 b1 s0 s1 c01\n");
+    for (i = 0; i < n; i++)
+        t += sprintf(t, "snp%d trait%d %g %g %g %g %g\n",
+            snp_index[i], trait_index[i], i + 0.0, i + 0.25, i + 0.5,
+            i + 0.75, i + 1.0);
+
+    return s;
+}
+
+/* Return the output we expect when converting with --order=trait
+   (by_snp = 0) or --order=snp (by_snp = 1). */
+static char *expected_ordered_output(int by_snp)
+{
+    char *s, *t;
+    unsigned long i, n, offset;
+    int snp, trait;
+
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    TEST_ASSERT_TRUE((s = (char *) malloc(64 * (n + 1))) != NULL);
+    t = s + sprintf(s, "snp trait b0 b1 s0 s1 c01\n");
+    for (i = 0; i < n; i++) {
+        snp = by_snp ? i / layout.ntrait : i % layout.nsnp;
+        trait = by_snp ? i % layout.ntrait : i / layout.nsnp;
+        offset = offsets[snp][trait];
+        t += sprintf(t, "snp%d trait%d %g %g %g %g %g\n", snp, trait,
+            offset + 0.0, offset + 0.25, offset + 0.5, offset + 0.75,
+            offset + 1.0);
+    }
+
+    return s;
+}
+
+/* Return the output we expect when converting only the snps and
+   traits flagged in is_snp and is_trait in the given order. */
+static char *expected_selected_output(int order, const int *is_snp,
+    const int *is_trait)
+{
+    char *s, *t;
+    unsigned long i, n, offset;
+    int snp, trait;
+
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    TEST_ASSERT_TRUE((s = (char *) malloc(64 * (n + 1))) != NULL);
+    t = s + sprintf(s, "snp trait b0 b1 s0 s1 c01\n");
+    for (i = 0; i < n; i++) {
+        if (order == ORDER_FILE)
+            offset2index(i, &snp, &trait, &layout);
+        else if (order == ORDER_TRAIT) {
+            snp = i % layout.nsnp;
+            trait = i / layout.nsnp;
+        }
+        else {
+            snp = i / layout.ntrait;
+            trait = i % layout.ntrait;
+        }
+        if (!is_snp[snp]  ||  !is_trait[trait])
+            continue;
+        offset = offsets[snp][trait];
+        t += sprintf(t, "snp%d trait%d %g %g %g %g %g\n", snp, trait,
+            offset + 0.0, offset + 0.25, offset + 0.5, offset + 0.75,
+            offset + 1.0);
+    }
+
+    return s;
+}
+
+/* Write a label file with the given content. */
+static void write_label_file(const char *file, const char *content)
+{
+    FILE *fp;
+
+    TEST_ASSERT_TRUE((fp = fopen(file, "w")) != NULL);
+    TEST_ASSERT_TRUE(fputs(content, fp) >= 0);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
+
+/* Convert the data file and return the output as a string. */
+static char *convert(void)
+{
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    write_data_file();
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&params, &layout));
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params, &layout),
+        err_msg);
+
+    return read_file(output_file);
 }
 
 /* Test whether offsets are correctly mapped to snps and traits. */
@@ -140,3 +325,705 @@ TEST(parse_data_file, offset2index_is_reverse_of_index2offset)
             TEST_ASSERT_EQUAL_INT(s, snp);
         }
 }
+
+/* Test offsets beyond 2^32 in a layout of 10 million snps and 5000
+   traits. */
+TEST(parse_data_file, offsets_beyond_2_to_the_32)
+{
+    int snp, trait;
+    unsigned long i, n, offset;
+
+    layout.nsnp = 10000000;
+    layout.ntrait = 5000;
+    layout.snps_per_tile = 1000;
+    layout.traits_per_tile = 256;
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+
+    index2offset(0, 256, &offset, &layout);
+    TEST_ASSERT_TRUE(offset == 2560000000UL);
+    index2offset(layout.nsnp - 1, layout.ntrait - 1, &offset, &layout);
+    TEST_ASSERT_TRUE(offset == n - 1);
+    offset2index(n - 1, &snp, &trait, &layout);
+    TEST_ASSERT_EQUAL_INT(layout.nsnp - 1, snp);
+    TEST_ASSERT_EQUAL_INT(layout.ntrait - 1, trait);
+
+    for (i = 0; i < n; i += n / 9973) {
+        offset2index(i, &snp, &trait, &layout);
+        index2offset(snp, trait, &offset, &layout);
+        TEST_ASSERT_TRUE(offset == i);
+    }
+}
+
+/* Walk the tile cursor from every offset to the end of the data file
+   and compare each step with offset2index. */
+static void check_tile_cursor(void)
+{
+    struct TileCursor c;
+    unsigned long start, offset, n;
+    int snp, trait;
+
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    for (start = 0; start < n; start++) {
+        init_tile_cursor(&c, &layout, start);
+        for (offset = start; offset < n; offset++) {
+            offset2index(offset, &snp, &trait, &layout);
+            TEST_ASSERT_TRUE(c.offset == offset);
+            TEST_ASSERT_EQUAL_INT(snp, c.snp);
+            TEST_ASSERT_EQUAL_INT(trait, c.trait);
+            next_tile_cursor(&c);
+        }
+    }
+}
+
+TEST(parse_data_file, tile_cursor)
+{
+    struct TileCursor c;
+    unsigned long offset;
+
+    /* Margin tiles at the right and at the bottom */
+    init_tile_cursor(&c, &layout, 0);
+    for (offset = 0; offset < 80; offset++, next_tile_cursor(&c))
+        TEST_ASSERT_TRUE(offsets[c.snp][c.trait] == offset);
+    check_tile_cursor();
+
+    /* Tiles that fit exactly */
+    layout.nsnp = 8;
+    layout.ntrait = 6;
+    check_tile_cursor();
+
+    /* A single tile larger than the data */
+    layout.snps_per_tile = 16;
+    layout.traits_per_tile = 16;
+    check_tile_cursor();
+
+    /* Tiles of a single record */
+    layout.snps_per_tile = 1;
+    layout.traits_per_tile = 1;
+    check_tile_cursor();
+}
+
+TEST(parse_data_file, tile_cursor_beyond_2_to_the_32)
+{
+    struct TileCursor c;
+    unsigned long offset, n;
+    int snp, trait;
+
+    layout.nsnp = 10000000;
+    layout.ntrait = 5000;
+    layout.snps_per_tile = 1000;
+    layout.traits_per_tile = 256;
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+
+    init_tile_cursor(&c, &layout, n - 3000000);
+    for (offset = n - 3000000; offset < n; offset++) {
+        offset2index(offset, &snp, &trait, &layout);
+        TEST_ASSERT_EQUAL_INT(snp, c.snp);
+        TEST_ASSERT_EQUAL_INT(trait, c.trait);
+        next_tile_cursor(&c);
+    }
+}
+
+static char **make_labels(const char *prefix, int n)
+{
+    char **labels, *s;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(labels = (char **) malloc(n * sizeof(char *)));
+    TEST_ASSERT_NOT_NULL(s = (char *) malloc((size_t) n * 8));
+    for (i = 0; i < n; i++, s += 8)
+        sprintf(labels[i] = s, "%s%d", prefix, i);
+    return labels;
+}
+
+static void free_labels(char **labels)
+{
+    free(labels[0]);
+    free(labels);
+}
+
+/* Convert three snps and three traits of a layout of nsnp snps and
+   ntrait traits.  The data file is sparse: only the records of the
+   three pairs snp[k] and trait[k] are written, with values k + 1 + j /
+   4 in column j.  The last of them is the last record of the data
+   file. */
+static void convert_sparse_data_file(int nsnp, int ntrait)
+{
+    int snp[3], trait[3], fd, j, k, l, use_mmap;
+    unsigned long offset;
+    size_t nbytes;
+    double x[5];
+    char **snp_names, **trait_names, *expected, *actual, *t;
+
+    snp[0] = 3;
+    snp[1] = nsnp / 2 + 1;
+    snp[2] = nsnp - 1;
+    trait[0] = ntrait / 2 - 1;
+    trait[1] = ntrait - 2;
+    trait[2] = ntrait - 1;
+
+    layout.nsnp = nsnp;
+    layout.ntrait = ntrait;
+    layout.snps_per_tile = 1000;
+    layout.traits_per_tile = 100;
+    layout.snp_labels = snp_names = make_labels("s", nsnp);
+    layout.trait_labels = trait_names = make_labels("t", ntrait);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, validate_layout(&layout), err_msg);
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+
+    nbytes = sizeof x;
+    TEST_ASSERT_TRUE((fd = open(data_file, O_WRONLY | O_CREAT | O_TRUNC,
+                0644)) != -1);
+    TEST_ASSERT_EQUAL_INT(0, ftruncate(fd,
+            (off_t) nsnp * ntrait * nbytes));
+    for (k = 0; k < 3; k++) {
+        for (j = 0; j < 5; j++)
+            x[j] = k + 1 + j / 4.0;
+        index2offset(snp[k], trait[k], &offset, &layout);
+        TEST_ASSERT_TRUE(pwrite(fd, x, nbytes, (off_t) offset * nbytes)
+            == (ssize_t) nbytes);
+    }
+    TEST_ASSERT_EQUAL_INT(0, close(fd));
+    TEST_ASSERT_TRUE(offset == (unsigned long) nsnp * ntrait - 1);
+
+    t = expected = (char *) malloc(1024);
+    TEST_ASSERT_NOT_NULL(expected);
+    t += sprintf(t, "snp trait b0 b1 s0 s1 c01\n");
+    for (k = 0; k < 3; k++)
+        for (l = 0; l < 3; l++)
+            t += sprintf(t, k == l ? "s%d t%d %g %g %g %g %g\n"
+                : "s%d t%d 0 0 0 0 0\n", snp[k], trait[l], k + 1.0,
+                k + 1.25, k + 1.5, k + 1.75, k + 2.0);
+
+    t = actual = (char *) malloc(1024);
+    TEST_ASSERT_NOT_NULL(actual);
+    for (k = 0; k < 3; k++)
+        t += sprintf(t, "s%d\n", snp[k]);
+    write_label_file("test/tmp/snps.txt", actual);
+    t = actual;
+    for (k = 0; k < 3; k++)
+        t += sprintf(t, "t%d\n", trait[k]);
+    write_label_file("test/tmp/traits.txt", actual);
+    free(actual);
+
+    params.snps_file = "test/tmp/snps.txt";
+    params.traits_file = "test/tmp/traits.txt";
+    params.order = ORDER_SNP;
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&params, &layout));
+    for (use_mmap = 0; use_mmap <= 1; use_mmap++) {
+        params.use_mmap = use_mmap;
+        TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params,
+                &layout), err_msg);
+        actual = read_file(output_file);
+        TEST_ASSERT_EQUAL_STRING(expected, actual);
+        free(actual);
+    }
+
+    free(expected);
+    free_labels(snp_names);
+    free_labels(trait_names);
+    remove(data_file);
+}
+
+/* Test converting a sparse data file of more than 2^31 records. */
+TEST(parse_data_file, convert_sparse_data_file_beyond_2_to_the_31)
+{
+    convert_sparse_data_file(50000, 50000);
+}
+
+/* Test converting a sparse data file of more than 2^32 records. */
+TEST(parse_data_file, convert_sparse_data_file_beyond_2_to_the_32)
+{
+    convert_sparse_data_file(70000, 70000);
+}
+
+/* Test that converting a memory-mapped data file gives the expected
+   output. */
+TEST(parse_data_file, convert_mapped_data_file)
+{
+    char *expected, *actual;
+
+    params.use_mmap = 1;
+    expected = expected_output();
+    actual = convert();
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+/* Test that reading the data file with buffered reads gives the same
+   output as reading it through a memory mapping. */
+TEST(parse_data_file, convert_buffered_data_file)
+{
+    char *expected, *actual;
+
+    params.use_mmap = 0;
+    expected = expected_output();
+    actual = convert();
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    free(expected);
+    free(actual);
+}
+
+/* Test that converting with several threads gives the same output as
+   converting with a single thread, both with and without a memory
+   mapping. */
+TEST(parse_data_file, convert_with_threads)
+{
+    char *expected, *actual;
+    int use_mmap, nthread;
+
+    expected = expected_output();
+    for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+        for (nthread = 2; nthread <= 5; nthread++) {
+            params.use_mmap = use_mmap;
+            params.nthread = nthread;
+            params.ncolumn = 0;         /* use all columns again */
+            actual = convert();
+            TEST_ASSERT_EQUAL_STRING(expected, actual);
+            free(actual);
+        }
+    free(expected);
+}
+
+/* Test that a truncated data file results in an error. */
+TEST(parse_data_file, truncated_data_file_gives_error)
+{
+    FILE *fp;
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite("12345678", 8, 1, fp) == 1);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&params, &layout));
+
+    params.use_mmap = 1;
+    TEST_ASSERT_EQUAL_INT(0, parse_data_file(&params, &layout));
+    TEST_ASSERT_EQUAL_STRING("data file too short: expected 3200 bytes, "
+        "got 8: test/tmp/data.out", err_msg);
+
+    params.use_mmap = 0;
+    TEST_ASSERT_EQUAL_INT(0, parse_data_file(&params, &layout));
+    TEST_ASSERT_EQUAL_STRING("failed to read record 0 from data file: "
+        "test/tmp/data.out", err_msg);
+
+    params.nthread = 3;
+    TEST_ASSERT_EQUAL_INT(0, parse_data_file(&params, &layout));
+    TEST_ASSERT_EQUAL_STRING("failed to read records 0 to 11 from data "
+        "file: test/tmp/data.out", err_msg);
+}
+
+/* Test that --order=trait and --order=snp give records grouped by
+   trait and by snp, for memory limits that make blocks of parts of a
+   trait or snp, of whole traits or snps, of whole tile rows or tile
+   columns, and of everything. */
+TEST(parse_data_file, convert_in_trait_and_snp_order)
+{
+    static unsigned long max_memory[] = {
+        40, 120, 200, 400, 480, 1200, 1600, 3200, DEFAULT_MAX_MEMORY
+    };
+    char *expected, *actual;
+    int by_snp, use_mmap, nthread;
+    size_t i;
+
+    for (by_snp = 0; by_snp <= 1; by_snp++) {
+        expected = expected_ordered_output(by_snp);
+        for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+            for (nthread = 1; nthread <= 3; nthread += 2)
+                for (i = 0; i < NELEMS(max_memory); i++) {
+                    params.order = by_snp ? ORDER_SNP : ORDER_TRAIT;
+                    params.max_memory = max_memory[i];
+                    params.use_mmap = use_mmap;
+                    params.nthread = nthread;
+                    params.ncolumn = 0;     /* use all columns again */
+                    actual = convert();
+                    TEST_ASSERT_EQUAL_STRING(expected, actual);
+                    free(actual);
+                }
+        free(expected);
+    }
+}
+
+/* Test that a truncated data file results in an error when converting
+   in trait order. */
+TEST(parse_data_file, truncated_data_file_gives_error_in_trait_order)
+{
+    FILE *fp;
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite("12345678", 8, 1, fp) == 1);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&params, &layout));
+
+    params.order = ORDER_TRAIT;
+    params.use_mmap = 0;
+    TEST_ASSERT_EQUAL_INT(0, parse_data_file(&params, &layout));
+    TEST_ASSERT_EQUAL_STRING("failed to read records 0 to 11 from data "
+        "file: test/tmp/data.out", err_msg);
+}
+
+/* Test that --snps-file and --traits-file select the listed snps and
+   traits in every order, with and without a mapping, and for batches
+   of a single record, of a few records, and of all records. */
+TEST(parse_data_file, convert_selected_snps_and_traits)
+{
+    static const int is_snp[] = {0, 0, 1, 0, 0, 1, 0, 0, 0, 1};
+    static const int is_trait[] = {1, 0, 0, 0, 1, 0, 0, 1};
+    static const int all[] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+    static unsigned long max_memory[] = {1, 300, DEFAULT_MAX_MEMORY};
+    static const int orders[] = {ORDER_FILE, ORDER_TRAIT, ORDER_SNP};
+    char *expected, *actual;
+    int k, use_mmap, nthread, only;
+    size_t i;
+
+    write_label_file("test/tmp/snps.txt", "snp9\n  snp2 \n\nsnp5\nsnp2\n");
+    write_label_file("test/tmp/traits.txt", "trait7\ntrait0\ntrait4");
+
+    /* only = 0: snps and traits, 1: only snps, 2: only traits */
+    for (only = 0; only <= 2; only++)
+        for (k = 0; k < 3; k++) {
+            expected = expected_selected_output(orders[k],
+                only == 2 ? all : is_snp, only == 1 ? all : is_trait);
+            for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+                for (nthread = 1; nthread <= 3; nthread += 2)
+                    for (i = 0; i < NELEMS(max_memory); i++) {
+                        params.snps_file = only == 2 ? NULL
+                            : "test/tmp/snps.txt";
+                        params.traits_file = only == 1 ? NULL
+                            : "test/tmp/traits.txt";
+                        params.order = orders[k];
+                        params.max_memory = max_memory[i];
+                        params.use_mmap = use_mmap;
+                        params.nthread = nthread;
+                        params.ncolumn = 0;
+                        actual = convert();
+                        TEST_ASSERT_EQUAL_STRING(expected, actual);
+                        free(actual);
+                    }
+            free(expected);
+        }
+}
+
+/* Test that an unknown label in a label file results in an error. */
+TEST(parse_data_file, unknown_snp_gives_error)
+{
+    write_label_file("test/tmp/snps.txt", "snp1\nsnp10\n");
+    params.snps_file = "test/tmp/snps.txt";
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    write_data_file();
+    TEST_ASSERT_EQUAL_INT(1, set_column_print_order(&params, &layout));
+    TEST_ASSERT_EQUAL_INT(0, parse_data_file(&params, &layout));
+    TEST_ASSERT_EQUAL_STRING("unknown snp in line 2 of test/tmp/snps.txt: "
+        "snp10", err_msg);
+}
+
+/* Test that --where drops records in all ways of converting, also
+   when the filter uses columns that aren't written. */
+TEST(parse_data_file, convert_with_filter)
+{
+    static char *columns[] = {"b0"};
+    static const int orders[] = {ORDER_FILE, ORDER_TRAIT, ORDER_SNP};
+    char *expected, *actual, *t;
+    unsigned long offset;
+    int k, use_mmap, nthread, snp, trait, i, n;
+
+    write_label_file("test/tmp/traits.txt", "trait0\ntrait4\ntrait5\n");
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    write_data_file();
+
+    for (k = 0; k < 3; k++) {
+        /* Records 20 to 49 and record 3 pass the filter. */
+        n = layout.nsnp * layout.ntrait;
+        TEST_ASSERT_NOT_NULL(expected = (char *) malloc(32 * (n + 1)));
+        t = expected + sprintf(expected, "snp trait b0\n");
+        for (i = 0; i < n; i++) {
+            if (orders[k] == ORDER_FILE)
+                offset2index(i, &snp, &trait, &layout);
+            else if (orders[k] == ORDER_TRAIT) {
+                snp = i % layout.nsnp;
+                trait = i / layout.nsnp;
+            }
+            else {
+                snp = i / layout.ntrait;
+                trait = i % layout.ntrait;
+            }
+            offset = offsets[snp][trait];
+            if ((offset >= 20  &&  offset < 50)  ||  offset == 3)
+                t += sprintf(t, "snp%d trait%d %g\n", snp, trait,
+                    offset + 0.0);
+        }
+
+        for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+            for (nthread = 1; nthread <= 3; nthread += 2) {
+                free(params.ucp2acp);
+                initialize_parameters(&params);
+                params.layout_file = (char *) layout_file;
+                params.data_file   = (char *) data_file;
+                params.output_file = (char *) output_file;
+                params.ncolumn = 1;
+                params.columns = columns;
+                TEST_ASSERT_NOT_NULL(params.ucp2acp =
+                    (int *) malloc(2 * sizeof(int)));
+                TEST_ASSERT_EQUAL_INT(1,
+                    set_column_print_order(&params, &layout));
+                TEST_ASSERT_NOT_NULL(params.filter = Filter_Compile(
+                        "b1 >= 20.25 && c01 < 51 || s1 == 3.75", &layout));
+                params.order = orders[k];
+                params.use_mmap = use_mmap;
+                params.nthread = nthread;
+                TEST_ASSERT_EQUAL_INT_MESSAGE(1,
+                    parse_data_file(&params, &layout), err_msg);
+                actual = read_file(output_file);
+                TEST_ASSERT_EQUAL_STRING(expected, actual);
+                free(actual);
+
+                /* Selections are filtered as well. */
+                if (orders[k] == ORDER_FILE  &&  nthread == 1) {
+                    params.traits_file = "test/tmp/traits.txt";
+                    TEST_ASSERT_EQUAL_INT_MESSAGE(1,
+                        parse_data_file(&params, &layout), err_msg);
+                    actual = read_file(output_file);
+                    TEST_ASSERT_EQUAL_STRING("snp trait b0\n"
+                        "snp3 trait0 3\n"
+                        "snp8 trait0 24\n" "snp9 trait0 25\n"
+                        "snp0 trait4 34\n" "snp1 trait4 35\n"
+                        "snp2 trait4 36\n" "snp3 trait4 37\n"
+                        "snp0 trait5 38\n" "snp1 trait5 39\n"
+                        "snp2 trait5 40\n" "snp3 trait5 41\n"
+                        "snp4 trait4 46\n" "snp5 trait4 47\n"
+                        "snp6 trait4 48\n" "snp7 trait4 49\n",
+                        actual);
+                    free(actual);
+                }
+                Filter_Destroy(params.filter);
+            }
+        free(expected);
+    }
+}
+
+/* Test that data files of floats, of doubles in the other byte order,
+   and of floats in the other byte order give the same output as data
+   files of native doubles, whether the byte order comes from the
+   layout file or from --endian. */
+TEST(parse_data_file, convert_float32_and_byte_swapped_data_files)
+{
+    static const int sizes[] = {4, 8, 4};
+    static const int swapped[] = {0, 1, 1};
+    char *expected[2], *actual;
+    int k, use_mmap, nthread, by_order, endian;
+
+    expected[0] = expected_output();
+    expected[1] = expected_ordered_output(0);
+    for (k = 0; k < 3; k++)
+        for (endian = 0; endian <= 1; endian++)
+            for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+                for (nthread = 1; nthread <= 3; nthread += 2)
+                    for (by_order = 0; by_order <= 1; by_order++) {
+                        layout.bytes_per_double = sizes[k];
+                        layout.swapped = swapped[k];
+                        TEST_ASSERT_EQUAL_INT(1,
+                            write_layout_file(layout_file, &layout));
+                        write_data_file();
+
+                        /* --endian wins over the layout file. */
+                        params.endian = ENDIAN_AUTO;
+                        if (endian) {
+                            params.endian = swapped[k] == is_big_endian()
+                                ? ENDIAN_LITTLE : ENDIAN_BIG;
+                            layout.swapped = !swapped[k];
+                        }
+                        params.use_mmap = use_mmap;
+                        params.nthread = nthread;
+                        params.order = by_order ? ORDER_TRAIT : ORDER_FILE;
+                        params.ncolumn = 0;
+                        TEST_ASSERT_EQUAL_INT(1,
+                            set_column_print_order(&params, &layout));
+                        TEST_ASSERT_EQUAL_INT_MESSAGE(1,
+                            parse_data_file(&params, &layout), err_msg);
+                        actual = read_file(output_file);
+                        TEST_ASSERT_EQUAL_STRING(expected[by_order],
+                            actual);
+                        free(actual);
+                    }
+    free(expected[0]);
+    free(expected[1]);
+}
+
+/* Test that converting only some columns of records that span several
+   pages, which skips the pages holding only unused columns, gives the
+   right output with and without a memory mapping and threads. */
+TEST(parse_data_file, convert_skipping_unused_columns)
+{
+    static char *columns[] = {"b1"};
+    static char names[2][600][8];
+    static char *wide_beta_labels[600], *wide_se_labels[600];
+    char *expected, *actual, *t;
+    unsigned long i, n;
+    int j, use_mmap, nthread;
+
+    for (j = 0; j < 600; j++) {
+        sprintf(wide_beta_labels[j] = names[0][j], "b%d", j);
+        sprintf(wide_se_labels[j] = names[1][j], "s%d", j);
+    }
+    layout.nvar = 600;
+    layout.beta_labels = wide_beta_labels;
+    layout.se_labels = wide_se_labels;
+
+    n = (unsigned long) layout.nsnp * layout.ntrait;
+    TEST_ASSERT_NOT_NULL(expected = (char *) malloc(32 * (n + 1)));
+    t = expected + sprintf(expected, "snp trait b1\n");
+    for (i = 0; i < n; i++)
+        t += sprintf(t, "snp%d trait%d %g\n", snp_index[i],
+            trait_index[i], i + 0.25);
+
+    for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+        for (nthread = 1; nthread <= 3; nthread += 2) {
+            free(params.ucp2acp);
+            params.ncolumn = 1;
+            params.columns = columns;
+            TEST_ASSERT_NOT_NULL(params.ucp2acp =
+                (int *) malloc(2 * sizeof(int)));
+            params.use_mmap = use_mmap;
+            params.nthread = nthread;
+            actual = convert();
+            TEST_ASSERT_EQUAL_STRING(expected, actual);
+            free(actual);
+        }
+    free(expected);
+}
+
+/* Test that --top-k writes the records of every trait that rank
+   highest, in order, with and without a memory mapping and threads,
+   by a p-value and by the absolute value of an expression, and that
+   records that fail --where don't rank. */
+TEST(parse_data_file, convert_top_k)
+{
+    static char *columns[] = {"b1"};
+    static const char *ranks[] = {"p(b0)", "b0 - 40"};
+    char *expected, *actual, *t;
+    double score, best;
+    unsigned long offset;
+    int k, use_mmap, nthread, snp, trait, i, top, taken[10];
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    write_data_file();
+    for (k = 0; k < 2; k++) {
+        /* The p-value of b0 / s0 falls as the offset grows. */
+        TEST_ASSERT_NOT_NULL(expected = (char *) malloc(32
+                * (3 * layout.ntrait + 1)));
+        t = expected + sprintf(expected, "snp trait b1\n");
+        for (trait = 0; trait < layout.ntrait; trait++) {
+            memset(taken, 0, sizeof taken);
+            for (i = 0; i < 3; i++) {
+                top = -1;
+                best = -1;
+                for (snp = 0; snp < layout.nsnp; snp++) {
+                    offset = offsets[snp][trait];
+                    score = k == 0 ? (double) offset
+                        : fabs(offset - 40.0);
+                    if (!taken[snp]  &&  offset < 70  &&  score > best) {
+                        best = score;
+                        top = snp;
+                    }
+                }
+                taken[top] = 1;
+                t += sprintf(t, "snp%d trait%d %g\n", top, trait,
+                    offsets[top][trait] + 0.25);
+            }
+        }
+
+        for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+            for (nthread = 1; nthread <= 3; nthread += 2) {
+                free(params.ucp2acp);
+                initialize_parameters(&params);
+                params.data_file   = (char *) data_file;
+                params.output_file = (char *) output_file;
+                params.ncolumn = 1;
+                params.columns = columns;
+                TEST_ASSERT_NOT_NULL(params.ucp2acp =
+                    (int *) malloc(2 * sizeof(int)));
+                TEST_ASSERT_EQUAL_INT(1,
+                    set_column_print_order(&params, &layout));
+                TEST_ASSERT_NOT_NULL(params.filter = Filter_Compile(
+                        "b0 < 70", &layout));
+                TEST_ASSERT_NOT_NULL(params.rank = Filter_Compile(
+                        ranks[k], &layout));
+                params.top_k = 3;
+                params.use_mmap = use_mmap;
+                params.nthread = nthread;
+                TEST_ASSERT_EQUAL_INT_MESSAGE(1,
+                    parse_data_file(&params, &layout), err_msg);
+                actual = read_file(output_file);
+                TEST_ASSERT_EQUAL_STRING(expected, actual);
+                free(actual);
+                Filter_Destroy(params.filter);
+                Filter_Destroy(params.rank);
+            }
+        free(expected);
+    }
+}
+
+/* Test that --summary writes a line per trait that counts the records
+   that pass --where, whatever the number of threads. */
+TEST(parse_data_file, convert_summary)
+{
+    static const char header[] = "trait n lambda max_logp hits_0.001 "
+        "hits_1e-05 hits_1e-06 hits_5e-08 hits_1e-10 logp_0 logp_1 ";
+    char *first, *actual, *line, *end, label[16], name[16];
+    unsigned long long n, count[SUMMARY_NHIT + SUMMARY_NHIST];
+    double lambda;
+    int use_mmap, nthread, trait, snp, expected, k, pos;
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    write_data_file();
+    first = NULL;
+    for (use_mmap = 0; use_mmap <= 1; use_mmap++)
+        for (nthread = 1; nthread <= 3; nthread += 2) {
+            free(params.ucp2acp);
+            initialize_parameters(&params);
+            params.data_file   = (char *) data_file;
+            params.output_file = (char *) output_file;
+            params.summary = "b0";
+            TEST_ASSERT_EQUAL_INT(1,
+                set_column_print_order(&params, &layout));
+            TEST_ASSERT_NOT_NULL(params.filter = Filter_Compile(
+                    "b0 < 70", &layout));
+            params.use_mmap = use_mmap;
+            params.nthread = nthread;
+            TEST_ASSERT_EQUAL_INT_MESSAGE(1,
+                parse_data_file(&params, &layout), err_msg);
+            actual = read_file(output_file);
+            Filter_Destroy(params.filter);
+            if (first != NULL) {
+                TEST_ASSERT_EQUAL_STRING(first, actual);
+                free(actual);
+                continue;
+            }
+            first = actual;
+        }
+
+    /* b0 / s0 = offset / (offset + 0.5) < 1, so p > 0.1 everywhere. */
+    TEST_ASSERT_EQUAL_INT(0, strncmp(first, header, strlen(header)));
+    line = strchr(first, '\n') + 1;
+    for (trait = 0; trait < layout.ntrait; trait++) {
+        expected = 0;
+        for (snp = 0; snp < layout.nsnp; snp++)
+            expected += offsets[snp][trait] < 70;
+        TEST_ASSERT_EQUAL_INT(3, sscanf(line, "%15s %llu %lf%n", label, &n,
+                &lambda, &pos));
+        sprintf(name, "trait%d", trait);
+        TEST_ASSERT_EQUAL_STRING(name, label);
+        TEST_ASSERT_EQUAL_INT(expected, (int) n);
+        TEST_ASSERT_TRUE(lambda > 0  &&  lambda < 2.2);
+        strtod(line + pos, &end);           /* max_logp */
+        for (k = 0; k < SUMMARY_NHIT + SUMMARY_NHIST; k++)
+            count[k] = strtoull(end, &end, 10);
+        for (k = 0; k < SUMMARY_NHIT + SUMMARY_NHIST; k++)
+            TEST_ASSERT_EQUAL_INT(k == SUMMARY_NHIT ? expected : 0,
+                (int) count[k]);
+        line = strchr(line, '\n') + 1;
+    }
+    TEST_ASSERT_EQUAL_STRING("", line);
+    free(first);
+}
@@ -3,6 +3,7 @@
 #include "parse_command_line_args.h"
 #include "err_msg.h"
 #include <stddef.h>
+#include <unistd.h>
 
 #define NELEMS(x) (sizeof (x) / sizeof (x[0]))
 
@@ -109,15 +110,89 @@ TEST(parse_layout_file, write_and_read_back_layout_file)
         TEST_ASSERT_EQUAL_STRING_MESSAGE(out.cov_labels[i],
             in.cov_labels[i], "cov labels");
 
-    TEST_ASSERT_TRUE(in.snp_labels != NULL);
     for (i = 0; i < out.nsnp; i++)
         TEST_ASSERT_EQUAL_STRING_MESSAGE(out.snp_labels[i],
-            in.snp_labels[i], "snp labels");
+            snp_label(&in, i), "snp labels");
 
-    TEST_ASSERT_TRUE(in.trait_labels != NULL);
     for (i = 0; i < out.ntrait; i++)
         TEST_ASSERT_EQUAL_STRING_MESSAGE(out.trait_labels[i],
-            in.trait_labels[i], "trait labels");
+            trait_label(&in, i), "trait labels");
+
+    free_layout(&in);
+}
+
+/* Test that the snp and trait labels are left in the mapped layout
+   file instead of being copied. */
+TEST(parse_layout_file, labels_stay_in_layout_file)
+{
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(file, &out));
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_layout_file(file, &in),
+        err_msg);
+
+    TEST_ASSERT_NULL(in.snp_labels);
+    TEST_ASSERT_NULL(in.trait_labels);
+    TEST_ASSERT_NOT_NULL(in.map);
+    TEST_ASSERT_EQUAL_INT(0, in.swapped);
+    TEST_ASSERT_EQUAL_STRING("snp9", snp_label(&in, 9));
+    TEST_ASSERT_EQUAL_STRING("trait0", trait_label(&in, 0));
+
+    free_layout(&in);
+}
+
+/* Test that a layout file written on a machine of the other byte
+   order is read correctly and marked as swapped. */
+TEST(parse_layout_file, read_byte_swapped_layout_file)
+{
+    FILE *fp;
+    int a[8], i;
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(file, &out));
+    TEST_ASSERT_NOT_NULL(fp = fopen(file, "r+b"));
+    TEST_ASSERT_EQUAL_INT(8, fread(a, sizeof(int), 8, fp));
+    for (i = 0; i < 8; i++)
+        a[i] = (int) __builtin_bswap32((unsigned) a[i]);
+    rewind(fp);
+    TEST_ASSERT_EQUAL_INT(8, fwrite(a, sizeof(int), 8, fp));
+    TEST_ASSERT_EQUAL_INT(0, fclose(fp));
+
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_layout_file(file, &in),
+        err_msg);
+    TEST_ASSERT_EQUAL_INT(1, in.swapped);
+    TEST_ASSERT_EQUAL_INT(out.magic_number, in.magic_number);
+    TEST_ASSERT_EQUAL_INT(out.bytes_per_double, in.bytes_per_double);
+    TEST_ASSERT_EQUAL_INT(out.nsnp, in.nsnp);
+    TEST_ASSERT_EQUAL_INT(out.max_char, in.max_char);
+    TEST_ASSERT_EQUAL_STRING("se2", in.se_labels[2]);
+    TEST_ASSERT_EQUAL_STRING("snp9", snp_label(&in, 9));
+
+    free_layout(&in);
+}
+
+/* Test that a layout file without all of its labels causes an
+   error. */
+TEST(parse_layout_file, truncated_layout_file_gives_error)
+{
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(file, &out));
+    TEST_ASSERT_EQUAL_INT(0, truncate(file, 8 * sizeof(int) + 100));
+
+    status = parse_layout_file(file, &in);
+
+    TEST_ASSERT_EQUAL_INT(0, status);
+    TEST_ASSERT_EQUAL_STRING("unexpectedly reached end of layout file: "
+        "test/tmp/foo.iout", err_msg);
+}
+
+/* Test that a layout whose data file would have more bytes than an
+   unsigned long can address causes an error. */
+TEST(parse_layout_file, too_many_records)
+{
+    in = out;           /* pretend layout file was parsed correctly */
+    in.nsnp = in.ntrait = 2147483647;
+    status = validate_layout(&in);
+
+    TEST_ASSERT_EQUAL_INT(0, status);
+    TEST_ASSERT_EQUAL_STRING("too many records in layout file: "
+        "4611686014132420609 records of 72 bytes each", err_msg);
 }
 
 /* Test that a bad magic number causes an error. */
@@ -133,17 +208,26 @@ TEST(parse_layout_file, bad_magic_number)
         "expected 6, got 99", err_msg);
 }
 
-/* Test that a negative number of bytes per double causes an error. */
+/* Test that a number of bytes per double other than 4 or 8 causes an
+   error. */
 TEST(parse_layout_file, bad_bytes_per_double)
 {
     in = out;           /* pretend layout file was parsed correctly */
-    in.bytes_per_double = -1;   /* should be >0 */
+    in.bytes_per_double = -1;   /* should be 4 or 8 */
     status = validate_layout(&in);
 
     TEST_ASSERT_EQUAL_INT_MESSAGE(0, status,
         "validate_layout return value");
     TEST_ASSERT_EQUAL_STRING("bad number of bytes per double in "
-        "layout file: expected >0, got -1", err_msg);
+        "layout file: expected 4 or 8, got -1", err_msg);
+
+    in.bytes_per_double = 2;
+    TEST_ASSERT_EQUAL_INT(0, validate_layout(&in));
+    TEST_ASSERT_EQUAL_STRING("bad number of bytes per double in "
+        "layout file: expected 4 or 8, got 2", err_msg);
+
+    in.bytes_per_double = 4;
+    TEST_ASSERT_EQUAL_INT(1, validate_layout(&in));
 }
 
 /* Test that a too small number of covariates causes an error. */
@@ -294,8 +378,8 @@ TEST(parse_layout_file, set_column_print_order_with_subset_of_columns)
     char *columns[] = {"se2", "cov0_2", "beta1"};
     int ncolumn = NELEMS(columns);
     int ucp2acp[] = {-1, -1, -1, -9};
-    struct Params params = {ncolumn, columns, ucp2acp,
-                            0, 0, 0, NULL, NULL, NULL};
+    struct Params params = {.ncolumn = ncolumn, .columns = columns,
+                            .ucp2acp = ucp2acp};
     int correct_ucp2acp[] = {5, 7, 1, -9};
     int i;
 
@@ -320,8 +404,8 @@ TEST(parse_layout_file, set_permuted_column_print_order)
                        "beta0",  "se2",   "cov0_2", "beta1"};
     int ncolumn = NELEMS(columns);
     int ucp2acp[] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -9};
-    struct Params params = {ncolumn, columns, ucp2acp,
-                            0, 0, 0, NULL, NULL, NULL};
+    struct Params params = {.ncolumn = ncolumn, .columns = columns,
+                            .ucp2acp = ucp2acp};
     int correct_ucp2acp[] = {8, 2, 4, 6, 3, 0, 5, 7, 1, -9};
     int i;
 
@@ -341,8 +425,8 @@ TEST(parse_layout_file, invalid_user_supplied_column_label)
     char *columns[] = {"cov1_2", "beta2", "foobar"};;
     int ncolumn = NELEMS(columns);
     int ucp2acp[] = {-1, -1, -1, -9};
-    struct Params params = {ncolumn, columns, ucp2acp,
-                            0, 0, 0, NULL, NULL, NULL};
+    struct Params params = {.ncolumn = ncolumn, .columns = columns,
+                            .ucp2acp = ucp2acp};
 
     in = out;           /* pretend layout file was parsed correctly */
     status = set_column_print_order(&params, &in);
@@ -356,8 +440,8 @@ TEST(parse_layout_file, invalid_user_supplied_column_label)
    columns in their default order. */
 TEST(parse_layout_file, use_default_columns)
 {
-    struct Params params = {0, NULL, NULL,
-                            0, 0, 0, NULL, NULL, NULL};
+    struct Params params = {.ncolumn = 0, .columns = NULL,
+                            .ucp2acp = NULL};
     int i;
 
     /* Whenever set_column_print_order is called in a real program
@@ -0,0 +1,183 @@
+#include "unity_fixture.h"
+#include "read_block.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Test data:
+
+   We use the layout shown in parse_data_file.c Figure 1 with records
+   consisting of a single double that holds the record's offset. */
+static struct Layout layout;
+static double data[80];
+static double block[80];
+
+static const char *data_file = "test/tmp/block.out";
+
+TEST_GROUP(read_block);
+
+TEST_SETUP(read_block)
+{
+    int i;
+
+    layout.nsnp            = 10;
+    layout.ntrait          = 8;
+    layout.snps_per_tile   = 4;
+    layout.traits_per_tile = 3;
+    for (i = 0; i < 80; i++)
+        data[i] = i;
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(read_block)
+{
+}
+
+/* Read every possible block and check that every record ends up in
+   the right place. */
+static void check_all_blocks(struct RecordSource *src)
+{
+    int t0, t1, s0, s1, t, s;
+    unsigned long offset;
+
+    for (t0 = 0; t0 < layout.ntrait; t0++)
+        for (t1 = t0 + 1; t1 <= layout.ntrait; t1++)
+            for (s0 = 0; s0 < layout.nsnp; s0++)
+                for (s1 = s0 + 1; s1 <= layout.nsnp; s1++) {
+                    TEST_ASSERT_EQUAL_INT_MESSAGE(1, read_block(src,
+                            &layout, t0, t1, s0, s1, (char *) block),
+                        err_msg);
+                    for (t = t0; t < t1; t++)
+                        for (s = s0; s < s1; s++) {
+                            index2offset(s, t, &offset, &layout);
+                            TEST_ASSERT_EQUAL_DOUBLE(offset,
+                                block[(t - t0) * (s1 - s0) + (s - s0)]);
+                        }
+                }
+}
+
+/* Test reading blocks from a mapped data file. */
+TEST(read_block, blocks_from_mapping)
+{
+    struct RecordSource src;
+
+    init_record_source(&src, data_file, (const char *) data, -1,
+        sizeof(double));
+    check_all_blocks(&src);
+    free_record_source(&src);
+}
+
+/* Test reading blocks with pread(2). */
+TEST(read_block, blocks_from_file)
+{
+    struct RecordSource src;
+    FILE *fp;
+    int fd;
+
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite(data, sizeof data, 1, fp) == 1);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_TRUE((fd = open(data_file, O_RDONLY)) != -1);
+
+    init_record_source(&src, data_file, NULL, fd, sizeof(double));
+    check_all_blocks(&src);
+    free_record_source(&src);
+    close(fd);
+}
+
+/* Test that reading past the end of the data file gives an error. */
+TEST(read_block, short_file_gives_error)
+{
+    struct RecordSource src;
+    FILE *fp;
+    int fd;
+
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite(data, sizeof(double), 40, fp) == 40);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_TRUE((fd = open(data_file, O_RDONLY)) != -1);
+
+    init_record_source(&src, data_file, NULL, fd, sizeof(double));
+    TEST_ASSERT_EQUAL_INT(0, read_block(&src, &layout, 6, 8, 0, 10,
+            (char *) block));
+    TEST_ASSERT_EQUAL_STRING("failed to read records 60 to 67 from "
+        "data file: test/tmp/block.out", err_msg);
+    free_record_source(&src);
+    close(fd);
+}
+
+/* Test the spans of a projection and whether it skips pages. */
+TEST(read_block, projection_spans)
+{
+    static unsigned char used[2000];
+    struct Projection proj;
+
+    used[0] = used[2] = used[3] = 1;
+    TEST_ASSERT_EQUAL_INT(1, make_projection(&proj, used, 5, 8, 4096));
+    TEST_ASSERT_EQUAL_INT(2, proj.nspan);
+    TEST_ASSERT_EQUAL_INT(0, proj.start[0]);
+    TEST_ASSERT_EQUAL_INT(8, proj.len[0]);
+    TEST_ASSERT_EQUAL_INT(16, proj.start[1]);
+    TEST_ASSERT_EQUAL_INT(16, proj.len[1]);
+    TEST_ASSERT_EQUAL_INT(0, proj.skip);   /* records share pages */
+    free_projection(&proj);
+
+    TEST_ASSERT_EQUAL_INT(1, make_projection(&proj, used, 2000, 8, 4096));
+    TEST_ASSERT_EQUAL_INT(1, proj.skip);   /* about one page in four */
+    free_projection(&proj);
+
+    /* Records of less than two pages touch more than half the pages
+       even if we only need their first and last column. */
+    used[999] = 1;
+    TEST_ASSERT_EQUAL_INT(1, make_projection(&proj, used, 1000, 8, 4096));
+    TEST_ASSERT_EQUAL_INT(3, proj.nspan);
+    TEST_ASSERT_EQUAL_INT(7992, proj.start[2]);
+    TEST_ASSERT_EQUAL_INT(8, proj.len[2]);
+    TEST_ASSERT_EQUAL_INT(0, proj.skip);
+    free_projection(&proj);
+}
+
+/* Test that reading records through a projection that skips pages
+   reads only the pages with needed bytes. */
+TEST(read_block, records_through_projection)
+{
+    enum { NREC = 64, NCOL = 2048 };
+    static unsigned char used[NCOL];
+    struct RecordSource src;
+    struct Projection proj;
+    const double *p;
+    double *x;
+    FILE *fp;
+    int i, j, fd;
+
+    TEST_ASSERT_NOT_NULL(x = (double *) malloc(NREC * NCOL * sizeof(double)));
+    for (i = 0; i < NREC * NCOL; i++)
+        x[i] = i;
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    TEST_ASSERT_TRUE(fwrite(x, sizeof(double), NREC * NCOL, fp)
+        == NREC * NCOL);
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+    TEST_ASSERT_TRUE((fd = open(data_file, O_RDONLY)) != -1);
+
+    used[1] = used[2] = 1;
+    TEST_ASSERT_EQUAL_INT(1, make_projection(&proj, used, NCOL, 8, 4096));
+    TEST_ASSERT_EQUAL_INT(1, proj.skip);
+    init_record_source(&src, data_file, NULL, fd, NCOL * sizeof(double));
+    src.proj = &proj;
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, read_records(&src, 3, NREC - 3,
+            (const char **) &p), err_msg);
+    for (i = 0; i < NREC - 3; i++)
+        for (j = 1; j <= 2; j++)
+            TEST_ASSERT_EQUAL_DOUBLE((i + 3) * NCOL + j, p[i * NCOL + j]);
+    TEST_ASSERT_TRUE(src.bytes_read == (NREC - 3) * 4096ULL);
+    TEST_ASSERT_TRUE(src.nread == NREC - 3);
+
+    free_record_source(&src);
+    free_projection(&proj);
+    close(fd);
+    free(x);
+}
@@ -0,0 +1,169 @@
+#include "unity_fixture.h"
+#include "result_index.h"
+#include "parse_data_file.h"
+#include "parse_layout_file.h"
+#include "parse_command_line_args.h"
+#include "err_msg.h"
+#include "Filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Enough snps and traits for the output to span several BGZF
+   blocks. */
+enum { NSNP = 2000, NTRAIT = 10 };
+
+static struct Layout layout;
+static struct Params params;
+static char *beta_labels[] = {"b0"};
+static char *se_labels[] = {"s0"};
+static char *snp_labels[NSNP];
+static char *trait_labels[NTRAIT];
+static char label_text[NSNP + NTRAIT][8];
+static int ucp2acp[] = {0, 1, -9};
+
+static const char *layout_file = "test/tmp/indexed.iout";
+static const char *data_file = "test/tmp/indexed.out";
+static const char *output_file = "test/tmp/indexed.txt.gz";
+static const char *index_file = "test/tmp/indexed.txt.gz.r3i";
+
+TEST_GROUP(result_index);
+
+TEST_SETUP(result_index)
+{
+    int i;
+
+    for (i = 0; i < NSNP; i++) {
+        sprintf(label_text[i], "s%d", i);
+        snp_labels[i] = label_text[i];
+    }
+    for (i = 0; i < NTRAIT; i++) {
+        sprintf(label_text[NSNP + i], "t%d", i);
+        trait_labels[i] = label_text[NSNP + i];
+    }
+
+    layout.magic_number     = 6;
+    layout.bytes_per_double = sizeof(double);
+    layout.nvar             = 1;
+    layout.ncov             = 0;
+    layout.nsnp             = NSNP;
+    layout.ntrait           = NTRAIT;
+    layout.snps_per_tile    = 64;
+    layout.traits_per_tile  = 3;
+    layout.max_char         = 8;
+    layout.beta_labels      = beta_labels;
+    layout.se_labels        = se_labels;
+    layout.cov_labels       = NULL;
+    layout.snp_labels       = snp_labels;
+    layout.trait_labels     = trait_labels;
+
+    initialize_parameters(&params);
+    params.ncolumn     = 2;
+    params.ucp2acp     = ucp2acp;
+    params.layout_file = (char *) layout_file;
+    params.data_file   = (char *) data_file;
+    params.output_file = (char *) output_file;
+    params.compress    = COMPRESS_BGZF;
+
+    clear_err_msg();
+}
+
+TEST_TEAR_DOWN(result_index)
+{
+    Filter_Destroy(params.filter);
+}
+
+/* Write a data file whose record at offset i holds beta i and
+   standard error i + 0.5. */
+static void write_data_file(void)
+{
+    FILE *fp;
+    unsigned long i;
+    double x[2];
+
+    TEST_ASSERT_EQUAL_INT(1, write_layout_file(layout_file, &layout));
+    TEST_ASSERT_TRUE((fp = fopen(data_file, "wb")) != NULL);
+    for (i = 0; i < (unsigned long) NSNP * NTRAIT; i++) {
+        x[0] = i;
+        x[1] = i + 0.5;
+        TEST_ASSERT_TRUE(fwrite(x, sizeof x, 1, fp) == 1);
+    }
+    TEST_ASSERT_TRUE(fclose(fp) == 0);
+}
+
+static void check_line(int snp, int trait)
+{
+    char line[64], expected[64];
+    unsigned long offset;
+
+    index2offset(snp, trait, &offset, &layout);
+    sprintf(expected, "s%d t%d %lu %lu.5", snp, trait, offset, offset);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, fetch_result(output_file,
+            index_file, &layout, snp, trait, line, sizeof line), err_msg);
+    TEST_ASSERT_EQUAL_STRING(expected, line);
+}
+
+/* Test that lines are found through the index in every order and
+   with any number of threads. */
+TEST(result_index, fetch_lines)
+{
+    static const int orders[] = {ORDER_FILE, ORDER_TRAIT, ORDER_SNP};
+    FILE *fp;
+    int k, nthread, snp, trait;
+
+    write_data_file();
+    for (k = 0; k < 3; k++)
+        for (nthread = 1; nthread <= 2; nthread++) {
+            params.order = orders[k];
+            params.nthread = nthread;
+            TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params,
+                    &layout), err_msg);
+
+            /* The output spans several blocks. */
+            TEST_ASSERT_TRUE((fp = fopen(index_file, "rb")) != NULL);
+            TEST_ASSERT_TRUE(fseek(fp, 0, SEEK_END) == 0);
+            TEST_ASSERT_TRUE(ftell(fp) > 32 + 5 * 16);
+            TEST_ASSERT_TRUE(fclose(fp) == 0);
+
+            for (snp = 0; snp < NSNP; snp += snp < 70 ? 1 : 37)
+                for (trait = 0; trait < NTRAIT; trait++)
+                    check_line(snp, trait);
+            check_line(NSNP - 1, NTRAIT - 1);
+        }
+}
+
+/* Test that lines left out by --where are not found. */
+TEST(result_index, fetch_filtered_line)
+{
+    char line[64];
+    int snp, trait;
+
+    write_data_file();
+    TEST_ASSERT_NOT_NULL(params.filter = Filter_Compile(
+            "b0 < 10000 || b0 >= 10100", &layout));
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, parse_data_file(&params, &layout),
+        err_msg);
+
+    offset2index(10050, &snp, &trait, &layout);
+    TEST_ASSERT_EQUAL_INT(0, fetch_result(output_file, index_file,
+            &layout, snp, trait, line, sizeof line));
+    sprintf(line, "no line for snp s%d and trait t%d in %s", snp, trait,
+        output_file);
+    TEST_ASSERT_EQUAL_STRING(line, err_msg);
+
+    offset2index(10100, &snp, &trait, &layout);
+    check_line(snp, trait);
+    offset2index(9999, &snp, &trait, &layout);
+    check_line(snp, trait);
+}
+
+/* Test that a file other than an index is rejected. */
+TEST(result_index, bad_index_file)
+{
+    char line[64];
+
+    TEST_ASSERT_EQUAL_INT(0, fetch_result(output_file, data_file,
+            &layout, 0, 0, line, sizeof line));
+    TEST_ASSERT_EQUAL_STRING("not an index file: test/tmp/indexed.out",
+        err_msg);
+}
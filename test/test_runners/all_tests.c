@@ -6,6 +6,25 @@ static void RunAllTests(void)
     RUN_TEST_GROUP(parse_layout_file);
     RUN_TEST_GROUP(parse_data_file);
     RUN_TEST_GROUP(Stream);
+    RUN_TEST_GROUP(Lookup);
+    RUN_TEST_GROUP(format_double);
+    RUN_TEST_GROUP(read_block);
+    RUN_TEST_GROUP(decode);
+    RUN_TEST_GROUP(label_index);
+    RUN_TEST_GROUP(LabelPool);
+    RUN_TEST_GROUP(Stats);
+    RUN_TEST_GROUP(Filter);
+    RUN_TEST_GROUP(ArrowWriter);
+    RUN_TEST_GROUP(Bgzf);
+    RUN_TEST_GROUP(result_index);
+    RUN_TEST_GROUP(convert_batch);
+    RUN_TEST_GROUP(merge_result_sets);
+    RUN_TEST_GROUP(Reader);
+    RUN_TEST_GROUP(Histogram);
+    RUN_TEST_GROUP(TileCache);
+    RUN_TEST_GROUP(serve_queries);
+    RUN_TEST_GROUP(TopK);
+    RUN_TEST_GROUP(trait_summary);
 }
 
 int main(int argc, const char *argv[])
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(ArrowWriter)
+{
+    RUN_TEST_CASE(ArrowWriter, schema);
+    RUN_TEST_CASE(ArrowWriter, dictionaries);
+    RUN_TEST_CASE(ArrowWriter, record_batches);
+    RUN_TEST_CASE(ArrowWriter, one_batch_per_tile);
+}
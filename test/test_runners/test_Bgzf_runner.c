@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Bgzf)
+{
+    RUN_TEST_CASE(Bgzf, write_and_read_blocks);
+    RUN_TEST_CASE(Bgzf, first_line_of_every_block);
+    RUN_TEST_CASE(Bgzf, write_through_stream);
+    RUN_TEST_CASE(Bgzf, read_non_bgzf_file);
+}
@@ -0,0 +1,13 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Filter)
+{
+    RUN_TEST_CASE(Filter, comparisons);
+    RUN_TEST_CASE(Filter, arithmetic_and_precedence);
+    RUN_TEST_CASE(Filter, logical_operators);
+    RUN_TEST_CASE(Filter, functions);
+    RUN_TEST_CASE(Filter, all_columns_and_short_batch);
+    RUN_TEST_CASE(Filter, evaluate_values);
+    RUN_TEST_CASE(Filter, errors);
+    RUN_TEST_CASE(Filter, nesting_limit);
+}
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Histogram)
+{
+    RUN_TEST_CASE(Histogram, empty_histogram_gives_zeros);
+    RUN_TEST_CASE(Histogram, small_values_are_exact);
+    RUN_TEST_CASE(Histogram, percentiles_are_within_one_percent);
+    RUN_TEST_CASE(Histogram, record_largest_values);
+}
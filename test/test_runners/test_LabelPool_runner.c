@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(LabelPool)
+{
+    RUN_TEST_CASE(LabelPool, get_labels_with_lengths);
+    RUN_TEST_CASE(LabelPool, pool_holds_one_tile);
+    RUN_TEST_CASE(LabelPool, labels_stay_in_layout_if_malloc_fails);
+    RUN_TEST_CASE(LabelPool, labels_are_at_most_max_char_long);
+    RUN_TEST_CASE(LabelPool, return_null_if_malloc_fails);
+}
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Lookup)
+{
+    RUN_TEST_CASE(Lookup, read_ranges_in_any_order);
+    RUN_TEST_CASE(Lookup, read_past_end_of_file_gives_error);
+    RUN_TEST_CASE(Lookup, retry_while_kernel_is_busy);
+    RUN_TEST_CASE(Lookup, failed_submission_gives_error);
+}
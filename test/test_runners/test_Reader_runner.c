@@ -0,0 +1,11 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Reader)
+{
+    RUN_TEST_CASE(Reader, get_records_by_snp_and_trait);
+    RUN_TEST_CASE(Reader, get_records_in_single_precision);
+    RUN_TEST_CASE(Reader, get_tiles_in_file_order);
+    RUN_TEST_CASE(Reader, errors_belong_to_reader);
+    RUN_TEST_CASE(Reader, truncated_data_file_gives_error);
+    RUN_TEST_CASE(Reader, many_threads_read_at_once);
+}
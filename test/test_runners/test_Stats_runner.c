@@ -0,0 +1,12 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Stats)
+{
+    RUN_TEST_CASE(Stats, phases_and_records_add_up);
+    RUN_TEST_CASE(Stats, report_progress_in_tiles);
+    RUN_TEST_CASE(Stats, report_progress_of_selection);
+    RUN_TEST_CASE(Stats, report_progress_in_result_sets);
+    RUN_TEST_CASE(Stats, print_summary_as_json);
+    RUN_TEST_CASE(Stats, null_stats_do_nothing);
+    RUN_TEST_CASE(Stats, return_null_if_malloc_fails);
+}
@@ -8,4 +8,10 @@ TEST_GROUP_RUNNER(Stream)
     RUN_TEST_CASE(Stream, chunk_size_can_be_changed);
     RUN_TEST_CASE(Stream, chunks_sizes_of_different_streams_are_independent);
     RUN_TEST_CASE(Stream, return_null_if_malloc_fails);
+    RUN_TEST_CASE(Stream, default_record_size_is_one);
+    RUN_TEST_CASE(Stream, record_size_can_be_changed);
+    RUN_TEST_CASE(Stream, close_reports_failure_to_close_file);
+    RUN_TEST_CASE(Stream, read_records_in_chunks);
+    RUN_TEST_CASE(Stream, close_before_end_of_file);
+    RUN_TEST_CASE(Stream, missing_file_gives_error);
 }
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(TileCache)
+{
+    RUN_TEST_CASE(TileCache, get_tiles_that_were_put);
+    RUN_TEST_CASE(TileCache, evict_least_recently_used_tile);
+    RUN_TEST_CASE(TileCache, keep_tile_larger_than_cache);
+    RUN_TEST_CASE(TileCache, find_many_tiles);
+}
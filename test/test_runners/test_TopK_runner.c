@@ -0,0 +1,8 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(TopK)
+{
+    RUN_TEST_CASE(TopK, keep_highest_scores);
+    RUN_TEST_CASE(TopK, ties_go_to_smaller_snps);
+    RUN_TEST_CASE(TopK, merge_parts);
+}
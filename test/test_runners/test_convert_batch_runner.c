@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(convert_batch)
+{
+    RUN_TEST_CASE(convert_batch, read_manifest);
+    RUN_TEST_CASE(convert_batch, empty_manifest_gives_error);
+    RUN_TEST_CASE(convert_batch, convert_into_separate_files);
+    RUN_TEST_CASE(convert_batch, concatenate_under_one_header);
+    RUN_TEST_CASE(convert_batch, different_columns_give_error);
+}
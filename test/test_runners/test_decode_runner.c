@@ -0,0 +1,7 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(decode)
+{
+    RUN_TEST_CASE(decode, all_kernels_give_native_doubles);
+    RUN_TEST_CASE(decode, no_decoder_for_unsupported_sizes);
+}
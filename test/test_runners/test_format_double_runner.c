@@ -0,0 +1,12 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(format_double)
+{
+    RUN_TEST_CASE(format_double, special_values_match_printf);
+    RUN_TEST_CASE(format_double, ties_round_to_even);
+    RUN_TEST_CASE(format_double, infinity_and_nan);
+    RUN_TEST_CASE(format_double, random_bits_match_printf);
+    RUN_TEST_CASE(format_double, typical_values_match_printf);
+    RUN_TEST_CASE(format_double, shortest_round_trips);
+    RUN_TEST_CASE(format_double, shortest_special_values);
+}
@@ -0,0 +1,9 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(label_index)
+{
+    RUN_TEST_CASE(label_index, lookup_finds_labels);
+    RUN_TEST_CASE(label_index, lookup_in_large_index);
+    RUN_TEST_CASE(label_index, read_label_file);
+    RUN_TEST_CASE(label_index, unknown_label_gives_error);
+}
@@ -0,0 +1,15 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(merge_result_sets)
+{
+    RUN_TEST_CASE(merge_result_sets, merge_by_snps);
+    RUN_TEST_CASE(merge_result_sets, merge_by_traits);
+    RUN_TEST_CASE(merge_result_sets, merge_with_threads);
+    RUN_TEST_CASE(merge_result_sets, merge_single_precision);
+    RUN_TEST_CASE(merge_result_sets, merge_in_small_units);
+    RUN_TEST_CASE(merge_result_sets, retile_to_one_trait_per_tile);
+    RUN_TEST_CASE(merge_result_sets, different_columns_give_error);
+    RUN_TEST_CASE(merge_result_sets, unrelated_result_sets_give_error);
+    RUN_TEST_CASE(merge_result_sets, duplicate_labels_give_error);
+    RUN_TEST_CASE(merge_result_sets, missing_result_set_gives_error);
+}
@@ -7,9 +7,35 @@ TEST_GROUP_RUNNER(parse_command_line_args)
     RUN_TEST_CASE(parse_command_line_args, long_digits_without_equal);
     RUN_TEST_CASE(parse_command_line_args, long_digits_with_equal);
     RUN_TEST_CASE(parse_command_line_args, short_digits);
+    RUN_TEST_CASE(parse_command_line_args, shortest_digits);
     RUN_TEST_CASE(parse_command_line_args, bad_digits_gives_error);
     RUN_TEST_CASE(parse_command_line_args, digits_over_100_gives_error);
     RUN_TEST_CASE(parse_command_line_args, digits_under_0_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, negative_digits_give_error);
+    RUN_TEST_CASE(parse_command_line_args, threads_are_set);
+    RUN_TEST_CASE(parse_command_line_args, zero_threads_give_error);
+    RUN_TEST_CASE(parse_command_line_args, huge_threads_give_error);
+    RUN_TEST_CASE(parse_command_line_args, order_and_max_memory_are_set);
+    RUN_TEST_CASE(parse_command_line_args, bad_order_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, bad_max_memory_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, label_files_are_set);
+    RUN_TEST_CASE(parse_command_line_args, io_report_is_set);
+    RUN_TEST_CASE(parse_command_line_args, format_is_set);
+    RUN_TEST_CASE(parse_command_line_args, bad_format_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, arrow_in_trait_order_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, compress_is_set);
+    RUN_TEST_CASE(parse_command_line_args, bad_compress_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, compressed_arrow_gives_error);
+    RUN_TEST_CASE(parse_command_line_args, queue_depth_is_set);
+    RUN_TEST_CASE(parse_command_line_args, stats_is_set);
+    RUN_TEST_CASE(parse_command_line_args, endian_is_set);
+    RUN_TEST_CASE(parse_command_line_args, manifest_replaces_file);
+    RUN_TEST_CASE(parse_command_line_args, merge_takes_files);
+    RUN_TEST_CASE(parse_command_line_args, retile_takes_file_and_tiles);
+    RUN_TEST_CASE(parse_command_line_args, serve_takes_file_and_socket);
+    RUN_TEST_CASE(parse_command_line_args, top_k_is_set);
+    RUN_TEST_CASE(parse_command_line_args, summary_is_set);
+    RUN_TEST_CASE(parse_command_line_args, zero_queue_depth_gives_error);
     RUN_TEST_CASE(parse_command_line_args, output_file_is_set);
     RUN_TEST_CASE(parse_command_line_args, column_labels_are_set);
     RUN_TEST_CASE(parse_command_line_args, missing_column_label_argument_gives_error);
@@ -6,4 +6,22 @@ TEST_GROUP_RUNNER(parse_data_file)
     RUN_TEST_CASE(parse_data_file, index2offset);
     RUN_TEST_CASE(parse_data_file, index2offset_is_reverse_of_offset2index);
     RUN_TEST_CASE(parse_data_file, offset2index_is_reverse_of_index2offset);
+    RUN_TEST_CASE(parse_data_file, offsets_beyond_2_to_the_32);
+    RUN_TEST_CASE(parse_data_file, tile_cursor);
+    RUN_TEST_CASE(parse_data_file, tile_cursor_beyond_2_to_the_32);
+    RUN_TEST_CASE(parse_data_file, convert_sparse_data_file_beyond_2_to_the_31);
+    RUN_TEST_CASE(parse_data_file, convert_sparse_data_file_beyond_2_to_the_32);
+    RUN_TEST_CASE(parse_data_file, convert_mapped_data_file);
+    RUN_TEST_CASE(parse_data_file, convert_buffered_data_file);
+    RUN_TEST_CASE(parse_data_file, convert_with_threads);
+    RUN_TEST_CASE(parse_data_file, truncated_data_file_gives_error);
+    RUN_TEST_CASE(parse_data_file, convert_in_trait_and_snp_order);
+    RUN_TEST_CASE(parse_data_file, truncated_data_file_gives_error_in_trait_order);
+    RUN_TEST_CASE(parse_data_file, convert_selected_snps_and_traits);
+    RUN_TEST_CASE(parse_data_file, unknown_snp_gives_error);
+    RUN_TEST_CASE(parse_data_file, convert_with_filter);
+    RUN_TEST_CASE(parse_data_file, convert_skipping_unused_columns);
+    RUN_TEST_CASE(parse_data_file, convert_top_k);
+    RUN_TEST_CASE(parse_data_file, convert_summary);
+    RUN_TEST_CASE(parse_data_file, convert_float32_and_byte_swapped_data_files);
 }
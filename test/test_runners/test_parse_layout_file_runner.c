@@ -3,6 +3,10 @@
 TEST_GROUP_RUNNER(parse_layout_file)
 {
     RUN_TEST_CASE(parse_layout_file, write_and_read_back_layout_file);
+    RUN_TEST_CASE(parse_layout_file, labels_stay_in_layout_file);
+    RUN_TEST_CASE(parse_layout_file, read_byte_swapped_layout_file);
+    RUN_TEST_CASE(parse_layout_file, truncated_layout_file_gives_error);
+    RUN_TEST_CASE(parse_layout_file, too_many_records);
     RUN_TEST_CASE(parse_layout_file, bad_magic_number);
     RUN_TEST_CASE(parse_layout_file, bad_bytes_per_double);
     RUN_TEST_CASE(parse_layout_file, bad_number_of_covariates);
@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(read_block)
+{
+    RUN_TEST_CASE(read_block, blocks_from_mapping);
+    RUN_TEST_CASE(read_block, blocks_from_file);
+    RUN_TEST_CASE(read_block, short_file_gives_error);
+    RUN_TEST_CASE(read_block, projection_spans);
+    RUN_TEST_CASE(read_block, records_through_projection);
+}
@@ -0,0 +1,8 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(result_index)
+{
+    RUN_TEST_CASE(result_index, fetch_lines);
+    RUN_TEST_CASE(result_index, fetch_filtered_line);
+    RUN_TEST_CASE(result_index, bad_index_file);
+}
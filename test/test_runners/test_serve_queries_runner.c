@@ -0,0 +1,10 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(serve_queries)
+{
+    RUN_TEST_CASE(serve_queries, answer_queries_and_report_stats);
+    RUN_TEST_CASE(serve_queries, answer_queries_with_small_cache);
+    RUN_TEST_CASE(serve_queries, bad_query_gives_error);
+    RUN_TEST_CASE(serve_queries, serve_several_clients);
+    RUN_TEST_CASE(serve_queries, missing_result_set_gives_error);
+}
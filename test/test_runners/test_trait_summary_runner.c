@@ -0,0 +1,11 @@
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(trait_summary)
+{
+    RUN_TEST_CASE(trait_summary, count_hits_and_bins);
+    RUN_TEST_CASE(trait_summary, null_statistics);
+    RUN_TEST_CASE(trait_summary, merge_parts);
+    RUN_TEST_CASE(trait_summary, inflated_statistics);
+    RUN_TEST_CASE(trait_summary, empty_summary);
+    RUN_TEST_CASE(trait_summary, minus_log10_p);
+}
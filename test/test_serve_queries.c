@@ -0,0 +1,180 @@
+#include "unity_fixture.h"
+#include "ResultSetFixture.h"
+#include "serve_queries.h"
+#include "err_msg.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/* Every test serves the result set of ResultSetFixture.h in tiles of
+   3 snps by 2 traits on a thread of its own. */
+enum { NSNP = FIXTURE_NSNP, NTRAIT = FIXTURE_NTRAIT,
+    NVALUE = FIXTURE_NVALUE };
+
+static char *inputs[] = {"test/tmp/serve"};
+static char socket_path[] = "test/tmp/serve.sock";
+
+static struct Params params;
+static pthread_t server;
+static int served;              /* return value of serve_queries */
+static int fd;                  /* client socket */
+
+static double value(int snp, int trait, int j)
+{
+    return ResultSetFixture_Value(snp, trait, j);
+}
+
+static void *run_server(void *arg)
+{
+    (void) arg;
+    served = serve_queries(&params);
+    return NULL;
+}
+
+/* Start the server and connect to it once it listens. */
+static void start_server(void)
+{
+    struct timespec ts = {0, 1000000};
+    int i;
+
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&server, NULL, run_server,
+            NULL));
+    for (i = 0; i < 5000  &&  (fd = serve_connect(socket_path)) == -1;
+         i++)
+        nanosleep(&ts, NULL);
+    TEST_ASSERT_TRUE_MESSAGE(fd != -1, err_msg);
+}
+
+static void stop_server(void)
+{
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, serve_shutdown(fd), err_msg);
+    close(fd);
+    fd = -1;
+    pthread_join(server, NULL);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, served, err_msg);
+    TEST_ASSERT_EQUAL_INT(-1, access(socket_path, F_OK));
+}
+
+TEST_GROUP(serve_queries);
+
+TEST_SETUP(serve_queries)
+{
+    initialize_parameters(&params);
+    params.command = COMMAND_SERVE;
+    params.inputs = inputs;
+    params.ninput = 1;
+    params.socket_path = socket_path;
+    ResultSetFixture_Write(inputs[0], 0, NSNP, 0, NTRAIT, 3, 2, 8);
+    fd = -1;
+}
+
+TEST_TEAR_DOWN(serve_queries)
+{
+    ResultSetFixture_Remove("test/tmp/serve");
+    clear_err_msg();
+}
+
+/* Ask for two columns of every record, in an order unlike the file
+   order, and compare with the expected values. */
+static void assert_all_records_served(void)
+{
+    static const uint32_t columns[] = {4, 0};
+    int32_t queries[2 * NSNP * NTRAIT];
+    double values[2 * NSNP * NTRAIT];
+    int i, snp, trait;
+
+    for (i = 0; i < NSNP * NTRAIT; i++) {
+        queries[2 * i] = i % NSNP;
+        queries[2 * i + 1] = NTRAIT - 1 - i / NSNP;
+    }
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, serve_query(fd, 2, columns,
+            NSNP * NTRAIT, queries, values), err_msg);
+    for (i = 0; i < NSNP * NTRAIT; i++) {
+        snp = queries[2 * i];
+        trait = queries[2 * i + 1];
+        TEST_ASSERT_EQUAL_DOUBLE(value(snp, trait, 4), values[2 * i]);
+        TEST_ASSERT_EQUAL_DOUBLE(value(snp, trait, 0), values[2 * i + 1]);
+    }
+}
+
+TEST(serve_queries, answer_queries_and_report_stats)
+{
+    double stats[SERVE_NSTAT];
+
+    start_server();
+    assert_all_records_served();
+    assert_all_records_served();
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, serve_stats(fd, stats), err_msg);
+    TEST_ASSERT_EQUAL_DOUBLE(2, stats[SERVE_STAT_QUERIES]);
+    TEST_ASSERT_EQUAL_DOUBLE(2 * NSNP * NTRAIT, stats[SERVE_STAT_RECORDS]);
+    TEST_ASSERT_TRUE(stats[SERVE_STAT_P50] > 0);
+    TEST_ASSERT_TRUE(stats[SERVE_STAT_P50] <= stats[SERVE_STAT_P99]);
+    TEST_ASSERT_TRUE(stats[SERVE_STAT_P99] <= stats[SERVE_STAT_MAX]);
+    TEST_ASSERT_EQUAL_DOUBLE(9, stats[SERVE_STAT_MISSES]);
+    TEST_ASSERT_EQUAL_DOUBLE(2 * NSNP * NTRAIT - 9, stats[SERVE_STAT_HITS]);
+    TEST_ASSERT_EQUAL_DOUBLE(9, stats[SERVE_STAT_TILES]);
+    stop_server();
+}
+
+/* Test that a cache of a single tile still gives the right records. */
+TEST(serve_queries, answer_queries_with_small_cache)
+{
+    double stats[SERVE_NSTAT];
+
+    params.max_memory = 1;
+    start_server();
+    assert_all_records_served();
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, serve_stats(fd, stats), err_msg);
+    TEST_ASSERT_EQUAL_DOUBLE(1, stats[SERVE_STAT_TILES]);
+    stop_server();
+}
+
+/* Test that a bad query gives an error and the client can go on. */
+TEST(serve_queries, bad_query_gives_error)
+{
+    uint32_t column = 0, bad_column = NVALUE;
+    int32_t queries[] = {0, 0, 3, NTRAIT};
+    double values[2];
+
+    start_server();
+    TEST_ASSERT_EQUAL_INT(0, serve_query(fd, 1, &column, 2, queries,
+            values));
+    TEST_ASSERT_EQUAL_STRING("trait index out of range: 5", err_msg);
+    TEST_ASSERT_EQUAL_INT(0, serve_query(fd, 1, &bad_column, 1, queries,
+            values));
+    TEST_ASSERT_EQUAL_STRING("column index out of range: 5", err_msg);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, serve_query(fd, 1, &column, 1,
+            queries, values), err_msg);
+    TEST_ASSERT_EQUAL_DOUBLE(0, values[0]);
+    stop_server();
+}
+
+/* Test that several clients are served at once and that a client that
+   is still connected doesn't keep the server from shutting down. */
+TEST(serve_queries, serve_several_clients)
+{
+    int other;
+
+    start_server();
+    TEST_ASSERT_TRUE_MESSAGE((other = serve_connect(socket_path)) != -1,
+        err_msg);
+    assert_all_records_served();
+    TEST_ASSERT_EQUAL_INT(1, serve_shutdown(other));
+    close(other);
+    TEST_ASSERT_EQUAL_INT(0, serve_query(fd, 0, NULL, 0, NULL, NULL));
+    close(fd);
+    pthread_join(server, NULL);
+    TEST_ASSERT_EQUAL_INT_MESSAGE(1, served, err_msg);
+}
+
+TEST(serve_queries, missing_result_set_gives_error)
+{
+    inputs[0] = "test/tmp/missing";
+    served = serve_queries(&params);
+    inputs[0] = "test/tmp/serve";
+    TEST_ASSERT_EQUAL_INT(0, served);
+    TEST_ASSERT_EQUAL_STRING("failed to open layout file for reading: "
+        "test/tmp/missing.iout", err_msg);
+}
@@ -0,0 +1,137 @@
+#include "unity_fixture.h"
+#include "trait_summary.h"
+#include <math.h>
+#include <string.h>
+
+static struct SummaryEdges edges;
+static struct TraitSummary s;
+
+/* Return a standard normal deviate from the generator state *seed. */
+static double normal(unsigned long long *seed)
+{
+    double u, v;
+
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    u = ((*seed >> 11) + 0.5) / 9007199254740992.0;
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    v = ((*seed >> 11) + 0.5) / 9007199254740992.0;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+TEST_GROUP(trait_summary);
+
+TEST_SETUP(trait_summary)
+{
+    init_summary_edges(&edges);
+    memset(&s, 0, sizeof s);
+}
+
+TEST_TEAR_DOWN(trait_summary)
+{
+}
+
+/* Test that hits and histogram bins count the right p-values. */
+TEST(trait_summary, count_hits_and_bins)
+{
+    int k;
+
+    add_to_trait_summary(&s, &edges, 0.0);      /* p = 1 */
+    add_to_trait_summary(&s, &edges, -2.0);     /* p = 0.0455 */
+    add_to_trait_summary(&s, &edges, 6.0);      /* p = 1.97e-9 */
+    add_to_trait_summary(&s, &edges, NAN);
+
+    TEST_ASSERT_EQUAL_INT(3, (int) s.n);
+    TEST_ASSERT_EQUAL_DOUBLE(36.0, s.max_chi2);
+    for (k = 0; k < SUMMARY_NHIT; k++)
+        TEST_ASSERT_EQUAL_INT(k < 4, (int) s.hits[k]);
+    for (k = 0; k < SUMMARY_NHIST; k++)
+        TEST_ASSERT_EQUAL_INT(k == 0 || k == 1 || k == 8, (int) s.hist[k]);
+
+    /* Beyond 1e-20, records fall into the last bin. */
+    add_to_trait_summary(&s, &edges, 30.0);
+    TEST_ASSERT_EQUAL_INT(1, (int) s.hist[SUMMARY_NHIST - 1]);
+    TEST_ASSERT_EQUAL_INT(1, (int) s.hits[SUMMARY_NHIT - 1]);
+}
+
+/* Test that lambda and the QQ points of null statistics are close to
+   what we expect. */
+TEST(trait_summary, null_statistics)
+{
+    unsigned long long seed = 42;
+    int i;
+
+    for (i = 0; i < 200000; i++)
+        add_to_trait_summary(&s, &edges, normal(&seed));
+    TEST_ASSERT_TRUE(fabs(trait_summary_lambda(&s) - 1) < 0.02);
+    TEST_ASSERT_TRUE(fabs(trait_summary_qq(&s, 1) - 1) < 0.05);
+    TEST_ASSERT_TRUE(fabs(trait_summary_qq(&s, 3) - 3) < 0.2);
+    TEST_ASSERT_TRUE(isnan(trait_summary_qq(&s, 6)));
+
+    /* Doubling every statistic inflates chi-square fourfold. */
+    memset(&s, 0, sizeof s);
+    for (i = 0; i < 200000; i++)
+        add_to_trait_summary(&s, &edges, 2 * normal(&seed));
+    TEST_ASSERT_TRUE(fabs(trait_summary_lambda(&s) - 4) < 0.08);
+}
+
+/* Test that merging the summaries of parts gives the summary of the
+   whole. */
+TEST(trait_summary, merge_parts)
+{
+    struct TraitSummary a, b;
+    unsigned long long seed = 7;
+    double z;
+    int i;
+
+    memset(&a, 0, sizeof a);
+    memset(&b, 0, sizeof b);
+    for (i = 0; i < 10000; i++) {
+        z = 3 * normal(&seed);
+        add_to_trait_summary(&s, &edges, z);
+        add_to_trait_summary(i % 3 ? &a : &b, &edges, z);
+    }
+    merge_trait_summary(&a, &b);
+    TEST_ASSERT_EQUAL_INT(0, memcmp(&a, &s, sizeof s));
+}
+
+/* Test lambda of strongly inflated statistics, whose median lies
+   above 2^11, and that quantiles beyond the sketch are unknown. */
+TEST(trait_summary, inflated_statistics)
+{
+    unsigned long long seed = 3;
+    int i;
+
+    for (i = 0; i < 100000; i++)
+        add_to_trait_summary(&s, &edges, 100 * normal(&seed));
+    TEST_ASSERT_TRUE(trait_summary_quantile(&s, 0.5) > 2048);
+    TEST_ASSERT_TRUE(fabs(trait_summary_lambda(&s) / 1e4 - 1) < 0.03);
+    TEST_ASSERT_TRUE(isfinite(trait_summary_qq(&s, 1)));
+
+    memset(&s, 0, sizeof s);
+    for (i = 0; i < 100000; i++)
+        add_to_trait_summary(&s, &edges, 1000 * normal(&seed));
+    TEST_ASSERT_TRUE(isnan(trait_summary_lambda(&s)));
+    TEST_ASSERT_TRUE(isnan(trait_summary_qq(&s, 1)));
+}
+
+/* Test that an empty summary has no statistics to report. */
+TEST(trait_summary, empty_summary)
+{
+    TEST_ASSERT_TRUE(isnan(trait_summary_lambda(&s)));
+    TEST_ASSERT_TRUE(isnan(trait_summary_qq(&s, 1)));
+}
+
+/* Test -log10(p) on both sides of the switch to the asymptotic
+   expansion. */
+TEST(trait_summary, minus_log10_p)
+{
+    double below, above;
+
+    TEST_ASSERT_EQUAL_DOUBLE(0.0, minus_log10_p(0.0));
+    TEST_ASSERT_TRUE(fabs(minus_log10_p(-5.326724) - 7) < 1e-5);
+    below = minus_log10_p(26 * M_SQRT2 - 1e-9);
+    above = minus_log10_p(26 * M_SQRT2 + 1e-9);
+    TEST_ASSERT_TRUE(fabs(above - below) < 1e-6 * below);
+    TEST_ASSERT_TRUE(minus_log10_p(100) > 2000);
+    TEST_ASSERT_TRUE(isfinite(minus_log10_p(1e10)));
+}